@@ -1,12 +1,17 @@
 #ifndef B_PLUS_TREE_H_
 #define B_PLUS_TREE_H_
 
+#include <algorithm>
 #include <limits>
 #include <queue>
+#include <stdexcept>
+#include <vector>
 
 #include "b_plus_tree_base.h"
+#include "b_plus_tree_diff.h"
 #include "b_plus_tree_iterator.h"
 #include "b_plus_tree_nodes.h"
+#include "b_plus_tree_snapshot.h"
 #include "b_plus_tree_transaction.h"
 #include "blob_store.h"
 #include "blob_store_transaction.h"
@@ -34,26 +39,61 @@ struct InsertionBundle {
   BlobStoreObject<NodeType> new_right_node;
 };
 
-template <typename KeyType, typename ValueType, std::size_t Order>
+template <typename SecondaryKeyType,
+          typename KeyType,
+          typename ValueType,
+          std::size_t Order>
+class SecondaryIndex;
+
+// RebalancePolicy controls when deletes rebalance the tree.
+enum class RebalancePolicy {
+  // Keeps every node but the root at least half full by borrowing from or
+  // merging with a sibling before descending into a minimal child.
+  kEager,
+  // Only rebalances a child that would become empty, so most deletes only
+  // rewrite the path to their leaf. Nodes may be left underfull until
+  // Compact repacks them.
+  kLazy,
+};
+
+// AggregateType is the aggregate the tree keeps over its values, see
+// b_plus_tree_aggregate.h. It defaults to NoAggregate.
+template <typename KeyType,
+          typename ValueType,
+          std::size_t Order,
+          typename AggregateType>
 class BPlusTree : public BPlusTreeBase<KeyType, ValueType, Order> {
  private:
   using BaseNode = BaseNode<Order>;
-  using InternalNode = InternalNode<Order>;
-  using LeafNode = LeafNode<Order>;
+  using InternalNode = InternalNode<Order, AggregateType>;
+  using LeafNode = LeafNode<Order, KeyType>;
   using Transaction = BPlusTreeBase<KeyType, ValueType, Order>::Transaction;
   using HeadNode = blob_store::HeadNode;
+  using SecondaryIndexBase = SecondaryIndexBase<KeyType, ValueType>;
 
   using InsertionBundle = InsertionBundle<KeyType, BaseNode>;
   using Iterator = TreeIterator<KeyType, ValueType, Order>;
+  using PathToRoot = typename Iterator::PathToRoot;
+  using Snapshot = Snapshot<KeyType, ValueType, Order, AggregateType>;
+  using TreeDiff = TreeDiff<KeyType, ValueType, Order>;
 
  public:
-  BPlusTree(BlobStore& blob_store) : blob_store_(blob_store) {
+  using AggregateValue = typename AggregateType::ValueType;
+
+  static_assert(std::is_trivially_copyable<AggregateValue>::value,
+                "Aggregates are stored in nodes and must be trivially "
+                "copyable");
+
+  BPlusTree(BlobStore& blob_store)
+      : blob_store_(blob_store), root_slot_(BlobStore::InvalidIndex) {
     CreateRootIfNecessary();
   }
 
   Transaction CreateTransaction() {
     // TODO(fsamuel): The head index should not be fixed.
-    return Transaction(this, &blob_store_, 1);
+    Transaction transaction(this, &blob_store_, 1);
+    transaction.set_observer(observer_);
+    return transaction;
   }
 
   // BPlusTreeBase implementation.
@@ -77,11 +117,102 @@ class BPlusTree : public BPlusTreeBase<KeyType, ValueType, Order> {
   // deleted_value is not null, the deleted value is stored in deleted_value.
   BlobStoreObject<const ValueType> Delete(const KeyType& key);
 
+  // Packs the tree's nodes closer to full, reclaiming the space left behind
+  // by lazy deletes. Compaction sweeps up the tree a level at a time, and
+  // each step replaces the children of one node with as few nodes as hold
+  // them. Sweeps repeat until one finds nothing to repack.
+  // Only the nodes a step replaces and the path to them are rewritten; keys
+  // and values are shared with the previous version.
+  //
+  // Compact() commits every step in a transaction of its own, so writers can
+  // run alongside it and a conflict only retries one step. Nodes that
+  // writers underfill behind the compaction are left as they are.
+  // Compact(transaction) runs every step in the provided transaction.
+  void Compact();
+  void Compact(Transaction* transaction);
+
+  // Returns the number of keys in the tree.
+  size_t Size();
+
+  // Returns the number of keys in the tree that are less than key. Internal
+  // nodes count the entries under each of their children, so this takes a
+  // single descent rather than a walk over the leaves.
+  size_t Rank(const KeyType& key);
+
+  // Returns an iterator to the key at position k in ascending order, starting
+  // at 0, or an invalid iterator if the tree holds k keys or fewer.
+  Iterator Select(size_t k);
+
+  // Returns the number of keys in [lo, hi).
+  size_t Count(const KeyType& lo, const KeyType& hi);
+
+  // Returns the aggregate of the values of the keys in [lo, hi), combined in
+  // key order. Internal nodes keep the aggregate of each of their subtrees,
+  // so only the nodes on the paths to lo and hi are read.
+  AggregateValue Aggregate(const KeyType& lo, const KeyType& hi);
+
+  // Opens a read-only view of the tree as of the provided committed version.
+  // The version's head is located through the head's history index in
+  // O(log(n)) steps. The returned snapshot is invalid if the version doesn't
+  // exist.
+  Snapshot OpenSnapshot(size_t version);
+
+  // Reports every key whose entry differs between from_version and to_version
+  // to visitor in ascending key order. Subtrees shared by both versions are
+  // skipped. Returns false if either version doesn't exist.
+  bool Diff(size_t from_version,
+            size_t to_version,
+            const typename TreeDiff::Visitor& visitor);
+
   // Prints the tree in a human-readable format in breadth-first order.
   void Print(size_t version = std::numeric_limits<size_t>::max());
 
+  // Registers a secondary index that is updated within every transaction that
+  // inserts into or deletes from this tree. Indexes must be registered before
+  // the tree is used concurrently. The index is not owned by the tree.
+  void AddSecondaryIndex(SecondaryIndexBase* index) {
+    secondary_indexes_.push_back(index);
+  }
+
+  // Unregisters a secondary index previously passed to AddSecondaryIndex.
+  void RemoveSecondaryIndex(SecondaryIndexBase* index) {
+    secondary_indexes_.erase(std::remove(secondary_indexes_.begin(),
+                                         secondary_indexes_.end(), index),
+                             secondary_indexes_.end());
+  }
+
+  // Sets the observer notified of every transaction of this tree that commits,
+  // e.g. a ReplicationLeader. The observer is not owned by the tree.
+  void SetTransactionObserver(blob_store::TransactionObserver* observer) {
+    observer_ = observer;
+  }
+
+  // Sets when deletes rebalance the tree. Defaults to RebalancePolicy::kEager.
+  // Either policy can operate on a tree built under the other.
+  void SetRebalancePolicy(RebalancePolicy policy) {
+    rebalance_policy_ = policy;
+  }
+
  private:
+  template <typename SecondaryKeyType,
+            typename PrimaryKeyType,
+            typename PrimaryValueType,
+            std::size_t PrimaryOrder>
+  friend class SecondaryIndex;
+  friend Snapshot;
+
+  // Creates a tree rooted at the provided secondary root slot of the head.
+  // The slot's root is created by the owning SecondaryIndex.
+  BPlusTree(BlobStore& blob_store, size_t root_slot)
+      : blob_store_(blob_store), root_slot_(root_slot) {}
+
   BlobStore& blob_store_;
+  // The secondary root slot of the head this tree lives in or InvalidIndex if
+  // this tree is rooted at the head's primary root.
+  const size_t root_slot_;
+  std::vector<SecondaryIndexBase*> secondary_indexes_;
+  blob_store::TransactionObserver* observer_ = nullptr;
+  RebalancePolicy rebalance_policy_ = RebalancePolicy::kEager;
 
   void CreateRootIfNecessary() {
     // TODO(fsamuel): This needs to be revamped. Can we have multiple B+ trees
@@ -92,25 +223,183 @@ class BPlusTree : public BPlusTreeBase<KeyType, ValueType, Order> {
       auto root = blob_store_.New<LeafNode>();
       head->root_index = root.Index();
       head->previous = BlobStore::InvalidIndex;
+      return;
+    }
+    // Persisted key hashes are only usable with the hash function that
+    // produced them.
+    BlobStoreObject<const HeadNode> head = blob_store_.Get<HeadNode>(1);
+    if (head != nullptr && head->hash_version != hashing::kHashVersion) {
+      throw std::runtime_error(
+          "BPlusTree: the store was built with a different hash version");
+    }
+  }
+
+  // Returns the index of this tree's root within the provided head.
+  size_t GetRootIndex(const HeadNode& head) const {
+    return root_slot_ == BlobStore::InvalidIndex
+               ? head.root_index
+               : head.secondary_roots[root_slot_];
+  }
+
+  // Returns the root of the latest committed version of this tree.
+  BlobStoreObject<const BaseNode> GetCommittedRoot() {
+    // Reads don't need a transaction: the latest committed root is immutable.
+    // TODO(fsamuel): The head index should not be fixed.
+    return blob_store_.Get<BaseNode>(
+        GetRootIndex(*blob_store_.Get<HeadNode>(1)));
+  }
+
+  // Returns the root of this tree as seen by the provided transaction.
+  BlobStoreObject<const BaseNode> GetRoot(
+      blob_store::Transaction* transaction) const {
+    if (root_slot_ == BlobStore::InvalidIndex) {
+      return transaction->GetRootNode<BaseNode>();
+    }
+    return transaction->GetSecondaryRootNode<BaseNode>(root_slot_);
+  }
+
+  // Sets the root of this tree within the provided transaction.
+  void SetRoot(blob_store::Transaction* transaction, size_t index) {
+    if (root_slot_ == BlobStore::InvalidIndex) {
+      transaction->SetRootNode(index);
+    } else {
+      transaction->SetSecondaryRootNode(root_slot_, index);
+    }
+  }
+
+  // Returns an iterator to the smallest key in the tree as seen by the
+  // provided transaction.
+  Iterator First(blob_store::Transaction* transaction) {
+    return First(GetRoot(transaction));
+  }
+
+  // Returns an iterator to the smallest key in the subtree rooted at node.
+  Iterator First(BlobStoreObject<const BaseNode> node) {
+    PathToRoot path_to_root;
+    while (node->is_internal()) {
+      path_to_root.push_back(node.Index());
+      GetChild(std::move(node).To<InternalNode>(), 0, &node);
     }
+    path_to_root.push_back(node.Index());
+    return Iterator(&blob_store_, path_to_root, 0);
   }
 
+  // Inserts key and value into the tree without notifying secondary indexes.
+  void InsertIntoTree(blob_store::Transaction* transaction,
+                      BlobStoreObject<const KeyType> key,
+                      BlobStoreObject<const ValueType> value);
+
+  // Deletes key from the tree without notifying secondary indexes. If
+  // deleted_key is not null and the key was found, it receives the index of
+  // the blob of the removed key.
+  BlobStoreObject<const ValueType> DeleteFromTree(
+      blob_store::Transaction* transaction,
+      const KeyType& key,
+      size_t* deleted_key = nullptr);
+
+  // Where compaction continues, see CompactStep.
+  struct CompactCursor {
+    // The height above the leaves of the nodes whose children are repacked.
+    size_t height = 1;
+    // The position of an entry under the next node to visit.
+    size_t position = 0;
+    // Whether the current sweep up the tree repacked any node.
+    bool repacked = false;
+  };
+
+  // Visits the nodes at the cursor's height from left to right, starting
+  // with the one that holds the entry at the cursor's position, and repacks
+  // the children of the first one whose children fit in fewer nodes. Moves
+  // the cursor past the nodes it visits, and up a level past the last one.
+  // Returns false without changing the tree once a sweep of every level
+  // found nothing to repack.
+  bool CompactStep(blob_store::Transaction* transaction,
+                   CompactCursor* cursor);
+
+  // Replaces the leaf children of parent with num_leaves leaves holding the
+  // same entries.
+  void RepackLeaves(blob_store::Transaction* transaction,
+                    InternalNode* parent,
+                    size_t num_leaves);
+
+  // Replaces the internal children of parent with num_nodes nodes holding
+  // the same children.
+  void RepackInternalNodes(blob_store::Transaction* transaction,
+                           InternalNode* parent,
+                           size_t num_nodes);
+
   // Searches for the provided key in the provided subtree rooted at node.
   // Returns an iterator starting at the first key >= key. If the key is not
-  // found, the iterator will be invalid. If the key is found, the path from
-  // the leaf to the root of the tree is returned in path_to_root.
-  Iterator Search(BlobStoreObject<const BaseNode> node,
-                  const KeyType& key,
-                  std::vector<size_t> path_to_root);
+  // found, the iterator will be invalid. The descent is iterative and records
+  // the path from the leaf to the root in the iterator, so a lookup doesn't
+  // allocate.
+  Iterator Search(BlobStoreObject<const BaseNode> node, const KeyType& key);
+
+  // Returns the number of keys less than key in the subtree rooted at node.
+  size_t Rank(BlobStoreObject<const BaseNode> node, const KeyType& key);
+
+  // Returns an iterator to the key at position k of the subtree rooted at
+  // node.
+  Iterator Select(BlobStoreObject<const BaseNode> node, size_t k);
+
+  // Returns the aggregate of the values of the keys in [lo, hi) in the
+  // subtree rooted at node.
+  AggregateValue Aggregate(BlobStoreObject<const BaseNode> node,
+                           const KeyType& lo,
+                           const KeyType& hi);
+
+  // Returns the aggregate of the values of the keys not less than lo in the
+  // subtree rooted at node.
+  AggregateValue AggregateFrom(BlobStoreObject<const BaseNode> node,
+                               const KeyType& lo);
+
+  // Returns the aggregate of the values of the keys less than hi in the
+  // subtree rooted at node.
+  AggregateValue AggregateUntil(BlobStoreObject<const BaseNode> node,
+                                const KeyType& hi);
+
+  // Returns the aggregate of the values at positions [begin, end) of leaf.
+  AggregateValue AggregateLeaf(const LeafNode& leaf, size_t begin, size_t end);
+
+  // Returns the aggregate of every value in the subtree rooted at node.
+  AggregateValue GetSubtreeAggregate(const BaseNode& node);
+
+  // Returns the index of the child of node whose subtree holds key.
+  size_t FindChild(const InternalNode& node, const KeyType& key);
+
+  // Returns the position of the first key of node not less than key, like
+  // BaseNode::Search. Leaves that pack their key prefixes are searched in the
+  // packed copy, so only the keys sharing the prefix of key are read.
+  size_t SearchNode(const BaseNode& node,
+                    const KeyType& key,
+                    BlobStoreObject<const KeyType>* key_found);
+
+  // Rebuilds the packed copy of the keys of leaf, if its keys are packed.
+  // Every change to a leaf's keys must be followed by a call to this.
+  void PackKeys(LeafNode* leaf);
+
+  // Records the entry count and aggregate of child as those of the child at
+  // child_index of parent. Every change to a child's entries must be
+  // followed by a call to this or CopyChildSummary.
+  void SetChildSummary(InternalNode* parent,
+                       size_t child_index,
+                       const BaseNode& child);
+
+  // Copies the entry count and aggregate of the child at from_index of from
+  // to the child at to_index of to.
+  static void CopyChildSummary(InternalNode* to,
+                               size_t to_index,
+                               const InternalNode& from,
+                               size_t from_index);
 
   // Split a leaf node into two leaf nodes and a middle key, all returned in
   // InsertionBundle. left_node is modified directly.
-  InsertionBundle SplitLeafNode(Transaction* transaction,
+  InsertionBundle SplitLeafNode(blob_store::Transaction* transaction,
                                 BlobStoreObject<LeafNode> left_node);
 
   // Split an internal node into two internal nodes nodes and a middle key, all
   // returned in InsertionBundle. left_node is modified directly.
-  InsertionBundle SplitInternalNode(Transaction* transaction,
+  InsertionBundle SplitInternalNode(blob_store::Transaction* transaction,
                                     BlobStoreObject<InternalNode> left_node);
 
   // Inserts key and value into the leaf node |node|. This method accepts both
@@ -119,11 +408,13 @@ class BPlusTree : public BPlusTreeBase<KeyType, ValueType, Order> {
   // non-const, we insert directly into the node.
   template <typename U>
   typename std::enable_if<
-      std::is_same<
-          typename std::remove_const<U>::type,
-          typename BPlusTree<KeyType, ValueType, Order>::LeafNode>::value,
+      std::is_same<typename std::remove_const<U>::type,
+                   typename BPlusTree<KeyType,
+                                      ValueType,
+                                      Order,
+                                      AggregateType>::LeafNode>::value,
       InsertionBundle>::type
-  InsertIntoLeaf(Transaction* transaction,
+  InsertIntoLeaf(blob_store::Transaction* transaction,
                  BlobStoreObject<U> node,
                  BlobStoreObject<const KeyType> key,
                  BlobStoreObject<const ValueType> value);
@@ -134,29 +425,34 @@ class BPlusTree : public BPlusTreeBase<KeyType, ValueType, Order> {
                                       BlobStoreObject<const KeyType> new_key,
                                       BlobStoreObject<BaseNode> new_child);
 
-  InsertionBundle Insert(Transaction* transaction,
+  InsertionBundle Insert(blob_store::Transaction* transaction,
                          BlobStoreObject<const BaseNode> node,
                          BlobStoreObject<const KeyType> key,
                          BlobStoreObject<const ValueType> value);
 
+  // The Delete helpers below return the removed value and store the index
+  // of the removed key in deleted_key, like DeleteFromTree.
   BlobStoreObject<const ValueType> Delete(
-      Transaction* transaction,
+      blob_store::Transaction* transaction,
       BlobStoreObject<BaseNode>* parent_node,
       size_t child_index,
-      const KeyType& key);
+      const KeyType& key,
+      size_t* deleted_key);
 
   BlobStoreObject<const ValueType> DeleteFromLeafNode(
       BlobStoreObject<LeafNode> node,
-      const KeyType& key);
+      const KeyType& key,
+      size_t* deleted_key);
 
   BlobStoreObject<const ValueType> DeleteFromInternalNode(
-      Transaction* transaction,
+      blob_store::Transaction* transaction,
       BlobStoreObject<InternalNode> node,
-      const KeyType& key);
+      const KeyType& key,
+      size_t* deleted_key);
 
   // Borrow a key from the left sibling of node and return the new right
   // sibling.
-  bool BorrowFromLeftSibling(Transaction* transaction,
+  bool BorrowFromLeftSibling(blob_store::Transaction* transaction,
                              BlobStoreObject<InternalNode> parent_node,
                              BlobStoreObject<const BaseNode> left_sibling,
                              BlobStoreObject<const BaseNode> right_sibling,
@@ -165,17 +461,33 @@ class BPlusTree : public BPlusTreeBase<KeyType, ValueType, Order> {
 
   // Borrow a key from the right sibling of node and return the new left
   // sibling.
-  bool BorrowFromRightSibling(Transaction* transaction,
+  bool BorrowFromRightSibling(blob_store::Transaction* transaction,
                               BlobStoreObject<InternalNode> parent_node,
                               BlobStoreObject<const BaseNode> left_sibling,
                               BlobStoreObject<const BaseNode> right_sibling,
                               size_t child_index,
                               BlobStoreObject<BaseNode>* out_left_sibling);
 
-  // Returns the key of the successor of node.
-  BlobStoreObject<const KeyType> GetSuccessorKey(
-      BlobStoreObject<const BaseNode> node,
-      const KeyType& key);
+  // Returns whether a delete must rebalance child before descending into it
+  // under the tree's rebalance policy.
+  bool NeedsRebalance(const BaseNode& child) const {
+    return rebalance_policy_ == RebalancePolicy::kEager
+               ? child.will_underflow()
+               : child.num_keys() <= 1;
+  }
+
+  // Returns the index of a copy of the key at key_index to store in an
+  // internal node. Separators are owned by their internal node rather than
+  // shared with a leaf, so they stay valid after their key is deleted and
+  // deletes never have to replace them.
+  size_t CopySeparator(blob_store::Transaction* transaction, size_t key_index) {
+    return transaction->NewCopy(blob_store_.Get<KeyType>(key_index)).Index();
+  }
+
+  // Drops a separator that was removed from its internal node.
+  void DropSeparator(blob_store::Transaction* transaction, size_t key_index) {
+    transaction->Drop(blob_store_.Get<KeyType>(key_index));
+  }
 
   // Merges the right child into the left child. The parent key separating the
   // two children is merged into the left child.
@@ -191,7 +503,7 @@ class BPlusTree : public BPlusTreeBase<KeyType, ValueType, Order> {
   // Merges the provded child with its left or right sibling depending on
   // whether child is the rightmost child of its parent. The new child is
   // returned in out_child.
-  void MergeChildWithLeftOrRightSibling(Transaction* transaction,
+  void MergeChildWithLeftOrRightSibling(blob_store::Transaction* transaction,
                                         BlobStoreObject<InternalNode> parent,
                                         size_t child_index,
                                         BlobStoreObject<const BaseNode> child,
@@ -201,16 +513,20 @@ class BPlusTree : public BPlusTreeBase<KeyType, ValueType, Order> {
   // keys, borrow a key from the sibling. Otherwise, merge the child with its
   // sibling. The new child is returned in new_child.
   void RebalanceChildWithLeftOrRightSibling(
-      Transaction* transaction,
+      blob_store::Transaction* transaction,
       BlobStoreObject<InternalNode> parent,
       size_t child_index,
       BlobStoreObject<const BaseNode> child,
       BlobStoreObject<BaseNode>* new_child);
 };
 
-template <typename KeyType, typename ValueType, size_t Order>
-bool BPlusTree<KeyType, ValueType, Order>::Insert(const KeyType& key,
-                                                  const ValueType& value) {
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+bool BPlusTree<KeyType, ValueType, Order, AggregateType>::Insert(
+    const KeyType& key,
+    const ValueType& value) {
   while (true) {
     Transaction txn(CreateTransaction());
     BlobStoreObject<KeyType> key_ptr = txn.New<KeyType>(key);
@@ -224,80 +540,684 @@ bool BPlusTree<KeyType, ValueType, Order>::Insert(const KeyType& key,
   return false;
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-void BPlusTree<KeyType, ValueType, Order>::Insert(
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::Insert(
     Transaction* transaction,
     BlobStoreObject<const KeyType> key,
     BlobStoreObject<const ValueType> value) {
-  BlobStoreObject<const BaseNode> root = transaction->GetRootNode<BaseNode>();
+  InsertIntoTree(transaction, key, value);
+  for (SecondaryIndexBase* index : secondary_indexes_) {
+    index->OnInsert(transaction, key, value);
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::InsertIntoTree(
+    blob_store::Transaction* transaction,
+    BlobStoreObject<const KeyType> key,
+    BlobStoreObject<const ValueType> value) {
+  BlobStoreObject<const BaseNode> root = GetRoot(transaction);
   InsertionBundle bundle = Insert(transaction, std::move(root), key, value);
   if (bundle.new_right_node != nullptr) {
-    BlobStoreObject<InternalNode> new_root = transaction->New<InternalNode>();
+    // Keep the new root next to the node it replaces.
+    BlobStoreObject<InternalNode> new_root =
+        transaction->NewNear<InternalNode>(bundle.new_left_node.Index());
     new_root->children[0] = bundle.new_left_node.Index();
     new_root->children[1] = bundle.new_right_node.Index();
+    SetChildSummary(&*new_root, 0, *bundle.new_left_node);
+    SetChildSummary(&*new_root, 1, *bundle.new_right_node);
     new_root->set_num_keys(1);
     new_root->set_key(0, bundle.new_key.Index());
-    transaction->SetRootNode(new_root.Index());
+    SetRoot(transaction, new_root.Index());
   } else {
-    transaction->SetRootNode(bundle.new_left_node.Index());
+    SetRoot(transaction, bundle.new_left_node.Index());
   }
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-typename BPlusTree<KeyType, ValueType, Order>::Iterator
-BPlusTree<KeyType, ValueType, Order>::Search(const KeyType& key) {
-  Transaction txn(CreateTransaction());
-  return txn.Search(key);
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::Iterator
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Search(
+    const KeyType& key) {
+  return Search(GetCommittedRoot(), key);
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-typename BPlusTree<KeyType, ValueType, Order>::Iterator
-BPlusTree<KeyType, ValueType, Order>::Search(Transaction* transaction,
-                                             const KeyType& key) {
-  BlobStoreObject<const BaseNode> root = transaction->GetRootNode<BaseNode>();
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::Iterator
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Search(
+    Transaction* transaction,
+    const KeyType& key) {
+  BlobStoreObject<const BaseNode> root = GetRoot(transaction);
   if (root == nullptr) {
-    return Iterator(&blob_store_, std::vector<size_t>(), 0);
+    return Iterator(&blob_store_, PathToRoot(), 0);
   }
-  return Search(std::move(root), key, std::vector<size_t>());
+  return Search(std::move(root), key);
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-typename BPlusTree<KeyType, ValueType, Order>::Iterator
-BPlusTree<KeyType, ValueType, Order>::Search(
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::Iterator
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Search(
     BlobStoreObject<const BaseNode> node,
-    const KeyType& key,
-    std::vector<size_t> path_to_root) {
-  path_to_root.push_back(node.Index());
+    const KeyType& key) {
+  PathToRoot path_to_root;
+  while (true) {
+    path_to_root.push_back(node.Index());
+
+    BlobStoreObject<const KeyType> key_found;
+    size_t key_index = SearchNode(*node, key, &key_found);
+
+    if (node->is_leaf()) {
+      return Iterator(&blob_store_, path_to_root, key_index);
+    }
+
+    // Keys equal to a separator live in its right subtree.
+    if (key_index < node->num_keys() && key == *key_found) {
+      ++key_index;
+    }
+    GetChild(std::move(node).To<InternalNode>(), key_index, &node);
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::Compact() {
+  // The cursor only moves past a step once the step commits, so a step that
+  // loses to a concurrent writer is the only work redone.
+  CompactCursor cursor;
+  while (true) {
+    Transaction txn(CreateTransaction());
+    CompactCursor next = cursor;
+    if (!CompactStep(&txn, &next)) {
+      std::move(txn).Abort();
+      return;
+    }
+    if (std::move(txn).Commit()) {
+      cursor = next;
+    }
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::Compact(
+    Transaction* transaction) {
+  CompactCursor cursor;
+  while (CompactStep(transaction, &cursor)) {
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+bool BPlusTree<KeyType, ValueType, Order, AggregateType>::CompactStep(
+    blob_store::Transaction* transaction,
+    CompactCursor* cursor) {
+  while (true) {
+    BlobStoreObject<const BaseNode> root = GetRoot(transaction);
+    // The tree is balanced, so the leftmost path gives its height.
+    size_t height = 0;
+    for (BlobStoreObject<const BaseNode> node = root; node->is_internal();
+         ++height) {
+      GetChild(std::move(node).To<InternalNode>(), 0, &node);
+    }
+    if (cursor->height > height) {
+      // Merging nodes lets the children of the merged nodes pack further, so
+      // the tree is swept again until a sweep leaves it as it is.
+      if (!cursor->repacked) {
+        return false;
+      }
+      *cursor = CompactCursor();
+      continue;
+    }
+    if (cursor->position >= GetSubtreeCount(*root)) {
+      ++cursor->height;
+      cursor->position = 0;
+      continue;
+    }
+
+    // Descend to the node at the cursor's height that holds the entry at the
+    // cursor's position, remembering the path to it.
+    std::vector<BlobStoreObject<const InternalNode>> path;
+    std::vector<size_t> child_indices;
+    BlobStoreObject<const InternalNode> node =
+        std::move(root).To<InternalNode>();
+    size_t k = cursor->position;
+    for (size_t h = height; h > cursor->height; --h) {
+      size_t child_index = 0;
+      while (k >= node->counts[child_index]) {
+        k -= node->counts[child_index];
+        ++child_index;
+      }
+      BlobStoreObject<const BaseNode> child;
+      GetChild(node, child_index, &child);
+      path.push_back(std::move(node));
+      child_indices.push_back(child_index);
+      node = std::move(child).To<InternalNode>();
+    }
+    // The next node at this height starts right after this one.
+    cursor->position += node->count() - k;
+
+    // Skip nodes whose children can't be packed into fewer nodes.
+    bool leaf_children = cursor->height == 1;
+    size_t num_children = node->num_keys() + 1;
+    size_t num_packed;
+    if (leaf_children) {
+      num_packed = (node->count() + Order - 2) / (Order - 1);
+    } else {
+      size_t num_grandchildren = 0;
+      for (size_t i = 0; i < num_children; ++i) {
+        num_grandchildren +=
+            blob_store_.Get<BaseNode>(node->children[i])->num_keys() + 1;
+      }
+      num_packed = (num_grandchildren + Order - 1) / Order;
+    }
+    if (num_packed >= num_children) {
+      continue;
+    }
+
+    BlobStoreObject<InternalNode> new_node =
+        transaction->GetMutable<InternalNode>(std::move(node));
+    cursor->repacked = true;
+    if (leaf_children) {
+      RepackLeaves(transaction, &*new_node, num_packed);
+    } else {
+      RepackInternalNodes(transaction, &*new_node, num_packed);
+    }
+    // Point the path at the new node.
+    while (!path.empty()) {
+      BlobStoreObject<InternalNode> parent =
+          transaction->GetMutable<InternalNode>(std::move(path.back()));
+      path.pop_back();
+      size_t child_index = child_indices.back();
+      child_indices.pop_back();
+      parent->children[child_index] = new_node.Index();
+      SetChildSummary(&*parent, child_index, new_node->base);
+      new_node = std::move(parent);
+    }
+    if (new_node->num_keys() == 0) {
+      // A root left with a single child is replaced by the child.
+      SetRoot(transaction, new_node->children[0]);
+      transaction->Drop(std::move(new_node));
+    } else {
+      SetRoot(transaction, new_node.Index());
+    }
+    return true;
+  }
+}
 
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::RepackLeaves(
+    blob_store::Transaction* transaction,
+    InternalNode* parent,
+    size_t num_leaves) {
+  // Collect the entries in key order, dropping the leaves and separators.
+  std::vector<size_t> keys;
+  std::vector<size_t> values;
+  size_t near_index = parent->children[0];
+  for (size_t i = 0; i <= parent->num_keys(); ++i) {
+    BlobStoreObject<const LeafNode> leaf_node =
+        blob_store_.Get<LeafNode>(parent->children[i]);
+    for (size_t j = 0; j < leaf_node->num_keys(); ++j) {
+      keys.push_back(leaf_node->get_key(j));
+      values.push_back(leaf_node->values[j]);
+    }
+    transaction->Drop(std::move(leaf_node));
+    if (i > 0) {
+      DropSeparator(transaction, parent->get_key(i - 1));
+    }
+  }
+
+  // Spread the entries evenly so that the last leaf isn't left underfull.
+  // Siblings are placed next to each other.
+  parent->set_num_keys(num_leaves - 1);
+  size_t begin = 0;
+  for (size_t i = 0; i < num_leaves; ++i) {
+    size_t end = (i + 1) * keys.size() / num_leaves;
+    BlobStoreObject<LeafNode> leaf_node =
+        transaction->NewNear<LeafNode>(near_index);
+    leaf_node->set_num_keys(end - begin);
+    for (size_t j = begin; j < end; ++j) {
+      leaf_node->set_key(j - begin, keys[j]);
+      leaf_node->values[j - begin] = values[j];
+    }
+    PackKeys(&*leaf_node);
+    parent->children[i] = leaf_node.Index();
+    SetChildSummary(parent, i, leaf_node->base);
+    if (i > 0) {
+      parent->set_key(i - 1, CopySeparator(transaction, keys[begin]));
+    }
+    near_index = leaf_node.Index();
+    begin = end;
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::RepackInternalNodes(
+    blob_store::Transaction* transaction,
+    InternalNode* parent,
+    size_t num_nodes) {
+  // The grandchildren in order, as a child and a position in it, and the
+  // separators between them. The separator at i sits between grandchildren i
+  // and i + 1, so separators only change owners.
+  std::vector<BlobStoreObject<const InternalNode>> children;
+  std::vector<std::pair<size_t, size_t>> grandchildren;
+  std::vector<size_t> separators;
+  for (size_t i = 0; i <= parent->num_keys(); ++i) {
+    children.push_back(blob_store_.Get<InternalNode>(parent->children[i]));
+    const InternalNode& child = *children.back();
+    if (i > 0) {
+      separators.push_back(parent->get_key(i - 1));
+    }
+    for (size_t j = 0; j <= child.num_keys(); ++j) {
+      grandchildren.emplace_back(i, j);
+      if (j < child.num_keys()) {
+        separators.push_back(child.get_key(j));
+      }
+    }
+  }
+
+  size_t near_index = parent->children[0];
+  parent->set_num_keys(num_nodes - 1);
+  size_t begin = 0;
+  for (size_t i = 0; i < num_nodes; ++i) {
+    size_t end = (i + 1) * grandchildren.size() / num_nodes;
+    BlobStoreObject<InternalNode> node =
+        transaction->NewNear<InternalNode>(near_index);
+    node->set_num_keys(end - begin - 1);
+    for (size_t j = begin; j < end; ++j) {
+      const InternalNode& child = *children[grandchildren[j].first];
+      node->children[j - begin] = child.children[grandchildren[j].second];
+      CopyChildSummary(&*node, j - begin, child, grandchildren[j].second);
+      if (j > begin) {
+        node->set_key(j - begin - 1, separators[j - 1]);
+      }
+    }
+    parent->children[i] = node.Index();
+    SetChildSummary(parent, i, node->base);
+    if (i > 0) {
+      parent->set_key(i - 1, separators[begin - 1]);
+    }
+    near_index = node.Index();
+    begin = end;
+  }
+  for (BlobStoreObject<const InternalNode>& child : children) {
+    transaction->Drop(std::move(child));
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+size_t BPlusTree<KeyType, ValueType, Order, AggregateType>::Size() {
+  return GetSubtreeCount(*GetCommittedRoot());
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+size_t BPlusTree<KeyType, ValueType, Order, AggregateType>::Rank(
+    const KeyType& key) {
+  return Rank(GetCommittedRoot(), key);
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::Iterator
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Select(size_t k) {
+  return Select(GetCommittedRoot(), k);
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+size_t BPlusTree<KeyType, ValueType, Order, AggregateType>::Count(
+    const KeyType& lo,
+    const KeyType& hi) {
+  if (!(lo < hi)) {
+    return 0;
+  }
+  // Both ranks must come from the same version.
+  BlobStoreObject<const BaseNode> root = GetCommittedRoot();
+  return Rank(root, hi) - Rank(root, lo);
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+size_t BPlusTree<KeyType, ValueType, Order, AggregateType>::Rank(
+    BlobStoreObject<const BaseNode> node,
+    const KeyType& key) {
+  size_t rank = 0;
+  while (true) {
+    BlobStoreObject<const KeyType> key_found;
+    size_t key_index = SearchNode(*node, key, &key_found);
+    if (node->is_leaf()) {
+      return rank + key_index;
+    }
+    // Every key under the children left of key_index is less than key. Keys
+    // equal to a separator live in its right subtree, so the child at
+    // key_index holds the rest of the keys less than key.
+    BlobStoreObject<const InternalNode> internal_node =
+        std::move(node).To<InternalNode>();
+    for (size_t i = 0; i < key_index; ++i) {
+      rank += internal_node->counts[i];
+    }
+    GetChild(internal_node, key_index, &node);
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::Iterator
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Select(
+    BlobStoreObject<const BaseNode> node,
+    size_t k) {
+  if (k >= GetSubtreeCount(*node)) {
+    return Iterator(&blob_store_, PathToRoot(), 0);
+  }
+  PathToRoot path_to_root;
+  while (true) {
+    path_to_root.push_back(node.Index());
+    if (node->is_leaf()) {
+      return Iterator(&blob_store_, path_to_root, k);
+    }
+    BlobStoreObject<const InternalNode> internal_node =
+        std::move(node).To<InternalNode>();
+    size_t child_index = 0;
+    while (k >= internal_node->counts[child_index]) {
+      k -= internal_node->counts[child_index];
+      ++child_index;
+    }
+    GetChild(internal_node, child_index, &node);
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateValue
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Aggregate(
+    const KeyType& lo,
+    const KeyType& hi) {
+  static_assert(!std::is_same<AggregateType, NoAggregate>::value,
+                "The tree doesn't keep an aggregate");
+  if (!(lo < hi)) {
+    return AggregateType::Identity();
+  }
+  return Aggregate(GetCommittedRoot(), lo, hi);
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateValue
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Aggregate(
+    BlobStoreObject<const BaseNode> node,
+    const KeyType& lo,
+    const KeyType& hi) {
+  // Descend while lo and hi fall under the same child. Once they part, the
+  // children between them are combined whole.
+  while (node->is_internal()) {
+    BlobStoreObject<const InternalNode> internal_node =
+        std::move(node).To<InternalNode>();
+    size_t lo_child = FindChild(*internal_node, lo);
+    // Keys equal to hi are excluded, so hi's child is the one left of the
+    // first separator not less than hi.
+    BlobStoreObject<const KeyType> key_found;
+    size_t hi_child = internal_node->Search(&blob_store_, hi, &key_found);
+    if (lo_child != hi_child) {
+      BlobStoreObject<const BaseNode> lo_node;
+      BlobStoreObject<const BaseNode> hi_node;
+      GetChild(internal_node, lo_child, &lo_node);
+      GetChild(internal_node, hi_child, &hi_node);
+      AggregateValue result = AggregateFrom(std::move(lo_node), lo);
+      for (size_t i = lo_child + 1; i < hi_child; ++i) {
+        result = AggregateType::Combine(result, internal_node->aggregates[i]);
+      }
+      return AggregateType::Combine(result,
+                                    AggregateUntil(std::move(hi_node), hi));
+    }
+    GetChild(internal_node, lo_child, &node);
+  }
   BlobStoreObject<const KeyType> key_found;
-  size_t key_index = node->Search(&blob_store_, key, &key_found);
+  size_t begin = SearchNode(*node, lo, &key_found);
+  size_t end = SearchNode(*node, hi, &key_found);
+  return AggregateLeaf(*node.To<LeafNode>(), begin, end);
+}
 
-  if (node->is_leaf()) {
-    return Iterator(&blob_store_, std::move(path_to_root), key_index);
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateValue
+BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateFrom(
+    BlobStoreObject<const BaseNode> node,
+    const KeyType& lo) {
+  // The subtrees right of the path to lo come after everything below it.
+  AggregateValue tail = AggregateType::Identity();
+  while (node->is_internal()) {
+    BlobStoreObject<const InternalNode> internal_node =
+        std::move(node).To<InternalNode>();
+    size_t child_index = FindChild(*internal_node, lo);
+    AggregateValue right = AggregateType::Identity();
+    for (size_t i = child_index + 1; i <= internal_node->num_keys(); ++i) {
+      right = AggregateType::Combine(right, internal_node->aggregates[i]);
+    }
+    tail = AggregateType::Combine(right, tail);
+    GetChild(internal_node, child_index, &node);
   }
+  BlobStoreObject<const KeyType> key_found;
+  size_t begin = SearchNode(*node, lo, &key_found);
+  return AggregateType::Combine(
+      AggregateLeaf(*node.To<LeafNode>(), begin, node->num_keys()), tail);
+}
 
-  if (key_index < node->num_keys() && key == *key_found) {
-    BlobStoreObject<const BaseNode> child;
-    GetChild(node.To<InternalNode>(), key_index + 1, &child);
-    return Search(std::move(child), key, std::move(path_to_root));
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateValue
+BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateUntil(
+    BlobStoreObject<const BaseNode> node,
+    const KeyType& hi) {
+  // The subtrees left of the path to hi come before everything below it.
+  AggregateValue head = AggregateType::Identity();
+  while (node->is_internal()) {
+    BlobStoreObject<const InternalNode> internal_node =
+        std::move(node).To<InternalNode>();
+    BlobStoreObject<const KeyType> key_found;
+    size_t child_index = internal_node->Search(&blob_store_, hi, &key_found);
+    for (size_t i = 0; i < child_index; ++i) {
+      head = AggregateType::Combine(head, internal_node->aggregates[i]);
+    }
+    GetChild(internal_node, child_index, &node);
   }
-  BlobStoreObject<const BaseNode> child;
-  GetChild(node.To<InternalNode>(), key_index, &child);
-  return Search(std::move(child), key, std::move(path_to_root));
+  BlobStoreObject<const KeyType> key_found;
+  size_t end = SearchNode(*node, hi, &key_found);
+  return AggregateType::Combine(head,
+                                AggregateLeaf(*node.To<LeafNode>(), 0, end));
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-typename BPlusTree<KeyType, ValueType, Order>::InsertionBundle
-BPlusTree<KeyType, ValueType, Order>::SplitLeafNode(
-    Transaction* transaction,
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateValue
+BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateLeaf(
+    const LeafNode& leaf,
+    size_t begin,
+    size_t end) {
+  AggregateValue result = AggregateType::Identity();
+  for (size_t i = begin; i < end; ++i) {
+    result = AggregateType::Combine(
+        result,
+        AggregateType::Lift(*blob_store_.Get<ValueType>(leaf.values[i])));
+  }
+  return result;
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::AggregateValue
+BPlusTree<KeyType, ValueType, Order, AggregateType>::GetSubtreeAggregate(
+    const BaseNode& node) {
+  if (node.is_leaf()) {
+    const LeafNode& leaf = reinterpret_cast<const LeafNode&>(node);
+    return AggregateLeaf(leaf, 0, leaf.num_keys());
+  }
+  const InternalNode& internal_node =
+      reinterpret_cast<const InternalNode&>(node);
+  AggregateValue result = AggregateType::Identity();
+  for (size_t i = 0; i <= internal_node.num_keys(); ++i) {
+    result = AggregateType::Combine(result, internal_node.aggregates[i]);
+  }
+  return result;
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+size_t BPlusTree<KeyType, ValueType, Order, AggregateType>::FindChild(
+    const InternalNode& node,
+    const KeyType& key) {
+  BlobStoreObject<const KeyType> key_found;
+  size_t key_index = node.Search(&blob_store_, key, &key_found);
+  // Keys equal to a separator live in its right subtree.
+  if (key_index < node.num_keys() && key == *key_found) {
+    ++key_index;
+  }
+  return key_index;
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+size_t BPlusTree<KeyType, ValueType, Order, AggregateType>::SearchNode(
+    const BaseNode& node,
+    const KeyType& key,
+    BlobStoreObject<const KeyType>* key_found) {
+  if constexpr (PacksLeafKeys<KeyType>()) {
+    if (node.is_leaf()) {
+      using Prefix = LeafKeyPrefix<KeyType>;
+      size_t key_index = reinterpret_cast<const LeafNode&>(node).LowerBound(
+          Prefix::Of(key));
+      // Only keys sharing the prefix of key can still be less than it.
+      while (!Prefix::kExact && key_index < node.num_keys() &&
+             *blob_store_.Get<KeyType>(node.get_key(key_index)) < key) {
+        ++key_index;
+      }
+      *key_found = key_index < node.num_keys()
+                       ? blob_store_.Get<KeyType>(node.get_key(key_index))
+                       : BlobStoreObject<const KeyType>();
+      return key_index;
+    }
+  }
+  return node.Search(&blob_store_, key, key_found);
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::PackKeys(
+    LeafNode* leaf) {
+  if constexpr (PacksLeafKeys<KeyType>()) {
+    std::array<std::uint64_t, Order - 1> keys;
+    for (size_t i = 0; i < leaf->num_keys(); ++i) {
+      keys[i] = LeafKeyPrefix<KeyType>::Of(
+          *blob_store_.Get<KeyType>(leaf->get_key(i)));
+    }
+    leaf->PackKeys(keys.data());
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::SetChildSummary(
+    InternalNode* parent,
+    size_t child_index,
+    const BaseNode& child) {
+  parent->counts[child_index] = GetSubtreeCount(child);
+  // Trees without an aggregate don't read their values.
+  if constexpr (InternalNode::kNumAggregates > 0) {
+    parent->aggregates[child_index] = GetSubtreeAggregate(child);
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::CopyChildSummary(
+    InternalNode* to,
+    size_t to_index,
+    const InternalNode& from,
+    size_t from_index) {
+  to->counts[to_index] = from.counts[from_index];
+  if constexpr (InternalNode::kNumAggregates > 0) {
+    to->aggregates[to_index] = from.aggregates[from_index];
+  }
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::InsertionBundle
+BPlusTree<KeyType, ValueType, Order, AggregateType>::SplitLeafNode(
+    blob_store::Transaction* transaction,
     BlobStoreObject<LeafNode> left_node) {
-  // Create a new right node tracked by the provided transaction.
-  BlobStoreObject<LeafNode> new_right_node = transaction->New<LeafNode>();
+  // Create a new right node tracked by the provided transaction. Siblings are
+  // scanned together, so place it next to the left node.
+  BlobStoreObject<LeafNode> new_right_node =
+      transaction->NewNear<LeafNode>(left_node.Index());
 
-  // Find the middle key.
+  // Find the middle key. The parent gets a copy of it.
   size_t middle_key_index = (left_node->num_keys() - 1) / 2;
   BlobStoreObject<const KeyType> middle_key;
   GetKey(left_node, middle_key_index, &middle_key);
+  middle_key = transaction->NewCopy(middle_key).Downgrade();
 
   // Copy the middle keys/values onward to the right node.
   new_right_node->set_num_keys(left_node->num_keys() - middle_key_index);
@@ -308,18 +1228,23 @@ BPlusTree<KeyType, ValueType, Order>::SplitLeafNode(
 
   // Update the key count of the left_node.
   left_node->set_num_keys(middle_key_index);
+  PackKeys(&*left_node);
+  PackKeys(&*new_right_node);
 
   return InsertionBundle(left_node.To<BaseNode>(), middle_key,
                          new_right_node.To<BaseNode>());
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-typename BPlusTree<KeyType, ValueType, Order>::InsertionBundle
-BPlusTree<KeyType, ValueType, Order>::SplitInternalNode(
-    Transaction* transaction,
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::InsertionBundle
+BPlusTree<KeyType, ValueType, Order, AggregateType>::SplitInternalNode(
+    blob_store::Transaction* transaction,
     BlobStoreObject<InternalNode> left_node) {
   BlobStoreObject<InternalNode> new_right_node =
-      transaction->New<InternalNode>(Order);
+      transaction->NewNear<InternalNode>(left_node.Index(), Order);
 
   size_t middle_key_index = (left_node->num_keys() - 1) / 2;
   BlobStoreObject<const KeyType> middle_key;
@@ -329,24 +1254,34 @@ BPlusTree<KeyType, ValueType, Order>::SplitInternalNode(
   for (int i = 0; i < new_right_node->num_keys(); ++i) {
     new_right_node->set_key(i, left_node->get_key(middle_key_index + i + 1));
     new_right_node->children[i] = left_node->children[middle_key_index + i + 1];
+    CopyChildSummary(&*new_right_node, i, *left_node,
+                     middle_key_index + i + 1);
   }
   new_right_node->children[new_right_node->num_keys()] =
       left_node->children[middle_key_index + new_right_node->num_keys() + 1];
+  CopyChildSummary(&*new_right_node, new_right_node->num_keys(), *left_node,
+                   middle_key_index + new_right_node->num_keys() + 1);
 
   left_node->set_num_keys(middle_key_index);
   return InsertionBundle(left_node.To<BaseNode>(), middle_key,
                          new_right_node.To<BaseNode>());
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
 template <typename U>
 typename std::enable_if<
-    std::is_same<
-        typename std::remove_const<U>::type,
-        typename BPlusTree<KeyType, ValueType, Order>::LeafNode>::value,
-    typename BPlusTree<KeyType, ValueType, Order>::InsertionBundle>::type
-BPlusTree<KeyType, ValueType, Order>::InsertIntoLeaf(
-    Transaction* transaction,
+    std::is_same<typename std::remove_const<U>::type,
+                 typename BPlusTree<KeyType,
+                                    ValueType,
+                                    Order,
+                                    AggregateType>::LeafNode>::value,
+    typename BPlusTree<KeyType, ValueType, Order, AggregateType>::
+        InsertionBundle>::type
+BPlusTree<KeyType, ValueType, Order, AggregateType>::InsertIntoLeaf(
+    blob_store::Transaction* transaction,
     BlobStoreObject<U> node,
     BlobStoreObject<const KeyType> key,
     BlobStoreObject<const ValueType> value) {
@@ -376,6 +1311,11 @@ BPlusTree<KeyType, ValueType, Order>::InsertIntoLeaf(
   // Shift the keys and values right.
   size_t i = new_left_node->num_keys();
   for (; i > 0; --i) {
+    // Interned keys share a blob, so a key with the same index is equal and
+    // doesn't need to be read.
+    if (new_left_node->get_key(i - 1) == key.Index()) {
+      break;
+    }
     BlobStoreObject<const KeyType> key_ptr;
     GetKey(new_left_node, i - 1, &key_ptr);
     if (*key >= *key_ptr) {
@@ -387,13 +1327,18 @@ BPlusTree<KeyType, ValueType, Order>::InsertIntoLeaf(
   new_left_node->set_key(i, key.Index());
   new_left_node->values[i] = value.Index();
   new_left_node->increment_num_keys();
+  PackKeys(&*new_left_node);
   return InsertionBundle(new_left_node.To<BaseNode>(),
                          BlobStoreObject<const KeyType>(),
                          BlobStoreObject<BaseNode>());
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-void BPlusTree<KeyType, ValueType, Order>::InsertKeyChildIntoInternalNode(
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::
+    InsertKeyChildIntoInternalNode(
     BlobStoreObject<InternalNode> node,
     BlobStoreObject<const KeyType> new_key,
     BlobStoreObject<BaseNode> new_child) {
@@ -406,16 +1351,21 @@ void BPlusTree<KeyType, ValueType, Order>::InsertKeyChildIntoInternalNode(
     }
     node->set_key(i, node->get_key(i - 1));
     node->children[i + 1] = node->children[i];
+    CopyChildSummary(&*node, i + 1, *node, i);
   }
   node->set_key(i, new_key.Index());
   node->children[i + 1] = new_child.Index();
+  SetChildSummary(&*node, i + 1, *new_child);
   node->increment_num_keys();
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-typename BPlusTree<KeyType, ValueType, Order>::InsertionBundle
-BPlusTree<KeyType, ValueType, Order>::Insert(
-    Transaction* transaction,
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::InsertionBundle
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Insert(
+    blob_store::Transaction* transaction,
     BlobStoreObject<const BaseNode> node,
     BlobStoreObject<const KeyType> key,
     BlobStoreObject<const ValueType> value) {
@@ -431,6 +1381,10 @@ BPlusTree<KeyType, ValueType, Order>::Insert(
   // inefficient.
   BlobStoreObject<const KeyType> key_found;
   size_t key_index = internal_node->Search(&blob_store_, *key, &key_found);
+  // Keys equal to a separator live in the separator's right subtree.
+  if (key_index < internal_node->num_keys() && *key == *key_found) {
+    ++key_index;
+  }
 
   // Don't hold onto the child node longer than necessary to avoid failing to
   // upgrade its lock.
@@ -443,6 +1397,8 @@ BPlusTree<KeyType, ValueType, Order>::Insert(
 
   new_internal_node->children[key_index] =
       child_node_bundle.new_left_node.Index();
+  SetChildSummary(&*new_internal_node, key_index,
+                  *child_node_bundle.new_left_node);
   // If the child node bundle has a new right node, then that means that a split
   // occurred to insert the key/value pair. We need to find a place to insert
   // the new middle key.
@@ -474,10 +1430,13 @@ BPlusTree<KeyType, ValueType, Order>::Insert(
     // insert the new child node and its minimum key into the parent node
     for (size_t j = new_internal_node->num_keys(); j > key_index; --j) {
       new_internal_node->children[j + 1] = new_internal_node->children[j];
+      CopyChildSummary(&*new_internal_node, j + 1, *new_internal_node, j);
       new_internal_node->set_key(j, new_internal_node->get_key(j - 1));
     }
     new_internal_node->children[key_index + 1] =
         child_node_bundle.new_right_node.Index();
+    SetChildSummary(&*new_internal_node, key_index + 1,
+                    *child_node_bundle.new_right_node);
     new_internal_node->set_key(key_index, child_node_bundle.new_key.Index());
     new_internal_node->increment_num_keys();
   }
@@ -487,8 +1446,12 @@ BPlusTree<KeyType, ValueType, Order>::Insert(
                          BlobStoreObject<BaseNode>());
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-BlobStoreObject<const ValueType> BPlusTree<KeyType, ValueType, Order>::Delete(
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+BlobStoreObject<const ValueType>
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Delete(
     const KeyType& key) {
   while (true) {
     Transaction txn(CreateTransaction());
@@ -499,19 +1462,50 @@ BlobStoreObject<const ValueType> BPlusTree<KeyType, ValueType, Order>::Delete(
   }
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-BlobStoreObject<const ValueType> BPlusTree<KeyType, ValueType, Order>::Delete(
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+BlobStoreObject<const ValueType>
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Delete(
     Transaction* transaction,
     const KeyType& key) {
-  BlobStoreObject<const BaseNode> root = transaction->GetRootNode<BaseNode>();
+  if (secondary_indexes_.empty()) {
+    return DeleteFromTree(transaction, key);
+  }
+  // Secondary indexes are keyed off the stored key. The leaf no longer refers
+  // to it, but its blob stays in the store.
+  size_t deleted_key_index;
+  BlobStoreObject<const ValueType> deleted =
+      DeleteFromTree(transaction, key, &deleted_key_index);
+  if (deleted != nullptr) {
+    BlobStoreObject<const KeyType> deleted_key =
+        blob_store_.Get<KeyType>(deleted_key_index);
+    for (SecondaryIndexBase* index : secondary_indexes_) {
+      index->OnDelete(transaction, deleted_key, deleted);
+    }
+  }
+  return deleted;
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+BlobStoreObject<const ValueType>
+BPlusTree<KeyType, ValueType, Order, AggregateType>::DeleteFromTree(
+    blob_store::Transaction* transaction,
+    const KeyType& key,
+    size_t* deleted_key) {
+  BlobStoreObject<const BaseNode> root = GetRoot(transaction);
   BlobStoreObject<BaseNode> new_root =
       transaction->GetMutable<BaseNode>(std::move(root));
 
   if (new_root->is_leaf()) {
     // If the root is a leaf node, then we can just delete the key from the leaf
     // node.
-    transaction->SetRootNode(new_root.Index());
-    return DeleteFromLeafNode(new_root.To<LeafNode>(), key);
+    SetRoot(transaction, new_root.Index());
+    return DeleteFromLeafNode(new_root.To<LeafNode>(), key, deleted_key);
   }
 
   // Find the child node where the key should be deleted.
@@ -522,28 +1516,66 @@ BlobStoreObject<const ValueType> BPlusTree<KeyType, ValueType, Order>::Delete(
   // As part of the Delete operation, the root node may have been deleted and
   // replaced with a new root node.
   if (key_index < new_root->num_keys() && key == *key_found) {
-    deleted = Delete(transaction, &new_root, key_index + 1, key);
+    deleted = Delete(transaction, &new_root, key_index + 1, key, deleted_key);
   } else {
-    deleted = Delete(transaction, &new_root, key_index, key);
+    deleted = Delete(transaction, &new_root, key_index, key, deleted_key);
   }
-  transaction->SetRootNode(new_root.Index());
+  SetRoot(transaction, new_root.Index());
   return deleted;
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-void BPlusTree<KeyType, ValueType, Order>::Print(size_t version) {
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+typename BPlusTree<KeyType, ValueType, Order, AggregateType>::Snapshot
+BPlusTree<KeyType, ValueType, Order, AggregateType>::OpenSnapshot(
+    size_t version) {
+  // TODO(fsamuel): The head index should not be fixed.
+  BlobStoreObject<const HeadNode> head =
+      blob_store::FindHead(&blob_store_, 1, version);
+  if (head == nullptr || head->version != version) {
+    return Snapshot(this, &blob_store_, version,
+                    BlobStoreObject<const BaseNode>());
+  }
+  return Snapshot(this, &blob_store_, version,
+                  blob_store_.Get<BaseNode>(GetRootIndex(*head)));
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+bool BPlusTree<KeyType, ValueType, Order, AggregateType>::Diff(
+    size_t from_version,
+    size_t to_version,
+    const typename TreeDiff::Visitor& visitor) {
+  // The snapshots pin both versions for the duration of the walk.
+  Snapshot from = OpenSnapshot(from_version);
+  Snapshot to = OpenSnapshot(to_version);
+  if (!from.is_valid() || !to.is_valid()) {
+    return false;
+  }
+  TreeDiff(&blob_store_).Run(from.root_.Index(), to.root_.Index(), visitor);
+  return true;
+}
+
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::Print(
+    size_t version) {
   struct NodeWithLevel {
     BlobStoreObject<const BaseNode> node;
     size_t level;
   };
   std::queue<NodeWithLevel> queue;
-  BlobStoreObject<const HeadNode> head = blob_store_.Get<HeadNode>(1);
   // Find the head with the given version
-  while (head->previous != BlobStore::InvalidIndex && head->version > version) {
-    head = blob_store_.Get<HeadNode>(head->previous);
-  }
+  BlobStoreObject<const HeadNode> head =
+      blob_store::FindHead(&blob_store_, 1, version);
   PrintNode(head);
-  queue.push({blob_store_.Get<BaseNode>(head->root_index), 1});
+  queue.push({blob_store_.Get<BaseNode>(GetRootIndex(*head)), 1});
   while (!queue.empty()) {
     NodeWithLevel node_with_level = queue.front();
     queue.pop();
@@ -566,20 +1598,28 @@ void BPlusTree<KeyType, ValueType, Order>::Print(size_t version) {
   }
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
 BlobStoreObject<const ValueType>
-BPlusTree<KeyType, ValueType, Order>::DeleteFromLeafNode(
+BPlusTree<KeyType, ValueType, Order, AggregateType>::DeleteFromLeafNode(
     BlobStoreObject<LeafNode> node,
-    const KeyType& key) {
+    const KeyType& key,
+    size_t* deleted_key) {
   BlobStoreObject<const KeyType> key_found;
-  size_t key_index = node->Search(&blob_store_, key, &key_found);
+  size_t key_index = SearchNode(node->base, key, &key_found);
 
-  if (!key_found) {
+  // key_found is the first key not less than key, which may be larger.
+  if (!key_found || !(*key_found == key)) {
     return BlobStoreObject<const ValueType>();
   }
 
   BlobStoreObject<const ValueType> deleted_value;
   GetValue(node, key_index, &deleted_value);
+  if (deleted_key != nullptr) {
+    *deleted_key = node->get_key(key_index);
+  }
 
   // Shift keys and values to fill the gap
   for (size_t j = key_index + 1; j < node->num_keys(); j++) {
@@ -587,48 +1627,42 @@ BPlusTree<KeyType, ValueType, Order>::DeleteFromLeafNode(
     node->values[j - 1] = node->values[j];
   }
   node->decrement_num_keys();
+  PackKeys(&*node);
 
   return deleted_value;  // Key successfully removed
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
 BlobStoreObject<const ValueType>
-BPlusTree<KeyType, ValueType, Order>::DeleteFromInternalNode(
-    Transaction* transaction,
+BPlusTree<KeyType, ValueType, Order, AggregateType>::DeleteFromInternalNode(
+    blob_store::Transaction* transaction,
     BlobStoreObject<InternalNode> node,
-    const KeyType& key) {
+    const KeyType& key,
+    size_t* deleted_key) {
   BlobStoreObject<const KeyType> key_found;
   size_t key_index = node->Search(&blob_store_, key, &key_found);
 
   BlobStoreObject<BaseNode> internal_node_base = node.To<BaseNode>();
 
-  // We found the first key larger or equal to the node we're looking for.
-  // Case 1: key == *current_key: we need to delete the key.
+  // Keys equal to a separator live in the separator's right subtree. The
+  // separator is a copy of the key, so it stays in place and keeps separating
+  // the two subtrees once the key is gone.
   if (key_index < node->num_keys() && key == *key_found) {
-    // The key/value pair is in the right child. Recurse down
-    // to delete the key/value pair first.
-    auto deleted_value =
-        Delete(transaction, &internal_node_base, key_index + 1, key);
-    // We need to update current key to a new successor since we just deleted
-    // the successor to this node. We shouldn't refer to nodes that don't exist.
-    BlobStoreObject<const KeyType> key_found;
-    size_t key_index = node->Search(&blob_store_, key, &key_found);
-
-    if (key_index < node->num_keys() && key == *key_found) {
-      // Can there ever be a null successor? That means there is no successor at
-      // all. That shouldn't happen I think.
-      auto key_ptr = GetSuccessorKey(node.To<const BaseNode>(), key);
-      node->set_key(key_index, key_ptr.Index());
-    }
-    return deleted_value;
+    ++key_index;
   }
-  // Delete at the left child if the current key is larger.
-  return Delete(transaction, &internal_node_base, key_index, key);
+  return Delete(transaction, &internal_node_base, key_index, key,
+                deleted_key);
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-bool BPlusTree<KeyType, ValueType, Order>::BorrowFromLeftSibling(
-    Transaction* transaction,
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+bool BPlusTree<KeyType, ValueType, Order, AggregateType>::BorrowFromLeftSibling(
+    blob_store::Transaction* transaction,
     BlobStoreObject<InternalNode> parent_node,
     BlobStoreObject<const BaseNode> left_sibling,
     BlobStoreObject<const BaseNode> right_sibling,
@@ -652,13 +1686,19 @@ bool BPlusTree<KeyType, ValueType, Order>::BorrowFromLeftSibling(
     auto new_right_sibling_internal_node = new_right_sibling.To<InternalNode>();
     auto new_left_sibling_internal_node = new_left_sibling.To<InternalNode>();
 
-    for (size_t i = new_right_sibling_internal_node->num_keys(); i >= 0; --i) {
-      new_right_sibling_internal_node->children[i + 1] =
-          new_right_sibling_internal_node->children[i];
+    for (size_t i = new_right_sibling_internal_node->num_keys() + 1; i > 0;
+         --i) {
+      new_right_sibling_internal_node->children[i] =
+          new_right_sibling_internal_node->children[i - 1];
+      CopyChildSummary(&*new_right_sibling_internal_node, i,
+                       *new_right_sibling_internal_node, i - 1);
     }
     new_right_sibling_internal_node->children[0] =
         new_left_sibling_internal_node
             ->children[new_left_sibling_internal_node->num_keys()];
+    CopyChildSummary(&*new_right_sibling_internal_node, 0,
+                     *new_left_sibling_internal_node,
+                     new_left_sibling_internal_node->num_keys());
 
     new_right_sibling->set_key(0, parent_node->get_key(child_index - 1));
   } else {
@@ -680,20 +1720,38 @@ bool BPlusTree<KeyType, ValueType, Order>::BorrowFromLeftSibling(
   }
 
   // We want to move this out so we need to return the last key of the left
-  // sibling that we're bumping up.
-  parent_node->set_key(child_index - 1, new_left_sibling->get_key(
-                                            new_left_sibling->num_keys() - 1));
+  // sibling that we're bumping up. A leaf keeps its key, so the parent gets a
+  // copy in place of its previous separator.
+  size_t separator =
+      new_left_sibling->get_key(new_left_sibling->num_keys() - 1);
+  if (new_left_sibling->is_leaf()) {
+    DropSeparator(transaction, parent_node->get_key(child_index - 1));
+    separator = CopySeparator(transaction, separator);
+  }
+  parent_node->set_key(child_index - 1, separator);
 
   new_right_sibling->increment_num_keys();
 
   new_left_sibling->decrement_num_keys();
 
+  if (new_left_sibling->is_leaf()) {
+    PackKeys(&*new_left_sibling.To<LeafNode>());
+    PackKeys(&*new_right_sibling.To<LeafNode>());
+  }
+
+  SetChildSummary(&*parent_node, child_index - 1, *new_left_sibling);
+  SetChildSummary(&*parent_node, child_index, *new_right_sibling);
+
   return true;
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-bool BPlusTree<KeyType, ValueType, Order>::BorrowFromRightSibling(
-    Transaction* transaction,
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+bool BPlusTree<KeyType, ValueType, Order, AggregateType>::
+    BorrowFromRightSibling(
+    blob_store::Transaction* transaction,
     BlobStoreObject<InternalNode> parent_node,
     BlobStoreObject<const BaseNode> left_sibling,
     BlobStoreObject<const BaseNode> right_sibling,
@@ -718,10 +1776,15 @@ bool BPlusTree<KeyType, ValueType, Order>::BorrowFromRightSibling(
                                     parent_node->get_key(child_index));
     new_left_internal_node->children[new_left_internal_node->num_keys() + 1] =
         new_right_internal_node->children[0];
+    CopyChildSummary(&*new_left_internal_node,
+                     new_left_internal_node->num_keys() + 1,
+                     *new_right_internal_node, 0);
 
     for (int i = 1; i <= new_right_internal_node->num_keys(); ++i) {
       new_right_internal_node->children[i - 1] =
           new_right_internal_node->children[i];
+      CopyChildSummary(&*new_right_internal_node, i - 1,
+                       *new_right_internal_node, i);
     }
 
     key_index = new_right_sibling->get_key(0);
@@ -738,7 +1801,9 @@ bool BPlusTree<KeyType, ValueType, Order>::BorrowFromRightSibling(
       new_right_leaf_node->values[i - 1] = new_right_leaf_node->values[i];
     }
 
-    key_index = new_right_sibling->get_key(1);
+    // The right sibling's new first key separates the two leaves.
+    DropSeparator(transaction, parent_node->get_key(child_index));
+    key_index = CopySeparator(transaction, new_right_sibling->get_key(1));
   }
 
   for (int i = 1; i < new_right_sibling->num_keys(); ++i) {
@@ -747,25 +1812,37 @@ bool BPlusTree<KeyType, ValueType, Order>::BorrowFromRightSibling(
 
   new_left_sibling->increment_num_keys();
   new_right_sibling->decrement_num_keys();
+  if (new_left_sibling->is_leaf()) {
+    PackKeys(&*new_left_sibling.To<LeafNode>());
+    PackKeys(&*new_right_sibling.To<LeafNode>());
+  }
 
   parent_node->set_key(child_index, key_index);
+  SetChildSummary(&*parent_node, child_index, *new_left_sibling);
+  SetChildSummary(&*parent_node, child_index + 1, *new_right_sibling);
 
   return true;
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-BlobStoreObject<const ValueType> BPlusTree<KeyType, ValueType, Order>::Delete(
-    Transaction* transaction,
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+BlobStoreObject<const ValueType>
+BPlusTree<KeyType, ValueType, Order, AggregateType>::Delete(
+    blob_store::Transaction* transaction,
     BlobStoreObject<BaseNode>* parent_node,
     size_t child_index,
-    const KeyType& key) {
+    const KeyType& key,
+    size_t* deleted_key) {
   BlobStoreObject<InternalNode> parent_internal_node =
       parent_node->To<InternalNode>();
   BlobStoreObject<const BaseNode> const_child;
   GetChildConst(parent_internal_node, child_index, &const_child);
   BlobStoreObject<BaseNode> child;
+  bool parent_dropped = false;
   // The current child where we want to delete a node is too small.
-  if (const_child->will_underflow()) {
+  if (NeedsRebalance(*const_child)) {
     // Rebalancing might involve one of three operations:
     //     1. Borrowing a key from the left sibling.
     //     2. Borrowing a key from the right sibling.
@@ -784,52 +1861,47 @@ BlobStoreObject<const ValueType> BPlusTree<KeyType, ValueType, Order>::Delete(
       // This is okay to drop since this is a new clone.
       transaction->Drop(std::move(parent_internal_node));
       *parent_node = child;
+      parent_dropped = true;
     }
   } else {
     child = transaction->GetMutable<BaseNode>(std::move(const_child));
     parent_internal_node->children[child_index] = child.Index();
   }
 
+  BlobStoreObject<const ValueType> deleted;
+  // Keep a reference to the child to summarize it once the key is gone.
+  BlobStoreObject<BaseNode> updated_child = child;
   // The current child where we want to delete a node is a leaf node.
   if (child->is_leaf()) {
-    return DeleteFromLeafNode(std::move(child).To<LeafNode>(), key);
-  }
-
-  return DeleteFromInternalNode(transaction,
-                                std::move(child).To<InternalNode>(), key);
-}
-
-template <typename KeyType, typename ValueType, size_t Order>
-BlobStoreObject<const KeyType>
-BPlusTree<KeyType, ValueType, Order>::GetSuccessorKey(
-    BlobStoreObject<const BaseNode> node,
-    const KeyType& key) {
-  if (node->is_leaf()) {
-    BlobStoreObject<const KeyType> key_found;
-    node->Search(&blob_store_, key, &key_found);
-    return key_found;
+    deleted =
+        DeleteFromLeafNode(std::move(child).To<LeafNode>(), key, deleted_key);
+  } else {
+    deleted = DeleteFromInternalNode(
+        transaction, std::move(child).To<InternalNode>(), key, deleted_key);
   }
-  BlobStoreObject<const InternalNode> internal_node =
-      std::move(node).To<InternalNode>();
-  for (int i = 0; i <= internal_node->num_keys(); ++i) {
-    BlobStoreObject<const BaseNode> child;
-    GetChild(internal_node, i, &child);  // Get the leftmost child
-    auto key_ptr = GetSuccessorKey(std::move(child), std::move(key));
-    if (key_ptr != nullptr)
-      return key_ptr;
+  if (deleted != nullptr && !parent_dropped) {
+    // A merge with the left sibling moves the child one slot left, and that
+    // only happens when the child was the rightmost one.
+    SetChildSummary(
+        &*parent_internal_node,
+        std::min(child_index, parent_internal_node->num_keys()),
+        *updated_child);
   }
-  // We should never get here unless the tree has a problem.
-  return BlobStoreObject<const KeyType>();
+  return deleted;
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-void BPlusTree<KeyType, ValueType, Order>::MergeInternalNodes(
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::MergeInternalNodes(
     BlobStoreObject<InternalNode> left_node,
     BlobStoreObject<const InternalNode> right_node,
     size_t parent_key) {
   // Move the key from the parent node down to the left sibling node
   left_node->set_key(left_node->num_keys(), parent_key);
   left_node->children[left_node->num_keys() + 1] = right_node->children[0];
+  CopyChildSummary(&*left_node, left_node->num_keys() + 1, *right_node, 0);
   left_node->increment_num_keys();
 
   // Move all keys and child pointers from the right sibling node to the left
@@ -838,12 +1910,17 @@ void BPlusTree<KeyType, ValueType, Order>::MergeInternalNodes(
     left_node->set_key(left_node->num_keys(), right_node->get_key(i));
     left_node->children[left_node->num_keys() + 1] =
         right_node->children[i + 1];
+    CopyChildSummary(&*left_node, left_node->num_keys() + 1, *right_node,
+                     i + 1);
     left_node->increment_num_keys();
   }
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-void BPlusTree<KeyType, ValueType, Order>::MergeLeafNodes(
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::MergeLeafNodes(
     BlobStoreObject<LeafNode> left_node,
     BlobStoreObject<const LeafNode> right_node) {
   // Move all keys and values from the right sibling node to the left sibling
@@ -853,11 +1930,16 @@ void BPlusTree<KeyType, ValueType, Order>::MergeLeafNodes(
     left_node->values[left_node->num_keys()] = right_node->values[i];
     left_node->increment_num_keys();
   }
+  PackKeys(&*left_node);
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-void BPlusTree<KeyType, ValueType, Order>::MergeChildWithLeftOrRightSibling(
-    Transaction* transaction,
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::
+    MergeChildWithLeftOrRightSibling(
+    blob_store::Transaction* transaction,
     BlobStoreObject<InternalNode> parent,
     size_t child_index,
     BlobStoreObject<const BaseNode> child,
@@ -883,27 +1965,35 @@ void BPlusTree<KeyType, ValueType, Order>::MergeChildWithLeftOrRightSibling(
 
   if (left_child->is_leaf()) {
     MergeLeafNodes(left_child.To<LeafNode>(), right_child.To<const LeafNode>());
+    // Leaves don't keep the separator between them.
+    DropSeparator(transaction, parent->get_key(key_index_in_parent));
   } else {
     MergeInternalNodes(left_child.To<InternalNode>(),
                        right_child.To<const InternalNode>(),
                        parent->get_key(key_index_in_parent));
   }
   transaction->Drop(std::move(right_child));
+  SetChildSummary(&*parent, key_index_in_parent, *left_child);
 
   // Update the parent node by removing the key that was moved down and the
   // pointer to the right sibling node
   for (size_t i = key_index_in_parent; i < parent->num_keys() - 1; ++i) {
     parent->set_key(i, parent->get_key(i + 1));
     parent->children[i + 1] = parent->children[i + 2];
+    CopyChildSummary(&*parent, i + 1, *parent, i + 2);
   }
   // The parent could underflow if we don't do something before getting this
   // far.
   parent->decrement_num_keys();
 }
 
-template <typename KeyType, typename ValueType, size_t Order>
-void BPlusTree<KeyType, ValueType, Order>::RebalanceChildWithLeftOrRightSibling(
-    Transaction* transaction,
+template <typename KeyType,
+          typename ValueType,
+          size_t Order,
+          typename AggregateType>
+void BPlusTree<KeyType, ValueType, Order, AggregateType>::
+    RebalanceChildWithLeftOrRightSibling(
+    blob_store::Transaction* transaction,
     BlobStoreObject<InternalNode> parent,
     size_t child_index,
     BlobStoreObject<const BaseNode> child,
@@ -928,6 +2018,10 @@ void BPlusTree<KeyType, ValueType, Order>::RebalanceChildWithLeftOrRightSibling(
     return;
   }
 
+  // Release the siblings before merging. The merge needs to upgrade the
+  // sibling it merges into if it was created by this transaction.
+  left_sibling = nullptr;
+  right_sibling = nullptr;
   MergeChildWithLeftOrRightSibling(transaction, parent, child_index,
                                    std::move(child), new_child);
 }
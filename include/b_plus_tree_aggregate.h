@@ -0,0 +1,100 @@
+#ifndef B_PLUS_TREE_AGGREGATE_H_
+#define B_PLUS_TREE_AGGREGATE_H_
+
+#include <algorithm>
+#include <limits>
+
+namespace b_plus_tree {
+
+// An aggregate is a monoid over the values of a BPlusTree. A tree with an
+// aggregate stores, next to each child of an internal node, the aggregate of
+// every value in the child's subtree, which lets it aggregate any key range by
+// combining whole subtrees. An aggregate provides:
+//
+//   // The type of the aggregate. Must be trivially copyable as it's stored in
+//   // internal nodes.
+//   using ValueType = ...;
+//   // The aggregate of no values.
+//   static ValueType Identity();
+//   // The aggregate of a single value, as stored in the tree.
+//   template <typename T>
+//   static ValueType Lift(const T& value);
+//   // Combines the aggregates of two adjacent ranges, lhs's range first.
+//   // Must be associative, and Identity() must be its neutral element.
+//   static ValueType Combine(const ValueType& lhs, const ValueType& rhs);
+//
+// Combine doesn't need to be commutative or invertible: ranges are always
+// combined in key order and never subtracted, so minimums and maximums work
+// as well as sums.
+
+// The aggregate of trees that don't keep one. Internal nodes reserve no space
+// for it.
+struct NoAggregate {
+  struct ValueType {};
+
+  static ValueType Identity() { return ValueType(); }
+
+  template <typename T>
+  static ValueType Lift(const T& value) {
+    return ValueType();
+  }
+
+  static ValueType Combine(const ValueType& lhs, const ValueType& rhs) {
+    return ValueType();
+  }
+};
+
+// The sum of the values, accumulated as T.
+template <typename T>
+struct SumAggregate {
+  using ValueType = T;
+
+  static ValueType Identity() { return ValueType(); }
+
+  template <typename U>
+  static ValueType Lift(const U& value) {
+    return static_cast<ValueType>(value);
+  }
+
+  static ValueType Combine(const ValueType& lhs, const ValueType& rhs) {
+    return lhs + rhs;
+  }
+};
+
+// The smallest value. The aggregate of no values is the largest T.
+template <typename T>
+struct MinAggregate {
+  using ValueType = T;
+
+  static ValueType Identity() { return std::numeric_limits<T>::max(); }
+
+  template <typename U>
+  static ValueType Lift(const U& value) {
+    return static_cast<ValueType>(value);
+  }
+
+  static ValueType Combine(const ValueType& lhs, const ValueType& rhs) {
+    return std::min(lhs, rhs);
+  }
+};
+
+// The largest value. The aggregate of no values is the lowest T.
+template <typename T>
+struct MaxAggregate {
+  using ValueType = T;
+
+  static ValueType Identity() { return std::numeric_limits<T>::lowest(); }
+
+  template <typename U>
+  static ValueType Lift(const U& value) {
+    return static_cast<ValueType>(value);
+  }
+
+  static ValueType Combine(const ValueType& lhs, const ValueType& rhs) {
+    return std::max(lhs, rhs);
+  }
+};
+
+}  // namespace b_plus_tree
+
+#endif  // B_PLUS_TREE_AGGREGATE_H_
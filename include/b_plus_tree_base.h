@@ -25,6 +25,25 @@ class BPlusTreeBase {
   virtual Iterator Search(Transaction* transaction, const KeyType& key) = 0;
 };
 
+// SecondaryIndexBase is the interface a primary BPlusTree uses to keep its
+// registered secondary indexes up to date. Both hooks run inside the primary
+// tree's transaction so that the index commits or aborts with the primary.
+template <typename KeyType, typename ValueType>
+class SecondaryIndexBase {
+ public:
+  virtual ~SecondaryIndexBase() = default;
+
+  // Called after key and value were inserted into the primary tree.
+  virtual void OnInsert(blob_store::Transaction* transaction,
+                        BlobStoreObject<const KeyType> key,
+                        BlobStoreObject<const ValueType> value) = 0;
+
+  // Called after key and value were deleted from the primary tree.
+  virtual void OnDelete(blob_store::Transaction* transaction,
+                        BlobStoreObject<const KeyType> key,
+                        BlobStoreObject<const ValueType> value) = 0;
+};
+
 }  // namespace b_plus_tree
 
 #endif  // B_PLUS_TREE_BASE_H_
\ No newline at end of file
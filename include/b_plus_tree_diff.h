@@ -0,0 +1,212 @@
+#ifndef B_PLUS_TREE_DIFF_H_
+#define B_PLUS_TREE_DIFF_H_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "b_plus_tree_nodes.h"
+#include "blob_store.h"
+
+namespace b_plus_tree {
+
+enum class DiffType { kInserted, kDeleted, kChanged };
+
+// DiffEntry describes a key whose entry differs between two versions of a
+// tree. old_value is null for inserted keys and new_value is null for deleted
+// keys.
+template <typename KeyType, typename ValueType>
+struct DiffEntry {
+  DiffType type;
+  BlobStoreObject<const KeyType> key;
+  BlobStoreObject<const ValueType> old_value;
+  BlobStoreObject<const ValueType> new_value;
+};
+
+// TreeDiff walks two versions of a copy-on-write tree side by side and reports
+// the keys whose entries differ. Versions share every unchanged subtree by
+// index, so whenever both walks reach the same node the whole subtree is
+// skipped. Only the paths to changed entries are visited, which makes a diff
+// O(changes * depth) rather than O(n).
+//
+// A key is changed if it's mapped to a different value blob. Values are not
+// compared by content.
+template <typename KeyType, typename ValueType, std::size_t Order>
+class TreeDiff {
+ public:
+  using BaseNode = BaseNode<Order>;
+  using InternalNode = InternalNode<Order>;
+  using LeafNode = LeafNode<Order>;
+  using Entry = DiffEntry<KeyType, ValueType>;
+  using Visitor = std::function<void(const Entry&)>;
+
+  explicit TreeDiff(BlobStore* store) : store_(store) {}
+
+  // Reports every difference between the trees rooted at from_root and
+  // to_root to visitor in ascending key order.
+  void Run(size_t from_root, size_t to_root, const Visitor& visitor);
+
+ private:
+  // An Item is either an unexpanded subtree or a leaf entry. A walk is a stack
+  // of items whose top holds the smallest keys not yet visited.
+  struct Item {
+    bool is_entry;
+    // The node index of a subtree or the value index of an entry.
+    size_t index;
+    // The key index of an entry or a lower bound on the keys of a subtree.
+    // InvalidIndex if the subtree is unbounded below.
+    size_t key;
+    // The depth of a subtree.
+    size_t level;
+  };
+  using Walk = std::vector<Item>;
+
+  // Replaces the subtree on top of walk with its children or entries.
+  void Expand(Walk* walk);
+
+  // Returns whether the key at lhs is less than the key at rhs. InvalidIndex
+  // is less than any key.
+  bool KeyLess(size_t lhs, size_t rhs) const;
+
+  void Report(DiffType type,
+              size_t key,
+              size_t old_value,
+              size_t new_value,
+              const Visitor& visitor) const;
+
+  BlobStore* store_;
+};
+
+template <typename KeyType, typename ValueType, std::size_t Order>
+void TreeDiff<KeyType, ValueType, Order>::Run(size_t from_root,
+                                              size_t to_root,
+                                              const Visitor& visitor) {
+  Walk from = {{false, from_root, BlobStore::InvalidIndex, 0}};
+  Walk to = {{false, to_root, BlobStore::InvalidIndex, 0}};
+  while (!from.empty() && !to.empty()) {
+    Item a = from.back();
+    Item b = to.back();
+    if (!a.is_entry && !b.is_entry && a.index == b.index) {
+      // Shared subtree.
+      from.pop_back();
+      to.pop_back();
+    } else if (a.is_entry && b.is_entry) {
+      if (KeyLess(a.key, b.key)) {
+        Report(DiffType::kDeleted, a.key, a.index, BlobStore::InvalidIndex,
+               visitor);
+        from.pop_back();
+      } else if (KeyLess(b.key, a.key)) {
+        Report(DiffType::kInserted, b.key, BlobStore::InvalidIndex, b.index,
+               visitor);
+        to.pop_back();
+      } else {
+        if (a.index != b.index) {
+          Report(DiffType::kChanged, b.key, a.index, b.index, visitor);
+        }
+        from.pop_back();
+        to.pop_back();
+      }
+    } else if (a.is_entry) {
+      // Nothing in b's subtree is smaller than its lower bound.
+      if (KeyLess(a.key, b.key)) {
+        Report(DiffType::kDeleted, a.key, a.index, BlobStore::InvalidIndex,
+               visitor);
+        from.pop_back();
+      } else {
+        Expand(&to);
+      }
+    } else if (b.is_entry) {
+      if (KeyLess(b.key, a.key)) {
+        Report(DiffType::kInserted, b.key, BlobStore::InvalidIndex, b.index,
+               visitor);
+        to.pop_back();
+      } else {
+        Expand(&from);
+      }
+    } else if (KeyLess(a.key, b.key)) {
+      Expand(&from);
+    } else if (KeyLess(b.key, a.key)) {
+      Expand(&to);
+    } else if (a.level != b.level) {
+      // Expand the larger subtree first to give the smaller one a chance to
+      // line up with a shared node.
+      Expand(a.level < b.level ? &from : &to);
+    } else {
+      Expand(&from);
+      Expand(&to);
+    }
+  }
+  while (!from.empty()) {
+    Item a = from.back();
+    if (!a.is_entry) {
+      Expand(&from);
+      continue;
+    }
+    Report(DiffType::kDeleted, a.key, a.index, BlobStore::InvalidIndex,
+           visitor);
+    from.pop_back();
+  }
+  while (!to.empty()) {
+    Item b = to.back();
+    if (!b.is_entry) {
+      Expand(&to);
+      continue;
+    }
+    Report(DiffType::kInserted, b.key, BlobStore::InvalidIndex, b.index,
+           visitor);
+    to.pop_back();
+  }
+}
+
+template <typename KeyType, typename ValueType, std::size_t Order>
+void TreeDiff<KeyType, ValueType, Order>::Expand(Walk* walk) {
+  Item item = walk->back();
+  walk->pop_back();
+  BlobStoreObject<const BaseNode> node = store_->Get<BaseNode>(item.index);
+  if (node == nullptr) {
+    return;
+  }
+  if (node->is_leaf()) {
+    BlobStoreObject<const LeafNode> leaf = node.To<LeafNode>();
+    for (size_t i = leaf->num_keys(); i > 0; --i) {
+      walk->push_back({true, leaf->values[i - 1], leaf->get_key(i - 1), 0});
+    }
+    return;
+  }
+  BlobStoreObject<const InternalNode> internal = node.To<InternalNode>();
+  for (size_t i = internal->num_keys() + 1; i > 0; --i) {
+    size_t lower_bound = i > 1 ? internal->get_key(i - 2) : item.key;
+    walk->push_back(
+        {false, internal->children[i - 1], lower_bound, item.level + 1});
+  }
+}
+
+template <typename KeyType, typename ValueType, std::size_t Order>
+bool TreeDiff<KeyType, ValueType, Order>::KeyLess(size_t lhs,
+                                                  size_t rhs) const {
+  if (rhs == BlobStore::InvalidIndex) {
+    return false;
+  }
+  if (lhs == BlobStore::InvalidIndex) {
+    return true;
+  }
+  if (lhs == rhs) {
+    return false;
+  }
+  return *store_->Get<KeyType>(lhs) < *store_->Get<KeyType>(rhs);
+}
+
+template <typename KeyType, typename ValueType, std::size_t Order>
+void TreeDiff<KeyType, ValueType, Order>::Report(
+    DiffType type,
+    size_t key,
+    size_t old_value,
+    size_t new_value,
+    const Visitor& visitor) const {
+  visitor({type, store_->Get<KeyType>(key), store_->Get<ValueType>(old_value),
+           store_->Get<ValueType>(new_value)});
+}
+
+}  // namespace b_plus_tree
+
+#endif  // B_PLUS_TREE_DIFF_H_
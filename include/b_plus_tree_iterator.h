@@ -3,25 +3,33 @@
 
 #include "b_plus_tree_nodes.h"
 #include "blob_store.h"
+#include "inline_vector.h"
 
 namespace b_plus_tree {
 
 using blob_store::BlobStore;
 
-// Iterator class for BPlusTree
+// The maximum depth of a tree. Every internal node but the root has at least
+// two children, so this is enough for more keys than a store can hold.
+constexpr std::size_t kMaxTreeDepth = 32;
+
+// Iterator class for BPlusTree. The iterator keeps the path from its leaf to
+// the root inline, so creating, copying and advancing it never allocates.
 template <typename KeyType, typename ValueType, std::size_t Order>
 class TreeIterator {
  public:
   using BaseNode = BaseNode<Order>;
   using InternalNode = InternalNode<Order>;
   using LeafNode = LeafNode<Order>;
+  using PathToRoot = InlineVector<size_t, kMaxTreeDepth>;
 
   TreeIterator(BlobStore* store,
-               std::vector<size_t> path_to_root,
+               const PathToRoot& path_to_root,
                size_t key_index)
-      : store_(store),
-        path_to_root_(std::move(path_to_root)),
-        key_index_(key_index) {
+      : store_(store), path_to_root_(path_to_root), key_index_(key_index) {
+    if (path_to_root_.empty()) {
+      return;
+    }
     leaf_node_ = store_->Get<LeafNode>(path_to_root_.back());
     path_to_root_.pop_back();
     if (key_index_ >= leaf_node_->num_keys()) {
@@ -111,7 +119,7 @@ class TreeIterator {
   }
 
   BlobStore* store_;
-  std::vector<size_t> path_to_root_;
+  PathToRoot path_to_root_;
   BlobStoreObject<const LeafNode> leaf_node_;
   size_t key_index_;
 };
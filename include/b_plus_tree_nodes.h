@@ -5,10 +5,15 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <type_traits>
 
+#include "b_plus_tree_aggregate.h"
 #include "blob_store.h"
 #include "fixed_string.h"
+#include "key_encoding.h"
+#include "packed_ints.h"
 #include "storage_traits.h"
+#include "utils.h"
 
 namespace b_plus_tree {
 
@@ -36,8 +41,9 @@ struct BaseNode {
   // Returns whether the node has the maximum number of keys it can hold.
   bool is_full() const { return n == Order - 1; }
 
-  // Returns whether the node has the minimum number of keys it can hold.
-  bool will_underflow() const { return n == (Order - 1) / 2; }
+  // Returns whether the node has the minimum number of keys it can hold or
+  // fewer, which lazy deletes may leave behind.
+  bool will_underflow() const { return n <= (Order - 1) / 2; }
 
   // Returns the number of keys in the node.
   size_t num_keys() const { return n; }
@@ -95,10 +101,25 @@ static_assert(std::is_trivially_copyable<BaseNode<>>::value,
 static_assert(std::is_standard_layout<BaseNode<>>::value,
               "BaseNode is standard layout");
 
-template <std::size_t Order = 4>
-struct InternalNode {
+// Nodes start on a cache line so that searching their keys touches as few
+// cache lines as possible.
+//
+// Aggregate is the tree's aggregate, see b_plus_tree_aggregate.h. Its values
+// come last, so an InternalNode<Order> reads the children and counts of an
+// InternalNode<Order, Aggregate> of any aggregate.
+template <std::size_t Order = 4, typename Aggregate = NoAggregate>
+struct alignas(utils::kCacheLineSize) InternalNode {
+  // The number of aggregate values the node stores.
+  static constexpr std::size_t kNumAggregates =
+      std::is_same<Aggregate, NoAggregate>::value ? 0 : Order;
+
   BaseNode<Order> base;
   std::array<std::size_t, Order> children;
+  // The number of entries in the subtree under each child. Ranks and range
+  // counts add these up on the way down instead of walking the leaves.
+  std::array<std::size_t, Order> counts;
+  // The aggregate of the values in the subtree under each child.
+  std::array<typename Aggregate::ValueType, kNumAggregates> aggregates;
   explicit InternalNode(std::size_t n = 0) : base(NodeType::INTERNAL, n) {}
 
   bool is_leaf() const { return base.is_leaf(); }
@@ -112,6 +133,15 @@ struct InternalNode {
   size_t get_key(size_t index) const { return base.get_key(index); }
   void set_key(size_t index, size_t key) { base.set_key(index, key); }
 
+  // Returns the number of entries in the subtree rooted at this node.
+  size_t count() const {
+    size_t count = 0;
+    for (size_t i = 0; i <= num_keys(); ++i) {
+      count += counts[i];
+    }
+    return count;
+  }
+
   template <typename KeyType,
             typename U = typename StorageTraits<KeyType>::SearchType>
   typename std::enable_if<
@@ -132,12 +162,84 @@ static_assert(std::is_trivially_copyable<InternalNode<>>::value,
 static_assert(std::is_standard_layout<InternalNode<>>::value,
               "InternalNode is standard layout");
 
-template <std::size_t Order = 4>
-struct LeafNode {
+// LeafKeyPrefix maps the keys of a tree to the 64-bit prefixes its leaves
+// pack next to their keys, see LeafNode::packed_keys. Prefixes order like
+// their keys: a < b implies Of(a) <= Of(b). If kExact, equal prefixes also
+// mean equal keys, so the prefixes alone find a key. Otherwise the keys that
+// share the searched prefix are compared in full. Leaves of key types without
+// a specialization don't pack their keys.
+template <typename KeyType, typename Enable = void>
+struct LeafKeyPrefix {
+  static constexpr bool kPacked = false;
+};
+
+// Unsigned integers are their own prefixes.
+template <typename KeyType>
+struct LeafKeyPrefix<
+    KeyType,
+    typename std::enable_if<std::is_integral<KeyType>::value &&
+                            std::is_unsigned<KeyType>::value &&
+                            sizeof(KeyType) <= sizeof(std::uint64_t)>::type> {
+  static constexpr bool kPacked = true;
+  static constexpr bool kExact = true;
+
+  static std::uint64_t Of(KeyType key) { return key; }
+};
+
+// An OrderedKey's prefix is the first 8 bytes of its encoding read
+// big-endian, padded with zeros, which orders like memcmp.
+template <>
+struct LeafKeyPrefix<key_encoding::OrderedKey> {
+  static constexpr bool kPacked = true;
+  static constexpr bool kExact = false;
+
+  static std::uint64_t Of(const key_encoding::OrderedKey& key) {
+    return Of(key.data(), key.size());
+  }
+  static std::uint64_t Of(const FixedString& key) {
+    return Of(key.data, key.size);
+  }
+
+ private:
+  static std::uint64_t Of(const char* data, std::size_t size) {
+    std::uint64_t prefix = 0;
+    for (std::size_t i = 0; i < sizeof(prefix); ++i) {
+      prefix <<= 8;
+      if (i < size) {
+        prefix |= static_cast<std::uint8_t>(data[i]);
+      }
+    }
+    return prefix;
+  }
+};
+
+// Returns whether leaves of KeyType keep a packed copy of their key prefixes.
+template <typename KeyType>
+constexpr bool PacksLeafKeys() {
+  return LeafKeyPrefix<KeyType>::kPacked;
+}
+
+// TreeKeyType is the key type of the leaf's tree. It only matters to trees
+// whose leaves pack their keys, which are larger than a LeafNode<Order>.
+template <std::size_t Order = 4, typename TreeKeyType = void>
+struct alignas(utils::kCacheLineSize) LeafNode {
+  // The number of words of packed_keys: the block header, one word per key
+  // at the widest and the padding word.
+  static constexpr std::size_t kNumPackedKeyWords =
+      PacksLeafKeys<TreeKeyType>()
+          ? sizeof(packed_ints::BlockHeader) / sizeof(std::uint64_t) + Order
+          : 0;
+
   BaseNode<Order> base;
   std::array<std::size_t, Order - 1> values;
+  // The prefixes of the keys as a packed_ints block, which searches
+  // binary-search in the node instead of reading a key blob per probe. It is
+  // rebuilt whenever the keys change. It comes last, so a LeafNode<Order>
+  // reads the keys and values of a leaf of any key type.
+  std::array<std::uint64_t, kNumPackedKeyWords> packed_keys;
 
-  LeafNode(std::size_t num_keys = 0) : base(NodeType::LEAF, num_keys) {}
+  LeafNode(std::size_t num_keys = 0)
+      : base(NodeType::LEAF, num_keys), packed_keys() {}
 
   bool is_leaf() const { return base.is_leaf(); }
   bool is_internal() const { return base.is_internal(); }
@@ -163,12 +265,40 @@ struct LeafNode {
          BlobStoreObject<const KeyType>* key_in_node) const {
     return base.Search<KeyType, U>(store, search_key, key_in_node);
   }
+
+  // Packs keys, the prefixes of the node's keys in order, into packed_keys.
+  void PackKeys(const std::uint64_t* keys) {
+    packed_ints::Pack(keys, num_keys(),
+                      reinterpret_cast<std::uint8_t*>(packed_keys.data()));
+  }
+
+  // Returns the position of the first key whose prefix is not less than
+  // prefix. Only the packed prefixes are read.
+  size_t LowerBound(std::uint64_t prefix) const {
+    return packed_ints::PackedView(
+               reinterpret_cast<const std::uint8_t*>(packed_keys.data()))
+        .LowerBound(prefix);
+  }
 };
 
 static_assert(std::is_trivially_copyable<LeafNode<>>::value,
               "LeafNode is trivially copyable");
 static_assert(std::is_standard_layout<LeafNode<>>::value,
               "LeafNode is standard layout");
+static_assert(std::is_trivially_copyable<LeafNode<4, std::uint64_t>>::value,
+              "LeafNode is trivially copyable");
+static_assert(std::is_standard_layout<LeafNode<4, std::uint64_t>>::value,
+              "LeafNode is standard layout");
+
+// Returns the number of entries in the subtree rooted at node, which is either
+// a leaf or an internal node.
+template <std::size_t Order>
+size_t GetSubtreeCount(const BaseNode<Order>& node) {
+  if (node.is_leaf()) {
+    return node.num_keys();
+  }
+  return reinterpret_cast<const InternalNode<Order>&>(node).count();
+}
 
 // Grab the key at the provided key_index. This method accepts all node types
 // and works for both const and non-const nodes.
@@ -199,8 +329,8 @@ static void GetValue(const BlobStoreObject<U>& node,
 }
 
 // Returns the child at the given index of the given node preserving constness.
-template <std::size_t Order>
-void GetChild(const BlobStoreObject<InternalNode<Order>>& node,
+template <std::size_t Order, typename Aggregate>
+void GetChild(const BlobStoreObject<InternalNode<Order, Aggregate>>& node,
               size_t child_index,
               BlobStoreObject<BaseNode<Order>>* child_ptr) {
   if (node == nullptr || child_index > node->num_keys()) {
@@ -211,8 +341,8 @@ void GetChild(const BlobStoreObject<InternalNode<Order>>& node,
                                                 node->children[child_index]);
 }
 
-template <std::size_t Order>
-void GetChild(const BlobStoreObject<const InternalNode<Order>>& node,
+template <std::size_t Order, typename Aggregate>
+void GetChild(const BlobStoreObject<const InternalNode<Order, Aggregate>>& node,
               size_t child_index,
               BlobStoreObject<const BaseNode<Order>>* child_ptr) {
   if (node == nullptr || child_index > node->num_keys()) {
@@ -238,8 +368,8 @@ void GetChildConst(const BlobStoreObject<U>& node,
 }
 
 // Prints a BlobStoreObject<BaseNode> in a human-readable format.
-template <typename KeyType, std::size_t Order>
-void PrintNode(BlobStoreObject<const InternalNode<Order>> node) {
+template <typename KeyType, std::size_t Order, typename Aggregate>
+void PrintNode(BlobStoreObject<const InternalNode<Order, Aggregate>> node) {
   if (node == nullptr) {
     std::cout << "NULL Node" << std::endl;
     return;
@@ -254,8 +384,8 @@ void PrintNode(BlobStoreObject<const InternalNode<Order>> node) {
   std::cout << std::endl;
 }
 
-template <typename KeyType, std::size_t Order>
-void PrintNode(BlobStoreObject<const LeafNode<Order>> node) {
+template <typename KeyType, std::size_t Order, typename TreeKeyType>
+void PrintNode(BlobStoreObject<const LeafNode<Order, TreeKeyType>> node) {
   if (node == nullptr) {
     std::cout << "NULL Node" << std::endl;
     return;
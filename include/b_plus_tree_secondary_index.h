@@ -0,0 +1,104 @@
+#ifndef B_PLUS_TREE_SECONDARY_INDEX_H_
+#define B_PLUS_TREE_SECONDARY_INDEX_H_
+
+#include <cstddef>
+#include <functional>
+
+#include "b_plus_tree.h"
+#include "b_plus_tree_base.h"
+#include "blob_store.h"
+#include "blob_store_transaction.h"
+
+namespace b_plus_tree {
+
+// SecondaryIndex maps a key extracted from every entry of a primary BPlusTree
+// to that entry's value. The index is itself a B+ tree rooted in one of the
+// secondary root slots of the primary tree's head, so it's updated within the
+// primary tree's transactions and commits or aborts atomically with them.
+// Index entries refer to the primary value blob by index rather than holding a
+// copy of it.
+//
+// Extracted keys must be unique. A non-unique attribute can be indexed by
+// folding the primary key into the extracted key.
+template <typename SecondaryKeyType,
+          typename KeyType,
+          typename ValueType,
+          std::size_t Order>
+class SecondaryIndex : public SecondaryIndexBase<KeyType, ValueType> {
+ public:
+  using PrimaryTree = BPlusTree<KeyType, ValueType, Order>;
+  using IndexTree = BPlusTree<SecondaryKeyType, ValueType, Order>;
+  using Iterator = TreeIterator<SecondaryKeyType, ValueType, Order>;
+  using KeyStorageType = typename StorageTraits<KeyType>::StorageType;
+  using ValueStorageType = typename StorageTraits<ValueType>::StorageType;
+  using Extractor = std::function<SecondaryKeyType(const KeyStorageType&,
+                                                   const ValueStorageType&)>;
+
+  // Opens the index stored in the secondary root |slot| of the head shared
+  // with |primary| and registers it with |primary|. If the slot is empty, the
+  // index is created and populated with the entries already in |primary|.
+  SecondaryIndex(BlobStore& blob_store,
+                 PrimaryTree* primary,
+                 size_t slot,
+                 Extractor extractor)
+      : primary_(primary),
+        tree_(blob_store, slot),
+        extractor_(std::move(extractor)) {
+    CreateIndexIfNecessary(slot);
+    primary_->AddSecondaryIndex(this);
+  }
+
+  ~SecondaryIndex() { primary_->RemoveSecondaryIndex(this); }
+
+  SecondaryIndex(const SecondaryIndex&) = delete;
+  SecondaryIndex& operator=(const SecondaryIndex&) = delete;
+
+  // Returns an iterator to the first entry whose secondary key is greater than
+  // or equal to key. The iterator's values are the primary tree's values.
+  Iterator Search(const SecondaryKeyType& key) { return tree_.Search(key); }
+
+  // SecondaryIndexBase implementation.
+  void OnInsert(blob_store::Transaction* transaction,
+                BlobStoreObject<const KeyType> key,
+                BlobStoreObject<const ValueType> value) override {
+    BlobStoreObject<SecondaryKeyType> secondary_key =
+        transaction->New<SecondaryKeyType>(extractor_(*key, *value));
+    tree_.InsertIntoTree(transaction, std::move(secondary_key).Downgrade(),
+                         std::move(value));
+  }
+
+  void OnDelete(blob_store::Transaction* transaction,
+                BlobStoreObject<const KeyType> key,
+                BlobStoreObject<const ValueType> value) override {
+    tree_.DeleteFromTree(transaction, extractor_(*key, *value));
+  }
+
+ private:
+  // Creates an empty root for the index and indexes all existing primary
+  // entries in a single transaction, unless another process got there first.
+  void CreateIndexIfNecessary(size_t slot) {
+    while (true) {
+      auto txn = primary_->CreateTransaction();
+      if (txn.GetSecondaryRootNode<BaseNode<Order>>(slot) != nullptr) {
+        std::move(txn).Abort();
+        return;
+      }
+      txn.SetSecondaryRootNode(
+          slot, txn.New<LeafNode<Order, SecondaryKeyType>>().Index());
+      for (auto it = primary_->First(&txn); it.GetKey() != nullptr; ++it) {
+        OnInsert(&txn, it.GetKey(), it.GetValue());
+      }
+      if (std::move(txn).Commit()) {
+        return;
+      }
+    }
+  }
+
+  PrimaryTree* primary_;
+  IndexTree tree_;
+  Extractor extractor_;
+};
+
+}  // namespace b_plus_tree
+
+#endif  // B_PLUS_TREE_SECONDARY_INDEX_H_
@@ -0,0 +1,120 @@
+#ifndef B_PLUS_TREE_SNAPSHOT_H_
+#define B_PLUS_TREE_SNAPSHOT_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "b_plus_tree_iterator.h"
+#include "b_plus_tree_nodes.h"
+#include "blob_store.h"
+
+namespace b_plus_tree {
+
+// The aggregate of a tree defaults to NoAggregate here, where the tree is
+// first declared.
+template <typename KeyType,
+          typename ValueType,
+          std::size_t Order,
+          typename AggregateType = NoAggregate>
+class BPlusTree;
+
+// Snapshot is a read-only, point-in-time view of a BPlusTree at a committed
+// version. Searches and iterators obtained from a snapshot see the tree exactly
+// as it was when that version was committed, regardless of what writers have
+// committed since.
+//
+// A snapshot pins its version: it holds a read lock on the version's root node
+// for as long as it's alive. Writers never need that lock as they clone
+// committed nodes, so an open snapshot doesn't block them, while anything that
+// reclaims history can tell a pinned version from its root's lock state.
+template <typename KeyType,
+          typename ValueType,
+          std::size_t Order,
+          typename AggregateType = NoAggregate>
+class Snapshot {
+ public:
+  using BaseNode = BaseNode<Order>;
+  using InternalNode = InternalNode<Order, AggregateType>;
+  using Iterator = TreeIterator<KeyType, ValueType, Order>;
+  using Tree = BPlusTree<KeyType, ValueType, Order, AggregateType>;
+  using AggregateValue = typename AggregateType::ValueType;
+
+  // Returns the version this snapshot reads.
+  std::size_t version() const { return version_; }
+
+  // Returns whether the requested version exists. Searches on an invalid
+  // snapshot return an invalid iterator.
+  bool is_valid() const { return root_ != nullptr; }
+
+  // Returns an iterator to the first element greater than or equal to key as
+  // of this snapshot's version.
+  Iterator Search(const KeyType& key) const {
+    if (root_ == nullptr) {
+      return Iterator(store_, typename Iterator::PathToRoot(), 0);
+    }
+    return tree_->Search(root_, key);
+  }
+
+  // Returns an iterator to the smallest key as of this snapshot's version.
+  Iterator First() const {
+    if (root_ == nullptr) {
+      return Iterator(store_, typename Iterator::PathToRoot(), 0);
+    }
+    return tree_->First(root_);
+  }
+
+  // Returns the number of keys as of this snapshot's version.
+  std::size_t Size() const {
+    return root_ == nullptr ? 0 : GetSubtreeCount(*root_);
+  }
+
+  // Returns the number of keys less than key as of this snapshot's version.
+  std::size_t Rank(const KeyType& key) const {
+    return root_ == nullptr ? 0 : tree_->Rank(root_, key);
+  }
+
+  // Returns an iterator to the key at position k as of this snapshot's
+  // version, or an invalid iterator if there are k keys or fewer.
+  Iterator Select(std::size_t k) const {
+    if (root_ == nullptr) {
+      return Iterator(store_, typename Iterator::PathToRoot(), 0);
+    }
+    return tree_->Select(root_, k);
+  }
+
+  // Returns the number of keys in [lo, hi) as of this snapshot's version.
+  std::size_t Count(const KeyType& lo, const KeyType& hi) const {
+    if (root_ == nullptr || !(lo < hi)) {
+      return 0;
+    }
+    return tree_->Rank(root_, hi) - tree_->Rank(root_, lo);
+  }
+
+  // Returns the aggregate of the values of the keys in [lo, hi) as of this
+  // snapshot's version.
+  AggregateValue Aggregate(const KeyType& lo, const KeyType& hi) const {
+    if (root_ == nullptr || !(lo < hi)) {
+      return AggregateType::Identity();
+    }
+    return tree_->Aggregate(root_, lo, hi);
+  }
+
+ private:
+  friend class BPlusTree<KeyType, ValueType, Order, AggregateType>;
+
+  Snapshot(Tree* tree,
+           BlobStore* store,
+           std::size_t version,
+           BlobStoreObject<const BaseNode> root)
+      : tree_(tree), store_(store), version_(version), root_(std::move(root)) {}
+
+  Tree* tree_;
+  BlobStore* store_;
+  std::size_t version_;
+  // Pins the snapshot's version.
+  BlobStoreObject<const BaseNode> root_;
+};
+
+}  // namespace b_plus_tree
+
+#endif  // B_PLUS_TREE_SNAPSHOT_H_
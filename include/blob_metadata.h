@@ -2,6 +2,9 @@
 #define BLOB_METADATA_H_
 
 #include <atomic>
+#include <cstdint>
+
+#include "concurrency_policy.h"
 
 namespace blob_store {
 
@@ -11,6 +14,15 @@ typedef __int64 ssize_t;
 typedef int ssize_t;
 #endif
 
+// Set in BlobMetadata::lock_state while a writer holds the lock. Otherwise,
+// lock_state is the number of readers.
+constexpr std::int32_t WRITE_LOCK_FLAG = 0x80000000;
+
+// Stored in BlobMetadata::next_free_index for a slot that is held for a blob
+// that BlobStore::Put will store later. It's neither occupied nor on the free
+// list.
+constexpr ssize_t RESERVED_SLOT = -2;
+
 struct BlobMetadata {
   // The size of the type stored.
   // TODO(fsamuel): Can we get this from the allocator? Or perhaps BlobStore is
@@ -24,8 +36,13 @@ struct BlobMetadata {
   // TODO(fsamuel): We should probably get rid of this.
   std::atomic<int> lock_state;
 
-  // This field can take one of three states:
+  // The alignment the blob was created with. The blob keeps it when it's
+  // cloned, resized or moved.
+  std::uint32_t alignment;
+
+  // This field can take one of four states:
   // -  -1 if the slot is occupied
+  // -  RESERVED_SLOT if the slot is reserved for BlobStore::Put
   // -   0 if the slot is tombstoned or at the end of the free list.
   // -   A positive number indicating the index of the next free slot in the
   // free list.
@@ -35,21 +52,28 @@ struct BlobMetadata {
   // blob.
   std::atomic<ssize_t> next_free_index;
 
-  BlobMetadata() : size(0), offset(0), lock_state(0), next_free_index(0) {}
+  BlobMetadata()
+      : size(0), offset(0), lock_state(0), alignment(0), next_free_index(0) {}
 
   BlobMetadata(size_t size, size_t count, std::size_t offset)
-      : size(size), offset(offset), lock_state(0), next_free_index(-1) {}
+      : size(size),
+        offset(offset),
+        lock_state(0),
+        alignment(0),
+        next_free_index(-1) {}
 
   BlobMetadata(const BlobMetadata& other)
       : size(other.size),
         offset(other.offset.load()),
         lock_state(0),
+        alignment(other.alignment),
         next_free_index(other.next_free_index.load()) {}
 
   bool is_deleted() const { return next_free_index.load() != -1; }
 
   bool is_tombstone() const { return next_free_index.load() == 0; }
 
+  template <typename Policy = MultiThreaded>
   bool SetTombstone() {
     ssize_t expected = next_free_index.load();
     // If the slot is already tombstoned, or on the free list then we don't
@@ -57,7 +81,7 @@ struct BlobMetadata {
     if (expected != -1) {
       return false;
     }
-    return next_free_index.compare_exchange_strong(expected, 0);
+    return Policy::CompareExchange(next_free_index, expected, 0);
   }
 };
 
@@ -2,17 +2,21 @@
 #define BLOB_STORE_H_
 
 #include <sys/types.h>
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <new>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include "blob_metadata.h"
 #include "blob_store_base.h"
 #include "blob_store_object.h"
 #include "chunked_vector.h"
+#include "concurrency_policy.h"
 #include "shm_allocator.h"
 #include "storage_traits.h"
 #include "string_slice.h"
@@ -23,7 +27,22 @@ namespace blob_store {
 // BlobStore is a class that manages the storage and retrieval of objects
 // (blobs) in shared memory. It supports storing, getting, and deleting
 // objects while maintaining a compact memory footprint.
-class BlobStore : public BlobStoreBase {
+//
+// BlobStore is final so that BlobStoreObjects, which call it through a
+// BlobStore pointer, don't pay for virtual calls. The uncontended paths of the
+// lock operations and GetRaw are defined in this header so they can be
+// inlined into callers.
+//
+// The Policy parameter is a concurrency policy from concurrency_policy.h.
+// BlobStore is the MultiThreaded store that every process sharing the store
+// uses. SingleThreadedBlobStore replaces the atomic read-modify-write
+// operations on blob locks, offsets and the free slot list with plain loads
+// and stores, for tools that own a store and use it from one thread. Both
+// share the same layout in memory and on disk. The allocator and the chunk
+// managers underneath are shared with the rest of the library and stay
+// thread-safe under either policy.
+template <typename Policy>
+class BasicBlobStore final : public BlobStoreBase {
  public:
   using Allocator = ShmAllocator;
 
@@ -31,17 +50,21 @@ class BlobStore : public BlobStoreBase {
       std::numeric_limits<std::size_t>::max();
 
   // Constructor that initializes the BlobStore with the provided metadata and
-  // data shared memory buffers.
-  BlobStore(BufferFactory* buffer_factory,
-            const std::string& name_prefix,
-            std::size_t requested_chunk_size,
-            ChunkManager&& dataBuffer);
+  // data shared memory buffers. Blobs of at least large_object_threshold bytes
+  // get a dedicated buffer instead of being allocated from dataBuffer.
+  BasicBlobStore(BufferFactory* buffer_factory,
+                 const std::string& name_prefix,
+                 std::size_t requested_chunk_size,
+                 ChunkManager&& dataBuffer,
+                 std::size_t large_object_threshold =
+                     ShmAllocator::kDefaultLargeObjectThreshold);
 
   // BlobStore destructor
-  ~BlobStore();
+  ~BasicBlobStore();
 
   // Creates a new object of type T with the provided arguments into the
-  // BlobStore and returns a BlobStoreObject.
+  // BlobStore and returns a BlobStoreObject. The object is aligned to
+  // alignof(T).
   template <typename T, typename... Args>
   typename std::enable_if<
       !is_unsized_array<T>::value &&
@@ -49,42 +72,124 @@ class BlobStore : public BlobStoreBase {
               typename StorageTraits<T>::StorageType>::value &&
           std::is_trivially_copyable<
               typename StorageTraits<T>::StorageType>::value,
-      BlobStoreObject<T>>::type
+      BlobStoreObject<T, BasicBlobStore>>::type
   New(Args&&... args);
 
+  // Same as above, but aligns the object to at least alignment bytes, e.g.
+  // std::align_val_t{64} to start it on a cache line.
+  template <typename T, typename... Args>
+  typename std::enable_if<
+      !is_unsized_array<T>::value &&
+          std::is_standard_layout<
+              typename StorageTraits<T>::StorageType>::value &&
+          std::is_trivially_copyable<
+              typename StorageTraits<T>::StorageType>::value,
+      BlobStoreObject<T, BasicBlobStore>>::type
+  New(std::align_val_t alignment, Args&&... args);
+
   template <typename T>
-  typename std::enable_if<is_unsized_array<T>::value, BlobStoreObject<T>>::type
+  typename std::enable_if<is_unsized_array<T>::value,
+                          BlobStoreObject<T, BasicBlobStore>>::type
   New(size_t size);
 
+  template <typename T>
+  typename std::enable_if<is_unsized_array<T>::value,
+                          BlobStoreObject<T, BasicBlobStore>>::type
+  New(std::align_val_t alignment, size_t size);
+
   template <typename T>
   typename std::enable_if<
       std::is_standard_layout<typename StorageTraits<T>::StorageType>::value &&
           std::is_trivially_copyable<
               typename StorageTraits<T>::StorageType>::value,
-      BlobStoreObject<T>>::type
+      BlobStoreObject<T, BasicBlobStore>>::type
   New(std::initializer_list<typename StorageTraits<T>::ElementType> initList);
 
+  // Same as New, but places the object in the same chunk as the blob at
+  // near_index when there is room, so that blobs that are read together
+  // share pages. Falls back to New's placement if near_index isn't a live
+  // blob.
+  template <typename T, typename... Args>
+  typename std::enable_if<
+      !is_unsized_array<T>::value &&
+          std::is_standard_layout<
+              typename StorageTraits<T>::StorageType>::value &&
+          std::is_trivially_copyable<
+              typename StorageTraits<T>::StorageType>::value,
+      BlobStoreObject<T, BasicBlobStore>>::type
+  NewNear(size_t near_index, Args&&... args);
+
+  template <typename T>
+  typename std::enable_if<is_unsized_array<T>::value,
+                          BlobStoreObject<T, BasicBlobStore>>::type
+  NewNear(size_t near_index, size_t size);
+
   // Creates a new BlobStoreObject<char[]> that consists of a serialized T type.
   template <typename T>
-  BlobStoreObject<char[]> Serialize(const T& object);
+  BlobStoreObject<char[], BasicBlobStore> Serialize(const T& object);
 
   // Gets the object of type T at the specified index.
   template <typename T>
-  BlobStoreObject<T> GetMutable(size_t index) {
-    return BlobStoreObject<T>(this, index);
+  BlobStoreObject<T, BasicBlobStore> GetMutable(size_t index) {
+    return BlobStoreObject<T, BasicBlobStore>(this, index);
   }
 
   // Gets the object of type T at the specified index as a constant.
   template <typename T>
-  BlobStoreObject<const T> Get(size_t index) const {
-    return const_cast<BlobStore*>(this)->GetMutable<const T>(index);
+  BlobStoreObject<const T, BasicBlobStore> Get(size_t index) const {
+    return const_cast<BasicBlobStore*>(this)->template GetMutable<const T>(
+        index);
   }
 
   // Drops the object at the specified index, freeing the associated memory.
   void Drop(size_t index);
 
+  // Stores a copy of the size bytes at data as the blob at index, replacing
+  // any blob already there. This lets a store mirror the indices of another
+  // store, e.g. a replication follower. If the metadata vector has to grow to
+  // reach index, the slots in between are reserved for later Puts instead of
+  // going on the free list, so New never hands them out. A live blob is only
+  // replaced once its readers have released it: Put takes its write lock,
+  // swaps in the copy and frees the old allocation. It must not race with any
+  // other writer to this store. The copy is aligned to alignment.
+  void Put(size_t index,
+           const void* data,
+           size_t size,
+           size_t alignment = ShmAllocator::kMinAlignment);
+
+  // Resizes the blob at index to new_size bytes, preserving its content up to
+  // the smaller of the old and new sizes. The blob grows in place if its
+  // allocation has room. Otherwise it's copied to a new allocation, its offset
+  // is swung to the copy atomically and the old allocation is freed. Returns false if there's no blob at index.
+  // The caller must hold the write lock on the blob, so that nobody is reading
+  // the allocation that is freed. BlobStoreObject<T>::Resize does this.
+  bool Resize(size_t index, size_t new_size) override;
+
+  // Returns the alignment of the blob at index, or 0 if there's no blob at
+  // index.
+  std::size_t GetAlignment(std::size_t index);
+
+  // Returns the allocator index of the blob at index, or
+  // ShmAllocator::InvalidIndex if there is no live blob there.
+  std::size_t GetOffset(std::size_t index);
+
+  // Returns the number of bytes held by live blobs in each chunk of the data
+  // buffer.
+  std::vector<size_t> GetLiveBytesPerChunk();
+
+  // Runs one bounded step of online defragmentation and returns the number of
+  // blobs moved. The step picks the last chunk that is at most half full and
+  // whose blobs fit in the free space of the chunks before it, and moves up to
+  // max_moves of its blobs to lower chunks. Blobs keep their indices: each one
+  // is copied to its new allocation and its offset is swung over with a
+  // compare-and-swap before the old allocation is freed. Blobs that are locked
+  // are skipped, so the step never blocks and never moves memory out from
+  // under a reader. Call it repeatedly, e.g. from a background thread, until it
+  // returns 0.
+  size_t Defragment(size_t max_moves);
+
   template <typename U>
-  void Drop(BlobStoreObject<U>&& object) {
+  void Drop(BlobStoreObject<U, BasicBlobStore>&& object) {
     size_t index = object.Index();
     // This ensures that we're no longer holding a lock on this object.
     object = nullptr;
@@ -106,7 +211,8 @@ class BlobStore : public BlobStoreBase {
   // Iterator class for BlobStore
   class Iterator {
    public:
-    Iterator(BlobStore* store, size_t index) : store_(store), index_(index) {
+    Iterator(BasicBlobStore* store, size_t index)
+        : store_(store), index_(index) {
       AdvanceToValidIndex();
     }
 
@@ -146,13 +252,13 @@ class BlobStore : public BlobStoreBase {
     bool operator!=(const Iterator& other) const { return !(*this == other); }
 
     template <typename T>
-    BlobStoreObject<const T> Get() const {
-      return store_->Get<const T>(index_);
+    BlobStoreObject<const T, BasicBlobStore> Get() const {
+      return store_->template Get<const T>(index_);
     }
 
     template <typename T>
-    BlobStoreObject<T> GetMutable() {
-      return store_->GetMutable<T>(index_);
+    BlobStoreObject<T, BasicBlobStore> GetMutable() {
+      return store_->template GetMutable<T>(index_);
     }
 
    private:
@@ -170,7 +276,7 @@ class BlobStore : public BlobStoreBase {
       }
     }
 
-    BlobStore* store_;
+    BasicBlobStore* store_;
     size_t index_;
   };
 
@@ -186,21 +292,31 @@ class BlobStore : public BlobStoreBase {
       std::is_standard_layout<typename StorageTraits<T>::StorageType>::value &&
           std::is_trivially_copyable<
               typename StorageTraits<T>::StorageType>::value,
-      BlobStoreObject<T>>::type
-  NewImpl(Args&&... args);
+      BlobStoreObject<T, BasicBlobStore>>::type
+  NewImpl(std::size_t alignment, std::size_t hint_offset, Args&&... args);
 
   template <typename T>
   typename std::enable_if<
       std::is_standard_layout<typename StorageTraits<T>::StorageType>::value &&
           std::is_trivially_copyable<
               typename StorageTraits<T>::StorageType>::value,
-      BlobStoreObject<T>>::type
+      BlobStoreObject<T, BasicBlobStore>>::type
   NewImpl(
+      std::size_t alignment,
+      std::size_t hint_offset,
       std::initializer_list<typename StorageTraits<T>::ElementType> initList);
 
   template <typename T>
-  typename std::enable_if<is_unsized_array<T>::value, BlobStoreObject<T>>::type
-  NewImpl(size_t size);
+  typename std::enable_if<is_unsized_array<T>::value,
+                          BlobStoreObject<T, BasicBlobStore>>::type
+  NewImpl(std::size_t alignment, std::size_t hint_offset, size_t size);
+
+  // Records a new blob of the provided size and alignment at ptr in the slot
+  // at index.
+  void InitializeMetadata(std::size_t index,
+                          std::size_t size,
+                          std::size_t alignment,
+                          uint8_t* ptr);
 
   // Returns the index of the first free slot in the metadata vector.
   size_t FindFreeSlot();
@@ -208,6 +324,24 @@ class BlobStore : public BlobStoreBase {
   // Returns the number of free slots in the metadata vector.
   size_t GetFreeSlotCount() const;
 
+  // Acquires a write lock for the object at the specified index if nobody
+  // holds a lock on it. Returns false without waiting otherwise.
+  bool TryAcquireWriteLock(std::size_t index);
+
+  // Unlinks the slot at index from the free list if it's on it. This walks
+  // the free list, so Put only calls it for slots that were dropped, not for
+  // the ones it reserved. Not safe against concurrent allocations.
+  void RemoveFreeSlot(size_t index);
+
+  // Spin until the lock is acquired or the blob is deleted. Called by the
+  // inline lock operations when the first attempt fails.
+  bool AcquireReadLockSlow(std::size_t index);
+  bool AcquireWriteLockSlow(std::size_t index);
+  void UnlockSlow(std::size_t index);
+
+  template <typename T, typename StoreType>
+  friend class BlobStoreObject;
+
   // BlobStoreBase implementation:
   uint8_t* GetRaw(size_t index, size_t* offset) override;
   std::size_t Clone(std::size_t index) override;
@@ -225,104 +359,233 @@ class BlobStore : public BlobStoreBase {
   MetadataVector metadata_;
 };
 
+template <typename Policy>
 template <typename T, typename... Args>
 typename std::enable_if<!is_unsized_array<T>::value &&
                             std::is_standard_layout<typename StorageTraits<
                                 T>::StorageType>::value &&
                             std::is_trivially_copyable<
                                 typename StorageTraits<T>::StorageType>::value,
-                        BlobStoreObject<T>>::type
-BlobStore::New(Args&&... args) {
-  return NewImpl<T>(std::forward<Args>(args)...);
+                        BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::New(Args&&... args) {
+  using StorageType = typename StorageTraits<T>::StorageType;
+  return NewImpl<T>(alignof(StorageType), ShmAllocator::InvalidIndex,
+                    std::forward<Args>(args)...);
 }
 
+template <typename Policy>
+template <typename T, typename... Args>
+typename std::enable_if<!is_unsized_array<T>::value &&
+                            std::is_standard_layout<typename StorageTraits<
+                                T>::StorageType>::value &&
+                            std::is_trivially_copyable<
+                                typename StorageTraits<T>::StorageType>::value,
+                        BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::New(std::align_val_t alignment, Args&&... args) {
+  using StorageType = typename StorageTraits<T>::StorageType;
+  return NewImpl<T>(std::max(static_cast<std::size_t>(alignment),
+                             alignof(StorageType)),
+                    ShmAllocator::InvalidIndex, std::forward<Args>(args)...);
+}
+
+template <typename Policy>
 template <typename T>
-typename std::enable_if<is_unsized_array<T>::value, BlobStoreObject<T>>::type
-BlobStore::New(size_t size) {
-  return NewImpl<T>(size);
+typename std::enable_if<is_unsized_array<T>::value,
+                        BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::New(size_t size) {
+  using ElementType = typename StorageTraits<T>::ElementType;
+  return NewImpl<T>(alignof(ElementType), ShmAllocator::InvalidIndex, size);
 }
 
+template <typename Policy>
+template <typename T>
+typename std::enable_if<is_unsized_array<T>::value,
+                        BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::New(std::align_val_t alignment, size_t size) {
+  using ElementType = typename StorageTraits<T>::ElementType;
+  return NewImpl<T>(std::max(static_cast<std::size_t>(alignment),
+                             alignof(ElementType)),
+                    ShmAllocator::InvalidIndex, size);
+}
+
+template <typename Policy>
+template <typename T, typename... Args>
+typename std::enable_if<
+    !is_unsized_array<T>::value &&
+        std::is_standard_layout<
+            typename StorageTraits<T>::StorageType>::value &&
+        std::is_trivially_copyable<
+            typename StorageTraits<T>::StorageType>::value,
+    BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::NewNear(size_t near_index, Args&&... args) {
+  using StorageType = typename StorageTraits<T>::StorageType;
+  return NewImpl<T>(alignof(StorageType), GetOffset(near_index),
+                    std::forward<Args>(args)...);
+}
+
+template <typename Policy>
+template <typename T>
+typename std::enable_if<is_unsized_array<T>::value,
+                        BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::NewNear(size_t near_index, size_t size) {
+  using ElementType = typename StorageTraits<T>::ElementType;
+  return NewImpl<T>(alignof(ElementType), GetOffset(near_index), size);
+}
+
+template <typename Policy>
 template <typename T>
 typename std::enable_if<
     std::is_standard_layout<typename StorageTraits<T>::StorageType>::value &&
         std::is_trivially_copyable<
             typename StorageTraits<T>::StorageType>::value,
-    BlobStoreObject<T>>::type
-BlobStore::New(
+    BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::New(
     std::initializer_list<typename StorageTraits<T>::ElementType> initList) {
-  return NewImpl<T>(initList);
+  using ElementType = typename StorageTraits<T>::ElementType;
+  return NewImpl<T>(alignof(ElementType), ShmAllocator::InvalidIndex,
+                    initList);
 }
 
+template <typename Policy>
 template <typename T>
-BlobStoreObject<char[]> BlobStore::Serialize(const T& object) {
+BlobStoreObject<char[], BasicBlobStore<Policy>>
+BasicBlobStore<Policy>::Serialize(const T& object) {
   size_t size = SerializeTraits<T>::Size(object);
-  BlobStoreObject<char[]> blob = New<char[]>(size);
+  BlobStoreObject<char[], BasicBlobStore<Policy>> blob = New<char[]>(size);
   SerializeTraits<T>::Serialize(&blob[0], object);
   return blob;
 }
 
+template <typename Policy>
 template <typename T, typename... Args>
 typename std::enable_if<
     std::is_standard_layout<typename StorageTraits<T>::StorageType>::value &&
         std::is_trivially_copyable<
             typename StorageTraits<T>::StorageType>::value,
-    BlobStoreObject<T>>::type
-BlobStore::NewImpl(Args&&... args) {
+    BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::NewImpl(std::size_t alignment,
+                                std::size_t hint_offset,
+                                Args&&... args) {
   using StorageType = typename StorageTraits<T>::StorageType;
   size_t index = FindFreeSlot();
   size_t size = StorageTraits<T>::size(std::forward<Args>(args)...);
-  uint8_t* ptr = allocator_.Allocate(size);
+  uint8_t* ptr = allocator_.AllocateNear(hint_offset, size, alignment);
   utils::Construct(reinterpret_cast<StorageType*>(ptr),
                    std::forward<Args>(args)...);
-  BlobMetadata& metadata = metadata_[index];
-  metadata.size = size;
-  metadata.offset = allocator_.ToIndex(ptr);
-  assert(metadata.offset != ShmAllocator::InvalidIndex);
-  metadata.lock_state = 0;
-  metadata.next_free_index = -1;
-  return BlobStoreObject<T>(this, index);
+  InitializeMetadata(index, size, alignment, ptr);
+  return BlobStoreObject<T, BasicBlobStore<Policy>>(this, index);
 }
 
+template <typename Policy>
 template <typename T>
 typename std::enable_if<
     std::is_standard_layout<typename StorageTraits<T>::StorageType>::value &&
         std::is_trivially_copyable<
             typename StorageTraits<T>::StorageType>::value,
-    BlobStoreObject<T>>::type
-BlobStore::NewImpl(
+    BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::NewImpl(
+    std::size_t alignment,
+    std::size_t hint_offset,
     std::initializer_list<typename StorageTraits<T>::ElementType> initList) {
   using ElementType = typename StorageTraits<T>::ElementType;
   size_t index = FindFreeSlot();
   size_t size = initList.size() * sizeof(ElementType);
-  uint8_t* ptr = allocator_.Allocate(size);
+  uint8_t* ptr = allocator_.AllocateNear(hint_offset, size, alignment);
   std::uninitialized_copy(initList.begin(), initList.end(),
                           reinterpret_cast<ElementType*>(ptr));
-  BlobMetadata& metadata = metadata_[index];
-  metadata.size = size;
-  metadata.offset = allocator_.ToIndex(ptr);
-  assert(metadata.offset != ShmAllocator::InvalidIndex);
-  metadata.lock_state = 0;
-  metadata.next_free_index = -1;
-  return BlobStoreObject<T>(this, index);
+  InitializeMetadata(index, size, alignment, ptr);
+  return BlobStoreObject<T, BasicBlobStore<Policy>>(this, index);
 }
 
+template <typename Policy>
 template <typename T>
-typename std::enable_if<is_unsized_array<T>::value, BlobStoreObject<T>>::type
-BlobStore::NewImpl(size_t size) {
+typename std::enable_if<is_unsized_array<T>::value,
+                        BlobStoreObject<T, BasicBlobStore<Policy>>>::type
+BasicBlobStore<Policy>::NewImpl(std::size_t alignment,
+                                std::size_t hint_offset,
+                                size_t size) {
   using ElementType = typename StorageTraits<T>::ElementType;
   using BaseType = typename std::remove_extent<ElementType>::type;
   size_t index = FindFreeSlot();
   size_t size_in_bytes = size * sizeof(BaseType);
-  uint8_t* ptr = allocator_.Allocate(size_in_bytes);
-  BlobMetadata& metadata = metadata_[index];
-  metadata.size = size_in_bytes;
-  metadata.offset = allocator_.ToIndex(ptr);
-  assert(metadata.offset != ShmAllocator::InvalidIndex);
-  metadata.lock_state = 0;
-  metadata.next_free_index = -1;
-  return BlobStoreObject<T>(this, index);
+  uint8_t* ptr = allocator_.AllocateNear(hint_offset, size_in_bytes, alignment);
+  InitializeMetadata(index, size_in_bytes, alignment, ptr);
+  return BlobStoreObject<T, BasicBlobStore<Policy>>(this, index);
 }
 
+template <typename Policy>
+uint8_t* BasicBlobStore<Policy>::GetRaw(size_t index, size_t* offset) {
+  if (index == InvalidIndex) {
+    return nullptr;
+  }
+  BlobMetadata* metadata = metadata_.at(index);
+  if (metadata == nullptr || metadata->is_deleted() || metadata->size == 0) {
+    return nullptr;
+  }
+
+  std::size_t offset_value = metadata->offset;
+  if (offset != nullptr) {
+    *offset = offset_value;
+  }
+  return allocator_.ToPtr<uint8_t>(offset_value);
+}
+
+template <typename Policy>
+bool BasicBlobStore<Policy>::AcquireReadLock(std::size_t index) {
+  if (index == InvalidIndex) {
+    return false;
+  }
+  BlobMetadata* metadata = metadata_.at(index);
+  if (metadata == nullptr || metadata->is_deleted()) {
+    return false;
+  }
+  int state = metadata->lock_state.load(std::memory_order_acquire);
+  if (state >= 0 && Policy::CompareExchange(metadata->lock_state, state,
+                                            state + 1,
+                                            std::memory_order_acquire)) {
+    return true;
+  }
+  return AcquireReadLockSlow(index);
+}
+
+template <typename Policy>
+bool BasicBlobStore<Policy>::AcquireWriteLock(std::size_t index) {
+  if (index == InvalidIndex) {
+    return false;
+  }
+  BlobMetadata* metadata = metadata_.at(index);
+  if (metadata == nullptr || metadata->is_deleted()) {
+    return false;
+  }
+  std::int32_t expected = 0;
+  if (Policy::CompareExchange(metadata->lock_state, expected, WRITE_LOCK_FLAG,
+                              std::memory_order_acquire)) {
+    return true;
+  }
+  return AcquireWriteLockSlow(index);
+}
+
+template <typename Policy>
+void BasicBlobStore<Policy>::Unlock(std::size_t index) {
+  if (index == InvalidIndex) {
+    return;
+  }
+  BlobMetadata* metadata = metadata_.at(index);
+  if (metadata == nullptr) {
+    return;
+  }
+  std::int32_t expected = metadata->lock_state.load();
+  std::int32_t new_state =
+      std::max<int32_t>((expected & ~WRITE_LOCK_FLAG) - 1, 0);
+  // Tombstoned blobs are dropped by the slow path once they're unlocked.
+  if (metadata->is_tombstone() ||
+      !Policy::CompareExchange(metadata->lock_state, expected, new_state)) {
+    UnlockSlow(index);
+  }
+}
+
+using SingleThreadedBlobStore = BasicBlobStore<SingleThreaded>;
+
 }  // namespace blob_store
 
 #endif  // BLOB_STORE_H_
\ No newline at end of file
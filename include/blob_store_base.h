@@ -24,6 +24,10 @@ class BlobStoreBase {
 
   virtual size_t GetSize(size_t index) = 0;
 
+  // Resizes the object at the specified index to new_size bytes. The caller
+  // must hold the write lock on the object.
+  virtual bool Resize(size_t index, size_t new_size) = 0;
+
   // Acquires a read lock for the object at the specified index.
   virtual bool AcquireReadLock(size_t index) = 0;
 
@@ -2,14 +2,91 @@
 #define BLOB_STORE_OBJECT_H_
 
 #include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
 #include <type_traits>
 
-#include "blob_store_base.h"
+#include "concurrency_policy.h"
 #include "serialize_traits.h"
 #include "storage_traits.h"
 
 namespace blob_store {
 
+template <typename Policy>
+class BasicBlobStore;
+using BlobStore = BasicBlobStore<MultiThreaded>;
+
+// ControlBlockPool recycles the memory of BlobStoreObject control blocks. A
+// lookup creates and destroys a handle for every node and key it visits, so
+// each thread keeps a bounded cache of freed control blocks rather than going
+// to the heap every time. Control blocks of every type fit in a block of
+// kBlockSize bytes. A block may be freed on a different thread than the one
+// that allocated it; it then joins the freeing thread's cache. Once a thread's
+// cache has been destroyed at thread exit, blocks that are still freed on that
+// thread, e.g. by other thread_local destructors, go straight to the heap.
+class ControlBlockPool {
+ public:
+  static constexpr std::size_t kBlockSize = 8 * sizeof(void*);
+
+  static void* Allocate() {
+    if (free_list_destroyed_ || GetFreeList().head == nullptr) {
+      return ::operator new(kBlockSize);
+    }
+    FreeList& free_list = GetFreeList();
+    FreeBlock* block = free_list.head;
+    free_list.head = block->next;
+    --free_list.size;
+    return block;
+  }
+
+  static void Free(void* ptr) {
+    if (free_list_destroyed_ || GetFreeList().size == kMaxFreeBlocks) {
+      ::operator delete(ptr);
+      return;
+    }
+    FreeList& free_list = GetFreeList();
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = free_list.head;
+    free_list.head = block;
+    ++free_list.size;
+  }
+
+ private:
+  // The maximum number of freed blocks each thread keeps.
+  static constexpr std::size_t kMaxFreeBlocks = 256;
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct FreeList {
+    ~FreeList() {
+      while (head != nullptr) {
+        FreeBlock* next = head->next;
+        ::operator delete(head);
+        head = next;
+      }
+      size = 0;
+      free_list_destroyed_ = true;
+    }
+
+    FreeBlock* head = nullptr;
+    std::size_t size = 0;
+  };
+
+  static FreeList& GetFreeList() {
+    thread_local FreeList free_list;
+    return free_list;
+  }
+
+  // Set when the calling thread's FreeList is destroyed. It has no destructor
+  // of its own, so it can still be read after that.
+  static thread_local bool free_list_destroyed_;
+};
+
+inline thread_local bool ControlBlockPool::free_list_destroyed_ = false;
+
 // The BlobStoreObject class provides a type-safe smart pointer for managing the
 // lifecycle and access of a Blob stored within a BlobStore. It uses RAII
 // (Resource Acquisition Is Initialization) principle to handle resource
@@ -20,12 +97,18 @@ namespace blob_store {
 // const) and downgrading (const to non-const) operations on the smart pointer,
 // while ensuring atomicity of operations.
 //
+// The BlobStoreObject is bound to the concrete type of its store, StoreType,
+// rather than to the BlobStoreBase interface. Locking and pointer translation
+// happen every time an object is constructed or destroyed, so calling them
+// directly lets the compiler inline them into hot loops such as B+ tree
+// searches.
+//
 // Usage Example:
 //   BlobStoreObject<MyClass> obj(&blobStore, index);
 //   obj->myMethod();
 //   MyClass& objRef = *obj;
 //
-template <typename T>
+template <typename T, typename StoreType = BlobStore>
 class BlobStoreObject {
  public:
   using non_const_T = typename std::remove_const<T>::type;
@@ -58,7 +141,7 @@ class BlobStoreObject {
   // Constructs a BlobStoreObject from a BlobStore and an index. The
   // BlobStoreObject will hold a pointer to the BlobStore and the index of the
   // Blob in the store. The created ControlBlock starts with a refcount of 1.
-  BlobStoreObject(BlobStoreBase* store, size_t index);
+  BlobStoreObject(StoreType* store, size_t index);
 
   // Destructor that decrements the refcount of the ControlBlock. If the
   // refcount reaches zero, it means there are no BlobStoreObjects pointing to
@@ -70,7 +153,7 @@ class BlobStoreObject {
   }
 
   // Accessor for the BlobStore associated with this object.
-  BlobStoreBase* GetBlobStore() const { return control_block_->store_; }
+  StoreType* GetBlobStore() const { return control_block_->store_; }
 
   // Arrow operators provide access to the methods of the actual object stored.
   // If control_block_ or the stored object pointer is null, it raises an
@@ -114,15 +197,17 @@ class BlobStoreObject {
 
   // Clone this BlobStoreObject, creating a new blob in the BlobStore
   // with the same content and returning a BlobStoreObject pointing to it.
-  BlobStoreObject<typename std::remove_const<T>::type> Clone() const {
+  BlobStoreObject<typename std::remove_const<T>::type, StoreType> Clone()
+      const {
     size_t clone_index = control_block_->store_->Clone(control_block_->index_);
-    return BlobStoreObject<typename std::remove_const<T>::type>(
+    return BlobStoreObject<typename std::remove_const<T>::type, StoreType>(
         control_block_->store_, clone_index);
   }
 
   // Deserializes the content of the blob into the provided object.
   template <typename U, typename V = T>
-  typename std::enable_if<!std::is_same<U, BlobStoreObject<V>>::value>::type
+  typename std::enable_if<
+      !std::is_same<U, BlobStoreObject<V, StoreType>>::value>::type
   Deserialize(U* obj) const {
     assert(control_block_ != nullptr);
     assert(control_block_->ptr_ != nullptr);
@@ -131,11 +216,11 @@ class BlobStoreObject {
   }
 
   template <typename U>
-  void Deserialize(BlobStoreObject<U>* obj) const {
+  void Deserialize(BlobStoreObject<U, StoreType>* obj) const {
     assert(control_block_ != nullptr);
     assert(control_block_->ptr_ != nullptr);
-    *obj = BlobStoreObject<U>(control_block_->store_, 0);
-    SerializeTraits<BlobStoreObject<U>>::Deserialize(
+    *obj = BlobStoreObject<U, StoreType>(control_block_->store_, 0);
+    SerializeTraits<BlobStoreObject<U, StoreType>>::Deserialize(
         &StorageTraits<T>::GetElement(control_block_->ptr_, 0), obj);
   }
 
@@ -146,7 +231,7 @@ class BlobStoreObject {
       std::is_same<typename std::remove_const<U>::type,
                    typename std::remove_const<T>::type>::value,
       bool>::type
-  CompareAndSwap(BlobStoreObject<U> other) {
+  CompareAndSwap(BlobStoreObject<U, StoreType> other) {
     if (*this == nullptr || other == nullptr) {
       return false;
     }
@@ -170,18 +255,36 @@ class BlobStoreObject {
     return control_block_->store_->GetSize(control_block_->index_);
   }
 
+  // Resizes the Blob to new_size bytes. The Blob may move, in which case this
+  // BlobStoreObject and its copies follow it. Pointers and references into the
+  // old Blob are invalidated. Only writers can resize a Blob.
+  template <typename V = T>
+  typename std::enable_if<!std::is_const<V>::value, bool>::type Resize(
+      size_t new_size) {
+    if (*this == nullptr ||
+        !control_block_->store_->Resize(control_block_->index_, new_size)) {
+      return false;
+    }
+    control_block_->ptr_ = reinterpret_cast<StorageType*>(
+        control_block_->store_->GetRaw(control_block_->index_,
+                                       &control_block_->offset_));
+    return true;
+  }
+
   // Casts BlobStoreObject<T> to a const-preserving BlobStoreObject<U>.
   // The casting mechanism ensures type safety.
   template <typename U>
   auto To() & -> typename std::conditional<
       std::is_const<T>::value,
-      BlobStoreObject<typename std::add_const<U>::type>,
-      BlobStoreObject<U>>::type {
+      BlobStoreObject<typename std::add_const<U>::type, StoreType>,
+      BlobStoreObject<U, StoreType>>::type {
     using const_preserving_U =
         typename std::conditional<std::is_const<T>::value,
                                   typename std::add_const<U>::type, U>::type;
-    return BlobStoreObject<const_preserving_U>(
-        reinterpret_cast<BlobStoreObject<const_preserving_U>::ControlBlock*>(
+    return BlobStoreObject<const_preserving_U, StoreType>(
+        reinterpret_cast<
+            typename BlobStoreObject<const_preserving_U,
+                                     StoreType>::ControlBlock*>(
             control_block_));
   }
 
@@ -189,15 +292,17 @@ class BlobStoreObject {
   template <typename U>
   auto To() && -> typename std::conditional<
       std::is_const<T>::value,
-      BlobStoreObject<typename std::add_const<U>::type>,
-      BlobStoreObject<U>>::type {
+      BlobStoreObject<typename std::add_const<U>::type, StoreType>,
+      BlobStoreObject<U, StoreType>>::type {
     using const_preserving_U =
         typename std::conditional<std::is_const<T>::value,
                                   typename std::add_const<U>::type, U>::type;
     ControlBlock* control_block = control_block_;
     control_block_ = nullptr;
-    BlobStoreObject<const_preserving_U> new_ptr(
-        reinterpret_cast<BlobStoreObject<const_preserving_U>::ControlBlock*>(
+    BlobStoreObject<const_preserving_U, StoreType> new_ptr(
+        reinterpret_cast<
+            typename BlobStoreObject<const_preserving_U,
+                                     StoreType>::ControlBlock*>(
             control_block));
     control_block->DecrementRefCount();
     return new_ptr;
@@ -205,18 +310,19 @@ class BlobStoreObject {
 
   // Downgrades the BlobStoreObject to const and removes the ownership,
   // if the refcount equals 1, otherwise returns an empty BlobStoreObject.
-  BlobStoreObject<const T> Downgrade() && {
+  BlobStoreObject<const T, StoreType> Downgrade() && {
     ControlBlock* control_block = control_block_;
     control_block_ = nullptr;
     // We should only return a BlobStoreObject<const T> cast of this
     // control_block if it has a refcount of 1. Otherwise, we should return a
     // nullptr BlobStoreObject<const T>.
     if (control_block == nullptr || control_block->ref_count_ != 1) {
-      return BlobStoreObject<const T>();
+      return BlobStoreObject<const T, StoreType>();
     }
     control_block->DowngradeLock();
-    BlobStoreObject<const T> downgraded_obj = BlobStoreObject<const T>(
-        reinterpret_cast<typename BlobStoreObject<const T>::ControlBlock*>(
+    BlobStoreObject<const T, StoreType> downgraded_obj(
+        reinterpret_cast<
+            typename BlobStoreObject<const T, StoreType>::ControlBlock*>(
             control_block));
     control_block->ref_count_.fetch_sub(1);
     return downgraded_obj;
@@ -225,18 +331,19 @@ class BlobStoreObject {
   // Upgrades a const T BlobStoreObject to a non-const T BlobStoreObject.
   // This operation is valid if the BlobStoreObject is the sole owner of the
   // Blob. Otherwise, it returns an empty BlobStoreObject.
-  BlobStoreObject<non_const_T> Upgrade() && {
+  BlobStoreObject<non_const_T, StoreType> Upgrade() && {
     ControlBlock* control_block = control_block_;
     control_block_ = nullptr;
     // We should only return a BlobStoreObject<non_const_T> cast of this
     // control_block if it has a refcount of 1. Otherwise, we should return a
     // nullptr BlobStoreObject<non_const_T>.
     if (control_block == nullptr || control_block->ref_count_ != 1) {
-      return BlobStoreObject<non_const_T>();
+      return BlobStoreObject<non_const_T, StoreType>();
     }
     control_block->UpgradeLock();
-    BlobStoreObject<non_const_T> upgraded_object = BlobStoreObject<non_const_T>(
-        reinterpret_cast<BlobStoreObject<non_const_T>::ControlBlock*>(
+    BlobStoreObject<non_const_T, StoreType> upgraded_object(
+        reinterpret_cast<
+            typename BlobStoreObject<non_const_T, StoreType>::ControlBlock*>(
             control_block));
     control_block->ref_count_.fetch_sub(1);
     return upgraded_object;
@@ -291,7 +398,7 @@ class BlobStoreObject {
   bool operator!() const  // Enables "if (!sp) ..."
   {
     return !control_block_ || control_block_->store_ == nullptr ||
-           control_block_->index_ == BlobStore::InvalidIndex ||
+           control_block_->index_ == StoreType::InvalidIndex ||
            control_block_->ptr_ == nullptr;
   }
 
@@ -346,10 +453,18 @@ class BlobStoreObject {
 
   struct ControlBlock {
    public:
-    ControlBlock(BlobStoreBase* store, size_t index);
+    ControlBlock(StoreType* store, size_t index);
 
     ~ControlBlock() {}
 
+    static void* operator new(std::size_t size) {
+      static_assert(sizeof(ControlBlock) <= ControlBlockPool::kBlockSize,
+                    "ControlBlock doesn't fit in a pool block");
+      return ControlBlockPool::Allocate();
+    }
+
+    static void operator delete(void* ptr) { ControlBlockPool::Free(ptr); }
+
     void IncrementRefCount() { ref_count_.fetch_add(1); }
 
     bool DecrementRefCount() {
@@ -366,7 +481,7 @@ class BlobStoreObject {
     void UpgradeLock() { store_->UpgradeReadLock(index_); }
 
     // Pointer to the BlobStore instance
-    BlobStoreBase* const store_;
+    StoreType* const store_;
     // Index of the object in the BlobStore
     size_t index_;
     // Offset of the object in the shared memory buffer.
@@ -379,19 +494,19 @@ class BlobStoreObject {
 
   ControlBlock* control_block_;
 
-  template <typename U>
+  template <typename U, typename OtherStoreType>
   friend class BlobStoreObject;
 };
 
-template <typename T>
-BlobStoreObject<T>::BlobStoreObject(BlobStoreBase* store, size_t index)
-    : control_block_(index == BlobStore::InvalidIndex
+template <typename T, typename StoreType>
+BlobStoreObject<T, StoreType>::BlobStoreObject(StoreType* store, size_t index)
+    : control_block_(index == StoreType::InvalidIndex
                          ? nullptr
                          : new ControlBlock(store, index)) {}
 
-template <typename T>
-BlobStoreObject<T>::BlobStoreObject::ControlBlock::ControlBlock(
-    BlobStoreBase* store,
+template <typename T, typename StoreType>
+BlobStoreObject<T, StoreType>::BlobStoreObject::ControlBlock::ControlBlock(
+    StoreType* store,
     size_t index)
     : store_(store), index_(index), ptr_(nullptr), ref_count_(1) {
   bool success = false;
@@ -403,7 +518,7 @@ BlobStoreObject<T>::BlobStoreObject::ControlBlock::ControlBlock(
   // If we failed to acquire the lock, then the blob was deleted while we were
   // constructing the object.
   if (!success) {
-    index_ = BlobStore::InvalidIndex;
+    index_ = StoreType::InvalidIndex;
     return;
   }
   ptr_ = reinterpret_cast<StorageType*>(store_->GetRaw(index_, &offset_));
@@ -413,22 +528,23 @@ BlobStoreObject<T>::BlobStoreObject::ControlBlock::ControlBlock(
 
 // SerializeTraits for BlobStoreObject<T>. This just stores the index of the
 // object in the BlobStore.
-template <typename T>
-struct SerializeTraits<blob_store::BlobStoreObject<T>> {
-  static size_t Size(const blob_store::BlobStoreObject<T>& s) {
+template <typename T, typename StoreType>
+struct SerializeTraits<blob_store::BlobStoreObject<T, StoreType>> {
+  static size_t Size(const blob_store::BlobStoreObject<T, StoreType>& s) {
     return sizeof(size_t);
   }
 
-  static void Serialize(char* buffer, const blob_store::BlobStoreObject<T>& s) {
+  static void Serialize(char* buffer,
+                        const blob_store::BlobStoreObject<T, StoreType>& s) {
     size_t index = s.Index();
     memcpy(buffer, &index, sizeof(size_t));
   }
 
   static void Deserialize(const char* buffer,
-                          blob_store::BlobStoreObject<T>* s) {
+                          blob_store::BlobStoreObject<T, StoreType>* s) {
     size_t index;
     memcpy(&index, buffer, sizeof(size_t));
-    *s = blob_store::BlobStoreObject<T>(s->GetBlobStore(), index);
+    *s = blob_store::BlobStoreObject<T, StoreType>(s->GetBlobStore(), index);
   }
 };
 
@@ -1,33 +1,74 @@
 #ifndef BLOB_STORE_TRANSACTION_H_
 #define BLOB_STORE_TRANSACTION_H_
 
+#include <array>
 #include <optional>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "blob_store.h"
+#include "change_feed.h"
+#include "hash.h"
 #include "serialize_traits.h"
 
 namespace blob_store {
 
 // Head points to the latest version of a BlobStore-indexed data structure.
 struct HeadNode {
+  // The maximum number of secondary roots a head can anchor.
+  static constexpr std::size_t kMaxSecondaryRoots = 4;
+
   // The version of the transaction.
   std::size_t version;
   // The index of the root node.
   std::size_t root_index;
   // The index of the previous head.
   std::size_t previous;
+  // The root of the HistoryNode tree that maps every older version to the
+  // index of its head.
+  std::size_t history;
+  // The index of the ChangeFeedRing commits are published to or InvalidIndex
+  // if the change feed is disabled.
+  std::size_t change_feed;
+  // The roots of secondary structures (e.g. secondary indexes) that are
+  // committed atomically with the root node.
+  std::array<std::size_t, kMaxSecondaryRoots> secondary_roots;
+  // The number of objects the commit of this version created, cloned and
+  // discarded. The change feed falls back to these if the commit's record
+  // isn't in the ring.
+  std::size_t new_objects;
+  std::size_t mutated_objects;
+  std::size_t discarded_objects;
+  // The hashing::kHashVersion the structure was created with. Keys such as
+  // FixedString persist their hashes, which only compare equal to hashes of
+  // the same version.
+  std::uint32_t hash_version;
 
   HeadNode(std::size_t version)
       : version(version),
         root_index(BlobStore::InvalidIndex),
-        previous(BlobStore::InvalidIndex) {}
+        previous(BlobStore::InvalidIndex),
+        history(BlobStore::InvalidIndex),
+        change_feed(BlobStore::InvalidIndex),
+        new_objects(0),
+        mutated_objects(0),
+        discarded_objects(0),
+        hash_version(hashing::kHashVersion) {
+    secondary_roots.fill(BlobStore::InvalidIndex);
+  }
 
   HeadNode()
       : version(0),
         root_index(BlobStore::InvalidIndex),
-        previous(BlobStore::InvalidIndex) {}
+        previous(BlobStore::InvalidIndex),
+        history(BlobStore::InvalidIndex),
+        change_feed(BlobStore::InvalidIndex),
+        new_objects(0),
+        mutated_objects(0),
+        discarded_objects(0),
+        hash_version(hashing::kHashVersion) {
+    secondary_roots.fill(BlobStore::InvalidIndex);
+  }
 };
 
 static_assert(std::is_trivially_copyable<HeadNode>::value,
@@ -37,6 +78,56 @@ static_assert(std::is_standard_layout<HeadNode>::value,
 
 void PrintNode(BlobStoreObject<const HeadNode> node);
 
+// HistoryNode is a node of the radix tree that maps each version of a
+// BlobStore-indexed data structure to the index of its head. Every head refers
+// to a tree holding all the versions before it. The tree is copy-on-write like
+// the data structures themselves, so a commit only clones the path to the slot
+// of the version it retires.
+//
+// History is never trimmed: every committed version stays readable for the
+// lifetime of the store. Each commit retains its old head and at most
+// GetHistoryDepth(version + 1) HistoryNodes, and aborted transactions retain
+// nothing. The nodes are shared between the history trees of later heads, so
+// trimming would need reference counts that the store doesn't keep.
+struct HistoryNode {
+  static constexpr std::size_t kFanoutBits = 5;
+  static constexpr std::size_t kFanout = 1 << kFanoutBits;
+
+  // Head indices in leaves, child HistoryNode indices in internal nodes.
+  std::array<std::size_t, kFanout> children;
+
+  HistoryNode() { children.fill(BlobStore::InvalidIndex); }
+};
+
+static_assert(std::is_trivially_copyable<HistoryNode>::value,
+              "HistoryNode is trivially copyable");
+static_assert(std::is_standard_layout<HistoryNode>::value,
+              "HistoryNode is standard layout");
+
+// Returns the number of HistoryNode levels needed to index num_versions
+// versions.
+std::size_t GetHistoryDepth(std::size_t num_versions);
+
+// Returns the head with the provided version from the history of the head at
+// head_index in O(log(n)). Returns the head at head_index itself if the version
+// is not older than it, and null if the version isn't part of its history.
+BlobStoreObject<const HeadNode> FindHead(BlobStore* blob_store,
+                                         std::size_t head_index,
+                                         std::size_t version);
+
+class Transaction;
+
+// TransactionObserver is notified of every transaction that commits
+// successfully.
+class TransactionObserver {
+ public:
+  virtual ~TransactionObserver() = default;
+
+  // Called after transaction's new head replaced the old head and before the
+  // transaction releases the new head.
+  virtual void OnCommit(const Transaction& transaction) = 0;
+};
+
 class Transaction {
  public:
   Transaction(BlobStore* blob_store, size_t head_index)
@@ -44,6 +135,8 @@ class Transaction {
     old_head_ = blob_store_->Get<HeadNode>(head_index);
     new_head_ = old_head_.Clone();
     ++new_head_->version;
+    // The clone and the old head swap places on commit, so the old head will
+    // be found at the clone's index.
     new_head_->previous = new_head_.Index();
     transaction_objects_.insert(new_head_.Index());
     mutated_objects_.emplace(old_head_.Index(), new_head_.Index());
@@ -59,21 +152,70 @@ class Transaction {
   // Commits the transaction. Returns true if the commit was successful, false
   // otherwise.
   bool Commit() && {
+    // Only transactions that try to commit pay for the history path.
+    AppendToHistory(old_head_->version, new_head_->previous);
+    new_head_->new_objects = new_objects_.size();
+    new_head_->mutated_objects = mutated_objects_.size();
+    new_head_->discarded_objects = discarded_objects_.size();
+    ChangeRecord record = {new_head_->version, new_head_->root_index,
+                           new_objects_.size(), mutated_objects_.size(),
+                           discarded_objects_.size()};
+    size_t change_feed = new_head_->change_feed;
     if (!old_head_.CompareAndSwap(new_head_)) {
       std::move(*this).Abort();
       return false;
     }
+    if (observer_ != nullptr) {
+      observer_->OnCommit(*this);
+    }
+    // The old head now lives at the new head's index as part of the history.
+    // Release our locks on it so readers walking the history don't block on a
+    // committed transaction that hasn't been destroyed yet.
+    new_head_ = BlobStoreObject<HeadNode>();
+    old_head_ = BlobStoreObject<const HeadNode>();
+    if (change_feed != BlobStore::InvalidIndex) {
+      ChangeFeed::Publish(blob_store_, change_feed, record);
+    }
     return true;
   }
 
+  // Returns the store this transaction updates.
+  BlobStore* blob_store() const { return blob_store_; }
+
   template <typename T>
   BlobStoreObject<const T> GetRootNode() const {
     return blob_store_->Get<T>(new_head_->root_index);
   }
 
+  // Sets the observer notified when this transaction commits. The observer is
+  // not owned by the transaction.
+  void set_observer(TransactionObserver* observer) { observer_ = observer; }
+
   // Sets the new_head's root to the provided index.
   void SetRootNode(size_t index) { new_head_->root_index = index; }
 
+  // Returns the secondary root stored in the provided slot of the new head or
+  // null if the slot is empty.
+  template <typename T>
+  BlobStoreObject<const T> GetSecondaryRootNode(size_t slot) const {
+    assert(slot < HeadNode::kMaxSecondaryRoots);
+    return blob_store_->Get<T>(new_head_->secondary_roots[slot]);
+  }
+
+  // Sets the new head's secondary root in the provided slot to index.
+  void SetSecondaryRootNode(size_t slot, size_t index) {
+    assert(slot < HeadNode::kMaxSecondaryRoots);
+    new_head_->secondary_roots[slot] = index;
+  }
+
+  // Creates a change feed for the head if it doesn't have one. Every commit
+  // from this one on is published to the feed. See ChangeFeed.
+  void EnableChangeFeed() {
+    if (new_head_->change_feed == BlobStore::InvalidIndex) {
+      new_head_->change_feed = New<ChangeFeedRing>().Index();
+    }
+  }
+
   // Returns a new object of type T. The object is initialized with the provided
   // arguments. The newly created object is tracked by the transaction and will
   // be deleted if the transaction is aborted.
@@ -86,6 +228,28 @@ class Transaction {
     return object;
   }
 
+  // Same as New, but asks the store to place the object next to the object at
+  // near_index, e.g. a split node next to its sibling.
+  template <typename T, typename... Args>
+  BlobStoreObject<T> NewNear(size_t near_index, Args&&... args) {
+    BlobStoreObject<T> object =
+        blob_store_->NewNear<T>(near_index, std::forward<Args>(args)...);
+    new_objects_.emplace(object.Index());
+    transaction_objects_.insert(object.Index());
+    return object;
+  }
+
+  // Returns a new object holding a copy of the provided object's blob. Like
+  // New, the copy is tracked by the transaction.
+  template <typename T>
+  BlobStoreObject<typename std::remove_const<T>::type> NewCopy(
+      const BlobStoreObject<T>& object) {
+    auto new_object = object.Clone();
+    new_objects_.emplace(new_object.Index());
+    transaction_objects_.insert(new_object.Index());
+    return new_object;
+  }
+
   // Returns a mutable version of the provided object. If the object is already
   // mutable, it is returned as-is. If the version of the node matches the
   // version of the transaction, then upgrade the pointer to a mutable version.
@@ -130,6 +294,10 @@ class Transaction {
   }
 
  private:
+  // Records head_index as the head of the provided version in the new head's
+  // history.
+  void AppendToHistory(size_t version, size_t head_index);
+
   BlobStore* blob_store_;
   // Holding onto the old head ensures we retain a snapshot of the tree.
   BlobStoreObject<const HeadNode> old_head_;
@@ -143,7 +311,9 @@ class Transaction {
   // This is a map from the old index to the new index.
   std::unordered_map<size_t, size_t> mutated_objects_;
   std::unordered_set<size_t> discarded_objects_;
+  TransactionObserver* observer_ = nullptr;
   friend struct SerializeTraits<Transaction>;
+  friend class ReplicationLeader;
 };
 
 }  // namespace blob_store
@@ -0,0 +1,454 @@
+#ifndef BLOB_VECTOR_H_
+#define BLOB_VECTOR_H_
+
+#include <cassert>
+#include <cstddef>
+
+#include "blob_store.h"
+#include "blob_store_object.h"
+#include "blob_store_transaction.h"
+#include "blob_vector_base.h"
+#include "blob_vector_nodes.h"
+#include "blob_vector_transaction.h"
+
+namespace blob_vector {
+
+using blob_store::BlobStore;
+using blob_store::BlobStoreObject;
+using blob_store::HeadNode;
+
+// A growable sequence of T stored in a blob store. The elements are kept in
+// leaves of a radix tree with kBranching slots per node, so random access is
+// O(log32(n)). The last leaf is kept out of the tree, which makes push_back
+// O(1) amortized: only one in kBranching pushes has to walk the tree.
+//
+// Nodes are copy-on-write through blob_store::Transaction, so every committed
+// version shares all unchanged nodes with its predecessor. Updating a single
+// element copies one path of the tree rather than the whole vector, and old
+// versions stay readable through snapshots.
+template <typename T>
+class BlobVector : public BlobVectorBase<T> {
+ public:
+  using Transaction = typename BlobVectorBase<T>::Transaction;
+
+  // Snapshot is a read-only view of a BlobVector at a committed version. It
+  // pins its version by holding a read lock on the version's root.
+  class Snapshot {
+   public:
+    // Returns the version this snapshot reads.
+    std::size_t version() const { return version_; }
+
+    // Returns whether the requested version exists.
+    bool is_valid() const { return root_ != nullptr; }
+
+    // Returns the number of elements as of this snapshot's version.
+    std::size_t GetSize() const { return root_ == nullptr ? 0 : root_->size; }
+
+    // Returns the element at the provided position as of this snapshot's
+    // version.
+    T Get(std::size_t index) const {
+      return BlobVector::GetElement(blob_store_, *root_, index);
+    }
+
+   private:
+    friend class BlobVector;
+
+    Snapshot(BlobStore* blob_store,
+             std::size_t version,
+             BlobStoreObject<const VectorRoot> root)
+        : blob_store_(blob_store), version_(version), root_(std::move(root)) {}
+
+    BlobStore* blob_store_;
+    std::size_t version_;
+    BlobStoreObject<const VectorRoot> root_;
+  };
+
+  // Create a new empty vector. Only the head and the root are allocated.
+  static BlobVector Create(BlobStore* blob_store);
+
+  // Open an existing vector with the given head_index.
+  static BlobVector Open(BlobStore* blob_store, std::size_t head_index);
+
+  Transaction CreateTransaction();
+
+  // Returns the index of the vector's head.
+  std::size_t head_index() const { return head_index_; }
+
+  // Returns the number of elements in the latest version.
+  std::size_t GetSize() const { return OpenSnapshot().GetSize(); }
+
+  // Returns the element at the provided position in the latest version.
+  T Get(std::size_t index) const { return OpenSnapshot().Get(index); }
+
+  // Each of these commits a transaction with a single operation, retrying
+  // until it succeeds. Batch operations in a Transaction to commit them
+  // together.
+  void Set(std::size_t index, const T& value);
+  void PushBack(const T& value);
+  void PopBack();
+
+  // Opens a snapshot of the latest version.
+  Snapshot OpenSnapshot() const;
+
+  // Opens a snapshot of the provided version. The snapshot is invalid if the
+  // version doesn't exist.
+  Snapshot OpenSnapshot(std::size_t version) const;
+
+ private:
+  using Leaf = VectorLeaf<T>;
+
+  BlobVector(BlobStore* blob_store, std::size_t head_index)
+      : blob_store_(blob_store), head_index_(head_index) {}
+
+  // BlobVectorBase implementation:
+  T Get(const Transaction& transaction, std::size_t index) const override;
+  void Set(Transaction* transaction,
+           std::size_t index,
+           const T& value) override;
+  void PushBack(Transaction* transaction, const T& value) override;
+  void PopBack(Transaction* transaction) override;
+
+  // Returns the element at the provided position of the vector rooted at
+  // root.
+  static T GetElement(BlobStore* blob_store,
+                      const VectorRoot& root,
+                      std::size_t index);
+
+  // Returns the leaf of the tree holding the element at the provided
+  // position.
+  static BlobStoreObject<const Leaf> FindLeaf(BlobStore* blob_store,
+                                              const VectorRoot& root,
+                                              std::size_t index);
+
+  // Returns the slot of the child of a node at the provided height that leads
+  // to the element at index. Leaves are at height 0.
+  static std::size_t GetSlot(std::size_t index, std::size_t height) {
+    return (index >> (kBranchingBits * height)) & kBranchingMask;
+  }
+
+  // Returns a chain of new internal nodes of the provided height that leads
+  // to leaf_index.
+  std::size_t NewPath(Transaction* transaction,
+                      std::size_t height,
+                      std::size_t leaf_index);
+
+  // Adds the leaf holding the elements starting at leaf_offset to the subtree
+  // of the provided height rooted at node_index. Returns the index of the
+  // subtree's mutable root.
+  std::size_t PushLeaf(Transaction* transaction,
+                       std::size_t height,
+                       std::size_t node_index,
+                       std::size_t leaf_offset,
+                       std::size_t leaf_index);
+
+  // Removes the last leaf, holding the elements starting at leaf_offset, from
+  // the subtree of the provided height rooted at node_index. Returns the index
+  // of the subtree's mutable root or InvalidIndex if the subtree is now empty.
+  std::size_t PopLeaf(Transaction* transaction,
+                      std::size_t height,
+                      std::size_t node_index,
+                      std::size_t leaf_offset);
+
+  // Sets the element at index in the subtree of the provided height rooted at
+  // node_index. Returns the index of the subtree's mutable root.
+  std::size_t SetInTree(Transaction* transaction,
+                        std::size_t height,
+                        std::size_t node_index,
+                        std::size_t index,
+                        const T& value);
+
+  // Returns a mutable copy of the transaction's root and makes it the new
+  // root.
+  BlobStoreObject<VectorRoot> GetMutableRoot(Transaction* transaction) {
+    BlobStoreObject<VectorRoot> root = transaction->template GetMutable<
+        VectorRoot>(transaction->template GetRootNode<VectorRoot>());
+    transaction->SetRootNode(root.Index());
+    return root;
+  }
+
+  BlobStore* blob_store_;
+  std::size_t head_index_;
+};
+
+template <typename T>
+BlobVector<T> BlobVector<T>::Create(BlobStore* blob_store) {
+  BlobStoreObject<HeadNode> head = blob_store->New<HeadNode>();
+  BlobStoreObject<VectorRoot> root = blob_store->New<VectorRoot>();
+  head->root_index = root.Index();
+  return BlobVector(blob_store, head.Index());
+}
+
+template <typename T>
+BlobVector<T> BlobVector<T>::Open(BlobStore* blob_store,
+                                  std::size_t head_index) {
+  return BlobVector(blob_store, head_index);
+}
+
+template <typename T>
+typename BlobVector<T>::Transaction BlobVector<T>::CreateTransaction() {
+  Transaction transaction(this, blob_store_, head_index_);
+  return transaction;
+}
+
+template <typename T>
+void BlobVector<T>::Set(std::size_t index, const T& value) {
+  while (true) {
+    Transaction transaction = CreateTransaction();
+    Set(&transaction, index, value);
+    if (std::move(transaction).Commit()) {
+      break;
+    }
+  }
+}
+
+template <typename T>
+void BlobVector<T>::PushBack(const T& value) {
+  while (true) {
+    Transaction transaction = CreateTransaction();
+    PushBack(&transaction, value);
+    if (std::move(transaction).Commit()) {
+      break;
+    }
+  }
+}
+
+template <typename T>
+void BlobVector<T>::PopBack() {
+  while (true) {
+    Transaction transaction = CreateTransaction();
+    PopBack(&transaction);
+    if (std::move(transaction).Commit()) {
+      break;
+    }
+  }
+}
+
+template <typename T>
+typename BlobVector<T>::Snapshot BlobVector<T>::OpenSnapshot() const {
+  BlobStoreObject<const HeadNode> head =
+      blob_store_->Get<HeadNode>(head_index_);
+  return Snapshot(blob_store_, head->version,
+                  blob_store_->Get<VectorRoot>(head->root_index));
+}
+
+template <typename T>
+typename BlobVector<T>::Snapshot BlobVector<T>::OpenSnapshot(
+    std::size_t version) const {
+  BlobStoreObject<const HeadNode> head =
+      blob_store::FindHead(blob_store_, head_index_, version);
+  if (head == nullptr || head->version != version) {
+    return Snapshot(blob_store_, version, BlobStoreObject<const VectorRoot>());
+  }
+  return Snapshot(blob_store_, version,
+                  blob_store_->Get<VectorRoot>(head->root_index));
+}
+
+template <typename T>
+T BlobVector<T>::Get(const Transaction& transaction, std::size_t index) const {
+  BlobStoreObject<const VectorRoot> root =
+      transaction.template GetRootNode<VectorRoot>();
+  return GetElement(blob_store_, *root, index);
+}
+
+template <typename T>
+void BlobVector<T>::Set(Transaction* transaction,
+                        std::size_t index,
+                        const T& value) {
+  BlobStoreObject<VectorRoot> root = GetMutableRoot(transaction);
+  assert(index < root->size);
+  if (index >= root->tail_offset()) {
+    BlobStoreObject<Leaf> tail = transaction->template GetMutable<Leaf>(
+        blob_store_->Get<Leaf>(root->tail));
+    tail->elements[index & kBranchingMask] = value;
+    root->tail = tail.Index();
+    return;
+  }
+  root->tree = SetInTree(transaction, root->levels, root->tree, index, value);
+}
+
+template <typename T>
+void BlobVector<T>::PushBack(Transaction* transaction, const T& value) {
+  BlobStoreObject<VectorRoot> root = GetMutableRoot(transaction);
+  std::size_t slot = root->size & kBranchingMask;
+  if (root->tail != BlobStore::InvalidIndex && slot != 0) {
+    // There's room in the tail.
+    BlobStoreObject<Leaf> tail = transaction->template GetMutable<Leaf>(
+        blob_store_->Get<Leaf>(root->tail));
+    tail->elements[slot] = value;
+    root->tail = tail.Index();
+    ++root->size;
+    return;
+  }
+
+  if (root->tail != BlobStore::InvalidIndex) {
+    // The tail is full. Move it into the tree.
+    std::size_t leaf_offset = root->size - kBranching;
+    if (root->tree == BlobStore::InvalidIndex) {
+      root->tree = root->tail;
+    } else if ((leaf_offset >> (kBranchingBits * (root->levels + 1))) != 0) {
+      // The tree is full. Grow it by a level.
+      BlobStoreObject<VectorInternalNode> new_tree =
+          transaction->template New<VectorInternalNode>();
+      new_tree->children[0] = root->tree;
+      new_tree->children[1] = NewPath(transaction, root->levels, root->tail);
+      root->tree = new_tree.Index();
+      ++root->levels;
+    } else {
+      root->tree = PushLeaf(transaction, root->levels, root->tree,
+                            leaf_offset, root->tail);
+    }
+  }
+
+  BlobStoreObject<Leaf> tail = transaction->template New<Leaf>();
+  tail->elements[0] = value;
+  root->tail = tail.Index();
+  ++root->size;
+}
+
+template <typename T>
+void BlobVector<T>::PopBack(Transaction* transaction) {
+  BlobStoreObject<VectorRoot> root = GetMutableRoot(transaction);
+  if (root->size == 0) {
+    return;
+  }
+  if ((root->size & kBranchingMask) != 1) {
+    // The tail keeps at least one element.
+    --root->size;
+    return;
+  }
+
+  transaction->Drop(blob_store_->Get<Leaf>(root->tail));
+  --root->size;
+  if (root->size == 0) {
+    root->tail = BlobStore::InvalidIndex;
+    return;
+  }
+
+  // The last leaf of the tree becomes the tail.
+  std::size_t leaf_offset = root->size - kBranching;
+  root->tail = FindLeaf(blob_store_, *root, leaf_offset).Index();
+  if (root->levels == 0) {
+    root->tree = BlobStore::InvalidIndex;
+    return;
+  }
+  root->tree = PopLeaf(transaction, root->levels, root->tree, leaf_offset);
+
+  // Drop the levels that are left with a single child.
+  while (root->levels > 0) {
+    BlobStoreObject<const VectorInternalNode> tree =
+        blob_store_->Get<VectorInternalNode>(root->tree);
+    if (tree->children[1] != BlobStore::InvalidIndex) {
+      break;
+    }
+    root->tree = tree->children[0];
+    --root->levels;
+    transaction->Drop(std::move(tree));
+  }
+}
+
+template <typename T>
+T BlobVector<T>::GetElement(BlobStore* blob_store,
+                            const VectorRoot& root,
+                            std::size_t index) {
+  assert(index < root.size);
+  if (index >= root.tail_offset()) {
+    return blob_store->Get<Leaf>(root.tail)->elements[index & kBranchingMask];
+  }
+  return FindLeaf(blob_store, root, index)->elements[index & kBranchingMask];
+}
+
+template <typename T>
+BlobStoreObject<const typename BlobVector<T>::Leaf> BlobVector<T>::FindLeaf(
+    BlobStore* blob_store,
+    const VectorRoot& root,
+    std::size_t index) {
+  std::size_t node_index = root.tree;
+  for (std::size_t height = root.levels; height > 0; --height) {
+    BlobStoreObject<const VectorInternalNode> node =
+        blob_store->Get<VectorInternalNode>(node_index);
+    node_index = node->children[GetSlot(index, height)];
+  }
+  return blob_store->Get<Leaf>(node_index);
+}
+
+template <typename T>
+std::size_t BlobVector<T>::NewPath(Transaction* transaction,
+                                   std::size_t height,
+                                   std::size_t leaf_index) {
+  if (height == 0) {
+    return leaf_index;
+  }
+  BlobStoreObject<VectorInternalNode> node =
+      transaction->template New<VectorInternalNode>();
+  node->children[0] = NewPath(transaction, height - 1, leaf_index);
+  return node.Index();
+}
+
+template <typename T>
+std::size_t BlobVector<T>::PushLeaf(Transaction* transaction,
+                                    std::size_t height,
+                                    std::size_t node_index,
+                                    std::size_t leaf_offset,
+                                    std::size_t leaf_index) {
+  BlobStoreObject<VectorInternalNode> node =
+      transaction->template GetMutable<VectorInternalNode>(
+          blob_store_->Get<VectorInternalNode>(node_index));
+  std::size_t slot = GetSlot(leaf_offset, height);
+  std::size_t child_index = node->children[slot];
+  if (height == 1) {
+    node->children[slot] = leaf_index;
+  } else if (child_index == BlobStore::InvalidIndex) {
+    node->children[slot] = NewPath(transaction, height - 1, leaf_index);
+  } else {
+    node->children[slot] = PushLeaf(transaction, height - 1, child_index,
+                                    leaf_offset, leaf_index);
+  }
+  return node.Index();
+}
+
+template <typename T>
+std::size_t BlobVector<T>::PopLeaf(Transaction* transaction,
+                                   std::size_t height,
+                                   std::size_t node_index,
+                                   std::size_t leaf_offset) {
+  BlobStoreObject<const VectorInternalNode> node =
+      blob_store_->Get<VectorInternalNode>(node_index);
+  std::size_t slot = GetSlot(leaf_offset, height);
+  std::size_t child_index =
+      height == 1 ? BlobStore::InvalidIndex
+                  : PopLeaf(transaction, height - 1, node->children[slot],
+                            leaf_offset);
+  if (child_index == BlobStore::InvalidIndex && slot == 0) {
+    transaction->Drop(std::move(node));
+    return BlobStore::InvalidIndex;
+  }
+  BlobStoreObject<VectorInternalNode> new_node =
+      transaction->template GetMutable<VectorInternalNode>(std::move(node));
+  new_node->children[slot] = child_index;
+  return new_node.Index();
+}
+
+template <typename T>
+std::size_t BlobVector<T>::SetInTree(Transaction* transaction,
+                                     std::size_t height,
+                                     std::size_t node_index,
+                                     std::size_t index,
+                                     const T& value) {
+  if (height == 0) {
+    BlobStoreObject<Leaf> leaf = transaction->template GetMutable<Leaf>(
+        blob_store_->Get<Leaf>(node_index));
+    leaf->elements[index & kBranchingMask] = value;
+    return leaf.Index();
+  }
+  BlobStoreObject<VectorInternalNode> node =
+      transaction->template GetMutable<VectorInternalNode>(
+          blob_store_->Get<VectorInternalNode>(node_index));
+  std::size_t slot = GetSlot(index, height);
+  node->children[slot] =
+      SetInTree(transaction, height - 1, node->children[slot], index, value);
+  return node.Index();
+}
+
+}  // namespace blob_vector
+
+#endif  // BLOB_VECTOR_H_
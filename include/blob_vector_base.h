@@ -0,0 +1,32 @@
+#ifndef BLOB_VECTOR_BASE_H_
+#define BLOB_VECTOR_BASE_H_
+
+#include <cstddef>
+
+namespace blob_vector {
+template <typename T>
+class Transaction;
+
+template <typename T>
+class BlobVectorBase {
+ public:
+  using Transaction = blob_vector::Transaction<T>;
+
+  // Returns the element at the provided position as of the transaction.
+  virtual T Get(const Transaction& transaction, std::size_t index) const = 0;
+
+  // Replaces the element at the provided position.
+  virtual void Set(Transaction* transaction,
+                   std::size_t index,
+                   const T& value) = 0;
+
+  // Appends an element to the end of the vector.
+  virtual void PushBack(Transaction* transaction, const T& value) = 0;
+
+  // Removes the last element of the vector if there is one.
+  virtual void PopBack(Transaction* transaction) = 0;
+};
+
+}  // namespace blob_vector
+
+#endif  // BLOB_VECTOR_BASE_H_
@@ -0,0 +1,70 @@
+#ifndef BLOB_VECTOR_NODES_H_
+#define BLOB_VECTOR_NODES_H_
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+#include "blob_store.h"
+
+namespace blob_vector {
+
+using blob_store::BlobStore;
+
+// Every node of a BlobVector has kBranching slots.
+constexpr std::size_t kBranchingBits = 5;
+constexpr std::size_t kBranching = 1 << kBranchingBits;
+constexpr std::size_t kBranchingMask = kBranching - 1;
+
+// VectorRoot is the root node of a BlobVector. The elements are stored in
+// leaves of kBranching elements. Every full leaf hangs off a radix tree while
+// the last leaf, the tail, is kept out of the tree so that a push_back usually
+// touches the tail alone.
+struct VectorRoot {
+  // The number of elements.
+  std::size_t size;
+  // The number of internal levels of the tree. A tree that is a single leaf
+  // has none.
+  std::size_t levels;
+  // The root of the tree or InvalidIndex if every element is in the tail.
+  std::size_t tree;
+  // The tail leaf or InvalidIndex if the vector is empty.
+  std::size_t tail;
+
+  VectorRoot()
+      : size(0),
+        levels(0),
+        tree(BlobStore::InvalidIndex),
+        tail(BlobStore::InvalidIndex) {}
+
+  // Returns the position of the first element in the tail.
+  std::size_t tail_offset() const {
+    return size == 0 ? 0 : (size - 1) & ~kBranchingMask;
+  }
+};
+
+// An internal node of the tree. Its children are either internal nodes or
+// leaves depending on its height.
+struct VectorInternalNode {
+  std::array<std::size_t, kBranching> children;
+
+  VectorInternalNode() { children.fill(BlobStore::InvalidIndex); }
+};
+
+template <typename T>
+struct VectorLeaf {
+  std::array<T, kBranching> elements;
+};
+
+static_assert(std::is_trivially_copyable<VectorRoot>::value,
+              "VectorRoot is trivially copyable");
+static_assert(std::is_standard_layout<VectorRoot>::value,
+              "VectorRoot is standard layout");
+static_assert(std::is_trivially_copyable<VectorInternalNode>::value,
+              "VectorInternalNode is trivially copyable");
+static_assert(std::is_standard_layout<VectorInternalNode>::value,
+              "VectorInternalNode is standard layout");
+
+}  // namespace blob_vector
+
+#endif  // BLOB_VECTOR_NODES_H_
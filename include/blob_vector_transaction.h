@@ -0,0 +1,60 @@
+#ifndef BLOB_VECTOR_TRANSACTION_H_
+#define BLOB_VECTOR_TRANSACTION_H_
+
+#include "blob_store_object.h"
+#include "blob_store_transaction.h"
+#include "blob_vector_base.h"
+#include "blob_vector_nodes.h"
+
+namespace blob_vector {
+using blob_store::BlobStore;
+using blob_store::BlobStoreObject;
+
+template <typename T>
+class Transaction : public blob_store::Transaction {
+ public:
+  using BlobVectorBase = blob_vector::BlobVectorBase<T>;
+
+  Transaction(BlobVectorBase* vector, BlobStore* store, size_t head_index)
+      : blob_store::Transaction(store, head_index), vector_(vector) {}
+
+  T Get(std::size_t index) const { return vector_->Get(*this, index); }
+
+  void Set(std::size_t index, const T& value) {
+    vector_->Set(this, index, value);
+  }
+
+  void PushBack(const T& value) { vector_->PushBack(this, value); }
+
+  void PopBack() { vector_->PopBack(this); }
+
+  // Return the number of elements in the vector.
+  std::size_t GetSize() const {
+    BlobStoreObject<const VectorRoot> root = GetRootNode<VectorRoot>();
+    return root->size;
+  }
+
+ private:
+  BlobVectorBase* vector_;
+};
+
+}  // namespace blob_vector
+
+template <typename T>
+struct SerializeTraits<blob_vector::Transaction<T>> {
+  static size_t Size(const blob_vector::Transaction<T>& transaction) {
+    return SerializeTraits<blob_store::Transaction>::Size(transaction);
+  }
+
+  static void Serialize(char* buffer,
+                        const blob_vector::Transaction<T>& transaction) {
+    SerializeTraits<blob_store::Transaction>::Serialize(buffer, transaction);
+  }
+
+  static void Deserialize(const char* buffer,
+                          blob_vector::Transaction<T>* transaction) {
+    SerializeTraits<blob_store::Transaction>::Deserialize(buffer, transaction);
+  }
+};
+
+#endif  // BLOB_VECTOR_TRANSACTION_H_
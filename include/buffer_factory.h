@@ -11,6 +11,11 @@ class BufferFactory {
  public:
   virtual std::unique_ptr<Buffer> CreateBuffer(const std::string& name,
                                                std::size_t size) = 0;
+
+  // Removes the storage of the buffer with the provided name. Buffers that are
+  // still open keep their data until they are destroyed. In-memory buffers
+  // have no storage beyond their own, so the default does nothing.
+  virtual void RemoveBuffer(const std::string& name) {}
 };
 
 #endif
\ No newline at end of file
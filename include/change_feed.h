@@ -0,0 +1,121 @@
+#ifndef CHANGE_FEED_H_
+#define CHANGE_FEED_H_
+
+#include <atomic>
+#include <cstddef>
+
+#include "blob_store.h"
+
+namespace blob_store {
+
+// ChangeRecord summarizes a single committed transaction.
+struct ChangeRecord {
+  // The version the transaction committed.
+  std::size_t version;
+  // The index of the root node as of that version. Committed nodes are
+  // immutable so the root can be compared with another version's root to
+  // recover key-level changes.
+  std::size_t root_index;
+  // The number of objects the transaction created, cloned and discarded.
+  std::size_t new_objects;
+  std::size_t mutated_objects;
+  std::size_t discarded_objects;
+};
+
+// ChangeFeedRing is a fixed-size ring of ChangeRecords that lives in the
+// BlobStore, so it's shared by every process that maps the store. The record of
+// version v is published to slot v % kCapacity. Each slot is a seqlock: its
+// sequence is 0 while the record is being written and the record's version once
+// it's readable. Versions are unique and published once, so writers never
+// contend on a slot unless they are kCapacity versions apart.
+//
+// A record is published after its commit becomes visible, so a committer that
+// stalls or dies in between leaves its slot pending. The same record is kept
+// in the version's head, and readers take it from there once the head is
+// visible.
+//
+// Every field is atomic so that the ring can be written and read concurrently
+// while all processes hold a shared read lock on its blob.
+struct ChangeFeedRing {
+  static constexpr std::size_t kCapacity = 256;
+
+  struct Slot {
+    mutable std::atomic<std::size_t> sequence;
+    mutable std::atomic<std::size_t> root_index;
+    mutable std::atomic<std::size_t> new_objects;
+    mutable std::atomic<std::size_t> mutated_objects;
+    mutable std::atomic<std::size_t> discarded_objects;
+  };
+
+  Slot slots[kCapacity];
+
+  ChangeFeedRing() {
+    for (Slot& slot : slots) {
+      slot.sequence = 0;
+      slot.root_index = BlobStore::InvalidIndex;
+      slot.new_objects = 0;
+      slot.mutated_objects = 0;
+      slot.discarded_objects = 0;
+    }
+  }
+};
+
+static_assert(std::is_trivially_copyable<ChangeFeedRing>::value,
+              "ChangeFeedRing is trivially copyable");
+static_assert(std::is_standard_layout<ChangeFeedRing>::value,
+              "ChangeFeedRing is standard layout");
+
+// ChangeFeed tails the committed versions of a BlobStore-indexed data
+// structure whose head has a change feed enabled (see
+// Transaction::EnableChangeFeed). Each ChangeFeed keeps its own cursor, so any
+// number of consumers in any number of processes can follow the same feed.
+class ChangeFeed {
+ public:
+  enum class Status {
+    // A record was read and the cursor advanced.
+    kOk,
+    // The next version hasn't been committed yet.
+    kPending,
+    // The next version was overwritten before it was read. The consumer must
+    // resynchronize, e.g. by comparing snapshots, and Seek past the gap.
+    kOverrun,
+  };
+
+  // Opens the change feed of the head at head_index. The cursor starts after
+  // the head's current version. The feed is invalid if the head has no change
+  // feed.
+  ChangeFeed(BlobStore* blob_store, std::size_t head_index);
+
+  // Returns whether the head has a change feed.
+  bool is_valid() const { return ring_ != nullptr; }
+
+  // Returns the next version this feed will read.
+  std::size_t cursor() const { return cursor_; }
+
+  // Moves the cursor to the provided version.
+  void Seek(std::size_t version) { cursor_ = version; }
+
+  // Reads the record at the cursor into record and advances the cursor. If
+  // the version is committed but its slot is still pending, the record is read
+  // from the version's head instead.
+  Status Next(ChangeRecord* record);
+
+  // Publishes record to the ring at ring_index. Called by Transaction::Commit.
+  static void Publish(BlobStore* blob_store,
+                      std::size_t ring_index,
+                      const ChangeRecord& record);
+
+ private:
+  // Reads the record at the cursor from the history of the head. Returns
+  // kPending if the version isn't committed yet.
+  Status NextFromHistory(ChangeRecord* record);
+
+  BlobStore* blob_store_;
+  std::size_t head_index_;
+  BlobStoreObject<const ChangeFeedRing> ring_;
+  std::size_t cursor_;
+};
+
+}  // namespace blob_store
+
+#endif  // CHANGE_FEED_H_
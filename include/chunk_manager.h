@@ -54,6 +54,12 @@ class ChunkManager {
   const uint8_t* at(std::size_t chunk_index, std::size_t offset_in_chunk) const;
   uint8_t* at(std::size_t chunk_index, std::size_t offset_in_chunk);
 
+  // Returns whether ptr points into one of the chunks mapped by this
+  // ChunkManager. If it does, its encoded index is stored in index. The
+  // chunks are searched from the largest one down, which holds most of the
+  // data, without taking a lock.
+  bool index_of(const uint8_t* ptr, std::uint64_t* index) const;
+
   // Returns the capacity of the ChunkManager.
   std::size_t capacity() const;
 
@@ -74,7 +80,27 @@ class ChunkManager {
     return chunk_size_ * (1ull << chunk_index);
   }
 
+  // Returns the factory that creates the chunks' buffers.
+  BufferFactory* buffer_factory() const { return buffer_factory_; }
+
+  // Returns the prefix of the chunks' buffer names.
+  const std::string& name_prefix() const { return name_prefix_; }
+
  private:
+  // Encoded indices have 7 bits for the chunk index.
+  static constexpr std::size_t kMaxChunks = 128;
+
+  // The address and size of a mapped chunk, excluding the chunk count at the
+  // start of the first chunk.
+  struct MappedChunk {
+    std::atomic<uint8_t*> data{nullptr};
+    std::atomic<std::size_t> size{0};
+  };
+
+  // Publishes the chunks in chunks_ to chunk_table_. Called with
+  // chunks_rw_mutex_ held exclusively whenever chunks_ changes.
+  void update_chunk_table();
+
   // Loads the number of chunks from the first chunk and adds any necessary
   // chunks. Returns the number of chunks that were added.
   std::size_t load_chunks_if_necessary();
@@ -119,6 +145,11 @@ class ChunkManager {
   // is modified when a new chunk is added or removed.
   mutable std::shared_mutex chunks_rw_mutex_;
 
+  // A copy of the chunks' addresses that at() and index_of() read without
+  // taking chunks_rw_mutex_. Entries below num_mapped_chunks_ are valid.
+  MappedChunk chunk_table_[kMaxChunks];
+  std::atomic<std::size_t> num_mapped_chunks_{0};
+
   // BufferFactory creates either private or shared memory buffers.
   BufferFactory* buffer_factory_;
 };
@@ -0,0 +1,84 @@
+#ifndef CONCURRENCY_POLICY_H_
+#define CONCURRENCY_POLICY_H_
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+// Concurrency policies select, at compile time, how a store updates the
+// fields it shares between threads and processes. Both policies operate on the
+// same std::atomic fields, so the layout of the data they manage is identical
+// and a store built with one policy can be opened with the other.
+
+// MultiThreaded is safe for any number of threads and processes sharing the
+// data. Updates are atomic read-modify-write operations.
+struct MultiThreaded {
+  // Stores desired in value if value holds expected. Otherwise, loads the
+  // current value into expected and returns false.
+  template <typename T>
+  static bool CompareExchange(
+      std::atomic<T>& value,
+      T& expected,
+      typename std::atomic<T>::value_type desired,
+      std::memory_order order = std::memory_order_seq_cst) {
+    return value.compare_exchange_strong(expected, desired, order);
+  }
+
+  template <typename T>
+  static void Store(std::atomic<T>& value,
+                    typename std::atomic<T>::value_type desired) {
+    value.store(desired);
+  }
+
+  // Called between attempts to take a lock that's held by someone else.
+  static void SpinWait() {
+#if defined(_WIN32)
+    Sleep(0);
+#else
+    std::this_thread::yield();
+#endif
+  }
+};
+
+// SingleThreaded is for tools such as bulk loaders that own the data and
+// access it from a single thread. Updates are plain loads and stores, which
+// compile to ordinary moves instead of locked instructions.
+struct SingleThreaded {
+  template <typename T>
+  static bool CompareExchange(
+      std::atomic<T>& value,
+      T& expected,
+      typename std::atomic<T>::value_type desired,
+      std::memory_order order = std::memory_order_seq_cst) {
+    T current = value.load(std::memory_order_relaxed);
+    if (current != expected) {
+      expected = current;
+      return false;
+    }
+    value.store(desired, std::memory_order_relaxed);
+    return true;
+  }
+
+  template <typename T>
+  static void Store(std::atomic<T>& value,
+                    typename std::atomic<T>::value_type desired) {
+    value.store(desired, std::memory_order_relaxed);
+  }
+
+  // Nobody else can release a lock, so waiting for one would never end.
+  static void SpinWait() {
+    std::fputs("SingleThreaded: waiting for a lock held by this thread\n",
+               stderr);
+    std::abort();
+  }
+};
+
+#endif  // CONCURRENCY_POLICY_H_
@@ -5,6 +5,7 @@
 #include <cstring>
 #include <functional>
 #include <string>
+#include "hash.h"
 #include "storage_traits.h"
 #include "string_slice.h"
 
@@ -15,7 +16,8 @@ class FixedString {
  public:
   // The size of the data is stored at the start of the memory block
   std::size_t size;
-  // Hash of the string data
+  // Hash of the string data, computed with hashing::HashBytes. The hash is
+  // persisted with the string, so it must not depend on the platform.
   std::size_t hash;
   // Flexible array member for the string data.
   char data[1];
@@ -23,21 +25,21 @@ class FixedString {
   // Regular constructor from std::string
   // This isn't safe unless memory was preallocated for the FixedString.
   explicit FixedString(const std::string& str)
-      : size(str.size()), hash(std::hash<std::string>{}(str)) {
+      : size(str.size()), hash(Hash(str.data(), str.size())) {
     std::memcpy(data, str.data(), size);
   }
 
   // Regular constructor from StringSlice.
   // This isn't safe unless memory was preallocated for the FixedString.
   explicit FixedString(const StringSlice& slice)
-      : size(slice.size()), hash(std::hash<StringSlice>{}(slice)) {
+      : size(slice.size()), hash(Hash(slice.data(), slice.size())) {
     std::memcpy(data, slice.data(), size);
   }
 
   // Constructor from a C string
   // This isn't safe unless memory was preallocated for the FixedString.
   explicit FixedString(const char* str)
-      : size(std::strlen(str)), hash(std::hash<std::string>{}(str)) {
+      : size(std::strlen(str)), hash(Hash(str, size)) {
     std::memcpy(data, str, size);
   }
 
@@ -71,10 +73,10 @@ class FixedString {
   }
 
   bool operator!=(const FixedString& other) const { return !(*this == other); }
-  // Equality comparison with std::string
+  // Equality comparison with std::string. Hashing str would cost as much as
+  // comparing it, so only the sizes and contents are compared.
   bool operator==(const std::string& str) const {
-    return size == str.size() && hash == std::hash<std::string>{}(str) &&
-           std::memcmp(data, str.data(), size) == 0;
+    return size == str.size() && std::memcmp(data, str.data(), size) == 0;
   }
 
   // Inequality comparison with std::string
@@ -82,8 +84,7 @@ class FixedString {
 
   // Equality comparison with StringSlice
   bool operator==(const StringSlice& slice) const {
-    return size == slice.size() && hash == std::hash<StringSlice>{}(slice) &&
-           std::memcmp(data, slice.data(), size) == 0;
+    return size == slice.size() && std::memcmp(data, slice.data(), size) == 0;
   }
 
   // Inequality comparison with StringSlice
@@ -165,6 +166,11 @@ class FixedString {
 
   // Stream insertion operator to print the FixedString to an output stream.
   friend std::ostream& operator<<(std::ostream& os, const FixedString& str);
+
+  // Returns the hash a FixedString holding the size bytes at data stores.
+  static std::size_t Hash(const char* data, std::size_t size) {
+    return static_cast<std::size_t>(hashing::HashBytes(data, size));
+  }
 }
 #if defined(__GNUC__) || defined(__clang__)
 __attribute__((packed))
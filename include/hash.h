@@ -0,0 +1,29 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hashing {
+
+// The version of the output of HashBytes. Hashes are persisted alongside the
+// data they describe, e.g. in FixedString, so HashBytes must produce the same
+// value for the same bytes on every platform, compiler and standard library.
+// Any change to its output must bump kHashVersion. Every HeadNode records the
+// version it was created with, and BPlusTree refuses to open a store built
+// with another one.
+constexpr std::uint32_t kHashVersion = 1;
+
+// Returns a 64-bit hash of size bytes starting at data. The hash is wyhash
+// (final version 4) with its default secret: inputs are consumed 16 bytes at
+// a time and mixed with a 64x64->128-bit multiply. Inputs longer than 48
+// bytes are split over three independent lanes so that the multiplies of
+// neighbouring blocks execute in parallel, which is what dominates the cost
+// of hashing long keys such as URLs.
+std::uint64_t HashBytes(const void* data,
+                        std::size_t size,
+                        std::uint64_t seed = 0);
+
+}  // namespace hashing
+
+#endif  // HASH_H_
@@ -0,0 +1,90 @@
+#ifndef INLINE_VECTOR_H_
+#define INLINE_VECTOR_H_
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+// InlineVector is a vector with a fixed capacity of N elements that are stored
+// inline, so it never allocates memory on the heap. It's meant for small,
+// bounded sequences such as the path from a leaf to the root of a tree.
+// Pushing more than N elements is a bug.
+template <typename T, std::size_t N>
+class InlineVector {
+ public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "InlineVector only holds trivially copyable types");
+
+  InlineVector() : size_(0) {}
+
+  InlineVector(const InlineVector& other) : size_(other.size_) {
+    for (std::size_t i = 0; i < size_; ++i) {
+      data_[i] = other.data_[i];
+    }
+  }
+
+  InlineVector& operator=(const InlineVector& other) {
+    size_ = other.size_;
+    for (std::size_t i = 0; i < size_; ++i) {
+      data_[i] = other.data_[i];
+    }
+    return *this;
+  }
+
+  // Returns the number of elements in the InlineVector.
+  std::size_t size() const { return size_; }
+
+  // Returns true if the InlineVector is empty, false otherwise.
+  bool empty() const { return size_ == 0; }
+
+  // Returns the maximum number of elements the InlineVector can hold.
+  static constexpr std::size_t capacity() { return N; }
+
+  // Adds an element to the end of the InlineVector.
+  void push_back(const T& value) {
+    assert(size_ < N);
+    data_[size_++] = value;
+  }
+
+  // Removes the last element of the InlineVector.
+  void pop_back() {
+    assert(size_ > 0);
+    --size_;
+  }
+
+  // Removes all elements from the InlineVector.
+  void clear() { size_ = 0; }
+
+  T& back() {
+    assert(size_ > 0);
+    return data_[size_ - 1];
+  }
+
+  const T& back() const {
+    assert(size_ > 0);
+    return data_[size_ - 1];
+  }
+
+  T& operator[](std::size_t index) {
+    assert(index < size_);
+    return data_[index];
+  }
+
+  const T& operator[](std::size_t index) const {
+    assert(index < size_);
+    return data_[index];
+  }
+
+  T* begin() { return data_; }
+  T* end() { return data_ + size_; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+
+ private:
+  // Only the first size_ elements are copied, so a short path stays cheap to
+  // copy even though the capacity is fixed.
+  std::size_t size_;
+  T data_[N];
+};
+
+#endif  // INLINE_VECTOR_H_
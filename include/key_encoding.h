@@ -0,0 +1,189 @@
+#ifndef KEY_ENCODING_H_
+#define KEY_ENCODING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "fixed_string.h"
+#include "storage_traits.h"
+#include "string_slice.h"
+
+namespace key_encoding {
+
+// OrderedKey is a composite key of integers, floating point numbers and
+// strings, encoded so that comparing two encodings byte by byte, i.e. with
+// memcmp, orders the keys field by field. A tree keyed on OrderedKey stores
+// each key as a FixedString, so comparing keys is a single memcmp rather than
+// a call to a hand-written operator< on a custom struct.
+//
+// Fields are encoded as follows:
+// - Integers are stored big-endian in their own width, with the sign bit
+//   flipped if they're signed so that negative numbers order first.
+// - Floating point numbers are stored big-endian with the sign bit flipped if
+//   they're positive and every bit flipped if they're negative. -0.0 orders
+//   before 0.0 and NaNs order before or after every number, by their sign.
+// - Strings are stored with every 0x00 byte escaped as 0x00 0xFF and are
+//   terminated by 0x00 0x01, so a string orders before any string it is a
+//   prefix of.
+//
+// The encoding doesn't record the type of the fields, so only keys with the
+// same field types in the same order are comparable.
+class OrderedKey {
+ public:
+  OrderedKey() = default;
+
+  // Returns a key made of the provided fields, in order.
+  template <typename... Fields>
+  static OrderedKey Of(const Fields&... fields) {
+    OrderedKey key;
+    // Expands to a call to Append per field, from left to right.
+    int expand[] = {0, (key.Append(fields), 0)...};
+    (void)expand;
+    return key;
+  }
+
+  // Appends an integer field.
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value &&
+                              !std::is_same<T, bool>::value,
+                          OrderedKey&>::type
+  Append(T value) {
+    using Unsigned = typename std::make_unsigned<T>::type;
+    Unsigned bits = static_cast<Unsigned>(value);
+    if (std::is_signed<T>::value) {
+      bits ^= static_cast<Unsigned>(Unsigned(1) << (sizeof(T) * 8 - 1));
+    }
+    AppendBigEndian(bits, sizeof(T));
+    return *this;
+  }
+
+  // Appends a floating point field.
+  OrderedKey& Append(float value);
+  OrderedKey& Append(double value);
+
+  // Appends a string field.
+  OrderedKey& Append(const StringSlice& value);
+  OrderedKey& Append(const std::string& value) {
+    return Append(StringSlice(value.data(), 0, value.size()));
+  }
+  OrderedKey& Append(const char* value) {
+    return Append(StringSlice(value, 0, std::strlen(value)));
+  }
+
+  // Returns the encoded bytes.
+  const std::string& bytes() const { return bytes_; }
+  const char* data() const { return bytes_.data(); }
+  std::size_t size() const { return bytes_.size(); }
+
+  // Keys are stored as FixedStrings through this conversion.
+  operator StringSlice() const {
+    return StringSlice(bytes_.data(), 0, bytes_.size());
+  }
+
+  // Comparisons. std::string compares its characters as unsigned, like
+  // memcmp.
+  bool operator==(const OrderedKey& other) const {
+    return bytes_ == other.bytes_;
+  }
+  bool operator!=(const OrderedKey& other) const {
+    return bytes_ != other.bytes_;
+  }
+  bool operator<(const OrderedKey& other) const {
+    return bytes_ < other.bytes_;
+  }
+  bool operator>(const OrderedKey& other) const {
+    return bytes_ > other.bytes_;
+  }
+  bool operator<=(const OrderedKey& other) const {
+    return bytes_ <= other.bytes_;
+  }
+  bool operator>=(const OrderedKey& other) const {
+    return bytes_ >= other.bytes_;
+  }
+
+ private:
+  void AppendBigEndian(std::uint64_t bits, std::size_t size) {
+    for (std::size_t i = size; i > 0; --i) {
+      bytes_.push_back(static_cast<char>(bits >> ((i - 1) * 8)));
+    }
+  }
+
+  std::string bytes_;
+};
+
+// KeyReader decodes the fields of an encoded OrderedKey in the order they were
+// appended. Every Read returns false, leaving value untouched, if the
+// remaining bytes don't hold a field of the requested type.
+class KeyReader {
+ public:
+  explicit KeyReader(const StringSlice& encoded)
+      : data_(reinterpret_cast<const std::uint8_t*>(encoded.data())),
+        size_(encoded.size()),
+        position_(0) {}
+
+  // Reads an integer field.
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value &&
+                              !std::is_same<T, bool>::value,
+                          bool>::type
+  Read(T* value) {
+    using Unsigned = typename std::make_unsigned<T>::type;
+    std::uint64_t bits;
+    if (!ReadBigEndian(sizeof(T), &bits)) {
+      return false;
+    }
+    Unsigned field = static_cast<Unsigned>(bits);
+    if (std::is_signed<T>::value) {
+      field ^= static_cast<Unsigned>(Unsigned(1) << (sizeof(T) * 8 - 1));
+    }
+    *value = static_cast<T>(field);
+    return true;
+  }
+
+  // Reads a floating point field.
+  bool Read(float* value);
+  bool Read(double* value);
+
+  // Reads a string field.
+  bool Read(std::string* value);
+
+  // Returns whether every field has been read.
+  bool done() const { return position_ == size_; }
+
+ private:
+  bool ReadBigEndian(std::size_t size, std::uint64_t* bits);
+
+  const std::uint8_t* data_;
+  std::size_t size_;
+  std::size_t position_;
+};
+
+}  // namespace key_encoding
+
+// OrderedKeys are stored as FixedStrings holding their encoding.
+template <>
+struct StorageTraits<key_encoding::OrderedKey> {
+  using StorageType = FixedString;
+  using SearchType = key_encoding::OrderedKey;
+  using ElementType = char;
+
+  static size_t size(const key_encoding::OrderedKey& key) {
+    return sizeof(FixedString) + key.size() - 1;
+  }
+};
+
+template <>
+struct StorageTraits<const key_encoding::OrderedKey> {
+  using StorageType = const FixedString;
+  using SearchType = key_encoding::OrderedKey;
+  using ElementType = char;
+
+  static size_t size(const key_encoding::OrderedKey& key) {
+    return sizeof(FixedString) + key.size() - 1;
+  }
+};
+
+#endif  // KEY_ENCODING_H_
@@ -0,0 +1,106 @@
+#ifndef LARGE_OBJECT_SPACE_H_
+#define LARGE_OBJECT_SPACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "buffer_factory.h"
+
+// LargeObjectSpace hands out allocations that are too large for the chunked
+// heap. Each allocation gets a dedicated page-aligned buffer, so a few giant
+// objects neither double the size of the next chunk nor fragment the free list,
+// and their memory is unmapped as soon as they are freed.
+//
+// Allocations are identified by a slot in a table that lives in its own
+// buffer, named name_prefix_large_objects, so that every process sharing the
+// allocator agrees on which slots are in use. Each time a slot is reused its
+// generation is bumped, and the buffer backing it is named after the slot and
+// the generation. Processes map a slot's buffer the first time they access
+// it, and map it again once the generation changes. Accessing a slot whose
+// mapping is current doesn't take any lock.
+//
+// Free removes the buffer of the slot's generation through the buffer factory,
+// so a file-backed buffer's storage is reclaimed once the last process that
+// mapped it unmaps it.
+class LargeObjectSpace {
+ public:
+  // The maximum number of live large objects.
+  static constexpr std::size_t kMaxObjects = 1024;
+
+  static constexpr std::size_t InvalidSlot =
+      std::numeric_limits<std::size_t>::max();
+
+  LargeObjectSpace(BufferFactory* buffer_factory,
+                   const std::string& name_prefix);
+
+  LargeObjectSpace(LargeObjectSpace&& other);
+  LargeObjectSpace& operator=(LargeObjectSpace&& other);
+
+  // Creates a buffer of at least size bytes. Returns the slot of the new
+  // buffer and stores its address in data, or returns InvalidSlot if every
+  // slot is taken.
+  std::size_t Allocate(std::size_t size, uint8_t** data);
+
+  // Unmaps and removes the buffer in the provided slot and makes the slot
+  // available again.
+  void Free(std::size_t slot);
+
+  // Returns the address of the buffer in the provided slot, or nullptr if the
+  // slot isn't in use.
+  uint8_t* at(std::size_t slot) const;
+
+ private:
+  struct SlotEntry {
+    enum State : std::uint32_t {
+      kFree,
+      kReserved,
+      kInUse,
+    };
+    std::atomic<std::uint32_t> state;
+    // Bumped every time the slot is reserved.
+    std::atomic<std::uint32_t> generation;
+    // The size of the slot's buffer.
+    std::atomic<std::size_t> size;
+  };
+
+  // The buffer of a slot as mapped into this process. generation and data are
+  // read without the lock: data is valid as long as generation matches the
+  // slot's generation. Both are only written with mutex_ held.
+  struct Mapping {
+    std::atomic<std::uint32_t> generation{0};
+    std::atomic<uint8_t*> data{nullptr};
+    std::unique_ptr<Buffer> buffer;
+  };
+
+  // Returns the slot table, creating or opening it if necessary. Must be
+  // called with mutex_ held.
+  SlotEntry* table() const;
+
+  // Maps the buffer of the provided generation of slot into this process.
+  // Must be called with mutex_ held.
+  uint8_t* Map(std::size_t slot,
+               std::uint32_t generation,
+               std::size_t size) const;
+
+  // Drops this process's mapping of slot. Must be called with mutex_ held.
+  void Unmap(std::size_t slot) const;
+
+  std::string BufferName(std::size_t slot, std::uint32_t generation) const;
+
+  BufferFactory* buffer_factory_;
+  std::string name_prefix_;
+
+  // The table and the mappings are created on demand so that stores without
+  // large objects don't pay for them. entries_ is published once both exist.
+  mutable std::unique_ptr<Buffer> table_buffer_;
+  mutable std::unique_ptr<Mapping[]> mappings_;
+  mutable std::atomic<SlotEntry*> entries_{nullptr};
+  mutable std::mutex mutex_;
+};
+
+#endif  // LARGE_OBJECT_SPACE_H_
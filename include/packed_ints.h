@@ -0,0 +1,107 @@
+#ifndef PACKED_INTS_H_
+#define PACKED_INTS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace packed_ints {
+
+// A packed block stores a sequence of 64-bit integers with frame-of-reference
+// encoding: every value is stored as its difference from the smallest value of
+// the block, using just enough bits for the largest difference. Dense or
+// monotonically increasing keys such as timestamps and IDs shrink to a few
+// bits each.
+//
+// Values keep their position in the block, so any one of them can be read
+// without decoding the others, and sorted blocks are searched in place.
+//
+// Layout:
+//   BlockHeader
+//   uint64_t words[]  values packed least significant bit first, followed by
+//                     a zero padding word so that a value straddling two
+//                     words can always be read with two loads.
+struct BlockHeader {
+  // The smallest value in the block.
+  std::uint64_t base;
+  // The number of values in the block.
+  std::uint32_t count;
+  // The number of bits each value is stored with, from 0 to 64.
+  std::uint32_t bit_width;
+};
+
+// Returns the number of bits needed to store max_delta.
+std::uint32_t BitWidth(std::uint64_t max_delta);
+
+// Returns the number of bytes of a block of count values packed with
+// bit_width bits each.
+std::size_t BlockSize(std::size_t count, std::uint32_t bit_width);
+
+// Returns the number of bytes Pack needs for the provided values.
+std::size_t PackedSize(const std::uint64_t* values, std::size_t count);
+
+// Packs count values into out, which must hold PackedSize(values, count)
+// bytes and be 8-byte aligned. Returns the number of bytes written.
+std::size_t Pack(const std::uint64_t* values,
+                 std::size_t count,
+                 std::uint8_t* out);
+
+// PackedView reads a packed block in place.
+class PackedView {
+ public:
+  // data must point to a block written by Pack and be 8-byte aligned.
+  explicit PackedView(const std::uint8_t* data)
+      : header_(reinterpret_cast<const BlockHeader*>(data)),
+        words_(reinterpret_cast<const std::uint64_t*>(data +
+                                                      sizeof(BlockHeader))) {}
+
+  // Returns the number of values in the block.
+  std::size_t size() const { return header_->count; }
+
+  // Returns the number of bytes the block occupies.
+  std::size_t byte_size() const {
+    return BlockSize(header_->count, header_->bit_width);
+  }
+
+  // Returns the value at position i.
+  std::uint64_t operator[](std::size_t i) const {
+    std::uint32_t bit_width = header_->bit_width;
+    if (bit_width == 0) {
+      return header_->base;
+    }
+    std::size_t bit = i * bit_width;
+    std::size_t word = bit / 64;
+    std::size_t shift = bit % 64;
+    std::uint64_t delta = words_[word] >> shift;
+    // The padding word makes the second load safe. Shifting by 64 is
+    // undefined, so a value that doesn't straddle words skips it.
+    if (shift + bit_width > 64) {
+      delta |= words_[word + 1] << (64 - shift);
+    }
+    if (bit_width < 64) {
+      delta &= (std::uint64_t(1) << bit_width) - 1;
+    }
+    return header_->base + delta;
+  }
+
+  // Returns the position of the first value not less than value, or size()
+  // if there is none. The block must be sorted. Only the values the binary
+  // search probes are extracted.
+  std::size_t LowerBound(std::uint64_t value) const;
+
+  // Returns whether the sorted block holds value.
+  bool Contains(std::uint64_t value) const {
+    std::size_t i = LowerBound(value);
+    return i < size() && (*this)[i] == value;
+  }
+
+  // Decodes every value into out, which must hold size() values.
+  void Decode(std::uint64_t* out) const;
+
+ private:
+  const BlockHeader* header_;
+  const std::uint64_t* words_;
+};
+
+}  // namespace packed_ints
+
+#endif  // PACKED_INTS_H_
@@ -0,0 +1,118 @@
+#ifndef POSTING_LIST_H_
+#define POSTING_LIST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "blob_store.h"
+#include "blob_store_transaction.h"
+
+namespace posting_list {
+
+using blob_store::BlobStore;
+using blob_store::BlobStoreObject;
+
+// PostingListRoot is the root blob of a posting list. The values are split
+// into chunks of at most kMaxChunkSize sorted values. Each chunk is a
+// packed_ints block in its own blob, and the root refers to a directory blob
+// of ChunkRefs ordered by value.
+struct PostingListRoot {
+  // The number of values in the list.
+  std::size_t size;
+  // The number of chunks.
+  std::size_t num_chunks;
+  // The index of the ChunkRef[num_chunks] directory or InvalidIndex if the
+  // list is empty.
+  std::size_t chunks;
+
+  PostingListRoot() : size(0), num_chunks(0), chunks(BlobStore::InvalidIndex) {}
+};
+
+// ChunkRef describes a chunk in the directory. The value range lets queries
+// skip chunks without reading them.
+struct ChunkRef {
+  // The smallest and largest value in the chunk.
+  std::uint64_t first;
+  std::uint64_t last;
+  // The number of values in the chunk.
+  std::size_t count;
+  // The index of the chunk's blob, a packed_ints block stored as uint64_t[].
+  std::size_t chunk;
+};
+
+static_assert(std::is_trivially_copyable<PostingListRoot>::value,
+              "PostingListRoot is trivially copyable");
+static_assert(std::is_trivially_copyable<ChunkRef>::value,
+              "ChunkRef is trivially copyable");
+
+// The maximum number of values in a chunk. A chunk that grows past it is split
+// in two.
+constexpr std::size_t kMaxChunkSize = 128;
+
+// PostingList is a sorted set of 64-bit integers stored across blobs, meant
+// to be the value of a one-to-many relation such as the documents that
+// contain a term. A tree stores the index of the list's root as its value.
+//
+// Lists are copy-on-write at chunk granularity. Updates go through a
+// blob_store::Transaction and return the index of the list's new root; only
+// the root, the directory and the chunk that changed are rewritten, and every
+// other chunk is shared with the previous version of the list.
+class PostingList {
+ public:
+  // Creates an empty list and returns the index of its root.
+  static std::size_t Create(blob_store::Transaction* transaction);
+
+  // Adds value to the list at root_index. Returns the index of the list's
+  // root, which is root_index itself if the list already holds value.
+  static std::size_t Add(blob_store::Transaction* transaction,
+                         std::size_t root_index,
+                         std::uint64_t value);
+
+  // Appends values, which must be sorted and larger than every value in the
+  // list, filling the last chunk before starting new ones. Returns the index
+  // of the list's root.
+  static std::size_t Append(blob_store::Transaction* transaction,
+                            std::size_t root_index,
+                            const std::vector<std::uint64_t>& values);
+
+  // Removes value from the list at root_index. Returns the index of the
+  // list's root, which is root_index itself if the list doesn't hold value.
+  static std::size_t Remove(blob_store::Transaction* transaction,
+                            std::size_t root_index,
+                            std::uint64_t value);
+
+  // Opens the list at root_index for reading.
+  PostingList(BlobStore* blob_store, std::size_t root_index);
+
+  // Returns the number of values in the list.
+  std::size_t size() const { return root_ == nullptr ? 0 : root_->size; }
+
+  // Returns whether the list holds value.
+  bool Contains(std::uint64_t value) const;
+
+  // Returns every value in ascending order.
+  std::vector<std::uint64_t> ToVector() const;
+
+  // Returns the values held by both lists, in ascending order. Only chunks
+  // whose value ranges overlap are decoded.
+  static std::vector<std::uint64_t> Intersect(const PostingList& a,
+                                              const PostingList& b);
+
+  // Returns the values held by either list, in ascending order.
+  static std::vector<std::uint64_t> Union(const PostingList& a,
+                                          const PostingList& b);
+
+ private:
+  // Decodes the chunk described by ref and appends its values to out.
+  void DecodeChunk(const ChunkRef& ref, std::vector<std::uint64_t>* out) const;
+
+  BlobStore* blob_store_;
+  BlobStoreObject<const PostingListRoot> root_;
+  BlobStoreObject<const ChunkRef[]> chunks_;
+};
+
+}  // namespace posting_list
+
+#endif  // POSTING_LIST_H_
@@ -0,0 +1,153 @@
+#ifndef REPLICATION_H_
+#define REPLICATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "blob_store.h"
+#include "blob_store_transaction.h"
+
+namespace blob_store {
+
+// ReplicationStream is the transport between a ReplicationLeader and a
+// ReplicationFollower. It must deliver bytes in order, like a pipe or a
+// socket.
+class ReplicationStream {
+ public:
+  virtual ~ReplicationStream() = default;
+
+  // Writes size bytes from data. Returns false if the stream is broken.
+  virtual bool Write(const void* data, std::size_t size) = 0;
+
+  // Reads exactly size bytes into data, blocking until they are available.
+  // Returns false at the end of the stream or if the stream is broken.
+  virtual bool Read(void* data, std::size_t size) = 0;
+};
+
+// PipeReplicationStream is a ReplicationStream over an OS pipe. It can own
+// both ends of a new pipe, which is handy for tests and threads, or wrap the
+// ends a process inherited from its parent.
+class PipeReplicationStream : public ReplicationStream {
+ public:
+  // Creates a new pipe.
+  PipeReplicationStream();
+
+  // Takes ownership of existing pipe ends. Either end can be -1.
+  PipeReplicationStream(int read_fd, int write_fd);
+
+  ~PipeReplicationStream();
+
+  PipeReplicationStream(const PipeReplicationStream&) = delete;
+  PipeReplicationStream& operator=(const PipeReplicationStream&) = delete;
+
+  // Closes the write end so that the reader sees the end of the stream.
+  void CloseWriter();
+
+  // ReplicationStream implementation.
+  bool Write(const void* data, std::size_t size) override;
+  bool Read(void* data, std::size_t size) override;
+
+ private:
+  int read_fd_;
+  int write_fd_;
+};
+
+// Every record on a replication stream starts with a ReplicationRecordHeader.
+struct ReplicationRecordHeader {
+  enum Type : std::uint32_t {
+    // A copy of every live blob in the leader's store.
+    kSync,
+    // The blobs of a committed transaction.
+    kCommit,
+  };
+
+  Type type;
+  // The version of the head after the record is applied.
+  std::size_t version;
+  // The index of the head the record applies to.
+  std::size_t head_index;
+  // The size of the SerializeTraits<Transaction> data that follows. Zero for
+  // sync records.
+  std::size_t transaction_size;
+  // The size of the blobs that follow. Each blob is its index, its size, its
+  // alignment and its content.
+  std::size_t blobs_size;
+};
+
+// ReplicationLeader ships the transactions committed to a BlobStore to a
+// ReplicationStream. Register it as the TransactionObserver of the data
+// structures to replicate, e.g. with BPlusTree::SetTransactionObserver.
+//
+// A commit record holds the transaction's SerializeTraits<Transaction> data
+// and the content of every blob the transaction created, including the new
+// head. Committed blobs are immutable and the old head is swapped into the new
+// head's index, so a follower that applies the same writes and the same swap
+// ends up with the same blobs at the same indices.
+class ReplicationLeader : public TransactionObserver {
+ public:
+  ReplicationLeader(BlobStore* blob_store, ReplicationStream* stream);
+
+  // Sends a copy of every live blob in the store and the version of the head
+  // at head_index so that a follower can start from a copy of the store. Must
+  // be called while no transaction is in flight. Returns false if the stream
+  // is broken.
+  bool Sync(std::size_t head_index);
+
+  // Returns false once a write to the stream failed.
+  bool is_healthy() const { return healthy_; }
+
+  // TransactionObserver implementation.
+  void OnCommit(const Transaction& transaction) override;
+
+ private:
+  void Send(const ReplicationRecordHeader& header,
+            const std::vector<char>& payload);
+
+  BlobStore* blob_store_;
+  ReplicationStream* stream_;
+  // Commits may be reported concurrently. Records must not interleave.
+  std::mutex mutex_;
+  bool healthy_;
+};
+
+// ReplicationFollower applies the records of a ReplicationStream to its own
+// BlobStore. Records are applied in version order: a commit that arrives ahead
+// of its predecessor is buffered until the predecessor arrives. The follower's
+// store must not be written by anything else, but it can be read concurrently,
+// e.g. through BPlusTree::Search or snapshots.
+class ReplicationFollower {
+ public:
+  ReplicationFollower(BlobStore* blob_store, ReplicationStream* stream);
+
+  // Reads the next record from the stream and applies it along with any
+  // buffered records it unblocks. Returns false at the end of the stream or if
+  // the stream is broken.
+  bool ApplyNext();
+
+  // Returns the newest version applied.
+  std::size_t version() const { return version_; }
+
+ private:
+  struct Record {
+    ReplicationRecordHeader header;
+    std::vector<char> payload;
+  };
+
+  void Apply(const Record& record);
+
+  // Writes every blob in the provided range of a payload to the store.
+  void PutBlobs(const char* blobs, std::size_t size);
+
+  BlobStore* blob_store_;
+  ReplicationStream* stream_;
+  bool synced_;
+  std::size_t version_;
+  std::map<std::size_t, Record> pending_;
+};
+
+}  // namespace blob_store
+
+#endif  // REPLICATION_H_
@@ -1,6 +1,8 @@
 #ifndef SHARED_MEMORY_BUFFER_FACTORY_
 #define SHARED_MEMORY_BUFFER_FACTORY_
 
+#include <cstdio>
+
 #include "buffer_factory.h"
 #include "shared_memory_buffer.h"
 
@@ -15,6 +17,12 @@ class SharedMemoryBufferFactory : public BufferFactory {
                                        size_t size) override {
     return std::unique_ptr<Buffer>(new SharedMemoryBuffer(name, size));
   }
+
+  // Files are opened with delete sharing, so the file's name goes away now and
+  // its storage once every mapping of it is closed.
+  void RemoveBuffer(const std::string& name) override {
+    std::remove(name.c_str());
+  }
 };
 
 #endif  // SHARED_MEMORY_BUFFER_FACTORY_
\ No newline at end of file
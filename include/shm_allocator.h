@@ -10,7 +10,9 @@
 #include "allocation_logger.h"
 #include "chunk_manager.h"
 #include "chunked_vector.h"
+#include "large_object_space.h"
 #include "shm_node.h"
+#include "slab_space.h"
 
 // A simple allocator that allocates memory from a shared memory buffer. The
 // allocator maintains a free list of available blocks of memory. When a block
@@ -39,25 +41,78 @@
 // the next pointer), we can remove it from the free list (by marking the next
 // pointer), then changing the size of the currently allocated node, before
 // deallocating it.
+//
+// Allocations of at least large_object_threshold bytes bypass the chunks and
+// the free list altogether. They are placed in a LargeObjectSpace, which gives
+// each of them a dedicated buffer that is released as soon as the allocation
+// is freed. Their indices use the otherwise unused chunk index 0x7F.
+//
+// Every chunk has its own free list, so that an allocation can be placed in
+// the same region of memory as a related allocation: see AllocateNear. The
+// head of the first chunk's list is in the allocator state header, and the
+// head of every other chunk's list is in the first bytes of the chunk. Without
+// a hint, chunks are tried in order, which keeps live data in the lower
+// chunks.
+//
+// Allocations of at most SlabSpace::kMaxObjectSize bytes come from a SlabSpace
+// instead, which doesn't need a ShmNode header per allocation. Their indices
+// are tagged with kSlabTag.
 class ShmAllocator {
  public:
   static constexpr std::size_t InvalidIndex =
       std::numeric_limits<std::size_t>::max() >> 1;
 
+  // Every allocation is aligned to at least this many bytes.
+  static constexpr std::size_t kMinAlignment = alignof(ShmNode);
+
+  // The default size from which allocations are placed in the large object
+  // space.
+  static constexpr std::size_t kDefaultLargeObjectThreshold = 1 << 20;
+
   // Constructor that takes a reference to the shared memory buffer to be used
   // for allocation
-  explicit ShmAllocator(ChunkManager&& buffer);
+  explicit ShmAllocator(
+      ChunkManager&& buffer,
+      std::size_t large_object_threshold = kDefaultLargeObjectThreshold);
 
   explicit ShmAllocator(ShmAllocator&& other);
 
   // Allocate memory for n objects of type T, and return a pointer to the first
-  // object
-  uint8_t* Allocate(std::size_t bytes_requested);
+  // object. The pointer is aligned to alignment bytes, which must be a power
+  // of two no larger than the page size.
+  uint8_t* Allocate(std::size_t bytes_requested,
+                    std::size_t alignment = kMinAlignment);
+
+  // Same as Allocate, but tries to place the allocation in the same chunk as
+  // the allocation at hint_index, preferably after it, so that data that is
+  // accessed together shares pages. Falls back to the other chunks if there's
+  // no room. An InvalidIndex hint is ignored.
+  uint8_t* AllocateNear(std::size_t hint_index,
+                        std::size_t bytes_requested,
+                        std::size_t alignment = kMinAlignment);
+
+  // Allocates memory from the existing chunks only, never from the slabs or
+  // the large object space. Returns nullptr instead of requesting a new chunk
+  // if no free block is large enough.
+  uint8_t* AllocateFromExistingChunks(std::size_t bytes_requested,
+                                      std::size_t alignment = kMinAlignment,
+                                      std::size_t hint_index = InvalidIndex);
+
+  // Returns whether the allocation at ptr can hold bytes_requested bytes in
+  // place, i.e. whether its block has enough slack. The block never grows
+  // into its neighbours, so a false return means the caller must relocate.
+  // Only the owner of an allocation may grow it.
+  bool Grow(uint8_t* ptr, std::size_t bytes_requested);
 
   // Deallocate memory at the given pointer.
   template <typename U>
   bool Deallocate(U* ptr) {
-    return DeallocateNode(GetNode(reinterpret_cast<uint8_t*>(ptr)));
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(ptr);
+    std::uint64_t slab_index;
+    if (slabs_.IndexOf(bytes, &slab_index)) {
+      return slabs_.Free(slab_index);
+    }
+    return DeallocateNode(GetNode(bytes));
   }
 
   // Returns the size of the allocated block at the given index.
@@ -68,7 +123,33 @@ class ShmAllocator {
   template <typename U>
   typename std::enable_if<!std::is_same<U, uint8_t>::value, std::size_t>::type
   GetCapacity(U* ptr) {
-    return GetCapacity(reinterpret_cast<uin8_t*>(ptr));
+    return GetCapacity(reinterpret_cast<uint8_t*>(ptr));
+  }
+
+  // Returns the number of chunks memory is allocated from.
+  std::size_t GetNumChunks() { return state()->num_chunks.load(); }
+
+  // Returns the size from which allocations are placed in the large object
+  // space.
+  std::size_t large_object_threshold() const {
+    return large_object_threshold_;
+  }
+
+  // Returns whether the provided index refers to a slab object.
+  static bool IsSlabIndex(std::size_t index) {
+    return index != InvalidIndex && !IsLargeObjectIndex(index) &&
+           (index & kSlabTag) != 0;
+  }
+
+  // Returns whether the provided index refers to a large object.
+  static bool IsLargeObjectIndex(std::size_t index) {
+    return index != InvalidIndex &&
+           ChunkManager::chunk_index(index) == kLargeObjectChunkIndex;
+  }
+
+  // Returns the size of the chunk at the provided index.
+  std::size_t GetChunkSize(std::size_t chunk_index) const {
+    return chunk_manager_.chunk_size_at_index(chunk_index);
   }
 
   template <typename U>
@@ -83,6 +164,12 @@ class ShmAllocator {
     if (index == InvalidIndex) {
       return nullptr;
     }
+    if (IsLargeObjectIndex(index)) {
+      return reinterpret_cast<const U*>(LargeObjectAt(index));
+    }
+    if (IsSlabIndex(index)) {
+      return reinterpret_cast<const U*>(slabs_.at(index & ~kSlabTag));
+    }
     return reinterpret_cast<const U*>(chunk_manager_.at(index));
   }
 
@@ -91,11 +178,20 @@ class ShmAllocator {
     if (index == InvalidIndex) {
       return nullptr;
     }
+    if (IsLargeObjectIndex(index)) {
+      return reinterpret_cast<U*>(LargeObjectAt(index));
+    }
+    if (IsSlabIndex(index)) {
+      return reinterpret_cast<U*>(slabs_.at(index & ~kSlabTag));
+    }
     return reinterpret_cast<U*>(chunk_manager_.at(index));
   }
 
   ShmAllocator& operator=(ShmAllocator&& other) noexcept {
     chunk_manager_ = std::move(other.chunk_manager_);
+    large_objects_ = std::move(other.large_objects_);
+    large_object_threshold_ = other.large_object_threshold_;
+    slabs_ = std::move(other.slabs_);
     return *this;
   }
 
@@ -104,16 +200,37 @@ class ShmAllocator {
   struct AllocatorStateHeader {
     // Magic number for verifying the allocator state header.
     uint32_t magic_number;
-    // index of the first free block in the free list
+    // index of the first free block in the first chunk's free list
     std::atomic<std::size_t> free_list_index;
     // number of chunks in the chunk manager
     std::atomic<std::size_t> num_chunks;
   };
 
+  // Large object indices are encoded as this chunk index, the slot in the
+  // large object space, and the offset in the slot's buffer.
+  static constexpr std::size_t kLargeObjectChunkIndex = 0x7F;
+  static constexpr std::size_t kLargeObjectSlotShift = 40;
+
+  // Slab object indices are indices in the SlabSpace's chunks with this bit
+  // set. No chunk is large enough for its offsets to reach it.
+  static constexpr std::size_t kSlabTag = 1ull << 55;
+
   AllocatorStateHeader* state() {
     return reinterpret_cast<AllocatorStateHeader*>(chunk_manager_.at(0, 0));
   }
 
+  // Every chunk but the first starts with the head of its free list.
+  static constexpr std::size_t kChunkHeaderSize = sizeof(std::size_t);
+
+  // Returns the head of the free list of the chunk at chunk_index.
+  std::atomic<std::size_t>* free_list_head(std::size_t chunk_index) {
+    if (chunk_index == 0) {
+      return &state()->free_list_index;
+    }
+    return reinterpret_cast<std::atomic<std::size_t>*>(
+        chunk_manager_.at(chunk_index, 0));
+  }
+
   // Given a pointer, returns the ShmNode.
   ShmNodePtr GetNode(uint8_t* ptr) const {
     return ShmNodePtr(ptr == nullptr ? nullptr
@@ -123,26 +240,59 @@ class ShmAllocator {
   void InitializeAllocatorStateIfNecessary();
 
   static std::size_t CalculateBytesNeeded(std::size_t bytes) {
-    // Calculate the number of bytes needed for the memory block
-    return std::max<std::size_t>(sizeof(ShmNode) + bytes, sizeof(ShmNode));
+    // Calculate the number of bytes needed for the memory block. Rounding up
+    // keeps every node header, and so every allocation, aligned to
+    // kMinAlignment.
+    return (sizeof(ShmNode) + bytes + kMinAlignment - 1) &
+           ~(kMinAlignment - 1);
+  }
+
+  // Returns the number of bytes to add to a request so that an allocation
+  // aligned to alignment can be carved out of it. Any misaligned head must be
+  // large enough to be split off as a free node.
+  static std::size_t AlignmentPadding(std::size_t alignment) {
+    return alignment <= kMinAlignment
+               ? 0
+               : alignment + sizeof(ShmNode) + kMinAlignment;
   }
 
+  // Moves the start of a freshly allocated node forward so that its data is
+  // aligned to alignment, and frees the skipped head. Returns the node that
+  // now holds the allocation.
+  ShmNodePtr AlignNode(ShmNodePtr node, std::size_t alignment);
+
   ShmNodePtr NewAllocatedNode(uint8_t* buffer,
                               std::size_t index,
                               std::size_t size);
 
   bool DeallocateNode(ShmNodePtr node);
 
+  // Allocates a node with a dedicated buffer in the large object space.
+  // Returns nullptr if the large object space is full.
+  uint8_t* AllocateLargeObject(std::size_t bytes_needed, std::size_t alignment);
+
+  // Returns the address of the provided large object index.
+  uint8_t* LargeObjectAt(std::size_t index) const;
+
+  // Splits the tail of an allocated node beyond bytes_needed off into a new
+  // free node if it's large enough to hold one.
+  void SplitNodeIfPossible(ShmNode* node, std::size_t bytes_needed);
+
   std::uint64_t ToIndexImpl(ShmNode* ptr, std::true_type) const;
 
   template <typename U>
   std::uint64_t ToIndexImpl(U* ptr, std::false_type) const {
+    std::uint64_t slab_index;
+    if (slabs_.IndexOf(reinterpret_cast<const uint8_t*>(ptr), &slab_index)) {
+      return slab_index | kSlabTag;
+    }
     ShmNodePtr allocated_node = GetNode(ptr);
     return ToIndexImpl(allocated_node.get(), std::true_type{}) +
            sizeof(ShmNode);
   }
 
-  // Allocates space from a free node that can fit the requested size.
+  // Allocates space from a free node that can fit the requested size at or
+  // after min_index. Only the free list of min_index's chunk is searched.
   // Returns nullptr if no free node is found.
   uint8_t* AllocateFromFreeList(std::size_t min_bytes_needed,
                                 std::size_t min_index,
@@ -174,6 +324,7 @@ class ShmAllocator {
 
   // Given a size, returns the left node and right node, such that the
   // size of the left node < size, and the size of the right node >= size.
+  // Searches the free list of the chunk that index is in.
   ShmNodePtr SearchBySize(std::size_t size,
                           std::size_t index,
                           ShmNodePtr* left_node);
@@ -189,6 +340,11 @@ class ShmAllocator {
  private:
   // Reference to the shared memory buffer used for allocation
   ChunkManager chunk_manager_;
+  // Holds the allocations of at least large_object_threshold_ bytes.
+  LargeObjectSpace large_objects_;
+  std::size_t large_object_threshold_;
+  // Holds the allocations of at most SlabSpace::kMaxObjectSize bytes.
+  SlabSpace slabs_;
   friend class AllocationLogger;
 };
 
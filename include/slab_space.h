@@ -0,0 +1,117 @@
+#ifndef SLAB_SPACE_H_
+#define SLAB_SPACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "buffer_factory.h"
+#include "chunk_manager.h"
+
+// SlabSpace serves small allocations without a per-object header. Memory is
+// carved into fixed-size slabs, each dedicated to one size class. A slab
+// starts with a small header holding the size of its objects and a bitmap of
+// the objects in use, followed by the objects themselves. The size of an
+// object is therefore derived from the slab it lives in.
+//
+// Slabs live in their own ChunkManager, named name_prefix_slabs, so any
+// pointer into it is known to be a slab object. The first slab holds the
+// state of the space: the slabs with free objects of each size class and the
+// slabs that are completely empty, which are reused by any size class.
+//
+// Slab lists and bitmaps are updated under a spinlock in shared memory that
+// is shared by every process mapping the space.
+class SlabSpace {
+ public:
+  // The size of a slab in bytes.
+  static constexpr std::size_t kSlabSize = 4096;
+  // Size classes are multiples of kGranularity up to kMaxObjectSize.
+  static constexpr std::size_t kGranularity = 8;
+  static constexpr std::size_t kMaxObjectSize = 32;
+  static constexpr std::size_t kNumSizeClasses = kMaxObjectSize / kGranularity;
+
+  static constexpr std::uint64_t InvalidIndex =
+      std::numeric_limits<std::uint64_t>::max() >> 1;
+
+  SlabSpace(BufferFactory* buffer_factory, const std::string& name_prefix);
+
+  SlabSpace(SlabSpace&& other) = default;
+  SlabSpace& operator=(SlabSpace&& other) = default;
+
+  // Allocates an object of at least bytes_requested bytes, which must not
+  // exceed kMaxObjectSize. Returns the encoded index of the object in the
+  // slab chunks.
+  std::uint64_t Allocate(std::size_t bytes_requested);
+
+  // Frees the object at the provided index. Returns false if the object isn't
+  // allocated.
+  bool Free(std::uint64_t index);
+
+  // Returns the size of the object at the provided index.
+  std::size_t GetObjectSize(std::uint64_t index) const;
+
+  // Returns whether ptr points into the slab chunks and, if it does, stores
+  // the encoded index of the object in index.
+  bool IndexOf(const uint8_t* ptr, std::uint64_t* index) const {
+    return slabs_.index_of(ptr, index);
+  }
+
+  // Returns the address of the object at the provided index.
+  uint8_t* at(std::uint64_t index) { return slabs_.at(index); }
+  const uint8_t* at(std::uint64_t index) const { return slabs_.at(index); }
+
+ private:
+  struct SlabHeader {
+    // The size of the objects in the slab, or 0 if the slab is empty.
+    std::uint32_t object_size;
+    // The number of objects in use.
+    std::uint32_t num_used;
+    // The next slab on the same list.
+    std::uint64_t next_slab;
+    // One bit per object. The smallest size class has the most objects.
+    std::uint64_t bitmap[(kSlabSize / kGranularity + 63) / 64];
+  };
+
+  struct SpaceHeader {
+    // Magic number for verifying the space header.
+    std::uint32_t magic_number;
+    // Guards everything below and every slab header.
+    std::atomic<std::uint32_t> lock;
+    // The number of slabs handed out so far, including this header's.
+    std::uint64_t num_slabs;
+    // Slabs without any objects in use.
+    std::uint64_t empty_slabs;
+    // Slabs with at least one free object, per size class.
+    std::uint64_t partial_slabs[kNumSizeClasses];
+  };
+
+  static std::size_t Capacity(std::size_t object_size) {
+    return (kSlabSize - sizeof(SlabHeader)) / object_size;
+  }
+
+  SpaceHeader* state() {
+    return reinterpret_cast<SpaceHeader*>(slabs_.at(0, 0));
+  }
+
+  SlabHeader* slab(std::uint64_t slab_index) {
+    return reinterpret_cast<SlabHeader*>(slabs_.at(slab_index));
+  }
+
+  // Returns the index of the slab that holds the object at the provided index.
+  static std::uint64_t SlabIndexOf(std::uint64_t index) {
+    return index & ~static_cast<std::uint64_t>(kSlabSize - 1);
+  }
+
+  void Lock();
+  void Unlock();
+
+  // Returns an empty slab, reusing a freed one if possible. Must be called
+  // with the lock held.
+  std::uint64_t TakeEmptySlab();
+
+  ChunkManager slabs_;
+};
+
+#endif  // SLAB_SPACE_H_
@@ -0,0 +1,105 @@
+#ifndef STRING_INTERN_TABLE_H_
+#define STRING_INTERN_TABLE_H_
+
+#include <cstddef>
+#include <string>
+
+#include "blob_store.h"
+#include "fixed_string.h"
+
+namespace blob_store {
+
+// InternTableHeader is the root blob of a StringInternTable.
+struct InternTableHeader {
+  // The number of strings in the table.
+  std::size_t num_strings;
+  // The number of buckets that aren't empty, including deleted ones.
+  std::size_t num_used;
+  // The number of buckets. Always a power of two.
+  std::size_t capacity;
+  // The index of the InternEntry[capacity] blob holding the buckets.
+  std::size_t buckets_index;
+};
+
+// InternEntry is a bucket of a StringInternTable.
+struct InternEntry {
+  // Marks a bucket that never held a string.
+  static constexpr std::size_t kEmpty = BlobStore::InvalidIndex;
+  // Marks a bucket whose string was released. Probes continue past it.
+  static constexpr std::size_t kDeleted = BlobStore::InvalidIndex - 1;
+
+  // The hash stored in the string's FixedString.
+  std::size_t hash;
+  // The index of the string's blob, kEmpty or kDeleted.
+  std::size_t string_index;
+  // The number of outstanding Intern calls for the string.
+  std::size_t ref_count;
+};
+
+// StringInternTable deduplicates string blobs: every distinct string that's
+// interned is stored once, and interning it again returns the same blob. Trees
+// that index the same strings many times over can share key blobs, and two
+// interned keys are equal exactly when their blob indices are.
+//
+// The table is an open-addressing hash table stored in the BlobStore, so it's
+// shared by every process that maps the store. Lookups hold a read lock on the
+// header blob and updates hold its write lock.
+//
+// Interned blobs live outside of transactions. A string's blob is dropped by
+// the Release call that matches its last Intern, so a string must not be
+// released while any committed version still refers to it.
+class StringInternTable {
+ public:
+  // Creates a new, empty table.
+  static StringInternTable Create(BlobStore* blob_store);
+
+  // Opens the table whose header is at table_index.
+  static StringInternTable Open(BlobStore* blob_store, std::size_t table_index);
+
+  // Returns the index of the table's header.
+  std::size_t table_index() const { return table_index_; }
+
+  // Returns the blob holding str, storing str first if it isn't interned yet,
+  // and takes a reference to it.
+  BlobStoreObject<const std::string> Intern(const std::string& str);
+
+  // Returns the blob holding str without taking a reference, or nullptr if
+  // str isn't interned.
+  BlobStoreObject<const std::string> Find(const std::string& str) const;
+
+  // Gives up a reference taken by Intern. The string's blob is dropped once
+  // no references remain. Returns false if string_index isn't interned.
+  bool Release(std::size_t string_index);
+
+  // Returns the number of references to the interned string at string_index,
+  // or 0 if it isn't interned.
+  std::size_t GetRefCount(std::size_t string_index) const;
+
+  // Returns the number of distinct strings in the table.
+  std::size_t GetSize() const;
+
+ private:
+  // The number of buckets of a new table.
+  static constexpr std::size_t kInitialCapacity = 16;
+
+  StringInternTable(BlobStore* blob_store, std::size_t table_index)
+      : blob_store_(blob_store), table_index_(table_index) {}
+
+  // Returns the bucket holding str, whose hash is hash, or the capacity if
+  // str isn't interned.
+  std::size_t FindBucket(const InternTableHeader& header,
+                         const InternEntry* buckets,
+                         std::size_t hash,
+                         const std::string& str) const;
+
+  // Rehashes the table into capacity buckets, discarding deleted buckets.
+  // Must be called with the write lock held on the header.
+  void Rehash(InternTableHeader* header, std::size_t capacity);
+
+  BlobStore* blob_store_;
+  std::size_t table_index_;
+};
+
+}  // namespace blob_store
+
+#endif  // STRING_INTERN_TABLE_H_
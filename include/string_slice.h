@@ -2,9 +2,12 @@
 #define STRING_SLICE_H_
 
 #include <cstring>
+#include <limits>
 #include <ostream>
 #include <string>
 
+#include "hash.h"
+
 // The StringSlice class represents a slice of a string, i.e., a substring
 // defined by an offset and a size within the original string.
 //
@@ -24,6 +27,9 @@
 
 class StringSlice {
  public:
+  // Returned by the find functions when there is no match.
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
   // Constructs a StringSlice representing the given slice of the string.
   StringSlice(const char* str, size_t offset, size_t size);
 
@@ -57,6 +63,22 @@ class StringSlice {
   // StringSlice represents.
   std::string to_string() const;
 
+  // Compares this slice with other byte by byte, treating bytes as unsigned.
+  // Returns a negative value, zero or a positive value if this slice orders
+  // before, the same as, or after other.
+  int compare(const StringSlice& other) const;
+
+  // Returns the number of leading bytes this slice has in common with other.
+  size_t common_prefix_length(const StringSlice& other) const;
+
+  // Returns the position of the first occurrence of c at or after pos, or
+  // npos if there is none.
+  size_t find(char c, size_t pos = 0) const;
+
+  // Returns the position of the first occurrence of needle at or after pos,
+  // or npos if there is none. An empty needle is found at pos.
+  size_t find(const StringSlice& needle, size_t pos = 0) const;
+
   // Comparison operators.
   bool operator==(const StringSlice& other) const;
   bool operator!=(const StringSlice& other) const;
@@ -112,14 +134,7 @@ namespace std {
 template <>
 struct hash<StringSlice> {
   size_t operator()(const StringSlice& slice) const {
-    size_t hash = 0;
-    for (size_t i = 0; i < slice.size(); ++i) {
-      // This is a simple hash function based on the djb2 algorithm.
-      // It may not be suitable for all purposes, but it's a good starting
-      // point.
-      hash = ((hash << 5) + hash) + slice[i];  // hash * 33 + c
-    }
-    return hash;
+    return static_cast<size_t>(hashing::HashBytes(slice.data(), slice.size()));
   }
 };
 }  // namespace std
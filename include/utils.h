@@ -16,6 +16,9 @@
 
 namespace utils {
 
+// The size of a cache line on the platforms we care about.
+constexpr size_t kCacheLineSize = 64;
+
 template <typename U, typename... Args>
 void Construct(U* p, Args&&... args) {
   new (p) U(std::forward<Args>(args)...);
@@ -35,6 +38,10 @@ size_t GetPageSize();
 
 size_t RoundUpToPageSize(size_t size);
 
+// Copies size bytes from src to dst like memcpy, but with non-temporal stores
+// where available so that copying a large buffer doesn't flush the cache.
+void StreamCopy(void* dst, const void* src, size_t size);
+
 }  // namespace utils
 
 #endif  // UTILS_H_
\ No newline at end of file
@@ -0,0 +1,169 @@
+#ifndef VALUE_LOG_H_
+#define VALUE_LOG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+#include "blob_store.h"
+#include "blob_store_transaction.h"
+#include "string_slice.h"
+
+namespace value_log {
+
+using blob_store::BlobStore;
+using blob_store::BlobStoreObject;
+
+// ValueRef is the value a tree stores in place of a value kept by a ValueLog.
+// A value larger than the log's threshold is stored in a segment of the log,
+// and a smaller one in a blob of its own.
+struct ValueRef {
+  // Marks a value stored in a blob of its own.
+  static constexpr std::size_t kInline = BlobStore::InvalidIndex;
+
+  // The index of the segment holding the value, or kInline.
+  std::size_t segment;
+  // The offset of the value within the segment, or the index of the value's
+  // blob if segment is kInline.
+  std::size_t offset;
+  // The size of the value in bytes.
+  std::size_t length;
+
+  bool operator==(const ValueRef& other) const {
+    return segment == other.segment && offset == other.offset &&
+           length == other.length;
+  }
+  bool operator!=(const ValueRef& other) const { return !(*this == other); }
+};
+
+// ValueLogHeader is the root blob of a ValueLog. It's updated in place, under
+// its write lock, rather than through transactions.
+struct ValueLogHeader {
+  // The size of new segments in bytes.
+  std::size_t segment_size;
+  // Values up to this size are stored in blobs of their own.
+  std::size_t threshold;
+  // The oldest segment, the first one Collect rewrites.
+  std::size_t oldest;
+  // The segment values are appended to.
+  std::size_t active;
+  // The number of segments in the log.
+  std::size_t num_segments;
+};
+
+// SegmentHeader starts every segment. Segments are chained from the oldest
+// to the active one.
+struct SegmentHeader {
+  // The size of the segment in bytes, including this header.
+  std::uint64_t capacity;
+  // The number of bytes written, including this header.
+  std::uint64_t used;
+  // The next segment or InvalidIndex if this is the active segment.
+  std::uint64_t next;
+};
+
+// EntryHeader precedes the key and the value of every entry of a segment.
+// Entries start on 8-byte boundaries.
+struct EntryHeader {
+  std::uint32_t key_size;
+  std::uint32_t value_size;
+};
+
+static_assert(std::is_trivially_copyable<ValueRef>::value,
+              "ValueRef is trivially copyable");
+static_assert(std::is_trivially_copyable<ValueLogHeader>::value,
+              "ValueLogHeader is trivially copyable");
+static_assert(std::is_trivially_copyable<SegmentHeader>::value,
+              "SegmentHeader is trivially copyable");
+
+// ValueLog separates large values from the tree that indexes them, as in
+// WiscKey. Values are appended to large segment blobs and the tree only stores
+// a small ValueRef, so tree nodes stay small and dense, a transaction that
+// clones a leaf doesn't copy any value, and large values don't fragment the
+// allocator that small nodes are carved from.
+//
+// Every entry records its key, so that Collect can ask whether the tree still
+// refers to it. Appends don't go through transactions: the entries of an
+// aborted transaction stay in the log as garbage until their segment is
+// collected.
+//
+// Get reads a segment under the segment's read lock, and Append writes the
+// active segment under its write lock. Sealed segments are never written
+// again, so only reads of the active segment wait for appends, for as long
+// as it takes to copy an entry in.
+class ValueLog {
+ public:
+  // The default size of a segment.
+  static constexpr std::size_t kDefaultSegmentSize = 1 << 20;
+  // The default size of the largest value stored outside of the log.
+  static constexpr std::size_t kDefaultThreshold = 128;
+
+  // Called by Collect with the key and ref of every entry of the collected
+  // segment. Returns whether the tree still refers to the entry.
+  using LiveCheck =
+      std::function<bool(const StringSlice& key, const ValueRef& ref)>;
+
+  // Called by Collect with the key and new ref of every live entry once it
+  // has been copied. Must point the tree at new_ref within the transaction
+  // passed to Collect.
+  using Relocate = std::function<void(const StringSlice& key,
+                                      BlobStoreObject<const ValueRef> new_ref)>;
+
+  // Creates a new log with a single, empty segment.
+  static ValueLog Create(BlobStore* blob_store,
+                         std::size_t segment_size = kDefaultSegmentSize,
+                         std::size_t threshold = kDefaultThreshold);
+
+  // Opens the log whose header is at log_index.
+  static ValueLog Open(BlobStore* blob_store, std::size_t log_index);
+
+  // Returns the index of the log's header.
+  std::size_t log_index() const { return log_index_; }
+
+  // Stores value, the value of key, and returns a new ref to it, created
+  // within transaction, to insert into the tree. Throws std::length_error if
+  // value goes to the log and it or key is 4 GiB or larger.
+  BlobStoreObject<ValueRef> Put(blob_store::Transaction* transaction,
+                                const StringSlice& key,
+                                const StringSlice& value);
+
+  // Returns the value ref refers to.
+  std::string Get(const ValueRef& ref) const;
+
+  // Copies the entries of the oldest segment that is_live reports as live to
+  // the end of the log and reports their new refs to relocate. Returns the
+  // index of the segment, or InvalidIndex if every segment is still being
+  // appended to. The segment stays in the log until DropSegment is called,
+  // which must wait for transaction to commit. If transaction aborts, the
+  // segment is simply collected again later.
+  std::size_t Collect(blob_store::Transaction* transaction,
+                      const LiveCheck& is_live,
+                      const Relocate& relocate);
+
+  // Removes the segment returned by Collect from the log and frees it. No
+  // version of the tree that may still be read must refer to it.
+  void DropSegment(std::size_t segment);
+
+  // Returns the number of segments in the log.
+  std::size_t GetNumSegments() const;
+
+ private:
+  ValueLog(BlobStore* blob_store, std::size_t log_index)
+      : blob_store_(blob_store), log_index_(log_index) {}
+
+  // Appends an entry to the active segment, starting a new segment if it
+  // doesn't fit, and returns a ref to its value.
+  ValueRef Append(const StringSlice& key, const StringSlice& value);
+
+  // Creates a segment with room for at least capacity bytes.
+  BlobStoreObject<std::uint64_t[]> NewSegment(std::size_t capacity);
+
+  BlobStore* blob_store_;
+  std::size_t log_index_;
+};
+
+}  // namespace value_log
+
+#endif  // VALUE_LOG_H_
@@ -14,14 +14,17 @@ AllocationLogger::AllocationLogger()
     : operations_(TestMemoryBufferFactory::Get(), "operations", 1024) {}
 
 void AllocationLogger::RecordAllocation(const ShmNode& node) {
+  std::lock_guard<std::mutex> lock(log_mutex_);
   operations_.emplace_back(OperationType::Allocate, node);
 }
 
 void AllocationLogger::RecordDeallocation(const ShmNode& node) {
+  std::lock_guard<std::mutex> lock(log_mutex_);
   operations_.emplace_back(OperationType::Deallocate, node);
 }
 
 void AllocationLogger::RecordSearch(const ShmNode& node) {
+  std::lock_guard<std::mutex> lock(log_mutex_);
   operations_.emplace_back(OperationType::Search, node);
 }
 
@@ -2,51 +2,27 @@
 
 namespace blob_store {
 
-constexpr std::int32_t WRITE_LOCK_FLAG = 0x80000000;
-
-namespace {
-void SpinWait() {
-#if defined(_WIN32)
-  Sleep(0);
-#else
-  std::this_thread::yield();
-#endif
-}
-}  // namespace
-
-BlobStore::BlobStore(BufferFactory* buffer_factory,
-                     const std::string& name_prefix,
-                     std::size_t requested_chunk_size,
-                     ChunkManager&& dataBuffer)
-    : allocator_(std::move(dataBuffer)),
+template <typename Policy>
+BasicBlobStore<Policy>::BasicBlobStore(BufferFactory* buffer_factory,
+                                       const std::string& name_prefix,
+                                       std::size_t requested_chunk_size,
+                                       ChunkManager&& dataBuffer,
+                                       std::size_t large_object_threshold)
+    : allocator_(std::move(dataBuffer), large_object_threshold),
       metadata_(buffer_factory, name_prefix, requested_chunk_size) {
   if (metadata_.empty()) {
     metadata_.emplace_back();
   }
 }
 
-BlobStore::~BlobStore() {}
-
-uint8_t* BlobStore::GetRaw(size_t index, size_t* offset) {
-  if (index == BlobStore::InvalidIndex) {
-    return nullptr;
-  }
-  BlobMetadata* metadata = metadata_.at(index);
-  if (metadata == nullptr || metadata->is_deleted() || metadata->size == 0) {
-    return nullptr;
-  }
-
-  std::size_t offset_value = metadata->offset;
-  if (offset != nullptr) {
-    *offset = offset_value;
-  }
-  return allocator_.ToPtr<uint8_t>(offset_value);
-}
+template <typename Policy>
+BasicBlobStore<Policy>::~BasicBlobStore() {}
 
-bool BlobStore::CompareAndSwap(std::size_t index,
-                               std::size_t expected_offset,
-                               std::size_t new_offset) {
-  if (index == BlobStore::InvalidIndex) {
+template <typename Policy>
+bool BasicBlobStore<Policy>::CompareAndSwap(std::size_t index,
+                                            std::size_t expected_offset,
+                                            std::size_t new_offset) {
+  if (index == InvalidIndex) {
     return false;
   }
 
@@ -55,21 +31,33 @@ bool BlobStore::CompareAndSwap(std::size_t index,
     return false;
   }
 
-  return metadata->offset.compare_exchange_weak(expected_offset, new_offset);
+  return Policy::CompareExchange(metadata->offset, expected_offset,
+                                 new_offset);
 }
 
-std::size_t BlobStore::Clone(std::size_t index) {
+template <typename Policy>
+std::size_t BasicBlobStore<Policy>::Clone(std::size_t index) {
   // This is only safe if the calling object is holding a read or write lock.
   BlobMetadata& metadata = metadata_[index];
   size_t clone_index = FindFreeSlot();
-  uint8_t* ptr = allocator_.Allocate(metadata.size);
+  // Place the clone next to the original. Copy-on-write clones usually
+  // replace the original, so this keeps the blobs that are read together in
+  // the same chunk.
+  uint8_t* ptr = allocator_.AllocateNear(metadata.offset, metadata.size,
+                                         metadata.alignment);
   size_t offset;
   const uint8_t* obj = GetRaw(index, &offset);
   // Blobs are trivially copyable and standard layout so memcpy should be
-  // safe.
-  memcpy(ptr, obj, metadata.size);
+  // safe. Large blobs are copied with non-temporal stores so that the copy
+  // doesn't evict the rest of the working set from the cache.
+  if (metadata.size >= allocator_.large_object_threshold()) {
+    utils::StreamCopy(ptr, obj, metadata.size);
+  } else {
+    memcpy(ptr, obj, metadata.size);
+  }
   BlobMetadata& clone_metadata = metadata_[clone_index];
   clone_metadata.size = metadata.size;
+  clone_metadata.alignment = metadata.alignment;
   clone_metadata.offset = allocator_.ToIndex(ptr);
   assert(clone_metadata.offset != ShmAllocator::InvalidIndex);
   clone_metadata.lock_state = 0;
@@ -78,8 +66,9 @@ std::size_t BlobStore::Clone(std::size_t index) {
 }
 
 // Gets the size of the blob stored at the speific index.
-std::size_t BlobStore::GetSize(std::size_t index) {
-  if (index == BlobStore::InvalidIndex) {
+template <typename Policy>
+std::size_t BasicBlobStore<Policy>::GetSize(std::size_t index) {
+  if (index == InvalidIndex) {
     return 0;
   }
 
@@ -91,14 +80,15 @@ std::size_t BlobStore::GetSize(std::size_t index) {
   return metadata->size;
 }
 
-void BlobStore::Drop(size_t index) {
-  if (index == BlobStore::InvalidIndex) {
+template <typename Policy>
+void BasicBlobStore<Policy>::Drop(size_t index) {
+  if (index == InvalidIndex) {
     return;
   }
   BlobMetadata* metadata = metadata_.at(index);
   // Set a tombstone on the blob to ensure that no new locks are acquired on
   // it. We cannot drop a blob that is on the free list.
-  if (metadata == nullptr || !metadata->SetTombstone()) {
+  if (metadata == nullptr || !metadata->SetTombstone<Policy>()) {
     return;
   }
 
@@ -113,16 +103,16 @@ void BlobStore::Drop(size_t index) {
   while (true) {
     ssize_t first_free_index = free_list_head.next_free_index.load();
     ssize_t tombstone = 0;
-    if (!metadata->next_free_index.compare_exchange_weak(tombstone,
-                                                         first_free_index)) {
+    if (!Policy::CompareExchange(metadata->next_free_index, tombstone,
+                                 first_free_index)) {
       continue;
     }
 
     // If the head of the free list has changed, undo the change we made if
     // possible and try again.
-    if (!free_list_head.next_free_index.compare_exchange_weak(first_free_index,
-                                                              index)) {
-      metadata->next_free_index.store(tombstone);
+    if (!Policy::CompareExchange(free_list_head.next_free_index,
+                                 first_free_index, index)) {
+      Policy::Store(metadata->next_free_index, tombstone);
       continue;
     }
 
@@ -131,7 +121,206 @@ void BlobStore::Drop(size_t index) {
   }
 }
 
-size_t BlobStore::FindFreeSlot() {
+template <typename Policy>
+void BasicBlobStore<Policy>::Put(size_t index,
+                                 const void* data,
+                                 size_t size,
+                                 size_t alignment) {
+  while (metadata_.size() <= index) {
+    Policy::Store(metadata_[metadata_.emplace_back()].next_free_index,
+                  RESERVED_SLOT);
+  }
+
+  uint8_t* ptr = allocator_.Allocate(size, alignment);
+  memcpy(ptr, data, size);
+  BlobMetadata& metadata = metadata_[index];
+  // Readers of the old blob hold a lock on it, so waiting for the write lock
+  // ensures nobody reads the old allocation or its size after the swap.
+  if (!metadata.is_deleted() && AcquireWriteLock(index)) {
+    size_t old_offset = metadata.offset;
+    metadata.size = size;
+    metadata.alignment = static_cast<std::uint32_t>(alignment);
+    Policy::Store(metadata.offset, allocator_.ToIndex(ptr));
+    Unlock(index);
+    allocator_.Deallocate(allocator_.ToPtr<char>(old_offset));
+    return;
+  }
+
+  if (metadata.next_free_index.load() != RESERVED_SLOT) {
+    RemoveFreeSlot(index);
+  }
+  InitializeMetadata(index, size, alignment, ptr);
+}
+
+template <typename Policy>
+bool BasicBlobStore<Policy>::Resize(size_t index, size_t new_size) {
+  if (index == InvalidIndex) {
+    return false;
+  }
+  BlobMetadata* metadata = metadata_.at(index);
+  if (metadata == nullptr || metadata->is_deleted()) {
+    return false;
+  }
+
+  size_t old_offset = metadata->offset;
+  uint8_t* old_ptr = allocator_.ToPtr<uint8_t>(old_offset);
+  if (allocator_.Grow(old_ptr, new_size)) {
+    metadata->size = new_size;
+    return true;
+  }
+
+  uint8_t* ptr = allocator_.Allocate(new_size, metadata->alignment);
+  memcpy(ptr, old_ptr, std::min<size_t>(metadata->size, new_size));
+  if (!Policy::CompareExchange(metadata->offset, old_offset,
+                               allocator_.ToIndex(ptr))) {
+    // The blob was swapped out from under us.
+    allocator_.Deallocate(ptr);
+    return false;
+  }
+  metadata->size = new_size;
+  allocator_.Deallocate(old_ptr);
+  return true;
+}
+
+template <typename Policy>
+std::size_t BasicBlobStore<Policy>::GetOffset(std::size_t index) {
+  if (index == InvalidIndex) {
+    return ShmAllocator::InvalidIndex;
+  }
+
+  BlobMetadata* metadata = metadata_.at(index);
+  if (metadata == nullptr || metadata->is_deleted()) {
+    return ShmAllocator::InvalidIndex;
+  }
+
+  return metadata->offset;
+}
+
+template <typename Policy>
+std::size_t BasicBlobStore<Policy>::GetAlignment(std::size_t index) {
+  if (index == InvalidIndex) {
+    return 0;
+  }
+
+  BlobMetadata* metadata = metadata_.at(index);
+  if (metadata == nullptr || metadata->is_deleted()) {
+    return 0;
+  }
+
+  return metadata->alignment;
+}
+
+template <typename Policy>
+std::vector<size_t> BasicBlobStore<Policy>::GetLiveBytesPerChunk() {
+  std::vector<size_t> live_bytes(allocator_.GetNumChunks());
+  for (size_t index = 1; index < metadata_.size(); ++index) {
+    const BlobMetadata& metadata = metadata_[index];
+    if (metadata.is_deleted()) {
+      continue;
+    }
+    // Slab objects and large objects aren't in the chunks.
+    size_t offset = metadata.offset;
+    size_t chunk = ChunkManager::chunk_index(offset);
+    if (!ShmAllocator::IsSlabIndex(offset) && chunk < live_bytes.size()) {
+      live_bytes[chunk] += metadata.size;
+    }
+  }
+  return live_bytes;
+}
+
+template <typename Policy>
+size_t BasicBlobStore<Policy>::Defragment(size_t max_moves) {
+  std::vector<size_t> live_bytes = GetLiveBytesPerChunk();
+  // Chunk 0 has nowhere lower to go.
+  size_t source = 0;
+  size_t free_bytes_below = 0;
+  for (size_t chunk = 0; chunk < live_bytes.size(); ++chunk) {
+    size_t chunk_size = allocator_.GetChunkSize(chunk);
+    if (chunk > 0 && live_bytes[chunk] > 0 &&
+        live_bytes[chunk] * 2 <= chunk_size &&
+        live_bytes[chunk] <= free_bytes_below) {
+      source = chunk;
+    }
+    free_bytes_below += chunk_size - std::min(chunk_size, live_bytes[chunk]);
+  }
+  if (source == 0) {
+    return 0;
+  }
+
+  size_t moved = 0;
+  for (size_t index = 1; index < metadata_.size() && moved < max_moves;
+       ++index) {
+    BlobMetadata& metadata = metadata_[index];
+    if (metadata.is_deleted() || ShmAllocator::IsSlabIndex(metadata.offset) ||
+        ChunkManager::chunk_index(metadata.offset) != source ||
+        !TryAcquireWriteLock(index)) {
+      continue;
+    }
+    // The blob may have been dropped or moved before we locked it.
+    size_t old_offset = metadata.offset;
+    if (metadata.is_deleted() || ShmAllocator::IsSlabIndex(old_offset) ||
+        ChunkManager::chunk_index(old_offset) != source) {
+      Unlock(index);
+      continue;
+    }
+
+    // Without a hint, chunks are searched from the lowest one up, so a lower
+    // block is found first if there is one.
+    uint8_t* ptr = allocator_.AllocateFromExistingChunks(metadata.size,
+                                                         metadata.alignment);
+    if (ptr != nullptr &&
+        ChunkManager::chunk_index(allocator_.ToIndex(ptr)) >= source) {
+      allocator_.Deallocate(ptr);
+      ptr = nullptr;
+    }
+    if (ptr == nullptr) {
+      Unlock(index);
+      break;
+    }
+    memcpy(ptr, allocator_.ToPtr<uint8_t>(old_offset), metadata.size);
+    if (Policy::CompareExchange(metadata.offset, old_offset,
+                                allocator_.ToIndex(ptr))) {
+      allocator_.Deallocate(allocator_.ToPtr<uint8_t>(old_offset));
+      ++moved;
+    } else {
+      allocator_.Deallocate(ptr);
+    }
+    Unlock(index);
+  }
+  return moved;
+}
+
+template <typename Policy>
+void BasicBlobStore<Policy>::InitializeMetadata(std::size_t index,
+                                                std::size_t size,
+                                                std::size_t alignment,
+                                                uint8_t* ptr) {
+  BlobMetadata& metadata = metadata_[index];
+  metadata.size = size;
+  metadata.alignment = static_cast<std::uint32_t>(alignment);
+  Policy::Store(metadata.offset, allocator_.ToIndex(ptr));
+  assert(metadata.offset != ShmAllocator::InvalidIndex);
+  Policy::Store(metadata.lock_state, 0);
+  Policy::Store(metadata.next_free_index, -1);
+}
+
+template <typename Policy>
+void BasicBlobStore<Policy>::RemoveFreeSlot(size_t index) {
+  size_t previous = 0;
+  ssize_t current = metadata_[0].next_free_index.load();
+  while (current != 0) {
+    if (static_cast<size_t>(current) == index) {
+      Policy::Store(metadata_[previous].next_free_index,
+                    metadata_[index].next_free_index.load());
+      return;
+    }
+    previous = current;
+    current = metadata_[current].next_free_index.load();
+  }
+}
+
+template <typename Policy>
+size_t BasicBlobStore<Policy>::FindFreeSlot() {
   while (true) {
     BlobMetadata& free_list_head = metadata_[0];
     ssize_t free_index = free_list_head.next_free_index.load();
@@ -139,18 +328,19 @@ size_t BlobStore::FindFreeSlot() {
       return metadata_.emplace_back();
     }
     ssize_t next_free_index = metadata_[free_index].next_free_index.load();
-    if (free_list_head.next_free_index.compare_exchange_weak(free_index,
-                                                             next_free_index)) {
+    if (Policy::CompareExchange(free_list_head.next_free_index, free_index,
+                                next_free_index)) {
       // Make sure the tombstone bit is not set for the recycled metadata.
       BlobMetadata& metadata = metadata_[free_index];
-      metadata.next_free_index.store(-1);
+      Policy::Store(metadata.next_free_index, -1);
       return free_index;
     }
   }
 }
 
 // Returns the number of free slots in the metadata vector
-size_t BlobStore::GetFreeSlotCount() const {
+template <typename Policy>
+size_t BasicBlobStore<Policy>::GetFreeSlotCount() const {
   size_t count = 0;
   for (size_t i = 1; i < metadata_.size(); i++) {
     const BlobMetadata& metadata = metadata_[i];
@@ -161,10 +351,8 @@ size_t BlobStore::GetFreeSlotCount() const {
   return count;
 }
 
-bool BlobStore::AcquireReadLock(std::size_t index) {
-  if (index == BlobStore::InvalidIndex) {
-    return false;
-  }
+template <typename Policy>
+bool BasicBlobStore<Policy>::AcquireReadLockSlow(std::size_t index) {
   while (true) {
     BlobMetadata* metadata = metadata_.at(index);
     // It's possible that the blob was deleted while we were waiting for the
@@ -174,21 +362,30 @@ bool BlobStore::AcquireReadLock(std::size_t index) {
     }
     int state = metadata->lock_state.load(std::memory_order_acquire);
     if (state >= 0) {
-      if (metadata->lock_state.compare_exchange_weak(
-              state, state + 1, std::memory_order_acquire)) {
+      if (Policy::CompareExchange(metadata->lock_state, state, state + 1,
+                                  std::memory_order_acquire)) {
         break;
       }
     }
-    SpinWait();
+    Policy::SpinWait();
   }
 
   return true;
 }
 
-bool BlobStore::AcquireWriteLock(std::size_t index) {
-  if (index == BlobStore::InvalidIndex) {
+template <typename Policy>
+bool BasicBlobStore<Policy>::TryAcquireWriteLock(std::size_t index) {
+  BlobMetadata* metadata = metadata_.at(index);
+  if (metadata == nullptr || metadata->is_deleted()) {
     return false;
   }
+  std::int32_t expected = 0;
+  return Policy::CompareExchange(metadata->lock_state, expected,
+                                 WRITE_LOCK_FLAG);
+}
+
+template <typename Policy>
+bool BasicBlobStore<Policy>::AcquireWriteLockSlow(std::size_t index) {
   while (true) {
     BlobMetadata* metadata = metadata_.at(index);
     // It's possible that the blob was deleted while we were waiting for the
@@ -197,24 +394,18 @@ bool BlobStore::AcquireWriteLock(std::size_t index) {
       return false;
     }
     std::int32_t expected = 0;
-    if (metadata->lock_state.compare_exchange_weak(expected, WRITE_LOCK_FLAG,
-                                                   std::memory_order_acquire)) {
+    if (Policy::CompareExchange(metadata->lock_state, expected, WRITE_LOCK_FLAG,
+                                std::memory_order_acquire)) {
       break;
     }
-    SpinWait();
+    Policy::SpinWait();
   }
   return true;
 }
 
-void BlobStore::Unlock(std::size_t index) {
-  if (index == BlobStore::InvalidIndex) {
-    return;
-  }
+template <typename Policy>
+void BasicBlobStore<Policy>::UnlockSlow(std::size_t index) {
   BlobMetadata* metadata = metadata_.at(index);
-  if (metadata == nullptr) {
-    return;
-  }
-
   std::int32_t expected;
 
   while (true) {
@@ -222,10 +413,10 @@ void BlobStore::Unlock(std::size_t index) {
     std::int32_t new_state =
         std::max<int32_t>((expected & ~WRITE_LOCK_FLAG) - 1, 0);
 
-    if (metadata->lock_state.compare_exchange_weak(expected, new_state)) {
+    if (Policy::CompareExchange(metadata->lock_state, expected, new_state)) {
       break;
     }
-    SpinWait();
+    Policy::SpinWait();
   }
   // Check if the blob was tombstoned and is now ready to be reused.
   if (metadata->is_tombstone() && metadata->lock_state.load() == 0) {
@@ -233,8 +424,9 @@ void BlobStore::Unlock(std::size_t index) {
   }
 }
 
-void BlobStore::DowngradeWriteLock(std::size_t index) {
-  if (index == BlobStore::InvalidIndex) {
+template <typename Policy>
+void BasicBlobStore<Policy>::DowngradeWriteLock(std::size_t index) {
+  if (index == InvalidIndex) {
     return;
   }
   BlobMetadata* metadata = metadata_.at(index);
@@ -248,15 +440,16 @@ void BlobStore::DowngradeWriteLock(std::size_t index) {
 
   while (true) {
     std::int32_t expected = metadata->lock_state.load() & WRITE_LOCK_FLAG;
-    if (metadata->lock_state.compare_exchange_weak(expected, 1)) {
+    if (Policy::CompareExchange(metadata->lock_state, expected, 1)) {
       break;
     }
-    SpinWait();
+    Policy::SpinWait();
   }
 }
 
-void BlobStore::UpgradeReadLock(std::size_t index) {
-  if (index == BlobStore::InvalidIndex) {
+template <typename Policy>
+void BasicBlobStore<Policy>::UpgradeReadLock(std::size_t index) {
+  if (index == InvalidIndex) {
     return;
   }
   BlobMetadata* metadata = metadata_.at(index);
@@ -269,11 +462,15 @@ void BlobStore::UpgradeReadLock(std::size_t index) {
   }
   while (true) {
     std::int32_t expected = 1;
-    if (metadata->lock_state.compare_exchange_weak(expected, WRITE_LOCK_FLAG)) {
+    if (Policy::CompareExchange(metadata->lock_state, expected,
+                                WRITE_LOCK_FLAG)) {
       break;
     }
-    SpinWait();
+    Policy::SpinWait();
   }
 }
 
-}  // namespace blob_store
\ No newline at end of file
+template class BasicBlobStore<MultiThreaded>;
+template class BasicBlobStore<SingleThreaded>;
+
+}  // namespace blob_store
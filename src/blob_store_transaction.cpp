@@ -12,4 +12,65 @@ void PrintNode(BlobStoreObject<const HeadNode> node) {
             << ", version = " << node->version << ")" << std::endl;
 }
 
+std::size_t GetHistoryDepth(std::size_t num_versions) {
+  std::size_t depth = 1;
+  std::size_t capacity = HistoryNode::kFanout;
+  while (capacity < num_versions &&
+         depth * HistoryNode::kFanoutBits < sizeof(std::size_t) * 8) {
+    capacity <<= HistoryNode::kFanoutBits;
+    ++depth;
+  }
+  return depth;
+}
+
+BlobStoreObject<const HeadNode> FindHead(BlobStore* blob_store,
+                                         std::size_t head_index,
+                                         std::size_t version) {
+  BlobStoreObject<const HeadNode> head = blob_store->Get<HeadNode>(head_index);
+  if (head == nullptr || head->version <= version) {
+    return head;
+  }
+  std::size_t index = head->history;
+  for (std::size_t level = GetHistoryDepth(head->version);
+       level > 0 && index != BlobStore::InvalidIndex; --level) {
+    BlobStoreObject<const HistoryNode> node =
+        blob_store->Get<HistoryNode>(index);
+    index = node->children[(version >> (HistoryNode::kFanoutBits *
+                                        (level - 1))) &
+                           (HistoryNode::kFanout - 1)];
+  }
+  return blob_store->Get<HeadNode>(index);
+}
+
+void Transaction::AppendToHistory(size_t version, size_t head_index) {
+  size_t depth = GetHistoryDepth(version + 1);
+  size_t root_index = new_head_->history;
+  BlobStoreObject<HistoryNode> node;
+  if (root_index == BlobStore::InvalidIndex) {
+    node = New<HistoryNode>();
+  } else if (depth > GetHistoryDepth(version)) {
+    // The tree is full. Grow it by a level.
+    node = New<HistoryNode>();
+    node->children[0] = root_index;
+  } else {
+    node = GetMutable<HistoryNode>(blob_store_->Get<HistoryNode>(root_index));
+  }
+  new_head_->history = node.Index();
+
+  for (size_t level = depth - 1; level > 0; --level) {
+    size_t slot = (version >> (HistoryNode::kFanoutBits * level)) &
+                  (HistoryNode::kFanout - 1);
+    BlobStoreObject<HistoryNode> child;
+    if (node->children[slot] == BlobStore::InvalidIndex) {
+      child = New<HistoryNode>();
+    } else {
+      child = GetMutable<HistoryNode>(
+          blob_store_->Get<HistoryNode>(node->children[slot]));
+    }
+    node->children[slot] = child.Index();
+    node = std::move(child);
+  }
+  node->children[version & (HistoryNode::kFanout - 1)] = head_index;
+}
+
 }  // namespace blob_store
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "change_feed.h"
+
+#include "blob_store_transaction.h"
+
+namespace blob_store {
+
+ChangeFeed::ChangeFeed(BlobStore* blob_store, std::size_t head_index)
+    : blob_store_(blob_store), head_index_(head_index), cursor_(0) {
+  BlobStoreObject<const HeadNode> head = blob_store->Get<HeadNode>(head_index);
+  if (head == nullptr) {
+    return;
+  }
+  ring_ = blob_store->Get<ChangeFeedRing>(head->change_feed);
+  cursor_ = head->version + 1;
+}
+
+ChangeFeed::Status ChangeFeed::Next(ChangeRecord* record) {
+  if (ring_ == nullptr) {
+    return Status::kPending;
+  }
+  const ChangeFeedRing::Slot& slot =
+      ring_->slots[cursor_ % ChangeFeedRing::kCapacity];
+  std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+  if (sequence > cursor_) {
+    return Status::kOverrun;
+  }
+  if (sequence != cursor_) {
+    return NextFromHistory(record);
+  }
+  record->version = cursor_;
+  record->root_index = slot.root_index.load(std::memory_order_relaxed);
+  record->new_objects = slot.new_objects.load(std::memory_order_relaxed);
+  record->mutated_objects =
+      slot.mutated_objects.load(std::memory_order_relaxed);
+  record->discarded_objects =
+      slot.discarded_objects.load(std::memory_order_relaxed);
+  // If the slot was rewritten while we were reading it, the record is torn.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.sequence.load(std::memory_order_relaxed) != cursor_) {
+    return Status::kOverrun;
+  }
+  ++cursor_;
+  return Status::kOk;
+}
+
+ChangeFeed::Status ChangeFeed::NextFromHistory(ChangeRecord* record) {
+  BlobStoreObject<const HeadNode> head =
+      FindHead(blob_store_, head_index_, cursor_);
+  if (head == nullptr || head->version != cursor_) {
+    return Status::kPending;
+  }
+  *record = {cursor_, head->root_index, head->new_objects,
+             head->mutated_objects, head->discarded_objects};
+  ++cursor_;
+  return Status::kOk;
+}
+
+// static
+void ChangeFeed::Publish(BlobStore* blob_store,
+                         std::size_t ring_index,
+                         const ChangeRecord& record) {
+  BlobStoreObject<const ChangeFeedRing> ring =
+      blob_store->Get<ChangeFeedRing>(ring_index);
+  if (ring == nullptr) {
+    return;
+  }
+  const ChangeFeedRing::Slot& slot =
+      ring->slots[record.version % ChangeFeedRing::kCapacity];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.root_index.store(record.root_index, std::memory_order_relaxed);
+  slot.new_objects.store(record.new_objects, std::memory_order_relaxed);
+  slot.mutated_objects.store(record.mutated_objects,
+                             std::memory_order_relaxed);
+  slot.discarded_objects.store(record.discarded_objects,
+                               std::memory_order_relaxed);
+  slot.sequence.store(record.version, std::memory_order_release);
+}
+
+}  // namespace blob_store
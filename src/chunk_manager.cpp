@@ -1,4 +1,7 @@
 #include "chunk_manager.h"
+
+#include <algorithm>
+
 #include "buffer_factory.h"
 
 static std::size_t next_power_of_two(std::size_t v) {
@@ -23,6 +26,10 @@ ChunkManager::ChunkManager(BufferFactory* buffer_factory,
       name_prefix_ + "_0", chunk_size_ + sizeof(std::uint64_t)));
   num_chunks_encoded_ =
       reinterpret_cast<std::atomic<std::uint64_t>*>(chunks_[0]->GetData());
+  {
+    std::unique_lock<std::shared_mutex> lock(chunks_rw_mutex_);
+    update_chunk_table();
+  }
   load_chunks_if_necessary();
 }
 
@@ -31,14 +38,20 @@ ChunkManager::ChunkManager(ChunkManager&& other)
       chunk_size_(other.chunk_size_),
       chunks_(std::move(other.chunks_)),
       num_chunks_encoded_(other.num_chunks_encoded_),
-      buffer_factory_(other.buffer_factory_) {}
+      buffer_factory_(other.buffer_factory_) {
+  update_chunk_table();
+  other.update_chunk_table();
+}
 
 ChunkManager& ChunkManager::operator=(ChunkManager&& other) {
+  std::unique_lock<std::shared_mutex> lock(chunks_rw_mutex_);
   name_prefix_ = std::move(other.name_prefix_);
   chunk_size_ = std::move(other.chunk_size_);
   chunks_ = std::move(other.chunks_);
   num_chunks_encoded_ = other.num_chunks_encoded_;
   buffer_factory_ = other.buffer_factory_;
+  update_chunk_table();
+  other.update_chunk_table();
   return *this;
 }
 
@@ -99,6 +112,7 @@ void ChunkManager::remove_chunk() {
       while (chunks_.size() >= num_chunks) {
         chunks_.pop_back();
       }
+      update_chunk_table();
       break;
     }
   }
@@ -126,16 +140,31 @@ const uint8_t* ChunkManager::at(std::size_t chunk_index,
 
 uint8_t* ChunkManager::at(std::size_t chunk_index,
                           std::size_t offset_in_chunk) {
-  std::shared_lock<std::shared_mutex> lock(chunks_rw_mutex_);
-  if (chunk_index == 0) {
-    offset_in_chunk += sizeof(std::uint64_t);
+  if (chunk_index >= num_mapped_chunks_.load(std::memory_order_acquire)) {
+    return nullptr;
   }
-  if (chunk_index >= chunks_.size() ||
-      offset_in_chunk >= chunks_[chunk_index]->GetSize()) {
+  const MappedChunk& chunk = chunk_table_[chunk_index];
+  if (offset_in_chunk >= chunk.size.load(std::memory_order_relaxed)) {
     return nullptr;
   }
-  return reinterpret_cast<uint8_t*>(chunks_[chunk_index]->GetData()) +
-         offset_in_chunk;
+  return chunk.data.load(std::memory_order_relaxed) + offset_in_chunk;
+}
+
+bool ChunkManager::index_of(const uint8_t* ptr, std::uint64_t* index) const {
+  // Each chunk is twice the size of the one before it, so the last chunk
+  // usually holds ptr.
+  for (std::size_t chunk_index =
+           num_mapped_chunks_.load(std::memory_order_acquire);
+       chunk_index-- > 0;) {
+    const MappedChunk& chunk = chunk_table_[chunk_index];
+    const uint8_t* data = chunk.data.load(std::memory_order_relaxed);
+    std::size_t size = chunk.size.load(std::memory_order_relaxed);
+    if (ptr >= data && ptr < data + size) {
+      *index = (static_cast<std::uint64_t>(chunk_index) << 56) | (ptr - data);
+      return true;
+    }
+  }
+  return false;
 }
 
 std::size_t ChunkManager::capacity() const {
@@ -186,9 +215,35 @@ std::size_t ChunkManager::load_chunks_if_necessary() {
         chunk_size_ << chunks_.size()));
     ++num_chunks_loaded;
   }
+  if (num_chunks_loaded > 0) {
+    update_chunk_table();
+  }
   return num_chunks_loaded;
 }
 
+void ChunkManager::update_chunk_table() {
+  std::size_t num_mapped = std::min(chunks_.size(), kMaxChunks);
+  // Readers stop looking at removed chunks before their entries are cleared.
+  if (num_mapped < num_mapped_chunks_.load()) {
+    num_mapped_chunks_.store(num_mapped, std::memory_order_release);
+  }
+  for (std::size_t chunk_index = 0; chunk_index < kMaxChunks; ++chunk_index) {
+    uint8_t* data = nullptr;
+    std::size_t size = 0;
+    if (chunk_index < num_mapped) {
+      data = reinterpret_cast<uint8_t*>(chunks_[chunk_index]->GetData());
+      size = chunks_[chunk_index]->GetSize();
+      if (chunk_index == 0) {
+        data += sizeof(std::uint64_t);
+        size -= sizeof(std::uint64_t);
+      }
+    }
+    chunk_table_[chunk_index].data.store(data, std::memory_order_relaxed);
+    chunk_table_[chunk_index].size.store(size, std::memory_order_relaxed);
+  }
+  num_mapped_chunks_.store(num_mapped, std::memory_order_release);
+}
+
 std::uint64_t ChunkManager::decode_num_chunks(uint64_t num_chunks_encoded) {
   // The first 32-bits of num_chunks_encoded are the number of increments.
   // The next 32-bits of num_chunks_encoded are the number of decrements.
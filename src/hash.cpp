@@ -0,0 +1,121 @@
+#include "hash.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace hashing {
+
+namespace {
+
+constexpr std::uint64_t kSecret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull,
+    0x4d5a2da51de1aa47ull};
+
+// Multiplies a and b and stores the low 64 bits of the product in a and the
+// high 64 bits in b.
+inline void Multiply(std::uint64_t* a, std::uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t product = static_cast<__uint128_t>(*a) * *b;
+  *a = static_cast<std::uint64_t>(product);
+  *b = static_cast<std::uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  *a = _umul128(*a, *b, b);
+#else
+  std::uint64_t a_hi = *a >> 32, a_lo = static_cast<std::uint32_t>(*a);
+  std::uint64_t b_hi = *b >> 32, b_lo = static_cast<std::uint32_t>(*b);
+  std::uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo;
+  std::uint64_t lh = a_lo * b_hi, ll = a_lo * b_lo;
+  std::uint64_t t = ll + (hl << 32);
+  std::uint64_t carry = t < ll;
+  std::uint64_t lo = t + (lh << 32);
+  carry += lo < t;
+  *a = lo;
+  *b = hh + (hl >> 32) + (lh >> 32) + carry;
+#endif
+}
+
+inline std::uint64_t Mix(std::uint64_t a, std::uint64_t b) {
+  Multiply(&a, &b);
+  return a ^ b;
+}
+
+// Reads are little-endian regardless of the host so that the hash of a given
+// byte sequence is the same everywhere.
+inline std::uint64_t Read64(const std::uint8_t* p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  return value;
+}
+
+inline std::uint64_t Read32(const std::uint8_t* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap32(value);
+#endif
+  return value;
+}
+
+// Reads 1 to 3 bytes.
+inline std::uint64_t Read3(const std::uint8_t* p, std::size_t size) {
+  return (static_cast<std::uint64_t>(p[0]) << 16) |
+         (static_cast<std::uint64_t>(p[size >> 1]) << 8) | p[size - 1];
+}
+
+}  // namespace
+
+std::uint64_t HashBytes(const void* data,
+                        std::size_t size,
+                        std::uint64_t seed) {
+  const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+  seed ^= Mix(seed ^ kSecret[0], kSecret[1]);
+  std::uint64_t a;
+  std::uint64_t b;
+  if (size <= 16) {
+    if (size >= 4) {
+      // Two overlapping reads cover every byte of 4 to 16 byte inputs.
+      std::size_t shift = (size >> 3) << 2;
+      a = (Read32(p) << 32) | Read32(p + shift);
+      b = (Read32(p + size - 4) << 32) | Read32(p + size - 4 - shift);
+    } else if (size > 0) {
+      a = Read3(p, size);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    std::size_t remaining = size;
+    if (remaining > 48) {
+      std::uint64_t lane1 = seed;
+      std::uint64_t lane2 = seed;
+      do {
+        seed = Mix(Read64(p) ^ kSecret[1], Read64(p + 8) ^ seed);
+        lane1 = Mix(Read64(p + 16) ^ kSecret[2], Read64(p + 24) ^ lane1);
+        lane2 = Mix(Read64(p + 32) ^ kSecret[3], Read64(p + 40) ^ lane2);
+        p += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    while (remaining > 16) {
+      seed = Mix(Read64(p) ^ kSecret[1], Read64(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+    // The last 16 bytes of the input, which may overlap bytes already mixed.
+    a = Read64(p + remaining - 16);
+    b = Read64(p + remaining - 8);
+  }
+  a ^= kSecret[1];
+  b ^= seed;
+  Multiply(&a, &b);
+  return Mix(a ^ kSecret[0] ^ size, b ^ kSecret[1]);
+}
+
+}  // namespace hashing
@@ -0,0 +1,116 @@
+#include "key_encoding.h"
+
+namespace key_encoding {
+
+namespace {
+
+// Maps the bits of a floating point number to bits that order like the
+// number when compared as unsigned integers.
+std::uint64_t OrderFloatBits(std::uint64_t bits, std::size_t size) {
+  std::uint64_t sign = std::uint64_t(1) << (size * 8 - 1);
+  std::uint64_t all = size == 8 ? ~std::uint64_t(0) : (sign << 1) - 1;
+  return (bits & sign) ? (~bits & all) : (bits | sign);
+}
+
+// Reverses OrderFloatBits.
+std::uint64_t UnorderFloatBits(std::uint64_t bits, std::size_t size) {
+  std::uint64_t sign = std::uint64_t(1) << (size * 8 - 1);
+  std::uint64_t all = size == 8 ? ~std::uint64_t(0) : (sign << 1) - 1;
+  return (bits & sign) ? (bits & ~sign) : (~bits & all);
+}
+
+}  // namespace
+
+OrderedKey& OrderedKey::Append(float value) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  AppendBigEndian(OrderFloatBits(bits, sizeof(bits)), sizeof(bits));
+  return *this;
+}
+
+OrderedKey& OrderedKey::Append(double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  AppendBigEndian(OrderFloatBits(bits, sizeof(bits)), sizeof(bits));
+  return *this;
+}
+
+OrderedKey& OrderedKey::Append(const StringSlice& value) {
+  const char* data = value.data();
+  const char* end = data + value.size();
+  while (data < end) {
+    const char* zero =
+        static_cast<const char*>(std::memchr(data, 0, end - data));
+    if (zero == nullptr) {
+      bytes_.append(data, end - data);
+      break;
+    }
+    bytes_.append(data, zero - data);
+    bytes_.push_back('\x00');
+    bytes_.push_back('\xFF');
+    data = zero + 1;
+  }
+  bytes_.push_back('\x00');
+  bytes_.push_back('\x01');
+  return *this;
+}
+
+bool KeyReader::Read(float* value) {
+  std::uint64_t bits;
+  if (!ReadBigEndian(sizeof(float), &bits)) {
+    return false;
+  }
+  std::uint32_t float_bits =
+      static_cast<std::uint32_t>(UnorderFloatBits(bits, sizeof(float)));
+  std::memcpy(value, &float_bits, sizeof(float_bits));
+  return true;
+}
+
+bool KeyReader::Read(double* value) {
+  std::uint64_t bits;
+  if (!ReadBigEndian(sizeof(double), &bits)) {
+    return false;
+  }
+  bits = UnorderFloatBits(bits, sizeof(double));
+  std::memcpy(value, &bits, sizeof(bits));
+  return true;
+}
+
+bool KeyReader::Read(std::string* value) {
+  std::string field;
+  for (std::size_t i = position_; i < size_; ++i) {
+    if (data_[i] != 0) {
+      field.push_back(static_cast<char>(data_[i]));
+      continue;
+    }
+    if (i + 1 == size_) {
+      return false;
+    }
+    if (data_[i + 1] == 0x01) {
+      position_ = i + 2;
+      *value = std::move(field);
+      return true;
+    }
+    if (data_[i + 1] != 0xFF) {
+      return false;
+    }
+    field.push_back('\x00');
+    ++i;
+  }
+  return false;
+}
+
+bool KeyReader::ReadBigEndian(std::size_t size, std::uint64_t* bits) {
+  if (size_ - position_ < size) {
+    return false;
+  }
+  std::uint64_t result = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    result = (result << 8) | data_[position_ + i];
+  }
+  position_ += size;
+  *bits = result;
+  return true;
+}
+
+}  // namespace key_encoding
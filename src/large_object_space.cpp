@@ -0,0 +1,118 @@
+#include "large_object_space.h"
+
+#include "utils.h"
+
+LargeObjectSpace::LargeObjectSpace(BufferFactory* buffer_factory,
+                                   const std::string& name_prefix)
+    : buffer_factory_(buffer_factory), name_prefix_(name_prefix) {}
+
+LargeObjectSpace::LargeObjectSpace(LargeObjectSpace&& other)
+    : buffer_factory_(other.buffer_factory_),
+      name_prefix_(std::move(other.name_prefix_)),
+      table_buffer_(std::move(other.table_buffer_)),
+      mappings_(std::move(other.mappings_)),
+      entries_(other.entries_.exchange(nullptr)) {}
+
+LargeObjectSpace& LargeObjectSpace::operator=(LargeObjectSpace&& other) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffer_factory_ = other.buffer_factory_;
+  name_prefix_ = std::move(other.name_prefix_);
+  table_buffer_ = std::move(other.table_buffer_);
+  mappings_ = std::move(other.mappings_);
+  entries_.store(other.entries_.exchange(nullptr));
+  return *this;
+}
+
+std::size_t LargeObjectSpace::Allocate(std::size_t size, uint8_t** data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  SlotEntry* entries = table();
+  for (std::size_t slot = 0; slot < kMaxObjects; ++slot) {
+    std::uint32_t expected_state = SlotEntry::kFree;
+    if (!entries[slot].state.compare_exchange_strong(expected_state,
+                                                     SlotEntry::kReserved)) {
+      continue;
+    }
+    std::uint32_t generation = entries[slot].generation.fetch_add(1) + 1;
+    std::size_t buffer_size = utils::RoundUpToPageSize(size);
+    entries[slot].size.store(buffer_size);
+    *data = Map(slot, generation, buffer_size);
+    entries[slot].state.store(SlotEntry::kInUse);
+    return slot;
+  }
+  return InvalidSlot;
+}
+
+void LargeObjectSpace::Free(std::size_t slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  SlotEntry* entries = table();
+  Unmap(slot);
+  // Processes that still map the buffer keep it alive until they unmap it.
+  buffer_factory_->RemoveBuffer(
+      BufferName(slot, entries[slot].generation.load()));
+  entries[slot].state.store(SlotEntry::kFree);
+}
+
+uint8_t* LargeObjectSpace::at(std::size_t slot) const {
+  SlotEntry* entries = entries_.load(std::memory_order_acquire);
+  if (entries != nullptr && slot < kMaxObjects) {
+    // Fast path: the slot's current generation is already mapped.
+    if (entries[slot].state.load() != SlotEntry::kInUse) {
+      return nullptr;
+    }
+    std::uint32_t generation = entries[slot].generation.load();
+    const Mapping& mapping = mappings_[slot];
+    if (mapping.generation.load(std::memory_order_acquire) == generation) {
+      return mapping.data.load(std::memory_order_relaxed);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries = table();
+  if (slot >= kMaxObjects || entries[slot].state.load() != SlotEntry::kInUse) {
+    return nullptr;
+  }
+  std::uint32_t generation = entries[slot].generation.load();
+  if (mappings_[slot].generation.load() == generation) {
+    return mappings_[slot].data.load();
+  }
+  // Another process reused the slot since we last looked at it.
+  return Map(slot, generation, entries[slot].size.load());
+}
+
+LargeObjectSpace::SlotEntry* LargeObjectSpace::table() const {
+  if (table_buffer_ == nullptr) {
+    table_buffer_ = buffer_factory_->CreateBuffer(
+        name_prefix_ + "_large_objects", kMaxObjects * sizeof(SlotEntry));
+    mappings_.reset(new Mapping[kMaxObjects]);
+    entries_.store(reinterpret_cast<SlotEntry*>(table_buffer_->GetData()),
+                   std::memory_order_release);
+  }
+  return entries_.load();
+}
+
+uint8_t* LargeObjectSpace::Map(std::size_t slot,
+                               std::uint32_t generation,
+                               std::size_t size) const {
+  Unmap(slot);
+  Mapping& mapping = mappings_[slot];
+  mapping.buffer =
+      buffer_factory_->CreateBuffer(BufferName(slot, generation), size);
+  uint8_t* data = reinterpret_cast<uint8_t*>(mapping.buffer->GetData());
+  mapping.data.store(data, std::memory_order_relaxed);
+  mapping.generation.store(generation, std::memory_order_release);
+  return data;
+}
+
+void LargeObjectSpace::Unmap(std::size_t slot) const {
+  Mapping& mapping = mappings_[slot];
+  // Generations start at 1, so readers stop using the mapping first.
+  mapping.generation.store(0, std::memory_order_release);
+  mapping.data.store(nullptr, std::memory_order_relaxed);
+  mapping.buffer.reset();
+}
+
+std::string LargeObjectSpace::BufferName(std::size_t slot,
+                                         std::uint32_t generation) const {
+  return name_prefix_ + "_large_" + std::to_string(slot) + "_" +
+         std::to_string(generation);
+}
@@ -0,0 +1,107 @@
+#include "packed_ints.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace packed_ints {
+
+std::uint32_t BitWidth(std::uint64_t max_delta) {
+  std::uint32_t bit_width = 0;
+  while (max_delta != 0) {
+    ++bit_width;
+    max_delta >>= 1;
+  }
+  return bit_width;
+}
+
+std::size_t BlockSize(std::size_t count, std::uint32_t bit_width) {
+  std::size_t words = (count * bit_width + 63) / 64;
+  // Blocks with any packed bits end with a padding word.
+  return sizeof(BlockHeader) +
+         (words == 0 ? 0 : (words + 1) * sizeof(std::uint64_t));
+}
+
+std::size_t PackedSize(const std::uint64_t* values, std::size_t count) {
+  if (count == 0) {
+    return BlockSize(0, 0);
+  }
+  auto minmax = std::minmax_element(values, values + count);
+  return BlockSize(count, BitWidth(*minmax.second - *minmax.first));
+}
+
+std::size_t Pack(const std::uint64_t* values,
+                 std::size_t count,
+                 std::uint8_t* out) {
+  BlockHeader* header = reinterpret_cast<BlockHeader*>(out);
+  std::uint64_t base = 0;
+  std::uint32_t bit_width = 0;
+  if (count > 0) {
+    auto minmax = std::minmax_element(values, values + count);
+    base = *minmax.first;
+    bit_width = BitWidth(*minmax.second - base);
+  }
+  header->base = base;
+  header->count = static_cast<std::uint32_t>(count);
+  header->bit_width = bit_width;
+
+  std::size_t size = BlockSize(count, bit_width);
+  std::uint64_t* words =
+      reinterpret_cast<std::uint64_t*>(out + sizeof(BlockHeader));
+  std::memset(words, 0, size - sizeof(BlockHeader));
+  if (bit_width == 0) {
+    return size;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    std::uint64_t delta = values[i] - base;
+    std::size_t bit = i * bit_width;
+    std::size_t word = bit / 64;
+    std::size_t shift = bit % 64;
+    words[word] |= delta << shift;
+    if (shift + bit_width > 64) {
+      words[word + 1] |= delta >> (64 - shift);
+    }
+  }
+  return size;
+}
+
+std::size_t PackedView::LowerBound(std::uint64_t value) const {
+  std::size_t low = 0;
+  std::size_t high = size();
+  if (value <= header_->base) {
+    return 0;
+  }
+  while (low < high) {
+    std::size_t middle = low + (high - low) / 2;
+    if ((*this)[middle] < value) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+void PackedView::Decode(std::uint64_t* out) const {
+  std::size_t count = size();
+  std::uint32_t bit_width = header_->bit_width;
+  std::uint64_t base = header_->base;
+  if (bit_width == 0) {
+    std::fill(out, out + count, base);
+    return;
+  }
+  std::uint64_t mask =
+      bit_width == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << bit_width) - 1;
+  // Every value is assembled from two neighbouring words without branching.
+  // The second word is shifted in two steps so that a shift of 0 doesn't
+  // turn into an undefined shift by 64.
+  std::size_t bit = 0;
+  for (std::size_t i = 0; i < count; ++i, bit += bit_width) {
+    std::size_t word = bit / 64;
+    std::size_t shift = bit % 64;
+    std::uint64_t delta = (words_[word] >> shift) |
+                          ((words_[word + 1] << 1) << (63 - shift));
+    out[i] = base + (delta & mask);
+  }
+}
+
+}  // namespace packed_ints
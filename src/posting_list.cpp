@@ -0,0 +1,378 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "packed_ints.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POSTING_LIST_HAS_SSE2
+#endif
+
+namespace posting_list {
+
+namespace {
+
+// Appends the values of the sorted sets a and b that both hold to out.
+void IntersectSorted(const std::vector<std::uint64_t>& a,
+                     const std::vector<std::uint64_t>& b,
+                     std::vector<std::uint64_t>* out) {
+  std::size_t i = 0;
+  std::size_t j = 0;
+#ifdef POSTING_LIST_HAS_SSE2
+  // Compares two values of a against two values of b at a time: once as
+  // loaded and once with b's values swapped. SSE2 has no 64-bit compare, so
+  // a 64-bit lane is equal if both of its 32-bit halves are.
+  while (i + 2 <= a.size() && j + 2 <= b.size()) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&a[i]));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&b[j]));
+    __m128i vb_swapped = _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128i eq_straight = _mm_cmpeq_epi32(va, vb);
+    __m128i eq_swapped = _mm_cmpeq_epi32(va, vb_swapped);
+    eq_straight = _mm_and_si128(
+        eq_straight, _mm_shuffle_epi32(eq_straight, _MM_SHUFFLE(2, 3, 0, 1)));
+    eq_swapped = _mm_and_si128(
+        eq_swapped, _mm_shuffle_epi32(eq_swapped, _MM_SHUFFLE(2, 3, 0, 1)));
+    __m128i eq = _mm_or_si128(eq_straight, eq_swapped);
+    int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+    if (mask & 1) {
+      out->push_back(a[i]);
+    }
+    if (mask & 2) {
+      out->push_back(a[i + 1]);
+    }
+    // The block with the smaller maximum can't match any later value of the
+    // other set.
+    std::uint64_t a_max = a[i + 1];
+    std::uint64_t b_max = b[j + 1];
+    if (a_max <= b_max) {
+      i += 2;
+    }
+    if (b_max <= a_max) {
+      j += 2;
+    }
+  }
+#endif
+  while (i < a.size() && j < b.size()) {
+    if (a[i] < b[j]) {
+      ++i;
+    } else if (b[j] < a[i]) {
+      ++j;
+    } else {
+      out->push_back(a[i]);
+      ++i;
+      ++j;
+    }
+  }
+}
+
+// Returns the chunk directory of root.
+std::vector<ChunkRef> LoadChunks(BlobStore* blob_store,
+                                 const PostingListRoot& root) {
+  std::vector<ChunkRef> chunks;
+  if (root.chunks == BlobStore::InvalidIndex) {
+    return chunks;
+  }
+  BlobStoreObject<const ChunkRef[]> directory =
+      blob_store->Get<ChunkRef[]>(root.chunks);
+  chunks.assign(&directory[0], &directory[0] + root.num_chunks);
+  return chunks;
+}
+
+// Appends the values of the chunk described by ref to out.
+void Decode(BlobStore* blob_store,
+            const ChunkRef& ref,
+            std::vector<std::uint64_t>* out) {
+  BlobStoreObject<const std::uint64_t[]> chunk =
+      blob_store->Get<std::uint64_t[]>(ref.chunk);
+  packed_ints::PackedView view(
+      reinterpret_cast<const std::uint8_t*>(&chunk[0]));
+  std::size_t offset = out->size();
+  out->resize(offset + view.size());
+  view.Decode(out->data() + offset);
+}
+
+// Packs count sorted values into a new chunk.
+ChunkRef NewChunk(blob_store::Transaction* transaction,
+                  const std::uint64_t* values,
+                  std::size_t count) {
+  std::size_t bytes = packed_ints::PackedSize(values, count);
+  BlobStoreObject<std::uint64_t[]> chunk =
+      transaction->New<std::uint64_t[]>((bytes + 7) / 8);
+  packed_ints::Pack(values, count, reinterpret_cast<std::uint8_t*>(&chunk[0]));
+  ChunkRef ref;
+  ref.first = values[0];
+  ref.last = values[count - 1];
+  ref.count = count;
+  ref.chunk = chunk.Index();
+  return ref;
+}
+
+// Replaces the chunk at position with the provided sorted values, which may
+// be empty, splitting them in two if they don't fit in a chunk.
+void ReplaceChunk(blob_store::Transaction* transaction,
+                  std::vector<ChunkRef>* chunks,
+                  std::size_t position,
+                  const std::vector<std::uint64_t>& values) {
+  BlobStore* blob_store = transaction->blob_store();
+  transaction->Drop(
+      blob_store->Get<std::uint64_t[]>((*chunks)[position].chunk));
+  chunks->erase(chunks->begin() + position);
+  if (values.empty()) {
+    return;
+  }
+  if (values.size() <= kMaxChunkSize) {
+    chunks->insert(chunks->begin() + position,
+                   NewChunk(transaction, values.data(), values.size()));
+    return;
+  }
+  std::size_t half = values.size() / 2;
+  chunks->insert(chunks->begin() + position,
+                 {NewChunk(transaction, values.data(), half),
+                  NewChunk(transaction, values.data() + half,
+                           values.size() - half)});
+}
+
+// Points the list's root at a new directory holding chunks. Returns the index
+// of the root, which is cloned unless the transaction created it.
+std::size_t StoreChunks(blob_store::Transaction* transaction,
+                        std::size_t root_index,
+                        const std::vector<ChunkRef>& chunks,
+                        std::size_t size) {
+  BlobStore* blob_store = transaction->blob_store();
+  BlobStoreObject<PostingListRoot> root =
+      transaction->GetMutable<PostingListRoot>(
+          blob_store->Get<PostingListRoot>(root_index));
+  if (root->chunks != BlobStore::InvalidIndex) {
+    transaction->Drop(blob_store->Get<ChunkRef[]>(root->chunks));
+  }
+  root->chunks = BlobStore::InvalidIndex;
+  if (!chunks.empty()) {
+    BlobStoreObject<ChunkRef[]> directory =
+        transaction->New<ChunkRef[]>(chunks.size());
+    std::copy(chunks.begin(), chunks.end(), &directory[0]);
+    root->chunks = directory.Index();
+  }
+  root->num_chunks = chunks.size();
+  root->size = size;
+  return root.Index();
+}
+
+// Returns the position of the chunk that holds or would hold value: the first
+// chunk whose last value isn't less than value, or chunks.size().
+std::size_t FindChunk(const ChunkRef* chunks,
+                      std::size_t num_chunks,
+                      std::uint64_t value) {
+  return std::lower_bound(chunks, chunks + num_chunks, value,
+                          [](const ChunkRef& chunk, std::uint64_t value) {
+                            return chunk.last < value;
+                          }) -
+         chunks;
+}
+
+}  // namespace
+
+// static
+std::size_t PostingList::Create(blob_store::Transaction* transaction) {
+  return transaction->New<PostingListRoot>().Index();
+}
+
+// static
+std::size_t PostingList::Add(blob_store::Transaction* transaction,
+                             std::size_t root_index,
+                             std::uint64_t value) {
+  BlobStore* blob_store = transaction->blob_store();
+  std::vector<ChunkRef> chunks;
+  std::size_t size;
+  {
+    BlobStoreObject<const PostingListRoot> root =
+        blob_store->Get<PostingListRoot>(root_index);
+    chunks = LoadChunks(blob_store, *root);
+    size = root->size;
+  }
+  if (chunks.empty()) {
+    chunks.push_back(NewChunk(transaction, &value, 1));
+    return StoreChunks(transaction, root_index, chunks, size + 1);
+  }
+
+  // Values past the last chunk go to the last chunk.
+  std::size_t position =
+      std::min(FindChunk(chunks.data(), chunks.size(), value),
+               chunks.size() - 1);
+  std::vector<std::uint64_t> values;
+  Decode(blob_store, chunks[position], &values);
+  auto it = std::lower_bound(values.begin(), values.end(), value);
+  if (it != values.end() && *it == value) {
+    return root_index;
+  }
+  values.insert(it, value);
+  ReplaceChunk(transaction, &chunks, position, values);
+  return StoreChunks(transaction, root_index, chunks, size + 1);
+}
+
+// static
+std::size_t PostingList::Append(blob_store::Transaction* transaction,
+                                std::size_t root_index,
+                                const std::vector<std::uint64_t>& values) {
+  if (values.empty()) {
+    return root_index;
+  }
+  BlobStore* blob_store = transaction->blob_store();
+  std::vector<ChunkRef> chunks;
+  std::size_t size;
+  {
+    BlobStoreObject<const PostingListRoot> root =
+        blob_store->Get<PostingListRoot>(root_index);
+    chunks = LoadChunks(blob_store, *root);
+    size = root->size;
+  }
+  assert(chunks.empty() || chunks.back().last < values.front());
+
+  std::size_t next = 0;
+  if (!chunks.empty() && chunks.back().count < kMaxChunkSize) {
+    std::vector<std::uint64_t> last;
+    Decode(blob_store, chunks.back(), &last);
+    std::size_t room = std::min(kMaxChunkSize - last.size(), values.size());
+    last.insert(last.end(), values.begin(), values.begin() + room);
+    next = room;
+    ReplaceChunk(transaction, &chunks, chunks.size() - 1, last);
+  }
+  while (next < values.size()) {
+    std::size_t count = std::min(kMaxChunkSize, values.size() - next);
+    chunks.push_back(NewChunk(transaction, values.data() + next, count));
+    next += count;
+  }
+  return StoreChunks(transaction, root_index, chunks, size + values.size());
+}
+
+// static
+std::size_t PostingList::Remove(blob_store::Transaction* transaction,
+                                std::size_t root_index,
+                                std::uint64_t value) {
+  BlobStore* blob_store = transaction->blob_store();
+  std::vector<ChunkRef> chunks;
+  std::size_t size;
+  {
+    BlobStoreObject<const PostingListRoot> root =
+        blob_store->Get<PostingListRoot>(root_index);
+    chunks = LoadChunks(blob_store, *root);
+    size = root->size;
+  }
+  std::size_t position = FindChunk(chunks.data(), chunks.size(), value);
+  if (position == chunks.size() || chunks[position].first > value) {
+    return root_index;
+  }
+  std::vector<std::uint64_t> values;
+  Decode(blob_store, chunks[position], &values);
+  auto it = std::lower_bound(values.begin(), values.end(), value);
+  if (it == values.end() || *it != value) {
+    return root_index;
+  }
+  values.erase(it);
+  ReplaceChunk(transaction, &chunks, position, values);
+  return StoreChunks(transaction, root_index, chunks, size - 1);
+}
+
+PostingList::PostingList(BlobStore* blob_store, std::size_t root_index)
+    : blob_store_(blob_store),
+      root_(blob_store->Get<PostingListRoot>(root_index)) {
+  if (root_ != nullptr && root_->chunks != BlobStore::InvalidIndex) {
+    chunks_ = blob_store->Get<ChunkRef[]>(root_->chunks);
+  }
+}
+
+bool PostingList::Contains(std::uint64_t value) const {
+  if (chunks_ == nullptr) {
+    return false;
+  }
+  std::size_t position = FindChunk(&chunks_[0], root_->num_chunks, value);
+  if (position == root_->num_chunks || chunks_[position].first > value) {
+    return false;
+  }
+  // The chunk is searched without decoding it.
+  BlobStoreObject<const std::uint64_t[]> chunk =
+      blob_store_->Get<std::uint64_t[]>(chunks_[position].chunk);
+  return packed_ints::PackedView(
+             reinterpret_cast<const std::uint8_t*>(&chunk[0]))
+      .Contains(value);
+}
+
+std::vector<std::uint64_t> PostingList::ToVector() const {
+  std::vector<std::uint64_t> values;
+  values.reserve(size());
+  for (std::size_t i = 0; chunks_ != nullptr && i < root_->num_chunks; ++i) {
+    DecodeChunk(chunks_[i], &values);
+  }
+  return values;
+}
+
+// static
+std::vector<std::uint64_t> PostingList::Intersect(const PostingList& a,
+                                                  const PostingList& b) {
+  std::vector<std::uint64_t> result;
+  if (a.chunks_ == nullptr || b.chunks_ == nullptr) {
+    return result;
+  }
+  // Sweeps both directories in value order. Each value lives in exactly one
+  // chunk per list, so intersecting every pair of overlapping chunks finds
+  // every common value once, in ascending order.
+  std::vector<std::uint64_t> values_a;
+  std::vector<std::uint64_t> values_b;
+  std::size_t decoded_a = a.root_->num_chunks;
+  std::size_t decoded_b = b.root_->num_chunks;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < a.root_->num_chunks && j < b.root_->num_chunks) {
+    const ChunkRef& chunk_a = a.chunks_[i];
+    const ChunkRef& chunk_b = b.chunks_[j];
+    if (chunk_a.last < chunk_b.first) {
+      ++i;
+      continue;
+    }
+    if (chunk_b.last < chunk_a.first) {
+      ++j;
+      continue;
+    }
+    if (decoded_a != i) {
+      values_a.clear();
+      a.DecodeChunk(chunk_a, &values_a);
+      decoded_a = i;
+    }
+    if (decoded_b != j) {
+      values_b.clear();
+      b.DecodeChunk(chunk_b, &values_b);
+      decoded_b = j;
+    }
+    IntersectSorted(values_a, values_b, &result);
+    std::uint64_t last_a = chunk_a.last;
+    std::uint64_t last_b = chunk_b.last;
+    if (last_a <= last_b) {
+      ++i;
+    }
+    if (last_b <= last_a) {
+      ++j;
+    }
+  }
+  return result;
+}
+
+// static
+std::vector<std::uint64_t> PostingList::Union(const PostingList& a,
+                                              const PostingList& b) {
+  std::vector<std::uint64_t> values_a = a.ToVector();
+  std::vector<std::uint64_t> values_b = b.ToVector();
+  std::vector<std::uint64_t> result;
+  result.reserve(values_a.size() + values_b.size());
+  std::set_union(values_a.begin(), values_a.end(), values_b.begin(),
+                 values_b.end(), std::back_inserter(result));
+  return result;
+}
+
+void PostingList::DecodeChunk(const ChunkRef& ref,
+                              std::vector<std::uint64_t>* out) const {
+  Decode(blob_store_, ref, out);
+}
+
+}  // namespace posting_list
@@ -0,0 +1,281 @@
+#include "replication.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace blob_store {
+
+namespace {
+
+#ifdef _WIN32
+int CreatePipe(int fds[2]) {
+  return _pipe(fds, 64 * 1024, _O_BINARY);
+}
+int WriteFd(int fd, const char* data, std::size_t size) {
+  return _write(fd, data, static_cast<unsigned int>(size));
+}
+int ReadFd(int fd, char* data, std::size_t size) {
+  return _read(fd, data, static_cast<unsigned int>(size));
+}
+void CloseFd(int fd) {
+  _close(fd);
+}
+#else
+int CreatePipe(int fds[2]) {
+  return pipe(fds);
+}
+ssize_t WriteFd(int fd, const char* data, std::size_t size) {
+  return write(fd, data, size);
+}
+ssize_t ReadFd(int fd, char* data, std::size_t size) {
+  return read(fd, data, size);
+}
+void CloseFd(int fd) {
+  close(fd);
+}
+#endif
+
+void AppendBlob(std::vector<char>* payload,
+                std::size_t index,
+                std::size_t alignment,
+                const void* data,
+                std::size_t size) {
+  std::size_t offset = payload->size();
+  payload->resize(offset + 3 * sizeof(std::size_t) + size);
+  char* buffer = payload->data() + offset;
+  memcpy(buffer, &index, sizeof(std::size_t));
+  memcpy(buffer + sizeof(std::size_t), &size, sizeof(std::size_t));
+  memcpy(buffer + 2 * sizeof(std::size_t), &alignment, sizeof(std::size_t));
+  memcpy(buffer + 3 * sizeof(std::size_t), data, size);
+}
+
+}  // namespace
+
+PipeReplicationStream::PipeReplicationStream() : read_fd_(-1), write_fd_(-1) {
+  int fds[2];
+  if (CreatePipe(fds) == 0) {
+    read_fd_ = fds[0];
+    write_fd_ = fds[1];
+  }
+}
+
+PipeReplicationStream::PipeReplicationStream(int read_fd, int write_fd)
+    : read_fd_(read_fd), write_fd_(write_fd) {}
+
+PipeReplicationStream::~PipeReplicationStream() {
+  CloseWriter();
+  if (read_fd_ != -1) {
+    CloseFd(read_fd_);
+  }
+}
+
+void PipeReplicationStream::CloseWriter() {
+  if (write_fd_ != -1) {
+    CloseFd(write_fd_);
+    write_fd_ = -1;
+  }
+}
+
+bool PipeReplicationStream::Write(const void* data, std::size_t size) {
+  if (write_fd_ == -1) {
+    return false;
+  }
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    auto written = WriteFd(write_fd_, bytes, size);
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool PipeReplicationStream::Read(void* data, std::size_t size) {
+  if (read_fd_ == -1) {
+    return false;
+  }
+  char* bytes = static_cast<char*>(data);
+  while (size > 0) {
+    auto bytes_read = ReadFd(read_fd_, bytes, size);
+    if (bytes_read <= 0) {
+      return false;
+    }
+    bytes += bytes_read;
+    size -= bytes_read;
+  }
+  return true;
+}
+
+ReplicationLeader::ReplicationLeader(BlobStore* blob_store,
+                                     ReplicationStream* stream)
+    : blob_store_(blob_store), stream_(stream), healthy_(true) {}
+
+bool ReplicationLeader::Sync(std::size_t head_index) {
+  BlobStoreObject<const HeadNode> head = blob_store_->Get<HeadNode>(head_index);
+  if (head == nullptr) {
+    return false;
+  }
+  std::vector<char> payload;
+  for (auto it = blob_store_->begin(); it != blob_store_->end(); ++it) {
+    BlobStoreObject<const char[]> blob =
+        blob_store_->Get<char[]>(it.index());
+    if (blob == nullptr) {
+      continue;
+    }
+    AppendBlob(&payload, it.index(), blob_store_->GetAlignment(it.index()),
+               &blob[0], blob.GetSize());
+  }
+  ReplicationRecordHeader header = {ReplicationRecordHeader::kSync,
+                                    head->version, head_index, 0,
+                                    payload.size()};
+  Send(header, payload);
+  return healthy_;
+}
+
+void ReplicationLeader::OnCommit(const Transaction& transaction) {
+  std::size_t transaction_size =
+      SerializeTraits<Transaction>::Size(transaction);
+  std::vector<char> payload(transaction_size);
+  SerializeTraits<Transaction>::Serialize(payload.data(), transaction);
+
+  // The new head is still write-locked by the transaction, so it's read
+  // through the transaction's own handle.
+  std::size_t new_head_index = transaction.new_head_.Index();
+  AppendBlob(&payload, new_head_index,
+             blob_store_->GetAlignment(new_head_index),
+             &*transaction.new_head_, sizeof(HeadNode));
+  for (std::size_t index : transaction.transaction_objects_) {
+    if (index == new_head_index) {
+      continue;
+    }
+    BlobStoreObject<const char[]> blob = blob_store_->Get<char[]>(index);
+    if (blob == nullptr) {
+      continue;
+    }
+    AppendBlob(&payload, index, blob_store_->GetAlignment(index), &blob[0],
+               blob.GetSize());
+  }
+
+  ReplicationRecordHeader header = {
+      ReplicationRecordHeader::kCommit, transaction.new_head_->version,
+      transaction.old_head_.Index(), transaction_size,
+      payload.size() - transaction_size};
+  Send(header, payload);
+}
+
+void ReplicationLeader::Send(const ReplicationRecordHeader& header,
+                             const std::vector<char>& payload) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!healthy_) {
+    return;
+  }
+  healthy_ = stream_->Write(&header, sizeof(header)) &&
+             stream_->Write(payload.data(), payload.size());
+}
+
+ReplicationFollower::ReplicationFollower(BlobStore* blob_store,
+                                         ReplicationStream* stream)
+    : blob_store_(blob_store), stream_(stream), synced_(false), version_(0) {}
+
+bool ReplicationFollower::ApplyNext() {
+  Record record;
+  if (!stream_->Read(&record.header, sizeof(record.header))) {
+    return false;
+  }
+  record.payload.resize(record.header.transaction_size +
+                        record.header.blobs_size);
+  if (!stream_->Read(record.payload.data(), record.payload.size())) {
+    return false;
+  }
+
+  if (record.header.type == ReplicationRecordHeader::kSync) {
+    Apply(record);
+    synced_ = true;
+    version_ = record.header.version;
+    // Drop the commits that the copy already includes.
+    pending_.erase(pending_.begin(), pending_.upper_bound(version_));
+  } else if (!synced_ || record.header.version > version_ + 1) {
+    pending_.emplace(record.header.version, std::move(record));
+  } else if (record.header.version == version_ + 1) {
+    Apply(record);
+    ++version_;
+  }
+
+  while (synced_ && !pending_.empty() &&
+         pending_.begin()->first == version_ + 1) {
+    Apply(pending_.begin()->second);
+    ++version_;
+    pending_.erase(pending_.begin());
+  }
+  return true;
+}
+
+void ReplicationFollower::Apply(const Record& record) {
+  const ReplicationRecordHeader& header = record.header;
+  const char* transaction_data = record.payload.data();
+  PutBlobs(transaction_data + header.transaction_size, header.blobs_size);
+  if (header.type != ReplicationRecordHeader::kCommit) {
+    return;
+  }
+
+  // The transaction data starts with the new head followed by the new, mutated
+  // and discarded objects.
+  std::size_t new_head_index;
+  std::unordered_set<size_t> new_objects;
+  std::unordered_map<size_t, size_t> mutated_objects;
+  std::unordered_set<size_t> discarded_objects;
+  SerializeTraits<std::size_t>::Deserialize(transaction_data, &new_head_index);
+  transaction_data += sizeof(std::size_t);
+  SerializeTraits<std::unordered_set<size_t>>::Deserialize(transaction_data,
+                                                           &new_objects);
+  transaction_data +=
+      SerializeTraits<std::unordered_set<size_t>>::Size(new_objects);
+  SerializeTraits<std::unordered_map<size_t, size_t>>::Deserialize(
+      transaction_data, &mutated_objects);
+  transaction_data +=
+      SerializeTraits<std::unordered_map<size_t, size_t>>::Size(
+          mutated_objects);
+  SerializeTraits<std::unordered_set<size_t>>::Deserialize(transaction_data,
+                                                           &discarded_objects);
+
+  // Mirror the leader's commit.
+  BlobStoreObject<const HeadNode> old_head =
+      blob_store_->Get<HeadNode>(header.head_index);
+  BlobStoreObject<const HeadNode> new_head =
+      blob_store_->Get<HeadNode>(new_head_index);
+  old_head.CompareAndSwap(new_head);
+
+  // The leader's change feed isn't part of any transaction, so the follower
+  // publishes its commits to its own copy of the feed.
+  if (new_head->change_feed != BlobStore::InvalidIndex) {
+    ChangeFeed::Publish(
+        blob_store_, new_head->change_feed,
+        {new_head->version, new_head->root_index, new_objects.size(),
+         mutated_objects.size(), discarded_objects.size()});
+  }
+}
+
+void ReplicationFollower::PutBlobs(const char* blobs, std::size_t size) {
+  const char* end = blobs + size;
+  while (blobs < end) {
+    std::size_t index;
+    std::size_t blob_size;
+    std::size_t alignment;
+    memcpy(&index, blobs, sizeof(std::size_t));
+    memcpy(&blob_size, blobs + sizeof(std::size_t), sizeof(std::size_t));
+    memcpy(&alignment, blobs + 2 * sizeof(std::size_t), sizeof(std::size_t));
+    blobs += 3 * sizeof(std::size_t);
+    blob_store_->Put(index, blobs, blob_size, alignment);
+    blobs += blob_size;
+  }
+}
+
+}  // namespace blob_store
@@ -138,9 +138,11 @@ void SharedMemoryBuffer::OpenFile() {
 #ifdef _WIN32
   // Windows implementation
   // Open the file for reading and writing
-  file_handle_ = CreateFileA(name_.c_str(), GENERIC_READ | GENERIC_WRITE,
-                             FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
-                             OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  // Delete sharing lets the file be removed while it's mapped.
+  file_handle_ = CreateFileA(
+      name_.c_str(), GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+      OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
   if (file_handle_ == INVALID_HANDLE_VALUE) {
     throw std::runtime_error("Failed to open memory-mapped file");
   }
@@ -6,38 +6,48 @@
 #include "allocation_logger.h"
 #include "shm_node.h"
 
-ShmAllocator::ShmAllocator(ChunkManager&& chunk_manager)
-    : chunk_manager_(std::move(chunk_manager)) {
+ShmAllocator::ShmAllocator(ChunkManager&& chunk_manager,
+                           std::size_t large_object_threshold)
+    : chunk_manager_(std::move(chunk_manager)),
+      large_objects_(chunk_manager_.buffer_factory(),
+                     chunk_manager_.name_prefix()),
+      large_object_threshold_(large_object_threshold),
+      slabs_(chunk_manager_.buffer_factory(), chunk_manager_.name_prefix()) {
   InitializeAllocatorStateIfNecessary();
 }
 
 ShmAllocator::ShmAllocator(ShmAllocator&& other)
-    : chunk_manager_(std::move(other.chunk_manager_)) {}
-
-uint8_t* ShmAllocator::Allocate(std::size_t bytes_requested) {
-  // Calculate the number of bytes needed for the memory block
-  std::size_t bytes_needed = CalculateBytesNeeded(bytes_requested);
+    : chunk_manager_(std::move(other.chunk_manager_)),
+      large_objects_(std::move(other.large_objects_)),
+      large_object_threshold_(other.large_object_threshold_),
+      slabs_(std::move(other.slabs_)) {}
+
+uint8_t* ShmAllocator::Allocate(std::size_t bytes_requested,
+                                std::size_t alignment) {
+  return AllocateNear(InvalidIndex, bytes_requested, alignment);
+}
 
+uint8_t* ShmAllocator::AllocateNear(std::size_t hint_index,
+                                    std::size_t bytes_requested,
+                                    std::size_t alignment) {
+  alignment = std::max(alignment, kMinAlignment);
+  // Slab objects are only aligned to their size class granularity.
+  if (bytes_requested <= SlabSpace::kMaxObjectSize &&
+      alignment <= SlabSpace::kGranularity) {
+    return slabs_.at(slabs_.Allocate(bytes_requested));
+  }
+  if (bytes_requested >= large_object_threshold_) {
+    uint8_t* data =
+        AllocateLargeObject(CalculateBytesNeeded(bytes_requested), alignment);
+    // Fall back to the chunks if the large object space is full.
+    if (data != nullptr) {
+      return data;
+    }
+  }
   while (true) {
-    uint8_t* data = AllocateFromFreeList(bytes_needed, 0, false);
-
+    uint8_t* data =
+        AllocateFromExistingChunks(bytes_requested, alignment, hint_index);
     if (data != nullptr) {
-      ShmNodePtr allocated_node = GetNode(data);
-      allocated_node->version.fetch_add(1);
-
-      // If we have enough space to split the node then split it.
-      bool should_split_node =
-          (allocated_node->size > bytes_needed + sizeof(ShmNode));
-      if (should_split_node) {
-        std::size_t bytes_remaining = allocated_node->size - bytes_needed;
-        ShmNodePtr node = NewAllocatedNode(
-            reinterpret_cast<uint8_t*>(allocated_node.get()) + bytes_needed,
-            allocated_node->index + bytes_needed, bytes_remaining);
-
-        DeallocateNode(std::move(node));
-        allocated_node->size = bytes_needed;
-      }
-      AllocationLogger::Get()->RecordAllocation(*allocated_node);
       return data;
     }
     // No block of sufficient size was found. We need to request a new chunk,
@@ -50,10 +60,88 @@ uint8_t* ShmAllocator::Allocate(std::size_t bytes_requested) {
   }
 }
 
+uint8_t* ShmAllocator::AllocateFromExistingChunks(std::size_t bytes_requested,
+                                                  std::size_t alignment,
+                                                  std::size_t hint_index) {
+  // Calculate the number of bytes needed for the memory block
+  std::size_t bytes_needed = CalculateBytesNeeded(bytes_requested);
+  std::size_t bytes_to_search = bytes_needed + AlignmentPadding(alignment);
+  std::size_t num_chunks = state()->num_chunks.load();
+  uint8_t* data = nullptr;
+
+  // Try the hint's chunk first: after the hint, then anywhere in the chunk.
+  std::size_t hint_chunk = num_chunks;
+  if (hint_index != InvalidIndex && !IsLargeObjectIndex(hint_index) &&
+      !IsSlabIndex(hint_index) &&
+      ChunkManager::chunk_index(hint_index) < num_chunks) {
+    hint_chunk = ChunkManager::chunk_index(hint_index);
+    data = AllocateFromFreeList(bytes_to_search, hint_index, false);
+    if (data == nullptr) {
+      data = AllocateFromFreeList(
+          bytes_to_search, chunk_manager_.encode_index(hint_chunk, 0), false);
+    }
+  }
+  for (std::size_t chunk_index = 0; data == nullptr && chunk_index < num_chunks;
+       ++chunk_index) {
+    if (chunk_index != hint_chunk) {
+      data = AllocateFromFreeList(
+          bytes_to_search, chunk_manager_.encode_index(chunk_index, 0), false);
+    }
+  }
+  if (data == nullptr) {
+    return nullptr;
+  }
+  ShmNodePtr allocated_node = GetNode(data);
+  allocated_node->version.fetch_add(1);
+  if (alignment > kMinAlignment) {
+    allocated_node = AlignNode(std::move(allocated_node), alignment);
+  }
+  SplitNodeIfPossible(allocated_node.get(), bytes_needed);
+  AllocationLogger::Get()->RecordAllocation(*allocated_node);
+  return reinterpret_cast<uint8_t*>(allocated_node.get() + 1);
+}
+
+ShmNodePtr ShmAllocator::AlignNode(ShmNodePtr node, std::size_t alignment) {
+  uintptr_t data = reinterpret_cast<uintptr_t>(node.get() + 1);
+  if (data % alignment == 0) {
+    return node;
+  }
+  // The head that's skipped must be able to hold a free node.
+  uintptr_t aligned_data =
+      (data + sizeof(ShmNode) + kMinAlignment + alignment - 1) &
+      ~static_cast<uintptr_t>(alignment - 1);
+  std::size_t head_size = aligned_data - data;
+  ShmNodePtr aligned_node =
+      NewAllocatedNode(reinterpret_cast<uint8_t*>(node.get()) + head_size,
+                       node->index + head_size, node->size - head_size);
+  node->size = head_size;
+  DeallocateNode(std::move(node));
+  return aligned_node;
+}
+
+bool ShmAllocator::Grow(uint8_t* ptr, std::size_t bytes_requested) {
+  std::uint64_t slab_index;
+  if (slabs_.IndexOf(ptr, &slab_index)) {
+    return bytes_requested <= slabs_.GetObjectSize(slab_index);
+  }
+  ShmNodePtr node = GetNode(ptr);
+  if (node == nullptr || !node->is_allocated()) {
+    return false;
+  }
+  // The allocation can't grow past its block. Absorbing a free neighbour
+  // would mean pulling it out of the free list while other threads may still
+  // be walking through its header, which the free list can't rule out (see
+  // CoalesceWithRightNodeIfPossible), so the caller relocates instead.
+  return node->size >= CalculateBytesNeeded(bytes_requested);
+}
+
 std::size_t ShmAllocator::GetCapacity(std::size_t index) const {
   if (index < 0) {
     return 0;
   }
+  if (IsSlabIndex(index)) {
+    return slabs_.GetObjectSize(index & ~kSlabTag);
+  }
   std::size_t node_header_index = index - sizeof(ShmNode);
   const ShmNode* current_node = ToPtr<ShmNode>(node_header_index);
   return current_node->size.load() - sizeof(ShmNode);
@@ -64,6 +152,10 @@ std::size_t ShmAllocator::GetCapacity(uint8_t* ptr) {
   if (ptr == nullptr) {
     return 0;
   }
+  std::uint64_t slab_index;
+  if (slabs_.IndexOf(ptr, &slab_index)) {
+    return slabs_.GetObjectSize(slab_index);
+  }
   ShmNodePtr current_node = GetNode(ptr);
   return current_node->size - sizeof(ShmNode);
 }
@@ -98,6 +190,20 @@ ShmNodePtr ShmAllocator::NewAllocatedNode(uint8_t* buffer,
   return node;
 }
 
+void ShmAllocator::SplitNodeIfPossible(ShmNode* node,
+                                       std::size_t bytes_needed) {
+  // If we have enough space to split the node then split it.
+  if (node->size <= bytes_needed + sizeof(ShmNode)) {
+    return;
+  }
+  std::size_t bytes_remaining = node->size - bytes_needed;
+  ShmNodePtr remainder =
+      NewAllocatedNode(reinterpret_cast<uint8_t*>(node) + bytes_needed,
+                       node->index + bytes_needed, bytes_remaining);
+  DeallocateNode(std::move(remainder));
+  node->size = bytes_needed;
+}
+
 bool ShmAllocator::DeallocateNode(ShmNodePtr node) {
   // The version counter on every node ensures we don't accidentally double
   // free.
@@ -113,6 +219,16 @@ bool ShmAllocator::DeallocateNode(ShmNodePtr node) {
 
   AllocationLogger::Get()->RecordDeallocation(*node);
 
+  // Large objects never enter the free list. Their buffer is released right
+  // away.
+  if (IsLargeObjectIndex(node->index)) {
+    std::size_t slot = ChunkManager::offset_in_chunk(node->index) >>
+                       kLargeObjectSlotShift;
+    node.reset();
+    large_objects_.Free(slot);
+    return true;
+  }
+
   ShmNodePtr left_node;
   ShmNodePtr right_node;
 
@@ -131,8 +247,8 @@ bool ShmAllocator::DeallocateNode(ShmNodePtr node) {
         get_marked_reference(right_node_index);
     node->next_index.store(right_node_index_marked);
     if (left_node == nullptr) {
-      if (state()->free_list_index.compare_exchange_strong(right_node_index,
-                                                           node->index)) {
+      if (free_list_head(ChunkManager::chunk_index(node->index))
+              ->compare_exchange_strong(right_node_index, node->index)) {
         node->next_index.compare_exchange_strong(
             right_node_index_marked, get_unmarked_reference(right_node_index));
         return true;
@@ -148,6 +264,35 @@ bool ShmAllocator::DeallocateNode(ShmNodePtr node) {
   } while (true);  // B3
 }
 
+uint8_t* ShmAllocator::AllocateLargeObject(std::size_t bytes_needed,
+                                           std::size_t alignment) {
+  uint8_t* buffer = nullptr;
+  std::size_t slot =
+      large_objects_.Allocate(bytes_needed + alignment, &buffer);
+  if (slot == LargeObjectSpace::InvalidSlot) {
+    return nullptr;
+  }
+  // Place the node so that the data that follows it is aligned.
+  uintptr_t data = reinterpret_cast<uintptr_t>(buffer + sizeof(ShmNode));
+  std::size_t offset = ((data + alignment - 1) & ~(alignment - 1)) - data;
+  std::size_t index = (kLargeObjectChunkIndex << 56) |
+                      (slot << kLargeObjectSlotShift) | offset;
+  // The new node is allocated: NewAllocatedNode starts it at an odd version.
+  ShmNodePtr node = NewAllocatedNode(buffer + offset, index, bytes_needed);
+  AllocationLogger::Get()->RecordAllocation(*node);
+  return buffer + offset + sizeof(ShmNode);
+}
+
+uint8_t* ShmAllocator::LargeObjectAt(std::size_t index) const {
+  std::size_t offset = ChunkManager::offset_in_chunk(index);
+  std::size_t slot = offset >> kLargeObjectSlotShift;
+  uint8_t* buffer = large_objects_.at(slot);
+  if (buffer == nullptr) {
+    return nullptr;
+  }
+  return buffer + (offset & ((1ull << kLargeObjectSlotShift) - 1));
+}
+
 std::uint64_t ShmAllocator::ToIndexImpl(ShmNode* ptr, std::true_type) const {
   if (ptr == nullptr) {
     return InvalidIndex;
@@ -183,8 +328,9 @@ uint8_t* ShmAllocator::AllocateFromFreeList(std::size_t min_bytes_needed,
   std::size_t right_node_index =
       right_node == nullptr ? InvalidIndex : right_node->index;
   if (left_node == nullptr) {
-    if (!state()->free_list_index.compare_exchange_strong(
-            right_node_index, right_node_next_index)) {
+    if (!free_list_head(ChunkManager::chunk_index(min_index))
+             ->compare_exchange_strong(right_node_index,
+                                       right_node_next_index)) {
       ShmNodePtr new_left_node;
       SearchBySize(right_node->size, right_node->index, &new_left_node);
     }
@@ -210,9 +356,13 @@ void ShmAllocator::RequestNewFreeNodeFromChunkManager() {
                                          &new_chunk_size) == 0) {
     return;
   }
+  // The new chunk starts with the head of its own, initially empty, free list.
+  reinterpret_cast<std::atomic<std::size_t>*>(new_chunk_data)
+      ->store(InvalidIndex);
   ShmNodePtr node = NewAllocatedNode(
-      new_chunk_data, chunk_manager_.encode_index(last_num_chunks, 0),
-      new_chunk_size);
+      new_chunk_data + kChunkHeaderSize,
+      chunk_manager_.encode_index(last_num_chunks, kChunkHeaderSize),
+      new_chunk_size - kChunkHeaderSize);
   DeallocateNode(std::move(node));
   bool success = state()->num_chunks.compare_exchange_strong(
       last_num_chunks, last_num_chunks + 1);
@@ -227,7 +377,8 @@ ShmNodePtr ShmAllocator::SearchBySize(std::size_t size,
 search_again:
   do {
     ShmNodePtr current_node;
-    std::size_t current_node_next_index = state()->free_list_index.load();
+    std::size_t current_node_next_index =
+        free_list_head(ChunkManager::chunk_index(index))->load();
     // 1: Find left_node and right_node
     while (true) {
       if (!is_marked_reference(current_node_next_index)) {
@@ -270,8 +421,9 @@ search_again:
         }
       }
     } else {
-      if (state()->free_list_index.compare_exchange_strong(left_node_next_index,
-                                                           right_node_index)) {
+      if (free_list_head(ChunkManager::chunk_index(index))
+              ->compare_exchange_strong(left_node_next_index,
+                                        right_node_index)) {
         if (right_node != nullptr &&
             is_marked_reference(right_node->next_index.load())) {
           goto search_again;
@@ -284,7 +436,8 @@ search_again:
 }
 
 bool ShmAllocator::IsNodeReachable(std::size_t index) {
-  std::size_t first_free_node_index = state()->free_list_index.load();
+  std::size_t first_free_node_index =
+      free_list_head(ChunkManager::chunk_index(index))->load();
   ShmNodePtr current_node =
       first_free_node_index == InvalidIndex
           ? ShmNodePtr(nullptr)
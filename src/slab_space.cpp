@@ -0,0 +1,168 @@
+#include "slab_space.h"
+
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace {
+
+constexpr std::uint32_t kMagicNumber = 0x51AB51AB;
+
+void SpinWait() {
+#if defined(_WIN32)
+  Sleep(0);
+#else
+  std::this_thread::yield();
+#endif
+}
+
+}  // namespace
+
+SlabSpace::SlabSpace(BufferFactory* buffer_factory,
+                     const std::string& name_prefix)
+    : slabs_(buffer_factory, name_prefix + "_slabs", 4 * kSlabSize) {
+  SpaceHeader* header = state();
+  if (header->magic_number != kMagicNumber) {
+    header->magic_number = kMagicNumber;
+    header->lock = 0;
+    header->num_slabs = 1;
+    header->empty_slabs = InvalidIndex;
+    for (std::size_t i = 0; i < kNumSizeClasses; ++i) {
+      header->partial_slabs[i] = InvalidIndex;
+    }
+  }
+}
+
+std::uint64_t SlabSpace::Allocate(std::size_t bytes_requested) {
+  std::size_t size_class =
+      bytes_requested == 0 ? 0 : (bytes_requested - 1) / kGranularity;
+  std::uint32_t object_size =
+      static_cast<std::uint32_t>((size_class + 1) * kGranularity);
+  std::size_t capacity = Capacity(object_size);
+
+  Lock();
+  SpaceHeader* header = state();
+  std::uint64_t slab_index = header->partial_slabs[size_class];
+  if (slab_index == InvalidIndex) {
+    slab_index = TakeEmptySlab();
+    SlabHeader* new_slab = slab(slab_index);
+    memset(new_slab, 0, sizeof(SlabHeader));
+    new_slab->object_size = object_size;
+    new_slab->next_slab = InvalidIndex;
+    header->partial_slabs[size_class] = slab_index;
+  }
+
+  SlabHeader* current = slab(slab_index);
+  // Partial slabs always have a free object. The lowest clear bit is always
+  // below capacity.
+  std::size_t object = capacity;
+  for (std::size_t word = 0; object == capacity; ++word) {
+    std::uint64_t bits = ~current->bitmap[word];
+    if (bits == 0) {
+      continue;
+    }
+    std::size_t bit = 0;
+    while ((bits & 1) == 0) {
+      bits >>= 1;
+      ++bit;
+    }
+    current->bitmap[word] |= 1ull << bit;
+    object = word * 64 + bit;
+  }
+  if (++current->num_used == capacity) {
+    header->partial_slabs[size_class] = current->next_slab;
+    current->next_slab = InvalidIndex;
+  }
+  Unlock();
+  return slab_index + sizeof(SlabHeader) + object * object_size;
+}
+
+bool SlabSpace::Free(std::uint64_t index) {
+  std::uint64_t slab_index = SlabIndexOf(index);
+  Lock();
+  SpaceHeader* header = state();
+  SlabHeader* current = slab(slab_index);
+  std::size_t object_size = current->object_size;
+  std::size_t offset = index - slab_index;
+  if (object_size == 0 || offset < sizeof(SlabHeader) ||
+      (offset - sizeof(SlabHeader)) % object_size != 0) {
+    Unlock();
+    return false;
+  }
+  std::size_t object = (offset - sizeof(SlabHeader)) / object_size;
+  std::uint64_t mask = 1ull << (object % 64);
+  if ((current->bitmap[object / 64] & mask) == 0) {
+    Unlock();
+    return false;
+  }
+  current->bitmap[object / 64] &= ~mask;
+
+  std::size_t size_class = object_size / kGranularity - 1;
+  bool was_full = current->num_used == Capacity(object_size);
+  if (--current->num_used == 0) {
+    // Unlink the slab from its partial list and make it available to every
+    // size class.
+    std::uint64_t* link = &header->partial_slabs[size_class];
+    while (*link != slab_index) {
+      link = &slab(*link)->next_slab;
+    }
+    *link = current->next_slab;
+    current->object_size = 0;
+    current->next_slab = header->empty_slabs;
+    header->empty_slabs = slab_index;
+  } else if (was_full) {
+    current->next_slab = header->partial_slabs[size_class];
+    header->partial_slabs[size_class] = slab_index;
+  }
+  Unlock();
+  return true;
+}
+
+std::size_t SlabSpace::GetObjectSize(std::uint64_t index) const {
+  const SlabHeader* current =
+      reinterpret_cast<const SlabHeader*>(slabs_.at(SlabIndexOf(index)));
+  return current->object_size;
+}
+
+void SlabSpace::Lock() {
+  std::atomic<std::uint32_t>& lock = state()->lock;
+  std::uint32_t expected = 0;
+  while (!lock.compare_exchange_weak(expected, 1)) {
+    expected = 0;
+    SpinWait();
+  }
+}
+
+void SlabSpace::Unlock() {
+  state()->lock.store(0);
+}
+
+std::uint64_t SlabSpace::TakeEmptySlab() {
+  SpaceHeader* header = state();
+  if (header->empty_slabs != InvalidIndex) {
+    std::uint64_t slab_index = header->empty_slabs;
+    header->empty_slabs = slab(slab_index)->next_slab;
+    return slab_index;
+  }
+
+  // Slabs are numbered across chunks. Every chunk holds twice as many slabs
+  // as the previous one.
+  std::uint64_t slab_number = header->num_slabs++;
+  std::size_t chunk_index = 0;
+  std::size_t slabs_in_chunk = slabs_.chunk_size_at_index(0) / kSlabSize;
+  while (slab_number >= slabs_in_chunk) {
+    slab_number -= slabs_in_chunk;
+    slabs_in_chunk *= 2;
+    ++chunk_index;
+  }
+  uint8_t* data;
+  std::size_t chunk_size;
+  slabs_.get_or_create_chunk(chunk_index, &data, &chunk_size);
+  return slabs_.encode_index(chunk_index, slab_number * kSlabSize);
+}
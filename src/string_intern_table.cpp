@@ -0,0 +1,199 @@
+#include "string_intern_table.h"
+
+namespace blob_store {
+
+// static
+StringInternTable StringInternTable::Create(BlobStore* blob_store) {
+  BlobStoreObject<InternTableHeader> header =
+      blob_store->New<InternTableHeader>();
+  header->num_strings = 0;
+  header->num_used = 0;
+  header->capacity = 0;
+  header->buckets_index = BlobStore::InvalidIndex;
+  StringInternTable table(blob_store, header.Index());
+  table.Rehash(&*header, kInitialCapacity);
+  return table;
+}
+
+// static
+StringInternTable StringInternTable::Open(BlobStore* blob_store,
+                                          std::size_t table_index) {
+  return StringInternTable(blob_store, table_index);
+}
+
+BlobStoreObject<const std::string> StringInternTable::Intern(
+    const std::string& str) {
+  std::size_t hash = FixedString::Hash(str.data(), str.size());
+  BlobStoreObject<InternTableHeader> header =
+      blob_store_->GetMutable<InternTableHeader>(table_index_);
+  {
+    BlobStoreObject<InternEntry[]> buckets =
+        blob_store_->GetMutable<InternEntry[]>(header->buckets_index);
+    std::size_t bucket = FindBucket(*header, &buckets[0], hash, str);
+    if (bucket != header->capacity) {
+      ++buckets[bucket].ref_count;
+      return blob_store_->Get<std::string>(buckets[bucket].string_index);
+    }
+  }
+
+  // Keep at most 3/4 of the buckets in use so that probe sequences stay
+  // short. Rehashing also clears out deleted buckets, so the table only grows
+  // if it's at least half full of live strings.
+  if ((header->num_used + 1) * 4 > header->capacity * 3) {
+    std::size_t capacity = header->capacity;
+    while ((header->num_strings + 1) * 2 > capacity) {
+      capacity *= 2;
+    }
+    Rehash(&*header, capacity);
+  }
+
+  BlobStoreObject<std::string> string = blob_store_->New<std::string>(str);
+  BlobStoreObject<InternEntry[]> buckets =
+      blob_store_->GetMutable<InternEntry[]>(header->buckets_index);
+  std::size_t mask = header->capacity - 1;
+  std::size_t bucket = hash & mask;
+  while (buckets[bucket].string_index != InternEntry::kEmpty &&
+         buckets[bucket].string_index != InternEntry::kDeleted) {
+    bucket = (bucket + 1) & mask;
+  }
+  if (buckets[bucket].string_index == InternEntry::kEmpty) {
+    ++header->num_used;
+  }
+  buckets[bucket].hash = hash;
+  buckets[bucket].string_index = string.Index();
+  buckets[bucket].ref_count = 1;
+  ++header->num_strings;
+  return std::move(string).Downgrade();
+}
+
+BlobStoreObject<const std::string> StringInternTable::Find(
+    const std::string& str) const {
+  std::size_t hash = FixedString::Hash(str.data(), str.size());
+  BlobStoreObject<const InternTableHeader> header =
+      blob_store_->Get<InternTableHeader>(table_index_);
+  BlobStoreObject<const InternEntry[]> buckets =
+      blob_store_->Get<InternEntry[]>(header->buckets_index);
+  std::size_t bucket = FindBucket(*header, &buckets[0], hash, str);
+  if (bucket == header->capacity) {
+    return BlobStoreObject<const std::string>();
+  }
+  return blob_store_->Get<std::string>(buckets[bucket].string_index);
+}
+
+bool StringInternTable::Release(std::size_t string_index) {
+  BlobStoreObject<InternTableHeader> header =
+      blob_store_->GetMutable<InternTableHeader>(table_index_);
+  std::size_t hash;
+  {
+    BlobStoreObject<const std::string> string =
+        blob_store_->Get<std::string>(string_index);
+    if (string == nullptr) {
+      return false;
+    }
+    hash = string->hash;
+  }
+
+  BlobStoreObject<InternEntry[]> buckets =
+      blob_store_->GetMutable<InternEntry[]>(header->buckets_index);
+  std::size_t mask = header->capacity - 1;
+  for (std::size_t bucket = hash & mask, probes = 0;
+       probes < header->capacity &&
+       buckets[bucket].string_index != InternEntry::kEmpty;
+       bucket = (bucket + 1) & mask, ++probes) {
+    InternEntry& entry = buckets[bucket];
+    if (entry.string_index != string_index) {
+      continue;
+    }
+    if (--entry.ref_count == 0) {
+      entry.string_index = InternEntry::kDeleted;
+      --header->num_strings;
+      blob_store_->Drop(string_index);
+    }
+    return true;
+  }
+  return false;
+}
+
+std::size_t StringInternTable::GetRefCount(std::size_t string_index) const {
+  BlobStoreObject<const InternTableHeader> header =
+      blob_store_->Get<InternTableHeader>(table_index_);
+  BlobStoreObject<const std::string> string =
+      blob_store_->Get<std::string>(string_index);
+  if (string == nullptr) {
+    return 0;
+  }
+  BlobStoreObject<const InternEntry[]> buckets =
+      blob_store_->Get<InternEntry[]>(header->buckets_index);
+  std::size_t mask = header->capacity - 1;
+  for (std::size_t bucket = string->hash & mask, probes = 0;
+       probes < header->capacity &&
+       buckets[bucket].string_index != InternEntry::kEmpty;
+       bucket = (bucket + 1) & mask, ++probes) {
+    if (buckets[bucket].string_index == string_index) {
+      return buckets[bucket].ref_count;
+    }
+  }
+  return 0;
+}
+
+std::size_t StringInternTable::GetSize() const {
+  return blob_store_->Get<InternTableHeader>(table_index_)->num_strings;
+}
+
+std::size_t StringInternTable::FindBucket(const InternTableHeader& header,
+                                          const InternEntry* buckets,
+                                          std::size_t hash,
+                                          const std::string& str) const {
+  std::size_t mask = header.capacity - 1;
+  for (std::size_t bucket = hash & mask, probes = 0;
+       probes < header.capacity &&
+       buckets[bucket].string_index != InternEntry::kEmpty;
+       bucket = (bucket + 1) & mask, ++probes) {
+    const InternEntry& entry = buckets[bucket];
+    if (entry.string_index == InternEntry::kDeleted || entry.hash != hash) {
+      continue;
+    }
+    if (*blob_store_->Get<std::string>(entry.string_index) == str) {
+      return bucket;
+    }
+  }
+  return header.capacity;
+}
+
+void StringInternTable::Rehash(InternTableHeader* header,
+                               std::size_t capacity) {
+  BlobStoreObject<InternEntry[]> new_buckets =
+      blob_store_->New<InternEntry[]>(capacity);
+  for (std::size_t i = 0; i < capacity; ++i) {
+    new_buckets[i].hash = 0;
+    new_buckets[i].string_index = InternEntry::kEmpty;
+    new_buckets[i].ref_count = 0;
+  }
+
+  if (header->buckets_index != BlobStore::InvalidIndex) {
+    {
+      BlobStoreObject<const InternEntry[]> old_buckets =
+          blob_store_->Get<InternEntry[]>(header->buckets_index);
+      std::size_t mask = capacity - 1;
+      for (std::size_t i = 0; i < header->capacity; ++i) {
+        const InternEntry& entry = old_buckets[i];
+        if (entry.string_index == InternEntry::kEmpty ||
+            entry.string_index == InternEntry::kDeleted) {
+          continue;
+        }
+        std::size_t bucket = entry.hash & mask;
+        while (new_buckets[bucket].string_index != InternEntry::kEmpty) {
+          bucket = (bucket + 1) & mask;
+        }
+        new_buckets[bucket] = entry;
+      }
+    }
+    blob_store_->Drop(header->buckets_index);
+  }
+
+  header->buckets_index = new_buckets.Index();
+  header->capacity = capacity;
+  header->num_used = header->num_strings;
+}
+
+}  // namespace blob_store
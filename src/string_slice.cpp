@@ -1,5 +1,245 @@
 #include "string_slice.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define STRING_SLICE_HAS_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// The AVX2 kernels are compiled regardless of the baseline instruction set
+// and are only selected if the CPU supports AVX2.
+#if defined(__GNUC__) || defined(__clang__)
+#define STRING_SLICE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define STRING_SLICE_TARGET_AVX2
+#endif
+
+namespace {
+
+using MismatchFunction = size_t (*)(const uint8_t* a,
+                                    const uint8_t* b,
+                                    size_t size);
+using FindFunction = size_t (*)(const uint8_t* haystack,
+                                size_t haystack_size,
+                                const uint8_t* needle,
+                                size_t needle_size);
+
+// Returns the index of the lowest set bit of a non-zero mask.
+inline unsigned LowestBit(std::uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Returns the index of the first byte at which a and b differ, or size if the
+// first size bytes are equal.
+size_t MismatchScalar(const uint8_t* a, const uint8_t* b, size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t x;
+    uint64_t y;
+    std::memcpy(&x, a + i, sizeof(x));
+    std::memcpy(&y, b + i, sizeof(y));
+    if (x != y) {
+      break;
+    }
+  }
+  while (i < size && a[i] == b[i]) {
+    ++i;
+  }
+  return i;
+}
+
+// Returns the position of the first occurrence of needle in haystack, or
+// StringSlice::npos. needle_size must not be 0.
+size_t FindScalar(const uint8_t* haystack,
+                  size_t haystack_size,
+                  const uint8_t* needle,
+                  size_t needle_size) {
+  if (needle_size > haystack_size) {
+    return StringSlice::npos;
+  }
+  // The last position at which needle could start, plus one.
+  const uint8_t* end = haystack + haystack_size - needle_size + 1;
+  const uint8_t* candidate = haystack;
+  while (candidate < end) {
+    candidate = static_cast<const uint8_t*>(
+        std::memchr(candidate, needle[0], end - candidate));
+    if (candidate == nullptr) {
+      return StringSlice::npos;
+    }
+    if (std::memcmp(candidate + 1, needle + 1, needle_size - 1) == 0) {
+      return candidate - haystack;
+    }
+    ++candidate;
+  }
+  return StringSlice::npos;
+}
+
+#ifdef STRING_SLICE_HAS_SSE2
+
+size_t MismatchSse2(const uint8_t* a, const uint8_t* b, size_t size) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    std::uint32_t different =
+        ~static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) &
+        0xFFFF;
+    if (different != 0) {
+      return i + LowestBit(different);
+    }
+  }
+  return i + MismatchScalar(a + i, b + i, size - i);
+}
+
+// Compares the first and last byte of needle against 16 candidate positions
+// at once and only runs memcmp on the candidates where both match. needle_size
+// must be at least 2.
+size_t FindSse2(const uint8_t* haystack,
+                size_t haystack_size,
+                const uint8_t* needle,
+                size_t needle_size) {
+  if (needle_size > haystack_size) {
+    return StringSlice::npos;
+  }
+  const __m128i first = _mm_set1_epi8(static_cast<char>(needle[0]));
+  const __m128i last =
+      _mm_set1_epi8(static_cast<char>(needle[needle_size - 1]));
+  size_t i = 0;
+  for (; i + 16 + needle_size - 1 <= haystack_size; i += 16) {
+    __m128i block_first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+    __m128i block_last = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(haystack + i + needle_size - 1));
+    std::uint32_t candidates = static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                                        _mm_cmpeq_epi8(last, block_last))));
+    while (candidates != 0) {
+      size_t position = i + LowestBit(candidates);
+      if (std::memcmp(haystack + position + 1, needle + 1,
+                      needle_size - 2) == 0) {
+        return position;
+      }
+      candidates &= candidates - 1;
+    }
+  }
+  size_t position =
+      FindScalar(haystack + i, haystack_size - i, needle, needle_size);
+  return position == StringSlice::npos ? position : i + position;
+}
+
+STRING_SLICE_TARGET_AVX2
+size_t MismatchAvx2(const uint8_t* a, const uint8_t* b, size_t size) {
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    std::uint32_t different = ~static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+    if (different != 0) {
+      return i + LowestBit(different);
+    }
+  }
+  return i + MismatchSse2(a + i, b + i, size - i);
+}
+
+STRING_SLICE_TARGET_AVX2
+size_t FindAvx2(const uint8_t* haystack,
+                size_t haystack_size,
+                const uint8_t* needle,
+                size_t needle_size) {
+  if (needle_size > haystack_size) {
+    return StringSlice::npos;
+  }
+  const __m256i first = _mm256_set1_epi8(static_cast<char>(needle[0]));
+  const __m256i last =
+      _mm256_set1_epi8(static_cast<char>(needle[needle_size - 1]));
+  size_t i = 0;
+  for (; i + 32 + needle_size - 1 <= haystack_size; i += 32) {
+    __m256i block_first =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+    __m256i block_last = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(haystack + i + needle_size - 1));
+    std::uint32_t candidates =
+        static_cast<std::uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                             _mm256_cmpeq_epi8(last, block_last))));
+    while (candidates != 0) {
+      size_t position = i + LowestBit(candidates);
+      if (std::memcmp(haystack + position + 1, needle + 1,
+                      needle_size - 2) == 0) {
+        return position;
+      }
+      candidates &= candidates - 1;
+    }
+  }
+  size_t position =
+      FindSse2(haystack + i, haystack_size - i, needle, needle_size);
+  return position == StringSlice::npos ? position : i + position;
+}
+
+bool CpuSupportsAvx2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  // AVX2 also needs the OS to save the upper halves of the YMM registers.
+  __cpuid(info, 1);
+  const int kOsxsave = 1 << 27;
+  const int kAvx = 1 << 28;
+  if ((info[2] & kOsxsave) == 0 || (info[2] & kAvx) == 0 ||
+      (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif  // STRING_SLICE_HAS_SSE2
+
+// The kernels for the CPU we're running on, selected once.
+struct Kernels {
+  MismatchFunction mismatch;
+  FindFunction find;
+};
+
+Kernels SelectKernels() {
+#ifdef STRING_SLICE_HAS_SSE2
+  if (CpuSupportsAvx2()) {
+    return {MismatchAvx2, FindAvx2};
+  }
+  return {MismatchSse2, FindSse2};
+#else
+  return {MismatchScalar, FindScalar};
+#endif
+}
+
+const Kernels& GetKernels() {
+  static const Kernels kernels = SelectKernels();
+  return kernels;
+}
+
+}  // namespace
+
 StringSlice::StringSlice(const char* str, size_t offset, size_t size)
     : str_(str), offset_(offset), size_(size) {}
 
@@ -36,6 +276,48 @@ std::string StringSlice::to_string() const {
   return std::string(str_ + offset_, size_);
 }
 
+int StringSlice::compare(const StringSlice& other) const {
+  const uint8_t* a = reinterpret_cast<const uint8_t*>(data());
+  const uint8_t* b = reinterpret_cast<const uint8_t*>(other.data());
+  size_t size = std::min(size_, other.size_);
+  size_t mismatch = GetKernels().mismatch(a, b, size);
+  if (mismatch < size) {
+    return static_cast<int>(a[mismatch]) - static_cast<int>(b[mismatch]);
+  }
+  return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+}
+
+size_t StringSlice::common_prefix_length(const StringSlice& other) const {
+  return GetKernels().mismatch(reinterpret_cast<const uint8_t*>(data()),
+                               reinterpret_cast<const uint8_t*>(other.data()),
+                               std::min(size_, other.size_));
+}
+
+size_t StringSlice::find(char c, size_t pos) const {
+  if (pos >= size_) {
+    return npos;
+  }
+  // memchr is already vectorized and dispatched at runtime by the C library.
+  const void* found = std::memchr(data() + pos, c, size_ - pos);
+  return found == nullptr ? npos : static_cast<const char*>(found) - data();
+}
+
+size_t StringSlice::find(const StringSlice& needle, size_t pos) const {
+  if (pos > size_) {
+    return npos;
+  }
+  if (needle.size_ == 0) {
+    return pos;
+  }
+  if (needle.size_ == 1) {
+    return find(needle.data()[0], pos);
+  }
+  size_t found = GetKernels().find(
+      reinterpret_cast<const uint8_t*>(data() + pos), size_ - pos,
+      reinterpret_cast<const uint8_t*>(needle.data()), needle.size_);
+  return found == npos ? npos : pos + found;
+}
+
 bool StringSlice::operator==(const StringSlice& other) const {
   return size_ == other.size_ &&
          std::memcmp(str_ + offset_, other.str_ + other.offset_, size_) == 0;
@@ -46,9 +328,7 @@ bool StringSlice::operator!=(const StringSlice& other) const {
 }
 
 bool StringSlice::operator<(const StringSlice& other) const {
-  int cmp = std::memcmp(str_ + offset_, other.str_ + other.offset_,
-                        std::min(size_, other.size_));
-  return cmp < 0 || (cmp == 0 && size_ < other.size_);
+  return compare(other) < 0;
 }
 
 bool StringSlice::operator>(const StringSlice& other) const {
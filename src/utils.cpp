@@ -1,5 +1,14 @@
 #include "utils.h"
 
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTILS_HAS_SSE2
+#endif
+
 namespace utils {
 
 size_t GetPageSize() {
@@ -17,4 +26,37 @@ size_t RoundUpToPageSize(size_t size) {
   return ((size + page_size - 1) / page_size) * page_size;
 }
 
-}  // namespace utils
\ No newline at end of file
+void StreamCopy(void* dst, const void* src, size_t size) {
+#ifdef UTILS_HAS_SSE2
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  const uint8_t* in = static_cast<const uint8_t*>(src);
+  // Streaming stores must be 16-byte aligned. Copy the head up to the first
+  // aligned address normally.
+  size_t head = (16 - (reinterpret_cast<uintptr_t>(out) & 15)) & 15;
+  if (head > size) {
+    head = size;
+  }
+  memcpy(out, in, head);
+  out += head;
+  in += head;
+  size -= head;
+  for (; size >= 64; size -= 64, in += 64, out += 64) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 32));
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(out), a);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(out + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(out + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(out + 48), d);
+  }
+  memcpy(out, in, size);
+  // Streaming stores are weakly ordered. Make them visible before anyone is
+  // handed the copy.
+  _mm_sfence();
+#else
+  memcpy(dst, src, size);
+#endif
+}
+
+}  // namespace utils
@@ -0,0 +1,187 @@
+#include "value_log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace value_log {
+
+namespace {
+
+// Returns the number of bytes an entry with the provided key and value takes,
+// padded so that the next entry starts on an 8-byte boundary.
+std::size_t EntrySize(std::size_t key_size, std::size_t value_size) {
+  return (sizeof(EntryHeader) + key_size + value_size + 7) & ~std::size_t(7);
+}
+
+SegmentHeader ReadSegmentHeader(const std::uint64_t* segment) {
+  SegmentHeader header;
+  std::memcpy(&header, segment, sizeof(header));
+  return header;
+}
+
+void WriteSegmentHeader(std::uint64_t* segment, const SegmentHeader& header) {
+  std::memcpy(segment, &header, sizeof(header));
+}
+
+}  // namespace
+
+// static
+ValueLog ValueLog::Create(BlobStore* blob_store,
+                          std::size_t segment_size,
+                          std::size_t threshold) {
+  BlobStoreObject<ValueLogHeader> header = blob_store->New<ValueLogHeader>();
+  ValueLog log(blob_store, header.Index());
+  header->segment_size = segment_size;
+  header->threshold = threshold;
+  header->active = log.NewSegment(segment_size).Index();
+  header->oldest = header->active;
+  header->num_segments = 1;
+  return log;
+}
+
+// static
+ValueLog ValueLog::Open(BlobStore* blob_store, std::size_t log_index) {
+  return ValueLog(blob_store, log_index);
+}
+
+BlobStoreObject<ValueRef> ValueLog::Put(blob_store::Transaction* transaction,
+                                        const StringSlice& key,
+                                        const StringSlice& value) {
+  std::size_t threshold;
+  {
+    BlobStoreObject<const ValueLogHeader> header =
+        blob_store_->Get<ValueLogHeader>(log_index_);
+    threshold = header->threshold;
+  }
+  ValueRef ref;
+  if (value.size() <= threshold) {
+    // Small values aren't worth a log entry, and their blobs are dropped with
+    // the transaction if it aborts.
+    BlobStoreObject<char[]> blob =
+        transaction->New<char[]>(std::max<std::size_t>(value.size(), 1));
+    std::memcpy(&blob[0], value.data(), value.size());
+    ref = {ValueRef::kInline, blob.Index(), value.size()};
+  } else {
+    ref = Append(key, value);
+  }
+  return transaction->New<ValueRef>(ref);
+}
+
+std::string ValueLog::Get(const ValueRef& ref) const {
+  if (ref.segment == ValueRef::kInline) {
+    BlobStoreObject<const char[]> blob = blob_store_->Get<char[]>(ref.offset);
+    return std::string(&blob[0], ref.length);
+  }
+  BlobStoreObject<const std::uint64_t[]> segment =
+      blob_store_->Get<std::uint64_t[]>(ref.segment);
+  const char* bytes = reinterpret_cast<const char*>(&segment[0]);
+  return std::string(bytes + ref.offset, ref.length);
+}
+
+std::size_t ValueLog::Collect(blob_store::Transaction* transaction,
+                              const LiveCheck& is_live,
+                              const Relocate& relocate) {
+  std::size_t segment_index;
+  {
+    BlobStoreObject<const ValueLogHeader> header =
+        blob_store_->Get<ValueLogHeader>(log_index_);
+    if (header->oldest == header->active) {
+      return BlobStore::InvalidIndex;
+    }
+    segment_index = header->oldest;
+  }
+  // The segment is sealed, so nothing writes to it while it's read.
+  BlobStoreObject<const std::uint64_t[]> segment =
+      blob_store_->Get<std::uint64_t[]>(segment_index);
+  SegmentHeader segment_header = ReadSegmentHeader(&segment[0]);
+  const char* bytes = reinterpret_cast<const char*>(&segment[0]);
+  std::size_t offset = sizeof(SegmentHeader);
+  while (offset < segment_header.used) {
+    EntryHeader entry;
+    std::memcpy(&entry, bytes + offset, sizeof(entry));
+    const char* key_data = bytes + offset + sizeof(EntryHeader);
+    StringSlice key(key_data, 0, entry.key_size);
+    ValueRef ref = {segment_index,
+                    offset + sizeof(EntryHeader) + entry.key_size,
+                    entry.value_size};
+    if (is_live(key, ref)) {
+      StringSlice value(bytes + ref.offset, 0, ref.length);
+      relocate(key, transaction->New<ValueRef>(Append(key, value)).Downgrade());
+    }
+    offset += EntrySize(entry.key_size, entry.value_size);
+  }
+  return segment_index;
+}
+
+void ValueLog::DropSegment(std::size_t segment_index) {
+  BlobStoreObject<ValueLogHeader> header =
+      blob_store_->GetMutable<ValueLogHeader>(log_index_);
+  assert(header->oldest == segment_index && header->active != segment_index);
+  {
+    BlobStoreObject<const std::uint64_t[]> segment =
+        blob_store_->Get<std::uint64_t[]>(segment_index);
+    header->oldest = ReadSegmentHeader(&segment[0]).next;
+  }
+  --header->num_segments;
+  blob_store_->Drop(segment_index);
+}
+
+std::size_t ValueLog::GetNumSegments() const {
+  return blob_store_->Get<ValueLogHeader>(log_index_)->num_segments;
+}
+
+ValueRef ValueLog::Append(const StringSlice& key, const StringSlice& value) {
+  // Entry headers record sizes in 32 bits.
+  if (key.size() > std::numeric_limits<std::uint32_t>::max() ||
+      value.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("ValueLog: entry too large");
+  }
+  std::size_t entry_size = EntrySize(key.size(), value.size());
+  // The header's write lock serializes appends.
+  BlobStoreObject<ValueLogHeader> header =
+      blob_store_->GetMutable<ValueLogHeader>(log_index_);
+  BlobStoreObject<std::uint64_t[]> segment =
+      blob_store_->GetMutable<std::uint64_t[]>(header->active);
+  SegmentHeader segment_header = ReadSegmentHeader(&segment[0]);
+  if (segment_header.used + entry_size > segment_header.capacity) {
+    // Seal the active segment. A value larger than a segment gets a segment
+    // of its own.
+    BlobStoreObject<std::uint64_t[]> next = NewSegment(std::max(
+        header->segment_size, sizeof(SegmentHeader) + entry_size));
+    segment_header.next = next.Index();
+    WriteSegmentHeader(&segment[0], segment_header);
+    header->active = next.Index();
+    ++header->num_segments;
+    segment = std::move(next);
+    segment_header = ReadSegmentHeader(&segment[0]);
+  }
+
+  char* entry_data = reinterpret_cast<char*>(&segment[0]) + segment_header.used;
+  EntryHeader entry = {static_cast<std::uint32_t>(key.size()),
+                       static_cast<std::uint32_t>(value.size())};
+  std::memcpy(entry_data, &entry, sizeof(entry));
+  std::memcpy(entry_data + sizeof(entry), key.data(), key.size());
+  std::memcpy(entry_data + sizeof(entry) + key.size(), value.data(),
+              value.size());
+  ValueRef ref = {segment.Index(),
+                  segment_header.used + sizeof(entry) + key.size(),
+                  value.size()};
+  segment_header.used += entry_size;
+  WriteSegmentHeader(&segment[0], segment_header);
+  return ref;
+}
+
+BlobStoreObject<std::uint64_t[]> ValueLog::NewSegment(std::size_t capacity) {
+  std::size_t num_words = (capacity + 7) / 8;
+  BlobStoreObject<std::uint64_t[]> segment =
+      blob_store_->New<std::uint64_t[]>(num_words);
+  SegmentHeader header = {num_words * 8, sizeof(SegmentHeader),
+                          BlobStore::InvalidIndex};
+  WriteSegmentHeader(&segment[0], header);
+  return segment;
+}
+
+}  // namespace value_log
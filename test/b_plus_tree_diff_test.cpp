@@ -0,0 +1,127 @@
+#include <map>
+#include <random>
+#include <vector>
+
+#include "b_plus_tree.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace b_plus_tree;
+
+class BPlusTreeDiffTest : public ::testing::Test {
+ protected:
+  using Tree = BPlusTree<int, int, 16>;
+  using Entry = DiffEntry<int, int>;
+
+  virtual void SetUp() {
+    ChunkManager dataBuffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                            4 * utils::GetPageSize());
+    blob_store = new BlobStore(TestMemoryBufferFactory::Get(), "MetadataBuffer",
+                               4096, std::move(dataBuffer));
+  }
+
+  virtual void TearDown() {
+    // cleanup the BlobStore
+    delete blob_store;
+  }
+
+  std::vector<Entry> Diff(Tree* tree, size_t from, size_t to) {
+    std::vector<Entry> entries;
+    EXPECT_TRUE(tree->Diff(from, to, [&entries](const Entry& entry) {
+      entries.push_back(entry);
+    }));
+    return entries;
+  }
+
+  BlobStore* blob_store;
+};
+
+TEST_F(BPlusTreeDiffTest, SameVersionIsEmpty) {
+  Tree tree(*blob_store);
+  for (int i = 0; i < 100; ++i) {
+    tree.Insert(i, i);
+  }
+  EXPECT_TRUE(Diff(&tree, 100, 100).empty());
+  EXPECT_FALSE(tree.Diff(0, 101, [](const Entry&) {}));
+}
+
+TEST_F(BPlusTreeDiffTest, InsertedDeletedAndChanged) {
+  Tree tree(*blob_store);
+  for (int i = 0; i < 200; ++i) {
+    tree.Insert(i, i);
+  }
+  {
+    auto txn = tree.CreateTransaction();
+    txn.Insert(1000, 1000);
+    txn.Delete(50);
+    txn.Delete(120);
+    txn.Insert(120, 1200);
+    ASSERT_TRUE(std::move(txn).Commit());
+  }
+  std::vector<Entry> entries = Diff(&tree, 200, 201);
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries[0].type, DiffType::kDeleted);
+  EXPECT_EQ(*entries[0].key, 50);
+  EXPECT_EQ(*entries[0].old_value, 50);
+  EXPECT_EQ(entries[0].new_value, nullptr);
+  EXPECT_EQ(entries[1].type, DiffType::kChanged);
+  EXPECT_EQ(*entries[1].key, 120);
+  EXPECT_EQ(*entries[1].old_value, 120);
+  EXPECT_EQ(*entries[1].new_value, 1200);
+  EXPECT_EQ(entries[2].type, DiffType::kInserted);
+  EXPECT_EQ(*entries[2].key, 1000);
+  EXPECT_EQ(entries[2].old_value, nullptr);
+  EXPECT_EQ(*entries[2].new_value, 1000);
+
+  // Diffing in the other direction swaps inserts and deletes.
+  entries = Diff(&tree, 201, 200);
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries[0].type, DiffType::kInserted);
+  EXPECT_EQ(entries[1].type, DiffType::kChanged);
+  EXPECT_EQ(entries[2].type, DiffType::kDeleted);
+}
+
+// Compares diffs between random pairs of versions with the difference of
+// in-memory models of those versions.
+TEST_F(BPlusTreeDiffTest, MatchesModel) {
+  Tree tree(*blob_store);
+  std::vector<std::map<int, int>> models(1);
+  std::mt19937 generator(7);
+  std::uniform_int_distribution<int> key_distribution(0, 300);
+  for (int version = 1; version <= 150; ++version) {
+    std::map<int, int> model = models.back();
+    auto txn = tree.CreateTransaction();
+    for (int op = 0; op < 4; ++op) {
+      int key = key_distribution(generator);
+      if (model.count(key) > 0) {
+        txn.Delete(key);
+        model.erase(key);
+      } else {
+        txn.Insert(key, version);
+        model[key] = version;
+      }
+    }
+    ASSERT_TRUE(std::move(txn).Commit());
+    models.push_back(std::move(model));
+  }
+
+  for (size_t from = 0; from < models.size(); from += 13) {
+    for (size_t to = 0; to < models.size(); to += 17) {
+      std::vector<Entry> entries = Diff(&tree, from, to);
+      std::map<int, int> model = models[from];
+      int last_key = -1;
+      for (const Entry& entry : entries) {
+        EXPECT_GT(*entry.key, last_key);
+        last_key = *entry.key;
+        if (entry.type == DiffType::kDeleted) {
+          model.erase(*entry.key);
+        } else {
+          model[*entry.key] = *entry.new_value;
+        }
+      }
+      EXPECT_EQ(model, models[to]) << "from " << from << " to " << to;
+    }
+  }
+}
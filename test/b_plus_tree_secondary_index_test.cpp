@@ -0,0 +1,103 @@
+#include "b_plus_tree.h"
+#include "b_plus_tree_secondary_index.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace b_plus_tree;
+
+class BPlusTreeSecondaryIndexTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ChunkManager dataBuffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                            4 * utils::GetPageSize());
+    blob_store = new BlobStore(TestMemoryBufferFactory::Get(), "MetadataBuffer",
+                               4096, std::move(dataBuffer));
+  }
+
+  virtual void TearDown() {
+    // cleanup the BlobStore
+    delete blob_store;
+  }
+
+  BlobStore* blob_store;
+};
+
+// Indexes the values of a tree and verifies that inserts and deletes on the
+// primary tree are reflected in the index, and that index entries share the
+// primary tree's value blobs.
+TEST_F(BPlusTreeSecondaryIndexTest, TracksInsertsAndDeletes) {
+  BPlusTree<int, int, 16> tree(*blob_store);
+  SecondaryIndex<int, int, int, 16> index(
+      *blob_store, &tree, 0, [](const int& key, const int& value) {
+        return value;
+      });
+  for (int i = 0; i < 100; i++) {
+    tree.Insert(i, i * 100);
+  }
+  for (int i = 0; i < 100; i++) {
+    auto it = index.Search(i * 100);
+    ASSERT_NE(it.GetKey(), nullptr);
+    EXPECT_EQ(*it.GetKey(), i * 100);
+    EXPECT_EQ(*it.GetValue(), i * 100);
+    EXPECT_EQ(it.GetValue().Index(), tree.Search(i).GetValue().Index());
+  }
+  for (int i = 0; i < 100; i += 2) {
+    tree.Delete(i);
+  }
+  for (int i = 0; i < 100; i++) {
+    auto it = index.Search(i * 100);
+    if (i % 2 == 0) {
+      EXPECT_TRUE(it.GetKey() == nullptr || *it.GetKey() != i * 100);
+    } else {
+      ASSERT_NE(it.GetKey(), nullptr);
+      EXPECT_EQ(*it.GetValue(), i * 100);
+    }
+  }
+}
+
+// Creating an index on a tree that already has entries indexes those entries.
+TEST_F(BPlusTreeSecondaryIndexTest, IndexesExistingEntries) {
+  BPlusTree<int, int, 8> tree(*blob_store);
+  for (int i = 0; i < 50; i++) {
+    tree.Insert(i, i * 100);
+  }
+  SecondaryIndex<std::string, int, int, 8> index(
+      *blob_store, &tree, 1, [](const int& key, const int& value) {
+        return "V" + std::to_string(value);
+      });
+  for (int i = 0; i < 50; i++) {
+    auto it = index.Search("V" + std::to_string(i * 100));
+    ASSERT_NE(it.GetValue(), nullptr);
+    EXPECT_EQ(*it.GetValue(), i * 100);
+  }
+}
+
+// Index updates made in an aborted transaction are discarded along with the
+// primary tree's updates.
+TEST_F(BPlusTreeSecondaryIndexTest, AbortDiscardsIndexUpdates) {
+  BPlusTree<int, int, 4> tree(*blob_store);
+  SecondaryIndex<int, int, int, 4> index(
+      *blob_store, &tree, 0, [](const int& key, const int& value) {
+        return -key;
+      });
+  for (int i = 0; i < 10; i++) {
+    tree.Insert(i, i * 100);
+  }
+  auto txn = tree.CreateTransaction();
+  for (int i = 10; i < 20; i++) {
+    txn.Insert(i, i * 100);
+  }
+  std::move(txn).Abort();
+  for (int i = 0; i < 20; i++) {
+    auto it = index.Search(-i);
+    if (i < 10) {
+      ASSERT_NE(it.GetKey(), nullptr);
+      EXPECT_EQ(*it.GetKey(), -i);
+      EXPECT_EQ(*it.GetValue(), i * 100);
+    } else {
+      EXPECT_TRUE(it.GetKey() == nullptr || *it.GetKey() != -i);
+    }
+  }
+}
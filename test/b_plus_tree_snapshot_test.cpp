@@ -0,0 +1,125 @@
+#include "b_plus_tree.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace b_plus_tree;
+
+class BPlusTreeSnapshotTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ChunkManager dataBuffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                            4 * utils::GetPageSize());
+    blob_store = new BlobStore(TestMemoryBufferFactory::Get(), "MetadataBuffer",
+                               4096, std::move(dataBuffer));
+  }
+
+  virtual void TearDown() {
+    // cleanup the BlobStore
+    delete blob_store;
+  }
+
+  BlobStore* blob_store;
+};
+
+// Every insert commits a new version. Verifies that each historical version
+// contains exactly the keys inserted up to that point.
+TEST_F(BPlusTreeSnapshotTest, EveryVersionIsReadable) {
+  BPlusTree<int, int, 8> tree(*blob_store);
+  constexpr int kNumVersions = 200;
+  for (int i = 0; i < kNumVersions; i++) {
+    tree.Insert(i, i * 100);
+  }
+  for (int version = 0; version <= kNumVersions; version += 7) {
+    auto snapshot = tree.OpenSnapshot(version);
+    ASSERT_TRUE(snapshot.is_valid());
+    EXPECT_EQ(snapshot.version(), version);
+    int count = 0;
+    for (auto it = snapshot.First(); it.GetKey() != nullptr; ++it) {
+      EXPECT_EQ(*it.GetKey(), count);
+      EXPECT_EQ(*it.GetValue(), count * 100);
+      ++count;
+    }
+    EXPECT_EQ(count, version);
+    EXPECT_EQ(snapshot.Size(), version);
+    EXPECT_EQ(snapshot.Rank(version / 2), version / 2);
+    EXPECT_EQ(snapshot.Count(version / 2, version), version - version / 2);
+    if (version > 0) {
+      EXPECT_EQ(*snapshot.Select(version - 1).GetKey(), version - 1);
+    }
+    EXPECT_EQ(snapshot.Select(version).GetKey(), nullptr);
+    auto it = snapshot.Search(version);
+    EXPECT_EQ(it.GetKey(), nullptr);
+  }
+}
+
+// A snapshot keeps reading the same version while writers commit new ones.
+TEST_F(BPlusTreeSnapshotTest, SnapshotIsIsolatedFromLaterCommits) {
+  BPlusTree<int, int, 4> tree(*blob_store);
+  for (int i = 0; i < 50; i++) {
+    tree.Insert(i, i * 100);
+  }
+  auto snapshot = tree.OpenSnapshot(50);
+  ASSERT_TRUE(snapshot.is_valid());
+  for (int i = 50; i < 100; i++) {
+    tree.Insert(i, i * 100);
+  }
+  {
+    auto txn = tree.CreateTransaction();
+    txn.Insert(25, 1);
+    std::move(txn).Commit();
+  }
+  for (int i = 0; i < 100; i++) {
+    auto it = snapshot.Search(i);
+    if (i < 50) {
+      ASSERT_NE(it.GetKey(), nullptr);
+      EXPECT_EQ(*it.GetKey(), i);
+      EXPECT_EQ(*it.GetValue(), i * 100);
+    } else {
+      EXPECT_EQ(it.GetKey(), nullptr);
+    }
+  }
+  EXPECT_NE(tree.Search(99).GetKey(), nullptr);
+}
+
+// Versions that were never committed can't be opened.
+TEST_F(BPlusTreeSnapshotTest, MissingVersion) {
+  BPlusTree<int, int, 4> tree(*blob_store);
+  for (int i = 0; i < 10; i++) {
+    tree.Insert(i, i * 100);
+  }
+  auto snapshot = tree.OpenSnapshot(11);
+  EXPECT_FALSE(snapshot.is_valid());
+  EXPECT_EQ(snapshot.Search(1).GetKey(), nullptr);
+  EXPECT_EQ(snapshot.First().GetKey(), nullptr);
+}
+
+// History is kept for every committed version and costs each commit its old
+// head plus one path of HistoryNodes. Transactions only append to the history
+// when they commit.
+TEST_F(BPlusTreeSnapshotTest, HistoryRetention) {
+  BPlusTree<int, int, 8> tree(*blob_store);
+  for (int i = 0; i < 40; i++) {
+    tree.Insert(i, i);
+  }
+  std::size_t size = blob_store->GetSize();
+  {
+    auto txn = tree.CreateTransaction();
+    // Only the new head exists until the commit.
+    EXPECT_EQ(blob_store->GetSize(), size + 1);
+    std::move(txn).Abort();
+  }
+  EXPECT_EQ(blob_store->GetSize(), size);
+
+  for (std::size_t version = 40; version < 100; ++version) {
+    std::size_t before = blob_store->GetSize();
+    auto txn = tree.CreateTransaction();
+    ASSERT_TRUE(std::move(txn).Commit());
+    EXPECT_LE(blob_store->GetSize() - before,
+              1 + blob_store::GetHistoryDepth(version + 1));
+  }
+  for (int version = 0; version <= 100; ++version) {
+    EXPECT_TRUE(tree.OpenSnapshot(version).is_valid());
+  }
+}
@@ -1,4 +1,13 @@
 #include "b_plus_tree.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 #include "chunk_manager.h"
 #include "gtest/gtest.h"
 #include "test_memory_buffer_factory.h"
@@ -41,6 +50,21 @@ TEST_F(BPlusTreeTest, BasicTree) {
 // Sanity check concurrent version of BasicTree.  Spawns 10 threads, each of
 // which inserts 10 elements into the tree.  Then, verifies that all 100
 // elements are in the tree.
+// A store whose head was created with another hash version is rejected,
+// because the key hashes persisted in it can't be compared with new ones.
+TEST_F(BPlusTreeTest, RejectsOtherHashVersion) {
+  {
+    BPlusTree<int, int, 8> tree(*blob_store);
+    tree.Insert(1, 100);
+  }
+  BPlusTree<int, int, 8> reopened(*blob_store);
+  EXPECT_EQ(*reopened.Search(1).GetValue(), 100);
+
+  blob_store->GetMutable<blob_store::HeadNode>(1)->hash_version =
+      hashing::kHashVersion + 1;
+  EXPECT_THROW((BPlusTree<int, int, 8>(*blob_store)), std::runtime_error);
+}
+
 TEST_F(BPlusTreeTest, BasicTreeConcurrent) {
   BPlusTree<int, int, 4> tree(*blob_store);
   std::vector<std::thread> threads;
@@ -454,4 +478,294 @@ TEST_F(BPlusTreeTest, StringInsertion) {
     BlobStoreObject<const std::string> deleted = tree.Delete(key);
     EXPECT_EQ(*deleted, value);
   }
-}
\ No newline at end of file
+}
+// Checks Size, Rank, Select and Count against a sorted copy of the keys.
+template <typename Tree>
+void ExpectOrderStatistics(Tree* tree, const std::set<int>& keys) {
+  std::vector<int> sorted(keys.begin(), keys.end());
+  EXPECT_EQ(tree->Size(), sorted.size());
+  for (size_t k = 0; k < sorted.size(); ++k) {
+    auto it = tree->Select(k);
+    ASSERT_NE(it.GetKey(), nullptr) << k;
+    EXPECT_EQ(*it.GetKey(), sorted[k]);
+  }
+  EXPECT_EQ(tree->Select(sorted.size()).GetKey(), nullptr);
+  for (int key = -1; key <= 1000; key += 3) {
+    size_t rank = std::lower_bound(sorted.begin(), sorted.end(), key) -
+                  sorted.begin();
+    EXPECT_EQ(tree->Rank(key), rank) << key;
+    size_t upper = std::lower_bound(sorted.begin(), sorted.end(), key + 100) -
+                   sorted.begin();
+    EXPECT_EQ(tree->Count(key, key + 100), upper - rank) << key;
+  }
+}
+
+// Subtree counts stay exact through the splits, borrows and merges of
+// inserting and deleting in random order.
+TEST_F(BPlusTreeTest, OrderStatistics) {
+  BPlusTree<int, int, 4> tree(*blob_store);
+  std::vector<int> keys;
+  for (int i = 0; i < 500; ++i) {
+    keys.push_back(2 * i);
+  }
+  std::mt19937 rng(3);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  std::set<int> inserted;
+  for (int key : keys) {
+    tree.Insert(key, key);
+    inserted.insert(key);
+  }
+  ExpectOrderStatistics(&tree, inserted);
+
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (size_t i = 0; i < 300; ++i) {
+    EXPECT_NE(tree.Delete(keys[i]), nullptr);
+    inserted.erase(keys[i]);
+    // Deleting a key that isn't there doesn't change any count.
+    EXPECT_EQ(tree.Delete(keys[i] + 1), nullptr);
+  }
+  ExpectOrderStatistics(&tree, inserted);
+
+  EXPECT_EQ(tree.Count(500, 100), 0);
+  EXPECT_EQ(tree.Count(100, 100), 0);
+}
+
+// Aggregates the first and last value of a range and whether the values came
+// in ascending order. Combine isn't commutative, so this catches subtrees
+// combined out of order.
+struct OrderAggregate {
+  struct ValueType {
+    bool empty;
+    bool ascending;
+    int first;
+    int last;
+  };
+
+  static ValueType Identity() { return {true, true, 0, 0}; }
+
+  static ValueType Lift(int value) { return {false, true, value, value}; }
+
+  static ValueType Combine(const ValueType& lhs, const ValueType& rhs) {
+    if (lhs.empty) {
+      return rhs;
+    }
+    if (rhs.empty) {
+      return lhs;
+    }
+    return {false, lhs.ascending && rhs.ascending && lhs.last < rhs.first,
+            lhs.first, rhs.last};
+  }
+};
+
+// Range sums stay exact through the splits, borrows and merges of inserting
+// and deleting in random order.
+TEST_F(BPlusTreeTest, SumAggregate) {
+  BPlusTree<int, int, 4, SumAggregate<long>> tree(*blob_store);
+  std::vector<int> keys;
+  for (int i = 0; i < 400; ++i) {
+    keys.push_back(2 * i);
+  }
+  std::mt19937 rng(5);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  std::set<int> inserted;
+  for (int key : keys) {
+    tree.Insert(key, key * 10);
+    inserted.insert(key);
+  }
+  int first_key = keys.front();
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (size_t i = 0; i < 250; ++i) {
+    tree.Delete(keys[i]);
+    inserted.erase(keys[i]);
+  }
+
+  for (int i = 0; i < 300; ++i) {
+    int lo = static_cast<int>(rng() % 900) - 50;
+    int hi = lo + static_cast<int>(rng() % 400);
+    long expected = 0;
+    for (auto it = inserted.lower_bound(lo);
+         it != inserted.end() && *it < hi; ++it) {
+      expected += *it * 10;
+    }
+    EXPECT_EQ(tree.Aggregate(lo, hi), expected) << lo << " " << hi;
+  }
+  EXPECT_EQ(tree.Aggregate(100, 100), 0);
+  EXPECT_EQ(tree.Aggregate(200, 100), 0);
+
+  // Snapshots aggregate their own version.
+  auto snapshot = tree.OpenSnapshot(1);
+  EXPECT_EQ(snapshot.Aggregate(-1, 1000), first_key * 10);
+}
+
+TEST_F(BPlusTreeTest, AggregateCombinesInKeyOrder) {
+  BPlusTree<int, int, 4, OrderAggregate> tree(*blob_store);
+  std::vector<int> keys;
+  for (int i = 0; i < 300; ++i) {
+    keys.push_back(i);
+  }
+  std::mt19937 rng(11);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (int key : keys) {
+    tree.Insert(key, key);
+  }
+  for (int lo = 0; lo < 300; lo += 13) {
+    for (int hi = lo + 1; hi <= 300; hi += 29) {
+      OrderAggregate::ValueType aggregate = tree.Aggregate(lo, hi);
+      EXPECT_FALSE(aggregate.empty);
+      EXPECT_TRUE(aggregate.ascending) << lo << " " << hi;
+      EXPECT_EQ(aggregate.first, lo);
+      EXPECT_EQ(aggregate.last, hi - 1);
+    }
+  }
+  EXPECT_TRUE(tree.Aggregate(300, 400).empty);
+}
+
+// Lazy deletes leave nodes underfull and keep separators whose keys are gone.
+// Compact packs the entries back into full nodes, and the compacted tree
+// takes eager deletes.
+TEST_F(BPlusTreeTest, LazyDeleteAndCompact) {
+  BPlusTree<int, int, 4, SumAggregate<long>> tree(*blob_store);
+  tree.SetRebalancePolicy(RebalancePolicy::kLazy);
+  std::vector<int> keys;
+  for (int i = 0; i < 500; ++i) {
+    keys.push_back(2 * i);
+  }
+  std::mt19937 rng(7);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  std::set<int> inserted;
+  for (int key : keys) {
+    tree.Insert(key, key);
+    inserted.insert(key);
+  }
+
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (size_t i = 0; i < 400; ++i) {
+    EXPECT_EQ(*tree.Delete(keys[i]), keys[i]);
+    inserted.erase(keys[i]);
+    EXPECT_EQ(tree.Delete(keys[i]), nullptr);
+  }
+  ExpectOrderStatistics(&tree, inserted);
+  for (size_t i = 0; i < 400; ++i) {
+    auto it = tree.Search(keys[i]);
+    if (it.GetKey() != nullptr) {
+      EXPECT_GT(*it.GetKey(), keys[i]);
+    }
+  }
+
+  tree.Compact();
+  ExpectOrderStatistics(&tree, inserted);
+  long sum = 0;
+  for (int key : inserted) {
+    sum += key;
+  }
+  EXPECT_EQ(tree.Aggregate(-1, 1000), sum);
+
+  // Deleted keys can be inserted again, in between the stale separators.
+  for (size_t i = 0; i < 100; ++i) {
+    tree.Insert(keys[i], keys[i]);
+    inserted.insert(keys[i]);
+  }
+  tree.SetRebalancePolicy(RebalancePolicy::kEager);
+  for (size_t i = 400; i < 500; ++i) {
+    EXPECT_EQ(*tree.Delete(keys[i]), keys[i]);
+    inserted.erase(keys[i]);
+  }
+  ExpectOrderStatistics(&tree, inserted);
+}
+
+// Compact commits one step at a time, so it makes progress while a writer
+// keeps committing, and neither loses the other's changes.
+TEST_F(BPlusTreeTest, CompactWithConcurrentWriter) {
+  BPlusTree<int, int, 4> tree(*blob_store);
+  tree.SetRebalancePolicy(RebalancePolicy::kLazy);
+  std::set<int> inserted;
+  for (int i = 0; i < 1000; ++i) {
+    tree.Insert(i, i);
+    if (i % 4 == 0) {
+      inserted.insert(i);
+    }
+  }
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 4 != 0) {
+      EXPECT_EQ(*tree.Delete(i), i);
+    }
+  }
+
+  // The writer adds keys on both sides of the compaction and deletes some of
+  // the keys it is compacting.
+  std::thread writer([&tree]() {
+    for (int i = 0; i < 250; ++i) {
+      tree.Insert(1000 + i, 1000 + i);
+      tree.Insert(4 * i + 1, 4 * i + 1);
+      if (i % 5 == 0) {
+        tree.Delete(4 * i);
+      }
+    }
+  });
+  tree.Compact();
+  writer.join();
+  for (int i = 0; i < 250; ++i) {
+    inserted.insert(1000 + i);
+    inserted.insert(4 * i + 1);
+    if (i % 5 == 0) {
+      inserted.erase(4 * i);
+    }
+  }
+  ExpectOrderStatistics(&tree, inserted);
+
+  tree.Compact();
+  ExpectOrderStatistics(&tree, inserted);
+  for (int key : inserted) {
+    auto it = tree.Search(key);
+    ASSERT_NE(it.GetKey(), nullptr) << key;
+    EXPECT_EQ(*it.GetValue(), key);
+  }
+}
+
+// Leaves of uint64_t keys are searched in their packed copy of the keys, which
+// has to follow the keys through splits, borrows, merges and Compact. Keys far
+// apart pack at the full 64 bits.
+TEST_F(BPlusTreeTest, PackedIntegerKeys) {
+  BPlusTree<uint64_t, int, 4> tree(*blob_store);
+  std::vector<uint64_t> keys;
+  for (int i = 0; i < 300; ++i) {
+    keys.push_back(i % 2 == 0 ? 1000 + 3 * i
+                              : std::numeric_limits<uint64_t>::max() - 3 * i);
+  }
+  std::mt19937 rng(11);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  std::set<uint64_t> inserted;
+  for (uint64_t key : keys) {
+    tree.Insert(key, static_cast<int>(key % 1000));
+    inserted.insert(key);
+  }
+
+  auto expect_contents = [&]() {
+    std::vector<uint64_t> sorted(inserted.begin(), inserted.end());
+    for (uint64_t key : keys) {
+      size_t rank = std::lower_bound(sorted.begin(), sorted.end(), key) -
+                    sorted.begin();
+      EXPECT_EQ(tree.Rank(key), rank) << key;
+      auto it = tree.Search(key);
+      if (inserted.count(key) > 0) {
+        ASSERT_NE(it.GetKey(), nullptr) << key;
+        EXPECT_EQ(*it.GetKey(), key);
+        EXPECT_EQ(*it.GetValue(), static_cast<int>(key % 1000));
+      } else if (it.GetKey() != nullptr) {
+        EXPECT_GT(*it.GetKey(), key);
+      }
+    }
+  };
+  expect_contents();
+
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (size_t i = 0; i < 200; ++i) {
+    EXPECT_NE(tree.Delete(keys[i]), nullptr);
+    inserted.erase(keys[i]);
+    EXPECT_EQ(tree.Delete(keys[i]), nullptr);
+  }
+  expect_contents();
+
+  tree.Compact();
+  expect_contents();
+}
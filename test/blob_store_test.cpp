@@ -1,6 +1,13 @@
 #include "blob_store.h"
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
 #include "b_plus_tree_nodes.h"
 #include "chunk_manager.h"
 #include "fixed_string.h"
@@ -212,6 +219,29 @@ TEST_F(BlobStoreTest, BlobStoreObjectDrop2) {
   EXPECT_EQ(ptr3, nullptr);
 }
 
+// Readers share a blob, and dropping a blob while it's read leaves the readers
+// with a valid object.
+TEST_F(BlobStoreTest, BlobStoreObjectDropWhileReading) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  static_assert(std::is_same<decltype(std::declval<BlobStoreObject<int>>()
+                                          .GetBlobStore()),
+                             BlobStore*>::value,
+                "BlobStoreObjects call the concrete store");
+  size_t index = store.New<int>(64).Index();
+  BlobStoreObject<const int> reader1 = store.Get<int>(index);
+  BlobStoreObject<const int> reader2 = store.Get<int>(index);
+  ASSERT_NE(reader1, nullptr);
+  ASSERT_NE(reader2, nullptr);
+  store.Drop(index);
+  EXPECT_EQ(store.Get<int>(index), nullptr);
+  EXPECT_EQ(*reader2, 64);
+  reader1 = nullptr;
+  EXPECT_EQ(*reader2, 64);
+  reader2 = nullptr;
+  EXPECT_EQ(store.Get<int>(index), nullptr);
+}
+
 // Create blobs using FixedString, try to access them using BlobStoreObject.
 // Convert back to std::string or StringSlice and verify that the contents are
 // the same.
@@ -589,4 +619,400 @@ TEST_F(BlobStoreTest, SerializeTraitsBlobStoreObject) {
   ptr.Deserialize(&output);
 
   EXPECT_EQ(input.Index(), output.Index());
-}
\ No newline at end of file
+}
+// Resizes a blob within its allocation without moving it.
+TEST_F(BlobStoreTest, ResizeInPlace) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  BlobStoreObject<char[]> ptr1 = store.New<char[]>(64);
+  memset(&ptr1[0], 'a', 64);
+  char* data = &ptr1[0];
+
+  // Shrinking never moves a blob.
+  ASSERT_TRUE(ptr1.Resize(10));
+  EXPECT_EQ(&ptr1[0], data);
+  EXPECT_EQ(ptr1.GetSize(), 10);
+
+  // The allocation keeps its capacity, so growing back fits in place.
+  ASSERT_TRUE(ptr1.Resize(64));
+  EXPECT_EQ(&ptr1[0], data);
+  EXPECT_EQ(ptr1.GetSize(), 64);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(ptr1[i], 'a');
+  }
+}
+
+// Grows a blob that has no room to its right. It moves and every handle to it
+// follows.
+TEST_F(BlobStoreTest, ResizeRelocates) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  BlobStoreObject<int[]> ptr1 = store.New<int[]>(16);
+  BlobStoreObject<int[]> ptr2 = store.New<int[]>(16);
+  for (int i = 0; i < 16; i++) {
+    ptr1[i] = i;
+    ptr2[i] = -i;
+  }
+  BlobStoreObject<int[]> copy = ptr1;
+  int* data = &ptr1[0];
+  ASSERT_TRUE(ptr1.Resize(1024 * sizeof(int)));
+  EXPECT_NE(&ptr1[0], data);
+  EXPECT_EQ(&copy[0], &ptr1[0]);
+  EXPECT_EQ(ptr1.GetSize(), 1024 * sizeof(int));
+  for (int i = 16; i < 1024; i++) {
+    ptr1[i] = i;
+  }
+  for (int i = 0; i < 1024; i++) {
+    EXPECT_EQ(ptr1[i], i);
+  }
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(ptr2[i], -i);
+  }
+
+  // The blob keeps its index.
+  size_t index = ptr1.Index();
+  ptr1 = nullptr;
+  copy = nullptr;
+  BlobStoreObject<const int[]> reader = store.Get<int[]>(index);
+  EXPECT_EQ(reader[1023], 1023);
+  EXPECT_FALSE(store.Resize(BlobStore::InvalidIndex, 8));
+}
+
+// Puts blobs at chosen indices, as a replication follower does. The slots
+// skipped on the way stay reserved for later Puts, and replacing a live blob
+// waits for its readers.
+TEST_F(BlobStoreTest, PutAtIndex) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  int value = 5;
+  store.Put(5, &value, sizeof(value));
+  EXPECT_EQ(store.GetSize(), 1);
+  EXPECT_EQ(*store.Get<int>(5), 5);
+
+  // New doesn't hand out the reserved slots.
+  BlobStoreObject<int> other = store.New<int>(6);
+  EXPECT_EQ(other.Index(), 6);
+  value = 3;
+  store.Put(3, &value, sizeof(value));
+  EXPECT_EQ(*store.Get<int>(3), 3);
+  EXPECT_EQ(store.GetSize(), 3);
+
+  // A dropped slot is taken back off the free list.
+  store.Drop(std::move(other));
+  value = 6;
+  store.Put(6, &value, sizeof(value));
+  EXPECT_EQ(*store.Get<int>(6), 6);
+  EXPECT_EQ(store.New<int>(7).Index(), 7);
+
+  BlobStoreObject<const int> reader = store.Get<int>(5);
+  std::thread writer([&store]() {
+    int64_t replacement = 50;
+    store.Put(5, &replacement, sizeof(replacement), alignof(int64_t));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(*reader, 5);
+  reader = nullptr;
+  writer.join();
+  EXPECT_EQ(*store.Get<int64_t>(5), 50);
+  EXPECT_EQ(store.GetAlignment(5), alignof(int64_t));
+}
+
+// Fills several chunks, drops most blobs and defragments the store in small
+// steps. The survivors keep their indices and contents and move out of the
+// sparse chunks, except for a blob that's locked.
+TEST_F(BlobStoreTest, Defragment) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  std::vector<size_t> indices;
+  for (int i = 0; i < 400; i++) {
+    BlobStoreObject<int[]> blob = store.New<int[]>(16);
+    for (int j = 0; j < 16; j++) {
+      blob[j] = i;
+    }
+    indices.push_back(blob.Index());
+  }
+  ASSERT_GT(store.GetLiveBytesPerChunk().size(), 2);
+  for (int i = 0; i < 400; i++) {
+    if (i % 8 != 0) {
+      store.Drop(indices[i]);
+    }
+  }
+  std::vector<size_t> live_bytes = store.GetLiveBytesPerChunk();
+  size_t total_live_bytes = 0;
+  for (size_t bytes : live_bytes) {
+    total_live_bytes += bytes;
+  }
+  EXPECT_EQ(total_live_bytes, 50 * 16 * sizeof(int));
+
+  BlobStoreObject<const int[]> pinned = store.Get<int[]>(indices[392]);
+  size_t num_moved = 0;
+  while (size_t moved = store.Defragment(4)) {
+    EXPECT_LE(moved, 4);
+    num_moved += moved;
+  }
+  EXPECT_GT(num_moved, 0);
+  EXPECT_EQ(&store.Get<int[]>(indices[392])[0], &pinned[0]);
+
+  live_bytes = store.GetLiveBytesPerChunk();
+  EXPECT_LE(live_bytes.back(), 16 * sizeof(int));
+  size_t new_total_live_bytes = 0;
+  for (size_t bytes : live_bytes) {
+    new_total_live_bytes += bytes;
+  }
+  EXPECT_EQ(new_total_live_bytes, total_live_bytes);
+  for (int i = 0; i < 400; i += 8) {
+    BlobStoreObject<const int[]> blob = store.Get<int[]>(indices[i]);
+    for (int j = 0; j < 16; j++) {
+      EXPECT_EQ(blob[j], i);
+    }
+  }
+}
+
+// Defragments a store from a background thread while it's being read.
+TEST_F(BlobStoreTest, DefragmentConcurrentReaders) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  std::vector<size_t> indices;
+  for (int i = 0; i < 400; i++) {
+    BlobStoreObject<int[]> blob = store.New<int[]>(16);
+    for (int j = 0; j < 16; j++) {
+      blob[j] = i;
+    }
+    if (i % 4 == 0) {
+      indices.push_back(blob.Index());
+    } else {
+      store.Drop(std::move(blob));
+    }
+  }
+
+  std::atomic<bool> done(false);
+  std::thread defragmenter([&store, &done]() {
+    while (!done) {
+      store.Defragment(1);
+    }
+  });
+  for (int round = 0; round < 20; round++) {
+    for (size_t i = 0; i < indices.size(); i++) {
+      BlobStoreObject<const int[]> blob = store.Get<int[]>(indices[i]);
+      for (int j = 0; j < 16; j++) {
+        EXPECT_EQ(blob[j], static_cast<int>(i) * 4);
+      }
+    }
+  }
+  done = true;
+  defragmenter.join();
+}
+
+// Blobs above the large object threshold live outside the chunks, and so do
+// their clones.
+TEST_F(BlobStoreTest, LargeBlobClone) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer), /*large_object_threshold=*/1024);
+  BlobStoreObject<int[]> small = store.New<int[]>(16);
+  BlobStoreObject<int[]> large = store.New<int[]>(10000);
+  for (int i = 0; i < 10000; i++) {
+    large[i] = i;
+  }
+  BlobStoreObject<int[]> clone = large.Clone();
+  EXPECT_NE(clone.Index(), large.Index());
+  EXPECT_NE(&clone[0], &large[0]);
+  EXPECT_EQ(clone.GetSize(), 10000 * sizeof(int));
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_EQ(clone[i], i);
+  }
+
+  // Only the small blob takes up space in the chunks.
+  std::vector<size_t> live_bytes = store.GetLiveBytesPerChunk();
+  size_t total_live_bytes = 0;
+  for (size_t bytes : live_bytes) {
+    total_live_bytes += bytes;
+  }
+  EXPECT_LT(total_live_bytes, 1024);
+
+  store.Drop(std::move(large));
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_EQ(clone[i], i);
+  }
+}
+
+// Small blobs live in slabs rather than in the chunks, and move to the chunks
+// once they outgrow their size class.
+TEST_F(BlobStoreTest, SmallBlobsUseSlabs) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  std::vector<BlobStoreObject<int>> blobs;
+  for (int i = 0; i < 1000; i++) {
+    blobs.push_back(store.New<int>(i));
+  }
+  std::vector<size_t> live_bytes = store.GetLiveBytesPerChunk();
+  for (size_t bytes : live_bytes) {
+    EXPECT_EQ(bytes, 0);
+  }
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(*blobs[i], i);
+  }
+
+  BlobStoreObject<char[]> blob = store.New<char[]>(16);
+  memset(&blob[0], 'a', 16);
+  ASSERT_TRUE(blob.Resize(24));
+  ASSERT_TRUE(blob.Resize(256));
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(blob[i], 'a');
+  }
+  live_bytes = store.GetLiveBytesPerChunk();
+  EXPECT_EQ(live_bytes[0], 256);
+}
+
+// Blobs keep their alignment when they're created, cloned and moved.
+TEST_F(BlobStoreTest, AlignedNew) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  auto is_aligned = [](const void* ptr, size_t alignment) {
+    return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+  };
+  for (int i = 0; i < 20; i++) {
+    BlobStoreObject<int[]> padding = store.New<int[]>(i * 3 + 9);
+    BlobStoreObject<int[]> blob = store.New<int[]>(std::align_val_t{64}, 40);
+    EXPECT_TRUE(is_aligned(&blob[0], 64));
+    EXPECT_EQ(store.GetAlignment(blob.Index()), 64);
+    for (int j = 0; j < 40; j++) {
+      blob[j] = j;
+    }
+    BlobStoreObject<int[]> clone = blob.Clone();
+    EXPECT_TRUE(is_aligned(&clone[0], 64));
+    EXPECT_EQ(clone[39], 39);
+    ASSERT_TRUE(blob.Resize(4000));
+    EXPECT_TRUE(is_aligned(&blob[0], 64));
+    EXPECT_EQ(blob[39], 39);
+  }
+
+  // B+ tree nodes start on a cache line.
+  BlobStoreObject<LeafNode<16>> leaf = store.New<LeafNode<16>>();
+  EXPECT_TRUE(is_aligned(&*leaf, utils::kCacheLineSize));
+  BlobStoreObject<InternalNode<16>> internal =
+      store.New<InternalNode<16>>(std::align_val_t{128});
+  EXPECT_TRUE(is_aligned(&*internal, 128));
+}
+
+TEST_F(BlobStoreTest, NewNear) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  // Spread blobs over a few chunks.
+  std::vector<BlobStoreObject<int[]>> blobs;
+  for (int i = 0; i < 100; i++) {
+    blobs.push_back(store.New<int[]>(64));
+  }
+  size_t first_offset = store.GetOffset(blobs.front().Index());
+  size_t last_offset = store.GetOffset(blobs.back().Index());
+  ASSERT_NE(ChunkManager::chunk_index(first_offset),
+            ChunkManager::chunk_index(last_offset));
+
+  // Free a blob in the first chunk so both chunks have room.
+  store.Drop(std::move(blobs[1]));
+  blobs.erase(blobs.begin() + 1);
+  BlobStoreObject<int[]> near = store.NewNear<int[]>(blobs.back().Index(), 64);
+  EXPECT_EQ(ChunkManager::chunk_index(store.GetOffset(near.Index())),
+            ChunkManager::chunk_index(last_offset));
+
+  // Clones stay next to the original.
+  BlobStoreObject<int[]> clone = blobs.back().Clone();
+  EXPECT_EQ(ChunkManager::chunk_index(store.GetOffset(clone.Index())),
+            ChunkManager::chunk_index(last_offset));
+
+  // Without a live blob to place it near, NewNear behaves like New.
+  BlobStoreObject<int> fallback =
+      store.NewNear<int>(BlobStore::InvalidIndex, 1);
+  EXPECT_EQ(*fallback, 1);
+}
+
+// A handle owned by a thread_local that outlives the thread's control block
+// cache is freed to the heap and still releases its lock.
+TEST_F(BlobStoreTest, HandleOutlivesControlBlockCache) {
+  BlobStore store(TestMemoryBufferFactory::Get(), "MetadataBuffer", 4096,
+                  std::move(*dataBuffer));
+  size_t index = store.New<int>(42).Index();
+  std::thread thread([&store, index]() {
+    // The handle is constructed before the cache, so it's destroyed after it.
+    thread_local BlobStoreObject<const int> handle;
+    handle = store.Get<int>(index);
+    EXPECT_EQ(*handle, 42);
+  });
+  thread.join();
+  BlobStoreObject<int> writer = store.GetMutable<int>(index);
+  ASSERT_NE(writer, nullptr);
+  EXPECT_EQ(*writer, 42);
+}
+
+namespace {
+
+// Forwards to a buffer that's owned by someone else.
+class BufferView : public Buffer {
+ public:
+  explicit BufferView(Buffer* buffer) : buffer_(buffer) {}
+
+  const std::string& GetName() const override { return buffer_->GetName(); }
+  std::size_t GetSize() const override { return buffer_->GetSize(); }
+  void* GetData() override { return buffer_->GetData(); }
+  const void* GetData() const override { return buffer_->GetData(); }
+
+ private:
+  Buffer* buffer_;
+};
+
+// Hands out in-memory test buffers that outlive the stores using them, so a
+// store can be reopened by name without touching the file system.
+class RetainingBufferFactory : public BufferFactory {
+ public:
+  std::unique_ptr<Buffer> CreateBuffer(const std::string& name,
+                                       size_t size) override {
+    std::unique_ptr<Buffer>& buffer = buffers_[name];
+    if (buffer == nullptr) {
+      buffer = TestMemoryBufferFactory::Get()->CreateBuffer(name, size);
+    }
+    return std::unique_ptr<Buffer>(new BufferView(buffer.get()));
+  }
+
+ private:
+  std::map<std::string, std::unique_ptr<Buffer>> buffers_;
+};
+
+}  // namespace
+
+// A store built by a single-threaded tool can be opened by the concurrent
+// store.
+TEST_F(BlobStoreTest, SingleThreadedStoreOpensConcurrently) {
+  RetainingBufferFactory factory;
+  std::vector<size_t> indices;
+  {
+    SingleThreadedBlobStore store(
+        &factory, "SingleThreadedMetadata", 4096,
+        ChunkManager(&factory, "SingleThreadedData", 4096));
+    for (int i = 0; i < 100; ++i) {
+      BlobStoreObject<int[], SingleThreadedBlobStore> blob =
+          store.New<int[]>(i + 1);
+      for (int j = 0; j <= i; ++j) {
+        blob[j] = i;
+      }
+      indices.push_back(blob.Index());
+    }
+    // Dropped slots go on the shared free list.
+    for (int i = 0; i < 100; i += 2) {
+      store.Drop(indices[i]);
+    }
+    EXPECT_EQ(store.GetSize(), 50);
+  }
+
+  BlobStore store(&factory, "SingleThreadedMetadata", 4096,
+                  ChunkManager(&factory, "SingleThreadedData", 4096));
+  EXPECT_EQ(store.GetSize(), 50);
+  for (int i = 1; i < 100; i += 2) {
+    BlobStoreObject<const int[]> blob = store.Get<int[]>(indices[i]);
+    ASSERT_NE(blob, nullptr);
+    EXPECT_EQ(blob.GetSize(), (i + 1) * sizeof(int));
+    EXPECT_EQ(blob[i], i);
+  }
+  EXPECT_EQ(store.Get<int[]>(indices[0]), nullptr);
+  // The concurrent store reuses the slots freed by the single-threaded one.
+  size_t index = store.New<int>(7).Index();
+  EXPECT_NE(std::find(indices.begin(), indices.end(), index), indices.end());
+}
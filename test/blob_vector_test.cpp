@@ -0,0 +1,127 @@
+#include "blob_vector.h"
+
+#include <random>
+#include <vector>
+
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace blob_vector;
+
+class BlobVectorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ChunkManager dataBuffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                            4 * utils::GetPageSize());
+    blob_store = new BlobStore(TestMemoryBufferFactory::Get(), "MetadataBuffer",
+                               4096, std::move(dataBuffer));
+  }
+
+  virtual void TearDown() {
+    // cleanup the BlobStore
+    delete blob_store;
+  }
+
+  BlobStore* blob_store;
+};
+
+TEST_F(BlobVectorTest, Empty) {
+  BlobVector<int> vector = BlobVector<int>::Create(blob_store);
+  EXPECT_EQ(vector.GetSize(), 0);
+  vector.PopBack();
+  EXPECT_EQ(vector.GetSize(), 0);
+  vector.PushBack(42);
+  EXPECT_EQ(vector.GetSize(), 1);
+  EXPECT_EQ(vector.Get(0), 42);
+}
+
+// Grows a vector past several levels of the tree in one transaction.
+TEST_F(BlobVectorTest, PushBackAndGet) {
+  constexpr std::size_t kSize = 40000;
+  BlobVector<std::size_t> vector = BlobVector<std::size_t>::Create(blob_store);
+  auto txn = vector.CreateTransaction();
+  for (std::size_t i = 0; i < kSize; ++i) {
+    txn.PushBack(i * 3);
+  }
+  EXPECT_EQ(txn.GetSize(), kSize);
+  EXPECT_EQ(txn.Get(kSize - 1), (kSize - 1) * 3);
+  ASSERT_TRUE(std::move(txn).Commit());
+
+  EXPECT_EQ(vector.GetSize(), kSize);
+  auto snapshot = vector.OpenSnapshot();
+  for (std::size_t i = 0; i < kSize; ++i) {
+    EXPECT_EQ(snapshot.Get(i), i * 3);
+  }
+}
+
+// An update copies a single path of the tree and leaves older versions intact.
+TEST_F(BlobVectorTest, SnapshotsShareStructure) {
+  BlobVector<int> vector = BlobVector<int>::Create(blob_store);
+  auto txn = vector.CreateTransaction();
+  for (int i = 0; i < 5000; ++i) {
+    txn.PushBack(i);
+  }
+  ASSERT_TRUE(std::move(txn).Commit());
+
+  std::size_t blob_count = blob_store->GetSize();
+  vector.Set(1234, -1);
+  // A new head, a new root, one copied path of three nodes and a few history
+  // nodes.
+  EXPECT_LT(blob_store->GetSize() - blob_count, 10);
+  EXPECT_EQ(vector.Get(1234), -1);
+
+  auto snapshot = vector.OpenSnapshot(1);
+  ASSERT_TRUE(snapshot.is_valid());
+  EXPECT_EQ(snapshot.GetSize(), 5000);
+  EXPECT_EQ(snapshot.Get(1234), 1234);
+  EXPECT_FALSE(vector.OpenSnapshot(3).is_valid());
+  EXPECT_EQ(vector.OpenSnapshot(0).GetSize(), 0);
+}
+
+// Applies random operations and compares every version with a model.
+TEST_F(BlobVectorTest, MatchesModel) {
+  BlobVector<int> vector = BlobVector<int>::Create(blob_store);
+  std::vector<std::vector<int>> models(1);
+  std::mt19937 generator(11);
+  for (int version = 1; version <= 150; ++version) {
+    std::vector<int> model = models.back();
+    auto txn = vector.CreateTransaction();
+    int operation = generator() % 4;
+    std::size_t count = generator() % 100;
+    for (std::size_t i = 0; i < count; ++i) {
+      if (operation == 0 && !model.empty()) {
+        txn.PopBack();
+        model.pop_back();
+      } else if (operation == 1 && !model.empty()) {
+        std::size_t index = generator() % model.size();
+        txn.Set(index, version);
+        model[index] = version;
+      } else {
+        txn.PushBack(version);
+        model.push_back(version);
+      }
+    }
+    ASSERT_TRUE(std::move(txn).Commit());
+    models.push_back(std::move(model));
+  }
+
+  for (std::size_t version = 0; version < models.size(); ++version) {
+    auto snapshot = vector.OpenSnapshot(version);
+    ASSERT_TRUE(snapshot.is_valid());
+    ASSERT_EQ(snapshot.GetSize(), models[version].size());
+    for (std::size_t i = 0; i < snapshot.GetSize(); ++i) {
+      EXPECT_EQ(snapshot.Get(i), models[version][i]) << version << " " << i;
+    }
+  }
+
+  // Pop everything.
+  auto txn = vector.CreateTransaction();
+  while (txn.GetSize() > 0) {
+    txn.PopBack();
+  }
+  ASSERT_TRUE(std::move(txn).Commit());
+  EXPECT_EQ(vector.GetSize(), 0);
+  EXPECT_EQ(vector.OpenSnapshot(150).GetSize(), models.back().size());
+}
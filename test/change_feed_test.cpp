@@ -0,0 +1,150 @@
+#include "change_feed.h"
+
+#include "b_plus_tree.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace b_plus_tree;
+using blob_store::ChangeFeed;
+using blob_store::ChangeFeedRing;
+using blob_store::ChangeRecord;
+
+class ChangeFeedTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ChunkManager dataBuffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                            4 * utils::GetPageSize());
+    blob_store = new BlobStore(TestMemoryBufferFactory::Get(), "MetadataBuffer",
+                               4096, std::move(dataBuffer));
+  }
+
+  virtual void TearDown() {
+    // cleanup the BlobStore
+    delete blob_store;
+  }
+
+  void EnableChangeFeed(BPlusTree<int, int, 16>* tree) {
+    auto txn = tree->CreateTransaction();
+    txn.EnableChangeFeed();
+    ASSERT_TRUE(std::move(txn).Commit());
+  }
+
+  BlobStore* blob_store;
+};
+
+// A tree without a change feed has nothing to tail.
+TEST_F(ChangeFeedTest, Disabled) {
+  BPlusTree<int, int, 16> tree(*blob_store);
+  tree.Insert(1, 1);
+  ChangeFeed feed(blob_store, 1);
+  EXPECT_FALSE(feed.is_valid());
+  ChangeRecord record;
+  EXPECT_EQ(feed.Next(&record), ChangeFeed::Status::kPending);
+}
+
+// Every commit after a feed is opened is read in version order and matches
+// the tree's snapshot of that version.
+TEST_F(ChangeFeedTest, TailsCommits) {
+  BPlusTree<int, int, 16> tree(*blob_store);
+  EnableChangeFeed(&tree);
+  ChangeFeed feed(blob_store, 1);
+  ASSERT_TRUE(feed.is_valid());
+  EXPECT_EQ(feed.cursor(), 2);
+
+  ChangeRecord record;
+  EXPECT_EQ(feed.Next(&record), ChangeFeed::Status::kPending);
+  for (int i = 0; i < 10; ++i) {
+    tree.Insert(i, i * 10);
+  }
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(feed.Next(&record), ChangeFeed::Status::kOk);
+    EXPECT_EQ(record.version, i + 2);
+    // Each insert creates a key and a value.
+    EXPECT_EQ(record.new_objects, 2);
+    auto snapshot = tree.OpenSnapshot(record.version);
+    ASSERT_TRUE(snapshot.is_valid());
+    auto it = snapshot.Search(i);
+    ASSERT_NE(it.GetKey(), nullptr);
+    EXPECT_EQ(*it.GetValue(), i * 10);
+  }
+  EXPECT_EQ(feed.Next(&record), ChangeFeed::Status::kPending);
+
+  // A second consumer can replay the feed from an earlier version.
+  ChangeFeed replay(blob_store, 1);
+  replay.Seek(1);
+  ASSERT_EQ(replay.Next(&record), ChangeFeed::Status::kOk);
+  EXPECT_EQ(record.version, 1);
+}
+
+// Aborted and failed transactions are not published.
+TEST_F(ChangeFeedTest, AbortIsNotPublished) {
+  BPlusTree<int, int, 16> tree(*blob_store);
+  EnableChangeFeed(&tree);
+  ChangeFeed feed(blob_store, 1);
+  {
+    auto txn = tree.CreateTransaction();
+    txn.Insert(1, 1);
+    std::move(txn).Abort();
+  }
+  auto txn1 = tree.CreateTransaction();
+  auto txn2 = tree.CreateTransaction();
+  txn1.Insert(2, 2);
+  txn2.Insert(3, 3);
+  EXPECT_TRUE(std::move(txn1).Commit());
+  EXPECT_FALSE(std::move(txn2).Commit());
+
+  ChangeRecord record;
+  ASSERT_EQ(feed.Next(&record), ChangeFeed::Status::kOk);
+  EXPECT_EQ(record.version, 2);
+  EXPECT_EQ(feed.Next(&record), ChangeFeed::Status::kPending);
+}
+
+// A consumer that falls more than a ring's worth of versions behind is told
+// that it missed records.
+TEST_F(ChangeFeedTest, Overrun) {
+  BPlusTree<int, int, 16> tree(*blob_store);
+  EnableChangeFeed(&tree);
+  ChangeFeed feed(blob_store, 1);
+  for (int i = 0; i < ChangeFeedRing::kCapacity + 1; ++i) {
+    tree.Insert(i, i);
+  }
+  ChangeRecord record;
+  EXPECT_EQ(feed.Next(&record), ChangeFeed::Status::kOverrun);
+  feed.Seek(feed.cursor() + 1);
+  ASSERT_EQ(feed.Next(&record), ChangeFeed::Status::kOk);
+  EXPECT_EQ(record.version, 3);
+}
+
+// A commit whose record never made it into the ring, e.g. because the
+// committer died right after swapping the head, is read from its head.
+TEST_F(ChangeFeedTest, UnpublishedCommitIsReadFromHistory) {
+  BPlusTree<int, int, 16> tree(*blob_store);
+  EnableChangeFeed(&tree);
+  ChangeFeed published(blob_store, 1);
+  ChangeFeed unpublished(blob_store, 1);
+  tree.Insert(1, 10);
+  tree.Insert(2, 20);
+  ChangeRecord expected;
+  ASSERT_EQ(published.Next(&expected), ChangeFeed::Status::kOk);
+  EXPECT_EQ(expected.version, 2);
+
+  // Takes version 2's record back out of the ring.
+  {
+    auto head = blob_store->Get<blob_store::HeadNode>(1);
+    auto ring = blob_store->Get<ChangeFeedRing>(head->change_feed);
+    ring->slots[2].sequence.store(0);
+  }
+
+  ChangeRecord record;
+  ASSERT_EQ(unpublished.Next(&record), ChangeFeed::Status::kOk);
+  EXPECT_EQ(record.version, expected.version);
+  EXPECT_EQ(record.root_index, expected.root_index);
+  EXPECT_EQ(record.new_objects, expected.new_objects);
+  EXPECT_EQ(record.mutated_objects, expected.mutated_objects);
+  EXPECT_EQ(record.discarded_objects, expected.discarded_objects);
+  ASSERT_EQ(unpublished.Next(&record), ChangeFeed::Status::kOk);
+  EXPECT_EQ(record.version, 3);
+  EXPECT_EQ(unpublished.Next(&record), ChangeFeed::Status::kPending);
+}
@@ -157,4 +157,33 @@ TEST(ChunkManagerTest, ConcurrentAccess) {
       EXPECT_EQ(*chunk_offset_data, static_cast<uint8_t>(i + j));
     }
   }
-}
\ No newline at end of file
+}
+// index_of maps every pointer into a chunk back to the index at() resolves,
+// and rejects pointers outside the chunks, including ones in removed chunks.
+TEST(ChunkManagerTest, IndexOf) {
+  ChunkManager manager(TestMemoryBufferFactory::Get(), "test_chunk", 64);
+  uint8_t* chunk;
+  std::size_t chunk_size;
+  manager.get_or_create_chunk(3, &chunk, &chunk_size);
+
+  for (std::size_t chunk_index = 0; chunk_index < 4; ++chunk_index) {
+    std::size_t size = manager.chunk_size_at_index(chunk_index);
+    for (std::size_t offset : {std::size_t(0), size / 2, size - 1}) {
+      uint8_t* ptr = manager.at(chunk_index, offset);
+      ASSERT_NE(ptr, nullptr);
+      std::uint64_t index;
+      ASSERT_TRUE(manager.index_of(ptr, &index));
+      EXPECT_EQ(ChunkManager::chunk_index(index), chunk_index);
+      EXPECT_EQ(ChunkManager::offset_in_chunk(index), offset);
+      EXPECT_EQ(manager.at(index), ptr);
+    }
+  }
+  uint8_t local;
+  std::uint64_t index;
+  EXPECT_FALSE(manager.index_of(&local, &index));
+
+  uint8_t* last = manager.at(3, 0);
+  manager.remove_chunk();
+  EXPECT_EQ(manager.at(3, 0), nullptr);
+  EXPECT_FALSE(manager.index_of(last, &index));
+}
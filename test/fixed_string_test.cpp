@@ -15,8 +15,8 @@ TEST(FixedStringTest, Constructor) {
   auto fs = MakeFixedString(test_string);
 
   EXPECT_EQ(fs->size, test_string.size());  // Check if size matches
-  EXPECT_EQ(fs->hash,
-            std::hash<std::string>{}(test_string));  // Check if hash matches
+  EXPECT_EQ(fs->hash, hashing::HashBytes(test_string.data(),
+                                         test_string.size()));  // Check hash
   EXPECT_EQ(std::memcmp(fs->data, test_string.data(), fs->size),
             0);  // Check if data matches
 }
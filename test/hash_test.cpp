@@ -0,0 +1,68 @@
+#include "hash.h"
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "fixed_string.h"
+#include "gtest/gtest.h"
+#include "string_slice.h"
+
+// Hashes are persisted, so they must never change without bumping
+// kHashVersion. These are the reference test vectors of wyhash, where each
+// message is hashed with its position in the list as the seed.
+TEST(HashTest, MatchesReferenceVectors) {
+  ASSERT_EQ(hashing::kHashVersion, 1u);
+  const struct {
+    const char* message;
+    std::uint64_t hash;
+  } kVectors[] = {
+      {"", 0x93228a4de0eec5a2ull},
+      {"a", 0xc5bac3db178713c4ull},
+      {"abc", 0xa97f2f7b1d9b3314ull},
+      {"message digest", 0x786d1f1df3801df4ull},
+      {"abcdefghijklmnopqrstuvwxyz", 0xdca5a8138ad37c87ull},
+      {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+       0xb9e734f117cfaf70ull},
+      {"123456789012345678901234567890123456789012345678901234567890123456789"
+       "01234567890",
+       0x6cc5eab49a92d617ull},
+  };
+  for (std::size_t i = 0; i < sizeof(kVectors) / sizeof(kVectors[0]); ++i) {
+    EXPECT_EQ(hashing::HashBytes(kVectors[i].message,
+                                 std::strlen(kVectors[i].message), i),
+              kVectors[i].hash)
+        << kVectors[i].message;
+  }
+}
+
+// A string hashes the same whether it's stored from a std::string, a
+// StringSlice or a C string, and std::hash<StringSlice> agrees with the hash
+// stored in the FixedString.
+TEST(HashTest, FixedStringAndStringSliceAgree) {
+  std::string url =
+      "https://example.com/a/rather/long/path/to/some/resource?query=1&x=2";
+  StringSlice slice(url.data(), 0, url.size());
+
+  std::size_t size = StorageTraits<std::string>::size(url);
+  std::unique_ptr<char[]> from_string(new char[size]);
+  std::unique_ptr<char[]> from_slice(new char[size]);
+  std::unique_ptr<char[]> from_c_string(new char[size]);
+  FixedString* a = new (from_string.get()) FixedString(url);
+  FixedString* b = new (from_slice.get()) FixedString(slice);
+  FixedString* c = new (from_c_string.get()) FixedString(url.c_str());
+
+  EXPECT_EQ(a->hash, b->hash);
+  EXPECT_EQ(a->hash, c->hash);
+  EXPECT_EQ(a->hash, std::hash<StringSlice>{}(slice));
+  EXPECT_EQ(a->hash, std::hash<StringSlice>{}(static_cast<StringSlice>(*b)));
+  EXPECT_TRUE(*a == *b);
+
+  // Changing any byte of a long key changes its hash.
+  std::string other = url;
+  other[40] = 'X';
+  EXPECT_NE(hashing::HashBytes(url.data(), url.size()),
+            hashing::HashBytes(other.data(), other.size()));
+}
@@ -0,0 +1,42 @@
+#include "inline_vector.h"
+
+#include "gtest/gtest.h"
+
+TEST(InlineVectorTest, PushAndPop) {
+  InlineVector<size_t, 4> vector;
+  EXPECT_TRUE(vector.empty());
+  EXPECT_EQ(vector.capacity(), 4);
+  for (size_t i = 0; i < 4; ++i) {
+    vector.push_back(i * 10);
+    EXPECT_EQ(vector.size(), i + 1);
+    EXPECT_EQ(vector.back(), i * 10);
+  }
+  EXPECT_EQ(vector[2], 20);
+  vector.pop_back();
+  EXPECT_EQ(vector.size(), 3);
+  EXPECT_EQ(vector.back(), 20);
+  vector.clear();
+  EXPECT_TRUE(vector.empty());
+}
+
+TEST(InlineVectorTest, CopiesAreIndependent) {
+  InlineVector<size_t, 8> vector;
+  vector.push_back(1);
+  vector.push_back(2);
+  InlineVector<size_t, 8> copy = vector;
+  copy.push_back(3);
+  copy[0] = 7;
+  EXPECT_EQ(vector.size(), 2);
+  EXPECT_EQ(vector[0], 1);
+  EXPECT_EQ(copy.size(), 3);
+
+  size_t sum = 0;
+  for (size_t value : copy) {
+    sum += value;
+  }
+  EXPECT_EQ(sum, 12);
+
+  vector = copy;
+  EXPECT_EQ(vector.size(), 3);
+  EXPECT_EQ(vector[0], 7);
+}
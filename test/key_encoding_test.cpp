@@ -0,0 +1,162 @@
+#include "key_encoding.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "b_plus_tree.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using key_encoding::KeyReader;
+using key_encoding::OrderedKey;
+
+namespace {
+
+// Returns the sign of the byte-wise comparison of two encodings.
+int CompareBytes(const OrderedKey& a, const OrderedKey& b) {
+  int cmp = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+  if (cmp != 0) {
+    return cmp < 0 ? -1 : 1;
+  }
+  return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+}  // namespace
+
+// Encodings of random tuples compare like the tuples themselves.
+TEST(KeyEncodingTest, PreservesTupleOrder) {
+  using Tuple = std::tuple<std::int32_t, std::string, double, std::uint16_t>;
+  std::mt19937 rng(42);
+  const std::string kStrings[] = {"",  "a",      "ab",  std::string("a\0", 2),
+                                  "b", "\xff", "tenant"};
+  const double kDoubles[] = {-std::numeric_limits<double>::infinity(),
+                             -1.5, -1e-300, 0.0, 1e-300, 2.25, 1e300};
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < 300; ++i) {
+    tuples.emplace_back(
+        static_cast<std::int32_t>(rng() % 5) - 2, kStrings[rng() % 7],
+        kDoubles[rng() % 7], static_cast<std::uint16_t>(rng() % 3 * 30000));
+  }
+  for (const Tuple& a : tuples) {
+    for (const Tuple& b : tuples) {
+      OrderedKey key_a = OrderedKey::Of(std::get<0>(a), std::get<1>(a),
+                                        std::get<2>(a), std::get<3>(a));
+      OrderedKey key_b = OrderedKey::Of(std::get<0>(b), std::get<1>(b),
+                                        std::get<2>(b), std::get<3>(b));
+      int expected = a < b ? -1 : (b < a ? 1 : 0);
+      int actual = CompareBytes(key_a, key_b);
+      EXPECT_EQ(actual, expected);
+      EXPECT_EQ(key_a < key_b, actual < 0);
+    }
+  }
+}
+
+// -0.0 and 0.0 are equal as doubles but -0.0 orders first as an encoding.
+TEST(KeyEncodingTest, NegativeZero) {
+  EXPECT_LT(OrderedKey::Of(-0.0), OrderedKey::Of(0.0));
+  EXPECT_LT(OrderedKey::Of(-1e-300), OrderedKey::Of(-0.0));
+}
+
+// Every field decodes back to the value it was encoded from.
+TEST(KeyEncodingTest, RoundTrip) {
+  std::string with_zeros("x\0y\0", 4);
+  OrderedKey key = OrderedKey::Of(std::int64_t(-7), with_zeros, 3.5f,
+                                  std::uint8_t(200), std::string("end"));
+  KeyReader reader(key);
+  std::int64_t i64;
+  std::string str;
+  float f;
+  std::uint8_t u8;
+  ASSERT_TRUE(reader.Read(&i64));
+  EXPECT_EQ(i64, -7);
+  ASSERT_TRUE(reader.Read(&str));
+  EXPECT_EQ(str, with_zeros);
+  ASSERT_TRUE(reader.Read(&f));
+  EXPECT_EQ(f, 3.5f);
+  ASSERT_TRUE(reader.Read(&u8));
+  EXPECT_EQ(u8, 200);
+  ASSERT_TRUE(reader.Read(&str));
+  EXPECT_EQ(str, "end");
+  EXPECT_TRUE(reader.done());
+  EXPECT_FALSE(reader.Read(&u8));
+}
+
+// A tree keyed on OrderedKey iterates in field order.
+TEST(KeyEncodingTest, TreeKeys) {
+  ChunkManager data_buffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                           4 * utils::GetPageSize());
+  blob_store::BlobStore blob_store(TestMemoryBufferFactory::Get(),
+                                   "MetadataBuffer", 4096,
+                                   std::move(data_buffer));
+  b_plus_tree::BPlusTree<OrderedKey, int, 4> tree(blob_store);
+  for (int tenant = 2; tenant >= -2; --tenant) {
+    for (int path = 0; path < 10; ++path) {
+      tree.Insert(OrderedKey::Of(tenant, "path/" + std::to_string(path)),
+                  tenant * 100 + path);
+    }
+  }
+
+  auto it = tree.Search(OrderedKey::Of(-1, std::string("path/3")));
+  ASSERT_NE(it.GetValue(), nullptr);
+  EXPECT_EQ(*it.GetValue(), -97);
+
+  int count = 0;
+  int previous = std::numeric_limits<int>::min();
+  for (auto it = tree.Search(OrderedKey::Of(-2, std::string()));
+       it.GetValue() != nullptr; ++it) {
+    EXPECT_GT(*it.GetValue(), previous);
+    previous = *it.GetValue();
+    ++count;
+  }
+  EXPECT_EQ(count, 50);
+}
+
+// Leaves search the packed 8-byte prefixes of their keys first. Keys sharing
+// a prefix are then compared in full, so searches land on the right key
+// whether or not the prefixes tell the keys apart.
+TEST(KeyEncodingTest, TreeKeysSharingPrefixes) {
+  ChunkManager data_buffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                           4 * utils::GetPageSize());
+  blob_store::BlobStore blob_store(TestMemoryBufferFactory::Get(),
+                                   "MetadataBuffer", 4096,
+                                   std::move(data_buffer));
+  b_plus_tree::BPlusTree<OrderedKey, int, 4> tree(blob_store);
+  // The 64-bit tenant fills the prefix, so every key of a tenant shares it.
+  std::map<OrderedKey, int> expected;
+  for (std::int64_t tenant = 0; tenant < 3; ++tenant) {
+    for (int name = 0; name < 20; name += 2) {
+      OrderedKey key = OrderedKey::Of(tenant, std::to_string(100 + name));
+      tree.Insert(key, tenant * 1000 + name);
+      expected[key] = tenant * 1000 + name;
+    }
+  }
+  for (int name = 0; name < 20; name += 4) {
+    OrderedKey key =
+        OrderedKey::Of(std::int64_t(1), std::to_string(100 + name));
+    tree.Delete(key);
+    expected.erase(key);
+  }
+
+  // Missing keys find the next key in order.
+  for (std::int64_t tenant = 0; tenant < 3; ++tenant) {
+    for (int name = 0; name < 20; ++name) {
+      OrderedKey key = OrderedKey::Of(tenant, std::to_string(100 + name));
+      auto it = tree.Search(key);
+      auto expected_it = expected.lower_bound(key);
+      if (expected_it == expected.end()) {
+        EXPECT_EQ(it.GetValue(), nullptr);
+      } else {
+        ASSERT_NE(it.GetValue(), nullptr);
+        EXPECT_EQ(*it.GetValue(), expected_it->second);
+      }
+    }
+  }
+}
@@ -0,0 +1,83 @@
+#include "packed_ints.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using packed_ints::PackedView;
+
+namespace {
+
+// Packs values into an 8-byte aligned buffer.
+std::vector<std::uint64_t> PackToBuffer(
+    const std::vector<std::uint64_t>& values) {
+  std::size_t size = packed_ints::PackedSize(values.data(), values.size());
+  std::vector<std::uint64_t> buffer((size + 7) / 8);
+  EXPECT_EQ(packed_ints::Pack(values.data(), values.size(),
+                              reinterpret_cast<std::uint8_t*>(buffer.data())),
+            size);
+  return buffer;
+}
+
+}  // namespace
+
+// Values of every width read back the same through operator[] and Decode.
+TEST(PackedIntsTest, RoundTrip) {
+  std::mt19937_64 rng(7);
+  for (std::uint32_t bit_width : {0u, 1u, 7u, 17u, 32u, 63u, 64u}) {
+    std::uint64_t mask = bit_width == 64 ? ~std::uint64_t(0)
+                                         : (std::uint64_t(1) << bit_width) - 1;
+    std::vector<std::uint64_t> values;
+    for (int i = 0; i < 100; ++i) {
+      values.push_back(1000 + (rng() & mask));
+    }
+    if (bit_width == 64) {
+      values.push_back(0);
+    }
+    std::vector<std::uint64_t> buffer = PackToBuffer(values);
+    PackedView view(reinterpret_cast<const std::uint8_t*>(buffer.data()));
+    ASSERT_EQ(view.size(), values.size());
+    std::vector<std::uint64_t> decoded(values.size());
+    view.Decode(decoded.data());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      EXPECT_EQ(view[i], values[i]) << "width " << bit_width << " at " << i;
+      EXPECT_EQ(decoded[i], values[i]) << "width " << bit_width << " at " << i;
+    }
+  }
+}
+
+// Increasing timestamps pack to a fraction of their full width and are
+// searched without being decoded.
+TEST(PackedIntsTest, SortedSearch) {
+  std::vector<std::uint64_t> timestamps;
+  std::uint64_t now = 1700000000000ull;
+  for (int i = 0; i < 1000; ++i) {
+    now += 1 + i % 7;
+    timestamps.push_back(now);
+  }
+  std::vector<std::uint64_t> buffer = PackToBuffer(timestamps);
+  PackedView view(reinterpret_cast<const std::uint8_t*>(buffer.data()));
+  EXPECT_LT(view.byte_size() * 4, timestamps.size() * sizeof(std::uint64_t));
+
+  for (std::uint64_t probe = timestamps.front() - 2;
+       probe <= timestamps.back() + 2; probe += 3) {
+    std::size_t expected =
+        std::lower_bound(timestamps.begin(), timestamps.end(), probe) -
+        timestamps.begin();
+    EXPECT_EQ(view.LowerBound(probe), expected) << probe;
+    EXPECT_EQ(view.Contains(probe),
+              std::binary_search(timestamps.begin(), timestamps.end(), probe));
+  }
+}
+
+TEST(PackedIntsTest, Empty) {
+  std::vector<std::uint64_t> buffer = PackToBuffer({});
+  PackedView view(reinterpret_cast<const std::uint8_t*>(buffer.data()));
+  EXPECT_EQ(view.size(), 0);
+  EXPECT_EQ(view.LowerBound(5), 0);
+  EXPECT_FALSE(view.Contains(5));
+}
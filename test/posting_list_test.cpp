@@ -0,0 +1,190 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "blob_store_transaction.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace blob_store;
+using posting_list::PostingList;
+
+class PostingListTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ChunkManager dataBuffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                            4 * utils::GetPageSize());
+    blob_store = new BlobStore(TestMemoryBufferFactory::Get(), "MetadataBuffer",
+                               4096, std::move(dataBuffer));
+    head_index = blob_store->New<HeadNode>().Index();
+  }
+
+  virtual void TearDown() {
+    // cleanup the BlobStore
+    delete blob_store;
+  }
+
+  // Returns a list holding values, which must be sorted.
+  size_t CreateList(const std::vector<uint64_t>& values) {
+    Transaction txn(blob_store, head_index);
+    size_t root = PostingList::Create(&txn);
+    root = PostingList::Append(&txn, root, values);
+    EXPECT_TRUE(std::move(txn).Commit());
+    return root;
+  }
+
+  BlobStore* blob_store;
+  size_t head_index;
+};
+
+TEST_F(PostingListTest, AddAndRemove) {
+  Transaction txn(blob_store, head_index);
+  size_t root = PostingList::Create(&txn);
+  std::set<uint64_t> expected;
+  std::mt19937_64 rng(42);
+  for (int i = 0; i < 1000; ++i) {
+    uint64_t value = rng() % 5000;
+    root = PostingList::Add(&txn, root, value);
+    expected.insert(value);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    uint64_t value = rng() % 5000;
+    root = PostingList::Remove(&txn, root, value);
+    expected.erase(value);
+  }
+  EXPECT_TRUE(std::move(txn).Commit());
+
+  PostingList list(blob_store, root);
+  EXPECT_EQ(list.size(), expected.size());
+  EXPECT_EQ(list.ToVector(),
+            std::vector<uint64_t>(expected.begin(), expected.end()));
+  for (uint64_t value = 0; value < 5000; value += 7) {
+    EXPECT_EQ(list.Contains(value), expected.count(value) > 0) << value;
+  }
+}
+
+// Adding a value that's already there or removing one that isn't leaves the
+// list untouched.
+TEST_F(PostingListTest, NoOpUpdates) {
+  size_t root = CreateList({10, 20, 30});
+  Transaction txn(blob_store, head_index);
+  EXPECT_EQ(PostingList::Add(&txn, root, 20), root);
+  EXPECT_EQ(PostingList::Remove(&txn, root, 25), root);
+  EXPECT_EQ(PostingList::Remove(&txn, root, 40), root);
+  std::move(txn).Abort();
+}
+
+// Removing every value empties the list and its chunk directory.
+TEST_F(PostingListTest, RemoveAll) {
+  size_t root = CreateList({1, 2, 3});
+  Transaction txn(blob_store, head_index);
+  for (uint64_t value : {2, 1, 3}) {
+    root = PostingList::Remove(&txn, root, value);
+  }
+  EXPECT_TRUE(std::move(txn).Commit());
+  PostingList list(blob_store, root);
+  EXPECT_EQ(list.size(), 0);
+  EXPECT_TRUE(list.ToVector().empty());
+  EXPECT_FALSE(list.Contains(1));
+}
+
+// Appending fills chunks up to their maximum size; adding into a full chunk
+// splits it.
+TEST_F(PostingListTest, AppendAndSplit) {
+  std::vector<uint64_t> values;
+  for (uint64_t i = 0; i < 3 * posting_list::kMaxChunkSize; ++i) {
+    values.push_back(1000000 + 2 * i);
+  }
+  size_t root = CreateList(values);
+  EXPECT_EQ(blob_store->Get<posting_list::PostingListRoot>(root)->num_chunks,
+            3);
+
+  Transaction txn(blob_store, head_index);
+  root = PostingList::Add(&txn, root, 1000001);
+  EXPECT_TRUE(std::move(txn).Commit());
+  EXPECT_EQ(blob_store->Get<posting_list::PostingListRoot>(root)->num_chunks,
+            4);
+
+  values.insert(values.begin() + 1, 1000001);
+  PostingList list(blob_store, root);
+  EXPECT_EQ(list.size(), values.size());
+  EXPECT_EQ(list.ToVector(), values);
+}
+
+// An update rewrites only the root, the directory and the chunk that changed.
+// The previous version still reads the same and shares the other chunks.
+TEST_F(PostingListTest, CopyOnWrite) {
+  std::vector<uint64_t> values;
+  for (uint64_t i = 0; i < 2 * posting_list::kMaxChunkSize; ++i) {
+    values.push_back(i * 3);
+  }
+  size_t old_root = CreateList(values);
+
+  Transaction txn(blob_store, head_index);
+  size_t new_root = PostingList::Add(&txn, old_root, values.back() + 1);
+  EXPECT_TRUE(std::move(txn).Commit());
+  EXPECT_NE(new_root, old_root);
+
+  PostingList old_list(blob_store, old_root);
+  PostingList new_list(blob_store, new_root);
+  EXPECT_EQ(old_list.ToVector(), values);
+  EXPECT_EQ(new_list.size(), values.size() + 1);
+  EXPECT_FALSE(old_list.Contains(values.back() + 1));
+  EXPECT_TRUE(new_list.Contains(values.back() + 1));
+
+  auto old_chunks = blob_store->Get<posting_list::ChunkRef[]>(
+      blob_store->Get<posting_list::PostingListRoot>(old_root)->chunks);
+  auto new_chunks = blob_store->Get<posting_list::ChunkRef[]>(
+      blob_store->Get<posting_list::PostingListRoot>(new_root)->chunks);
+  EXPECT_EQ(old_chunks[0].chunk, new_chunks[0].chunk);
+  EXPECT_NE(old_chunks[1].chunk, new_chunks[1].chunk);
+}
+
+TEST_F(PostingListTest, IntersectAndUnion) {
+  std::mt19937_64 rng(7);
+  std::set<uint64_t> a;
+  std::set<uint64_t> b;
+  // b only covers the middle of a's range, so most of a's chunks are skipped.
+  for (int i = 0; i < 2000; ++i) {
+    a.insert(rng() % 100000);
+    b.insert(40000 + rng() % 20000);
+  }
+  std::vector<uint64_t> values_a(a.begin(), a.end());
+  std::vector<uint64_t> values_b(b.begin(), b.end());
+  PostingList list_a(blob_store, CreateList(values_a));
+  PostingList list_b(blob_store, CreateList(values_b));
+
+  std::vector<uint64_t> intersection;
+  std::set_intersection(values_a.begin(), values_a.end(), values_b.begin(),
+                        values_b.end(), std::back_inserter(intersection));
+  EXPECT_FALSE(intersection.empty());
+  EXPECT_EQ(PostingList::Intersect(list_a, list_b), intersection);
+  EXPECT_EQ(PostingList::Intersect(list_b, list_a), intersection);
+
+  std::vector<uint64_t> union_values;
+  std::set_union(values_a.begin(), values_a.end(), values_b.begin(),
+                 values_b.end(), std::back_inserter(union_values));
+  EXPECT_EQ(PostingList::Union(list_a, list_b), union_values);
+
+  PostingList empty(blob_store, CreateList({}));
+  EXPECT_TRUE(PostingList::Intersect(list_a, empty).empty());
+  EXPECT_EQ(PostingList::Union(empty, list_a), values_a);
+}
+
+// Values whose low or high halves collide must not be reported as equal.
+TEST_F(PostingListTest, IntersectWideValues) {
+  std::vector<uint64_t> a = {0x100000001ull, 0x200000002ull, 0x300000003ull,
+                             0x400000004ull, 0xFFFFFFFF00000000ull};
+  std::vector<uint64_t> b = {0x100000002ull, 0x200000001ull, 0x300000003ull,
+                             0x500000004ull, 0xFFFFFFFF00000000ull};
+  PostingList list_a(blob_store, CreateList(a));
+  PostingList list_b(blob_store, CreateList(b));
+  EXPECT_EQ(PostingList::Intersect(list_a, list_b),
+            std::vector<uint64_t>({0x300000003ull, 0xFFFFFFFF00000000ull}));
+}
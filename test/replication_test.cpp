@@ -0,0 +1,175 @@
+#include "replication.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "b_plus_tree.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace b_plus_tree;
+using blob_store::PipeReplicationStream;
+using blob_store::ReplicationFollower;
+using blob_store::ReplicationLeader;
+using blob_store::ReplicationRecordHeader;
+using blob_store::ReplicationStream;
+
+namespace {
+
+// An in-memory ReplicationStream that lets tests inspect and reorder records.
+class MemoryReplicationStream : public ReplicationStream {
+ public:
+  bool Write(const void* data, std::size_t size) override {
+    buffer_.append(static_cast<const char*>(data), size);
+    return true;
+  }
+
+  bool Read(void* data, std::size_t size) override {
+    if (buffer_.size() - read_offset_ < size) {
+      return false;
+    }
+    memcpy(data, buffer_.data() + read_offset_, size);
+    read_offset_ += size;
+    return true;
+  }
+
+  // Splits the buffered bytes into records.
+  std::vector<std::string> TakeRecords() {
+    std::vector<std::string> records;
+    size_t offset = 0;
+    while (offset < buffer_.size()) {
+      ReplicationRecordHeader header;
+      memcpy(&header, buffer_.data() + offset, sizeof(header));
+      size_t size =
+          sizeof(header) + header.transaction_size + header.blobs_size;
+      records.push_back(buffer_.substr(offset, size));
+      offset += size;
+    }
+    buffer_.clear();
+    return records;
+  }
+
+ private:
+  std::string buffer_;
+  size_t read_offset_ = 0;
+};
+
+}  // namespace
+
+class ReplicationTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ChunkManager leader_buffer(TestMemoryBufferFactory::Get(),
+                               "LeaderDataBuffer", 4 * utils::GetPageSize());
+    leader_store =
+        new BlobStore(TestMemoryBufferFactory::Get(), "LeaderMetadataBuffer",
+                      4096, std::move(leader_buffer));
+    ChunkManager follower_buffer(TestMemoryBufferFactory::Get(),
+                                 "FollowerDataBuffer",
+                                 4 * utils::GetPageSize());
+    follower_store =
+        new BlobStore(TestMemoryBufferFactory::Get(), "FollowerMetadataBuffer",
+                      4096, std::move(follower_buffer));
+  }
+
+  virtual void TearDown() {
+    delete leader_store;
+    delete follower_store;
+  }
+
+  BlobStore* leader_store;
+  BlobStore* follower_store;
+};
+
+// A follower tails a leader over a pipe while the leader commits. Once the
+// stream ends, the follower's tree and its history match the leader's.
+TEST_F(ReplicationTest, FollowerMatchesLeader) {
+  PipeReplicationStream stream;
+  BPlusTree<int, int, 16> tree(*leader_store);
+  ReplicationLeader leader(leader_store, &stream);
+  tree.SetTransactionObserver(&leader);
+  ASSERT_TRUE(leader.Sync(1));
+
+  ReplicationFollower follower(follower_store, &stream);
+  std::thread follower_thread([&follower]() {
+    while (follower.ApplyNext()) {
+    }
+  });
+
+  for (int i = 0; i < 300; ++i) {
+    tree.Insert(i, i * 10);
+  }
+  {
+    auto txn = tree.CreateTransaction();
+    for (int i = 0; i < 300; i += 3) {
+      txn.Delete(i);
+    }
+    ASSERT_TRUE(std::move(txn).Commit());
+  }
+  EXPECT_TRUE(leader.is_healthy());
+  stream.CloseWriter();
+  follower_thread.join();
+  EXPECT_EQ(follower.version(), 301);
+
+  BPlusTree<int, int, 16> replica(*follower_store);
+  for (int i = 0; i < 300; ++i) {
+    auto it = replica.Search(i);
+    if (i % 3 == 0) {
+      EXPECT_TRUE(it.GetKey() == nullptr || *it.GetKey() != i);
+    } else {
+      ASSERT_NE(it.GetKey(), nullptr);
+      EXPECT_EQ(*it.GetKey(), i);
+      EXPECT_EQ(*it.GetValue(), i * 10);
+    }
+  }
+
+  // History is replicated too.
+  auto snapshot = replica.OpenSnapshot(150);
+  ASSERT_TRUE(snapshot.is_valid());
+  int count = 0;
+  for (auto it = snapshot.First(); it.GetKey() != nullptr; ++it) {
+    EXPECT_EQ(*it.GetKey(), count);
+    ++count;
+  }
+  EXPECT_EQ(count, 150);
+}
+
+// Commits that reach the follower out of order are applied in version order.
+TEST_F(ReplicationTest, OutOfOrderCommits) {
+  MemoryReplicationStream stream;
+  BPlusTree<int, int, 16> tree(*leader_store);
+  ReplicationLeader leader(leader_store, &stream);
+  tree.SetTransactionObserver(&leader);
+  ASSERT_TRUE(leader.Sync(1));
+  for (int i = 0; i < 20; ++i) {
+    tree.Insert(i, i);
+  }
+
+  std::vector<std::string> records = stream.TakeRecords();
+  ASSERT_EQ(records.size(), 21);
+  std::reverse(records.begin(), records.end());
+  for (const std::string& record : records) {
+    stream.Write(record.data(), record.size());
+  }
+
+  ReplicationFollower follower(follower_store, &stream);
+  // Nothing can be applied before the sync record, which now comes last.
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(follower.ApplyNext());
+    EXPECT_EQ(follower.version(), 0);
+  }
+  ASSERT_TRUE(follower.ApplyNext());
+  EXPECT_EQ(follower.version(), 20);
+  EXPECT_FALSE(follower.ApplyNext());
+
+  BPlusTree<int, int, 16> replica(*follower_store);
+  for (int i = 0; i < 20; ++i) {
+    auto it = replica.Search(i);
+    ASSERT_NE(it.GetKey(), nullptr);
+    EXPECT_EQ(*it.GetValue(), i);
+  }
+}
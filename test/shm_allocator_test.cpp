@@ -1,4 +1,10 @@
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "chunk_manager.h"
 #include "gtest/gtest.h"
@@ -226,4 +232,288 @@ TEST_F(ShmAllocatorTest, MemoryRecyclingMultithreaded) {
   for (auto& thread : threads) {
     thread.join();
   }
-}
\ No newline at end of file
+}
+
+// An allocation grows only within its own block. Freeing the neighbour to its
+// right doesn't change that, so growing past the block is left to the caller.
+TEST_F(ShmAllocatorTest, GrowWithinCapacity) {
+  // Find two allocations that are next to each other.
+  std::vector<uint8_t*> ptrs;
+  for (int i = 0; i < 8; ++i) {
+    ptrs.push_back(shared_mem_allocator->Allocate(64));
+    memset(ptrs.back(), 'a' + i, 64);
+  }
+  uint8_t* left = nullptr;
+  uint8_t* right = nullptr;
+  for (uint8_t* ptr1 : ptrs) {
+    for (uint8_t* ptr2 : ptrs) {
+      if (ptr2 ==
+          ptr1 + shared_mem_allocator->GetCapacity(ptr1) + sizeof(ShmNode)) {
+        left = ptr1;
+        right = ptr2;
+      }
+    }
+  }
+  ASSERT_NE(left, nullptr);
+  std::size_t capacity = shared_mem_allocator->GetCapacity(left);
+
+  EXPECT_TRUE(shared_mem_allocator->Grow(left, capacity));
+  EXPECT_FALSE(shared_mem_allocator->Grow(left, capacity + 1));
+
+  ptrs.erase(std::find(ptrs.begin(), ptrs.end(), right));
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(right));
+  EXPECT_FALSE(shared_mem_allocator->Grow(left, capacity + 8));
+  EXPECT_EQ(shared_mem_allocator->GetCapacity(left), capacity);
+
+  for (uint8_t* ptr : ptrs) {
+    for (std::size_t i = 0; i < 64; ++i) {
+      EXPECT_EQ(ptr[i], ptr[0]);
+    }
+    EXPECT_TRUE(shared_mem_allocator->Deallocate(ptr));
+  }
+  EXPECT_FALSE(shared_mem_allocator->Grow(left, 8));
+}
+
+// Threads grow their allocations while others free their neighbours, and
+// relocate whenever an allocation can't grow in place.
+TEST_F(ShmAllocatorTest, ConcurrentGrowAndDeallocate) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.push_back(std::thread([this, t]() {
+      for (int round = 0; round < 200; ++round) {
+        std::size_t size = 32 + (round % 7) * 24;
+        uint8_t* ptr = shared_mem_allocator->Allocate(size);
+        ASSERT_NE(ptr, nullptr);
+        uint8_t fill = static_cast<uint8_t>('a' + (t + round) % 26);
+        memset(ptr, fill, size);
+
+        for (std::size_t new_size : {size + 8, size * 3}) {
+          if (!shared_mem_allocator->Grow(ptr, new_size)) {
+            uint8_t* moved = shared_mem_allocator->Allocate(new_size);
+            ASSERT_NE(moved, nullptr);
+            memcpy(moved, ptr, size);
+            EXPECT_TRUE(shared_mem_allocator->Deallocate(ptr));
+            ptr = moved;
+          }
+          EXPECT_GE(shared_mem_allocator->GetCapacity(ptr), new_size);
+          memset(ptr + size, fill, new_size - size);
+          size = new_size;
+        }
+
+        for (std::size_t i = 0; i < size; ++i) {
+          ASSERT_EQ(ptr[i], fill);
+        }
+        EXPECT_TRUE(shared_mem_allocator->Deallocate(ptr));
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Allocations above the large object threshold get their own buffer and
+// don't grow the chunked heap.
+TEST_F(ShmAllocatorTest, LargeObject) {
+  std::size_t num_chunks = shared_mem_allocator->GetNumChunks();
+  std::size_t size = 2 * ShmAllocator::kDefaultLargeObjectThreshold;
+  uint8_t* ptr = shared_mem_allocator->Allocate(size);
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_EQ(shared_mem_allocator->GetNumChunks(), num_chunks);
+  EXPECT_GE(shared_mem_allocator->GetCapacity(ptr), size);
+  memset(ptr, 'x', size);
+
+  std::uint64_t index = shared_mem_allocator->ToIndex(ptr);
+  EXPECT_TRUE(ShmAllocator::IsLargeObjectIndex(index));
+  EXPECT_EQ(shared_mem_allocator->ToPtr<uint8_t>(index), ptr);
+  EXPECT_GE(shared_mem_allocator->GetCapacity(index), size);
+
+  // Small allocations still come from the chunks.
+  uint8_t* small = shared_mem_allocator->Allocate(32);
+  num_chunks = shared_mem_allocator->GetNumChunks();
+  EXPECT_FALSE(
+      ShmAllocator::IsLargeObjectIndex(shared_mem_allocator->ToIndex(small)));
+
+  // A large object can't grow in place, but it can shrink.
+  EXPECT_FALSE(shared_mem_allocator->Grow(ptr, 4 * size));
+  EXPECT_TRUE(shared_mem_allocator->Grow(ptr, size / 2));
+  EXPECT_EQ(ptr[size - 1], 'x');
+
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(ptr));
+  EXPECT_EQ(shared_mem_allocator->ToPtr<uint8_t>(index), nullptr);
+
+  // The slot is reused once it's freed.
+  uint8_t* ptr2 = shared_mem_allocator->Allocate(size);
+  EXPECT_EQ(shared_mem_allocator->ToIndex(ptr2), index);
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(ptr2));
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(small));
+  EXPECT_EQ(shared_mem_allocator->GetNumChunks(), num_chunks);
+}
+
+// Tracks the buffers that exist, i.e. were created and not removed, and
+// creates them in memory.
+class TrackingBufferFactory : public BufferFactory {
+ public:
+  std::unique_ptr<Buffer> CreateBuffer(const std::string& name,
+                                       size_t size) override {
+    buffers.insert(name);
+    return TestMemoryBufferFactory::Get()->CreateBuffer(name, size);
+  }
+
+  void RemoveBuffer(const std::string& name) override { buffers.erase(name); }
+
+  std::set<std::string> buffers;
+};
+
+// Freeing a large object removes its buffer, so churning through a slot
+// doesn't leave a buffer behind per allocation.
+TEST_F(ShmAllocatorTest, LargeObjectFreeRemovesBuffer) {
+  TrackingBufferFactory factory;
+  ShmAllocator allocator(ChunkManager(&factory, "tracked", 64));
+  std::size_t size = 2 * ShmAllocator::kDefaultLargeObjectThreshold;
+
+  uint8_t* ptr = allocator.Allocate(size);
+  ASSERT_NE(ptr, nullptr);
+  std::uint64_t index = allocator.ToIndex(ptr);
+  EXPECT_EQ(factory.buffers.count("tracked_large_0_1"), 1);
+  EXPECT_TRUE(allocator.Deallocate(ptr));
+  EXPECT_EQ(factory.buffers.count("tracked_large_0_1"), 0);
+
+  // The slot is reused with a new generation and the old buffer stays gone.
+  for (int i = 0; i < 10; ++i) {
+    ptr = allocator.Allocate(size);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_EQ(allocator.ToIndex(ptr), index);
+    EXPECT_EQ(factory.buffers.count("tracked_large_0_" + std::to_string(i + 2)),
+              1);
+    EXPECT_EQ(factory.buffers.count("tracked_large_0_" + std::to_string(i + 1)),
+              0);
+    EXPECT_TRUE(allocator.Deallocate(ptr));
+  }
+  for (const std::string& name : factory.buffers) {
+    EXPECT_EQ(name.find("tracked_large_0_"), std::string::npos) << name;
+  }
+}
+
+// Small allocations are packed into slabs without a header per allocation.
+TEST_F(ShmAllocatorTest, SlabAllocation) {
+  std::vector<uint8_t*> ptrs;
+  for (int i = 0; i < 1000; ++i) {
+    uint8_t* ptr = shared_mem_allocator->Allocate(4);
+    ASSERT_NE(ptr, nullptr);
+    memset(ptr, i & 0xFF, 4);
+    ptrs.push_back(ptr);
+  }
+  // Neighbours in the same slab are exactly one size class apart.
+  EXPECT_EQ(ptrs[1] - ptrs[0], 8);
+  EXPECT_EQ(shared_mem_allocator->GetCapacity(ptrs[0]), 8);
+
+  std::uint64_t index = shared_mem_allocator->ToIndex(ptrs[10]);
+  EXPECT_TRUE(ShmAllocator::IsSlabIndex(index));
+  EXPECT_EQ(shared_mem_allocator->ToPtr<uint8_t>(index), ptrs[10]);
+  EXPECT_EQ(shared_mem_allocator->GetCapacity(index), 8);
+
+  // Slab objects can grow up to their size class.
+  EXPECT_TRUE(shared_mem_allocator->Grow(ptrs[0], 8));
+  EXPECT_FALSE(shared_mem_allocator->Grow(ptrs[0], 9));
+
+  // Larger allocations still carry a header.
+  uint8_t* large = shared_mem_allocator->Allocate(64);
+  EXPECT_FALSE(
+      ShmAllocator::IsSlabIndex(shared_mem_allocator->ToIndex(large)));
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(large));
+
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(ptrs[10]));
+  EXPECT_FALSE(shared_mem_allocator->Deallocate(ptrs[10]));
+  // The freed object is handed out again.
+  EXPECT_EQ(shared_mem_allocator->Allocate(8), ptrs[10]);
+
+  for (int i = 0; i < 1000; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(ptrs[i][j], i & 0xFF);
+    }
+    EXPECT_TRUE(shared_mem_allocator->Deallocate(ptrs[i]));
+  }
+  // Empty slabs can be taken by any size class.
+  uint8_t* ptr = shared_mem_allocator->Allocate(32);
+  EXPECT_EQ(shared_mem_allocator->GetCapacity(ptr), 32);
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(ptr));
+}
+
+TEST_F(ShmAllocatorTest, AlignedAllocation) {
+  std::vector<uint8_t*> ptrs;
+  for (std::size_t alignment : {8, 16, 64, 256, 4096}) {
+    for (std::size_t size : {1, 40, 100, 1000}) {
+      uint8_t* ptr = shared_mem_allocator->Allocate(size, alignment);
+      ASSERT_NE(ptr, nullptr);
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0)
+          << "size " << size << " alignment " << alignment;
+      EXPECT_GE(shared_mem_allocator->GetCapacity(ptr), size);
+      memset(ptr, static_cast<int>(ptrs.size()), size);
+      ptrs.push_back(ptr);
+    }
+  }
+  // Large objects are aligned too.
+  uint8_t* large = shared_mem_allocator->Allocate(
+      ShmAllocator::kDefaultLargeObjectThreshold, 64);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % 64, 0);
+  EXPECT_EQ(shared_mem_allocator->ToPtr<uint8_t>(
+                shared_mem_allocator->ToIndex(large)),
+            large);
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(large));
+
+  for (std::size_t i = 0; i < ptrs.size(); ++i) {
+    EXPECT_EQ(ptrs[i][0], static_cast<uint8_t>(i));
+    EXPECT_TRUE(shared_mem_allocator->Deallocate(ptrs[i]));
+  }
+}
+
+TEST_F(ShmAllocatorTest, AllocateNear) {
+  auto chunk_of = [this](uint8_t* ptr) {
+    return ChunkManager::chunk_index(shared_mem_allocator->ToIndex(ptr));
+  };
+  std::vector<uint8_t*> ptrs;
+  while (ptrs.empty() || chunk_of(ptrs.back()) < 4) {
+    ptrs.push_back(shared_mem_allocator->Allocate(40));
+    ASSERT_NE(ptrs.back(), nullptr);
+  }
+  // Free one block in chunk 2 and one in chunk 3.
+  auto in_chunk = [&](std::size_t chunk) {
+    return std::find_if(ptrs.begin(), ptrs.end(), [&](uint8_t* ptr) {
+      return chunk_of(ptr) == chunk;
+    });
+  };
+  auto lower = in_chunk(2);
+  auto higher = in_chunk(3);
+  ASSERT_NE(lower, ptrs.end());
+  ASSERT_NE(higher, ptrs.end());
+  uint8_t* freed_lower = *lower;
+  uint8_t* freed_higher = *higher;
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(freed_lower));
+  EXPECT_TRUE(shared_mem_allocator->Deallocate(freed_higher));
+  ptrs.erase(std::remove_if(ptrs.begin(), ptrs.end(),
+                            [&](uint8_t* ptr) {
+                              return ptr == freed_lower || ptr == freed_higher;
+                            }),
+             ptrs.end());
+
+  // A hint in chunk 3 skips the free block in chunk 2.
+  std::size_t hint = shared_mem_allocator->ToIndex(*in_chunk(3));
+  uint8_t* near = shared_mem_allocator->AllocateNear(hint, 40);
+  EXPECT_EQ(near, freed_higher);
+  // Without a hint the lowest chunk wins.
+  uint8_t* low = shared_mem_allocator->Allocate(40);
+  EXPECT_EQ(low, freed_lower);
+
+  // An invalid hint or a full chunk falls back to the other chunks.
+  uint8_t* fallback =
+      shared_mem_allocator->AllocateNear(ShmAllocator::InvalidIndex, 40);
+  EXPECT_NE(fallback, nullptr);
+
+  ptrs.push_back(near);
+  ptrs.push_back(low);
+  ptrs.push_back(fallback);
+  for (uint8_t* ptr : ptrs) {
+    EXPECT_TRUE(shared_mem_allocator->Deallocate(ptr));
+  }
+}
@@ -0,0 +1,112 @@
+#include "string_intern_table.h"
+
+#include <string>
+#include <vector>
+
+#include "b_plus_tree.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace blob_store;
+
+class StringInternTableTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ChunkManager dataBuffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                            4 * utils::GetPageSize());
+    blob_store = new BlobStore(TestMemoryBufferFactory::Get(), "MetadataBuffer",
+                               4096, std::move(dataBuffer));
+  }
+
+  virtual void TearDown() {
+    // cleanup the BlobStore
+    delete blob_store;
+  }
+
+  BlobStore* blob_store;
+};
+
+// Interning the same string twice returns the same blob and counts both
+// references. The blob is dropped with the last reference.
+TEST_F(StringInternTableTest, InternAndRelease) {
+  StringInternTable table = StringInternTable::Create(blob_store);
+  size_t index = table.Intern("tenant/alpha").Index();
+  EXPECT_EQ(table.Intern("tenant/alpha").Index(), index);
+  EXPECT_NE(table.Intern("tenant/beta").Index(), index);
+  EXPECT_EQ(table.GetSize(), 2);
+  EXPECT_EQ(table.GetRefCount(index), 2);
+  EXPECT_EQ(*table.Find("tenant/alpha"), "tenant/alpha");
+  EXPECT_EQ(table.Find("tenant/gamma"), nullptr);
+
+  EXPECT_TRUE(table.Release(index));
+  EXPECT_EQ(table.GetRefCount(index), 1);
+  EXPECT_NE(blob_store->Get<std::string>(index), nullptr);
+  EXPECT_TRUE(table.Release(index));
+  EXPECT_EQ(blob_store->Get<std::string>(index), nullptr);
+  EXPECT_EQ(table.Find("tenant/alpha"), nullptr);
+  EXPECT_FALSE(table.Release(index));
+  EXPECT_EQ(table.GetSize(), 1);
+
+  // A released string can be interned again.
+  EXPECT_EQ(*table.Intern("tenant/alpha"), "tenant/alpha");
+  EXPECT_EQ(table.GetSize(), 2);
+}
+
+// Grows the table well past its initial capacity and reopens it by index.
+TEST_F(StringInternTableTest, GrowAndReopen) {
+  StringInternTable table = StringInternTable::Create(blob_store);
+  std::vector<size_t> indices;
+  for (int i = 0; i < 200; ++i) {
+    indices.push_back(table.Intern("path/" + std::to_string(i)).Index());
+  }
+  // Release every other string so that rehashing has deleted buckets to
+  // clear out.
+  for (int i = 0; i < 200; i += 2) {
+    EXPECT_TRUE(table.Release(indices[i]));
+  }
+  for (int i = 200; i < 300; ++i) {
+    table.Intern("path/" + std::to_string(i));
+  }
+
+  StringInternTable reopened =
+      StringInternTable::Open(blob_store, table.table_index());
+  EXPECT_EQ(reopened.GetSize(), 200);
+  for (int i = 0; i < 300; ++i) {
+    std::string path = "path/" + std::to_string(i);
+    BlobStoreObject<const std::string> found = reopened.Find(path);
+    if (i < 200 && i % 2 == 0) {
+      EXPECT_EQ(found, nullptr) << path;
+    } else {
+      ASSERT_NE(found, nullptr) << path;
+      EXPECT_EQ(*found, path);
+      if (i < 200) {
+        EXPECT_EQ(found.Index(), indices[i]);
+      }
+    }
+  }
+}
+
+// Two trees that index the same strings share a single blob per string.
+TEST_F(StringInternTableTest, TreesShareInternedKeys) {
+  // The tree expects its head to be the first blob in the store.
+  b_plus_tree::BPlusTree<std::string, int, 4> tree(*blob_store);
+  StringInternTable table = StringInternTable::Create(blob_store);
+  for (int round = 0; round < 2; ++round) {
+    auto txn = tree.CreateTransaction();
+    for (int i = 0; i < 20; ++i) {
+      txn.Insert(table.Intern("tenant/" + std::to_string(i)),
+                 txn.New<int>(round * 100 + i).Downgrade());
+    }
+    ASSERT_TRUE(std::move(txn).Commit());
+  }
+  EXPECT_EQ(table.GetSize(), 20);
+  EXPECT_EQ(table.GetRefCount(table.Find("tenant/7").Index()), 2);
+
+  auto it = tree.Search("tenant/7");
+  ASSERT_NE(it.GetKey(), nullptr);
+  EXPECT_EQ(it.GetKey().Index(), table.Find("tenant/7").Index());
+  ++it;
+  EXPECT_EQ(it.GetKey().Index(), table.Find("tenant/7").Index());
+}
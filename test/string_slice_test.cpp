@@ -106,4 +106,60 @@ TEST_F(StringSliceTest, OperatorSquareBrackets) {
   // Checks that the operator[] function returns the correct characters.
   EXPECT_EQ(slice[0], 'H');
   EXPECT_EQ(slice[4], 'o');
-}
\ No newline at end of file
+}
+
+// Tests compare and common_prefix_length on slices long enough to exercise
+// the vectorized loops, with the first difference at every position.
+TEST_F(StringSliceTest, CompareAndCommonPrefixLength) {
+  std::string a(100, 'a');
+  for (size_t i = 0; i < a.size(); ++i) {
+    std::string b = a;
+    // Bytes are compared as unsigned, so 0x80 orders after 'a'.
+    b[i] = static_cast<char>(0x80);
+    StringSlice slice_a(a.data(), 0, a.size());
+    StringSlice slice_b(b.data(), 0, b.size());
+    EXPECT_EQ(slice_a.common_prefix_length(slice_b), i);
+    EXPECT_LT(slice_a.compare(slice_b), 0);
+    EXPECT_GT(slice_b.compare(slice_a), 0);
+    EXPECT_TRUE(slice_a < slice_b);
+  }
+
+  StringSlice whole(a.data(), 0, a.size());
+  StringSlice prefix(a.data(), 0, 40);
+  EXPECT_EQ(whole.common_prefix_length(prefix), 40);
+  EXPECT_EQ(whole.compare(whole), 0);
+  EXPECT_GT(whole.compare(prefix), 0);
+  EXPECT_LT(prefix.compare(whole), 0);
+}
+
+// Tests find against std::string::find for characters and for needles of
+// every length, at every starting position.
+TEST_F(StringSliceTest, Find) {
+  std::string haystack;
+  for (size_t i = 0; i < 200; ++i) {
+    haystack.push_back(static_cast<char>('a' + (i * 7) % 5));
+  }
+  haystack += "needle";
+  StringSlice slice(haystack.data(), 0, haystack.size());
+
+  EXPECT_EQ(slice.find('n'), haystack.find('n'));
+  EXPECT_EQ(slice.find('z'), StringSlice::npos);
+  EXPECT_EQ(slice.find('a', 201), StringSlice::npos);
+
+  for (size_t length = 0; length <= 40; ++length) {
+    for (size_t start = 0; start + length <= haystack.size(); start += 13) {
+      std::string needle = haystack.substr(start, length);
+      StringSlice needle_slice(needle.data(), 0, needle.size());
+      for (size_t pos = 0; pos <= haystack.size(); pos += 31) {
+        size_t expected = haystack.find(needle, pos);
+        EXPECT_EQ(slice.find(needle_slice, pos),
+                  expected == std::string::npos ? StringSlice::npos : expected)
+            << "needle " << needle << " pos " << pos;
+      }
+    }
+  }
+
+  std::string missing = "needlf";
+  EXPECT_EQ(slice.find(StringSlice(missing.data(), 0, missing.size())),
+            StringSlice::npos);
+}
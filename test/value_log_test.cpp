@@ -0,0 +1,170 @@
+#include "value_log.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "b_plus_tree.h"
+#include "chunk_manager.h"
+#include "gtest/gtest.h"
+#include "test_memory_buffer_factory.h"
+#include "utils.h"
+
+using namespace blob_store;
+using value_log::ValueLog;
+using value_log::ValueRef;
+
+namespace {
+
+// Returns a value of the provided size whose bytes depend on seed.
+std::string MakeValue(int seed, std::size_t size) {
+  std::string value(size, '\0');
+  for (std::size_t i = 0; i < size; ++i) {
+    value[i] = static_cast<char>('a' + (seed + i) % 26);
+  }
+  return value;
+}
+
+StringSlice KeyBytes(const int& key) {
+  return StringSlice(reinterpret_cast<const char*>(&key), 0, sizeof(key));
+}
+
+StringSlice Slice(const std::string& value) {
+  return StringSlice(value.data(), 0, value.size());
+}
+
+}  // namespace
+
+class ValueLogTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ChunkManager dataBuffer(TestMemoryBufferFactory::Get(), "DataBuffer",
+                            4 * utils::GetPageSize());
+    blob_store = new BlobStore(TestMemoryBufferFactory::Get(), "MetadataBuffer",
+                               4096, std::move(dataBuffer));
+  }
+
+  virtual void TearDown() {
+    // cleanup the BlobStore
+    delete blob_store;
+  }
+
+  BlobStore* blob_store;
+};
+
+// Small values get blobs of their own and large ones are appended to the log,
+// which grows by a segment whenever the active one fills up.
+TEST_F(ValueLogTest, PutAndGet) {
+  b_plus_tree::BPlusTree<int, ValueRef, 8> tree(*blob_store);
+  ValueLog log = ValueLog::Create(blob_store, 1024, 16);
+  EXPECT_EQ(log.GetNumSegments(), 1);
+
+  std::vector<ValueRef> refs;
+  {
+    auto txn(tree.CreateTransaction());
+    for (int i = 0; i < 20; ++i) {
+      std::size_t size = i % 4 == 0 ? 8 : 200;
+      std::string value = MakeValue(i, size);
+      refs.push_back(*log.Put(&txn, KeyBytes(i), Slice(value)));
+    }
+    // A value larger than a segment gets a segment of its own.
+    std::string value = MakeValue(20, 3000);
+    refs.push_back(*log.Put(&txn, KeyBytes(20), Slice(value)));
+    std::move(txn).Commit();
+  }
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(refs[i].segment == ValueRef::kInline, i % 4 == 0);
+    EXPECT_EQ(log.Get(refs[i]), MakeValue(i, i % 4 == 0 ? 8 : 200));
+  }
+  EXPECT_EQ(log.Get(refs[20]), MakeValue(20, 3000));
+  EXPECT_GT(log.GetNumSegments(), 3);
+
+  ValueLog reopened = ValueLog::Open(blob_store, log.log_index());
+  EXPECT_EQ(reopened.Get(refs[5]), MakeValue(5, 200));
+}
+
+// Overwritten values become garbage. Collecting the oldest segments moves
+// only the live values, and the segments can be dropped once the tree points
+// at the copies.
+TEST_F(ValueLogTest, CollectRelocatesLiveValues) {
+  using Tree = b_plus_tree::BPlusTree<int, ValueRef, 8>;
+  Tree tree(*blob_store);
+  ValueLog log = ValueLog::Create(blob_store, 1024, 16);
+
+  auto put = [&](auto* txn, int key, const std::string& value) {
+    txn->Delete(key);
+    txn->Insert(txn->template New<int>(key).Downgrade(),
+                log.Put(txn, KeyBytes(key), Slice(value)).Downgrade());
+  };
+
+  std::vector<std::string> expected(10);
+  for (int round = 0; round < 5; ++round) {
+    auto txn(tree.CreateTransaction());
+    for (int key = 0; key < 10; ++key) {
+      // Only even keys are overwritten after the first round.
+      if (round == 0 || key % 2 == 0) {
+        expected[key] = MakeValue(key + round, 100);
+        put(&txn, key, expected[key]);
+      }
+    }
+    std::move(txn).Commit();
+  }
+  std::size_t num_segments = log.GetNumSegments();
+  EXPECT_GT(num_segments, 2);
+
+  // Collects every segment that was sealed before collection started.
+  std::size_t num_relocated = 0;
+  for (std::size_t i = 0; i + 1 < num_segments; ++i) {
+    auto txn(tree.CreateTransaction());
+    std::size_t segment = log.Collect(
+        &txn,
+        [&](const StringSlice& key, const ValueRef& ref) {
+          int k;
+          std::memcpy(&k, key.data(), sizeof(k));
+          auto it = txn.Search(k);
+          return it.GetKey() != nullptr && *it.GetKey() == k &&
+                 *it.GetValue() == ref;
+        },
+        [&](const StringSlice& key, BlobStoreObject<const ValueRef> new_ref) {
+          int k;
+          std::memcpy(&k, key.data(), sizeof(k));
+          txn.Delete(k);
+          txn.Insert(txn.New<int>(k).Downgrade(), std::move(new_ref));
+          ++num_relocated;
+        });
+    ASSERT_NE(segment, BlobStore::InvalidIndex);
+    std::move(txn).Commit();
+    log.DropSegment(segment);
+  }
+  // Every live value was moved at most once.
+  EXPECT_LE(num_relocated, expected.size());
+  EXPECT_LT(log.GetNumSegments(), num_segments);
+
+  for (int key = 0; key < 10; ++key) {
+    auto it = tree.Search(key);
+    ASSERT_NE(it.GetValue(), nullptr);
+    EXPECT_EQ(log.Get(*it.GetValue()), expected[key]);
+  }
+}
+
+// Entries record their sizes in 32 bits, so larger values are rejected before
+// anything is appended.
+TEST_F(ValueLogTest, RejectsOversizedEntries) {
+  b_plus_tree::BPlusTree<int, ValueRef, 8> tree(*blob_store);
+  ValueLog log = ValueLog::Create(blob_store, 1024, 16);
+  std::string value = MakeValue(0, 100);
+  // The sizes are checked before the bytes are read.
+  StringSlice oversized(value.data(), 0, std::size_t(UINT32_MAX) + 1);
+
+  auto txn(tree.CreateTransaction());
+  EXPECT_THROW(log.Put(&txn, KeyBytes(1), oversized), std::length_error);
+  EXPECT_THROW(log.Put(&txn, oversized, Slice(value)), std::length_error);
+  ValueRef ref = *log.Put(&txn, KeyBytes(2), Slice(value));
+  std::move(txn).Commit();
+  // Nothing was appended for the rejected entries.
+  EXPECT_EQ(ref.offset, sizeof(value_log::SegmentHeader) +
+                            sizeof(value_log::EntryHeader) + sizeof(int));
+  EXPECT_EQ(log.Get(ref), value);
+}